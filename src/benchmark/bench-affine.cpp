@@ -0,0 +1,96 @@
+#include <vector>
+#include <string>
+
+#include "bench.h"
+
+#include "affine.h"
+
+// affine<double> operators as the number of variables grows
+
+namespace {
+
+using atom = affine<double>;
+
+// sum of 'n' variables named prefix0..prefix(n-1) with coefficients 1..n
+atom makeSum(const char *prefix, size_t n)
+{
+    atom a(0.5);
+    for (size_t i = 0; i < n; i++) a += atom(double(i + 1), std::string(prefix) + std::to_string(i));
+    return a;
+}
+
+// a += b with the same variables
+template<size_t N>
+void addSame(bench_state &state)
+{
+    atom a = makeSum("v", N), b = makeSum("v", N);
+    while (state.keep_running()) {
+        a += b;
+        do_not_optimize(a);
+    }
+}
+
+// a + b with disjoint variables (the result has 2N terms)
+template<size_t N>
+void addDisjoint(bench_state &state)
+{
+    atom a = makeSum("p", N), b = makeSum("q", N);
+    while (state.keep_running()) {
+        atom c = a + b;
+        do_not_optimize(c);
+    }
+}
+
+// a - a: every term cancels
+template<size_t N>
+void cancel(bench_state &state)
+{
+    atom a = makeSum("v", N);
+    while (state.keep_running()) {
+        atom c = a - a;
+        do_not_optimize(c);
+    }
+}
+
+// scaling by a constant
+template<size_t N>
+void scale(bench_state &state)
+{
+    atom a = makeSum("v", N), k(1.0000001);
+    while (state.keep_running()) {
+        a *= k;
+        do_not_optimize(a);
+    }
+}
+
+// copy construction (results are copied into the parser result vector)
+template<size_t N>
+void copy(bench_state &state)
+{
+    atom a = makeSum("v", N);
+    while (state.keep_running()) {
+        atom c(a);
+        do_not_optimize(c);
+    }
+}
+
+}
+
+BENCH(affine_add_same_1)   { addSame<1>(state); }
+BENCH(affine_add_same_4)   { addSame<4>(state); }
+BENCH(affine_add_same_16)  { addSame<16>(state); }
+BENCH(affine_add_same_256) { addSame<256>(state); }
+
+BENCH(affine_add_disjoint_1)   { addDisjoint<1>(state); }
+BENCH(affine_add_disjoint_4)   { addDisjoint<4>(state); }
+BENCH(affine_add_disjoint_16)  { addDisjoint<16>(state); }
+BENCH(affine_add_disjoint_256) { addDisjoint<256>(state); }
+
+BENCH(affine_cancel_4)   { cancel<4>(state); }
+BENCH(affine_cancel_256) { cancel<256>(state); }
+
+BENCH(affine_scale_4)   { scale<4>(state); }
+BENCH(affine_scale_256) { scale<256>(state); }
+
+BENCH(affine_copy_4)   { copy<4>(state); }
+BENCH(affine_copy_256) { copy<256>(state); }
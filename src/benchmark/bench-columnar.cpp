@@ -0,0 +1,127 @@
+#include <vector>
+#include <string>
+
+#include "bench.h"
+
+#include "lexer.h"
+#include "program.h"
+#include "columnar.h"
+#include "jit.h"
+
+// one formula over a table of rows: evaluator<double> row by row vs. columnar kernels vs. native code
+
+namespace {
+
+const size_t rows = 1 << 16;
+
+const std::string arithmetic = "2.5*a + b/3 - (a-b)*c";
+const std::string transcendental = "2.5*a + b/3 - log(c)*a^1.5";
+
+struct table {
+    std::vector<double> a, b, c;
+
+    table() {
+        for (size_t i = 0; i < rows; i++) {
+            a.push_back(1.0 + (i % 977) * 0.25);
+            b.push_back(2.0 + (i % 613) * 0.125);
+            c.push_back(1.5 + i);
+        }
+    }
+};
+
+void bench_rows(bench_state &state, const std::string &formula)
+{
+    table t;
+    auto p = program<double>::compile(tokenize_view(formula));
+    evaluator<double> ev(p);
+
+    int sa = p.slot("a"), sb = p.slot("b"), sc = p.slot("c");
+    double values[3];
+    std::vector<double> out(rows);
+
+    state.set_items(double(rows));
+    while (state.keep_running()) {
+        for (size_t i = 0; i < rows; i++) {
+            values[sa] = t.a[i]; values[sb] = t.b[i]; values[sc] = t.c[i];
+            out[i] = ev.run(values)[0].atom;
+        }
+        do_not_optimize(out);
+    }
+}
+
+void bench_columns(bench_state &state, const std::string &formula, simd_isa isa, bool approximate = false)
+{
+    table t;
+    auto p = program<double>::compile(tokenize_view(formula));
+    column_evaluator ev(p, 0, isa, approximate);
+    state.set_label(std::string(isaName(ev.isa())) + (approximate ? " approximate" : ""));
+
+    std::vector<const double*> columns(3);
+    columns[p.slot("a")] = t.a.data();
+    columns[p.slot("b")] = t.b.data();
+    columns[p.slot("c")] = t.c.data();
+    std::vector<double> out(rows);
+
+    state.set_items(double(rows));
+    while (state.keep_running()) {
+        ev.run(columns.data(), rows, out.data());
+        do_not_optimize(out);
+    }
+}
+
+void bench_jit(bench_state &state, const std::string &formula, simd_isa isa)
+{
+    table t;
+    auto p = program<double>::compile(tokenize_view(formula));
+    jit_function f(p, 0, isa);
+    state.set_label(f.native() ? f.packed() ? "native avx" : "native sse2" : "fallback");
+
+    std::vector<const double*> columns(3);
+    columns[p.slot("a")] = t.a.data();
+    columns[p.slot("b")] = t.b.data();
+    columns[p.slot("c")] = t.c.data();
+    std::vector<double> out(rows);
+
+    state.set_items(double(rows));
+    while (state.keep_running()) {
+        f.run(columns.data(), rows, out.data());
+        do_not_optimize(out);
+    }
+}
+
+// translation of an expression, and a lookup of the compiled function in the cache
+void bench_jit_compile(bench_state &state, bool cached)
+{
+    jit_cache cache;
+    state.set_items(1);
+    while (state.keep_running()) {
+        if (cached) {
+            do_not_optimize(cache.get(transcendental));
+        }
+        else {
+            jit_function f(program<double>::compile(tokenize_view(transcendental)));
+            do_not_optimize(f.code_size());
+        }
+    }
+}
+
+}
+
+BENCH(columnar_arith_rows)   { bench_rows(state, arithmetic); }
+BENCH(columnar_arith_scalar) { bench_columns(state, arithmetic, simd_isa::scalar); }
+BENCH(columnar_arith_sse2)   { bench_columns(state, arithmetic, simd_isa::sse2); }
+BENCH(columnar_arith_avx2)   { bench_columns(state, arithmetic, simd_isa::avx2); }
+BENCH(columnar_arith_jit_sse2) { bench_jit(state, arithmetic, simd_isa::sse2); }
+BENCH(columnar_arith_jit_avx)  { bench_jit(state, arithmetic, simd_isa::avx2); }
+
+BENCH(columnar_log_pow_rows)   { bench_rows(state, transcendental); }
+BENCH(columnar_log_pow_scalar) { bench_columns(state, transcendental, simd_isa::scalar); }
+BENCH(columnar_log_pow_sse2)   { bench_columns(state, transcendental, simd_isa::sse2); }
+BENCH(columnar_log_pow_avx2)   { bench_columns(state, transcendental, simd_isa::avx2); }
+BENCH(columnar_log_pow_sse2_approximate) { bench_columns(state, transcendental, simd_isa::sse2, true); }
+BENCH(columnar_log_pow_avx2_approximate) { bench_columns(state, transcendental, simd_isa::avx2, true); }
+BENCH(columnar_log_pow_jit_sse2) { bench_jit(state, transcendental, simd_isa::sse2); }
+BENCH(columnar_log_pow_jit_avx)  { bench_jit(state, transcendental, simd_isa::avx2); }
+
+BENCH(jit_compile)   { bench_jit_compile(state, false); }
+BENCH(jit_cache_hit) { bench_jit_compile(state, true); }
@@ -0,0 +1,72 @@
+#include <string>
+
+#include "bench.h"
+#include "corpus.h"
+
+#include "driver.h"
+#include "batch.h"
+#include "output.h"
+
+// end-to-end line processing of the calculator driver on generated corpora
+
+namespace {
+
+// discards the output, so only the line processing and formatting is measured
+class null_sink : public output_sink {
+public:
+    void write(bool, const char *p, size_t n) override { do_not_optimize(p); bytes += n; };
+    void flush() override {};
+
+    size_t bytes = 0;
+};
+
+void processCorpus(bench_state &state, corpus_kind kind, size_t lines, bool cached = false, bool use_arena = true,
+                   line_stats *stats = nullptr)
+{
+    std::string text = makeCorpus(kind, lines);
+    line_cache cache(64 << 20);
+    line_context ctx;
+    if (cached) ctx.cache = &cache;
+    ctx.use_arena = use_arena;
+    ctx.stats = stats;
+
+    auto handler = [&ctx](const char *s, size_t n, size_t, block_output &out) {
+        processLine(s, n, ctx, out);
+    };
+
+    state.set_items(double(lines));
+    state.set_label("lines/s");
+    while (state.keep_running()) {
+        null_sink sink;
+        processBatch(text.data(), text.size(), sink, 1, handler);
+        do_not_optimize(sink.bytes);
+    }
+}
+
+}
+
+BENCH(driver_mixed)        { processCorpus(state, corpus_kind::mixed, 10000); }
+BENCH(driver_mixed_cached) { processCorpus(state, corpus_kind::mixed, 10000, true); }
+BENCH(driver_nesting)      { processCorpus(state, corpus_kind::nesting, 1000); }
+BENCH(driver_wide)         { processCorpus(state, corpus_kind::wide, 1000); }
+BENCH(driver_variables)    { processCorpus(state, corpus_kind::variables, 1000); }
+
+// temporaries from the heap instead of the per-line arena
+BENCH(driver_mixed_heap)     { processCorpus(state, corpus_kind::mixed, 10000, false, false); }
+BENCH(driver_wide_heap)      { processCorpus(state, corpus_kind::wide, 1000, false, false); }
+BENCH(driver_variables_heap) { processCorpus(state, corpus_kind::variables, 1000, false, false); }
+BENCH(driver_errors)       { processCorpus(state, corpus_kind::errors, 10000); }
+
+// cost of the instrumentation (see stats.h): counters only, and with every 100th line traced
+BENCH(driver_mixed_stats)
+{
+    line_stats stats;
+    processCorpus(state, corpus_kind::mixed, 10000, false, true, &stats);
+}
+
+BENCH(driver_mixed_traced)
+{
+    line_stats stats(0, 100);
+    processCorpus(state, corpus_kind::mixed, 10000, false, true, &stats);
+    do_not_optimize(stats.events.size());
+}
@@ -0,0 +1,80 @@
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include "bench.h"
+#include "corpus.h"
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "format.h"
+
+// formatting of parsed results: the stream output against the formats of result_formatter
+
+namespace {
+
+using atom = affine<double>;
+using result = parser<atom>::result;
+
+// the results of the lines of a corpus that parse
+std::vector<std::vector<result>> parseCorpus(corpus_kind kind, size_t lines)
+{
+    std::vector<std::vector<result>> parsed;
+    for (auto &line : corpusLines(kind, lines)) {
+        std::vector<result> r;
+        auto tokens = tokenize_view(line);
+        if (parser<atom>::try_parse(tokens, r).ok()) parsed.push_back(std::move(r));
+    }
+    return parsed;
+}
+
+// the previous driver output: every result written to a stream
+void formatStream(bench_state &state, corpus_kind kind, size_t lines)
+{
+    auto parsed = parseCorpus(kind, lines);
+    std::ostringstream os;
+
+    state.set_items(double(parsed.size()));
+    state.set_label("lines/s");
+    while (state.keep_running()) {
+        os.str(std::string());
+        for (auto &line : parsed) {
+            for (auto &z : line) os << "Result: " << z.atom << '\n';
+        }
+        do_not_optimize(os.tellp());
+    }
+}
+
+void formatBuffer(bench_state &state, corpus_kind kind, size_t lines, output_format format)
+{
+    auto parsed = parseCorpus(kind, lines);
+    result_formatter<double> f(format);
+    std::string buf;
+
+    state.set_items(double(parsed.size()));
+    state.set_label("lines/s");
+    while (state.keep_running()) {
+        buf.clear();
+        for (auto &line : parsed) {
+            f.line();
+            for (auto &z : line) {
+                if (z.equal_to_zero) f.equation(buf, z.atom);
+                else                 f.expression(buf, z.atom);
+            }
+        }
+        do_not_optimize(buf.data());
+    }
+}
+
+}
+
+BENCH(format_stream_mixed) { formatStream(state, corpus_kind::mixed, 10000); }
+BENCH(format_text_mixed)   { formatBuffer(state, corpus_kind::mixed, 10000, output_format::text); }
+BENCH(format_json_mixed)   { formatBuffer(state, corpus_kind::mixed, 10000, output_format::json); }
+BENCH(format_binary_mixed) { formatBuffer(state, corpus_kind::mixed, 10000, output_format::binary); }
+
+BENCH(format_stream_wide) { formatStream(state, corpus_kind::wide, 1000); }
+BENCH(format_text_wide)   { formatBuffer(state, corpus_kind::wide, 1000, output_format::text); }
+BENCH(format_json_wide)   { formatBuffer(state, corpus_kind::wide, 1000, output_format::json); }
+BENCH(format_binary_wide) { formatBuffer(state, corpus_kind::wide, 1000, output_format::binary); }
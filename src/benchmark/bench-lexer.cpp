@@ -0,0 +1,84 @@
+#include <vector>
+#include <string>
+
+#include "bench.h"
+#include "corpus.h"
+
+#include "lexer.h"
+#include "cpu.h"
+
+// tokenizer throughput: short lines, one very long literal, a generated corpus; lines of
+// hundreds of KB with the scanner of every instruction set
+
+namespace {
+
+const std::string short_line = "2*x + 1 = 3 - log(10)*y";
+
+// 1/0.000...0 with about 600 digits, as in ParserErrors.VerySmallNumber
+const std::string long_literal = "1/0." + std::string(600, '0');
+
+// 256 KB lines: one literal, whitespace around a few tokens, one identifier
+const size_t huge = 1 << 18;
+const std::string huge_literal = "1/0." + std::string(huge, '0') + "1";
+const std::string huge_spaces = std::string(huge / 2, ' ') + "x = 1" + std::string(huge / 2, '\t');
+const std::string huge_identifier = "2*x" + std::string(huge, 'y') + "9 = 1";
+
+void tokenizeLine(bench_state &state, const std::string &line)
+{
+    std::vector<token_view> t;
+    state.set_items(double(line.size()));
+    state.set_label("bytes/s");
+    while (state.keep_running()) {
+        tokenize(line.data(), line.size(), t);
+        do_not_optimize(t);
+    }
+}
+
+void tokenizeLine(bench_state &state, const std::string &line, simd_isa isa)
+{
+    std::vector<token_view> t;
+    state.set_items(double(line.size()));
+    state.set_label(std::string("bytes/s ") + isaName(isa));
+    while (state.keep_running()) {
+        tokenize(line.data(), line.size(), t, isa);
+        do_not_optimize(t);
+    }
+}
+
+}
+
+BENCH(lexer_short_line)   { tokenizeLine(state, short_line); }
+BENCH(lexer_long_literal) { tokenizeLine(state, long_literal); }
+
+BENCH(lexer_huge_literal_scalar)    { tokenizeLine(state, huge_literal, simd_isa::scalar); }
+BENCH(lexer_huge_literal_sse2)      { tokenizeLine(state, huge_literal, simd_isa::sse2); }
+BENCH(lexer_huge_literal_avx2)      { tokenizeLine(state, huge_literal, simd_isa::avx2); }
+BENCH(lexer_huge_spaces_scalar)     { tokenizeLine(state, huge_spaces, simd_isa::scalar); }
+BENCH(lexer_huge_spaces_avx2)       { tokenizeLine(state, huge_spaces, simd_isa::avx2); }
+BENCH(lexer_huge_identifier_scalar) { tokenizeLine(state, huge_identifier, simd_isa::scalar); }
+BENCH(lexer_huge_identifier_avx2)   { tokenizeLine(state, huge_identifier, simd_isa::avx2); }
+
+// string-owning tokens of the compatibility interface
+BENCH(lexer_short_line_copy)
+{
+    state.set_items(double(short_line.size()));
+    state.set_label("bytes/s");
+    while (state.keep_running()) {
+        auto t = tokenize(short_line);
+        do_not_optimize(t);
+    }
+}
+
+BENCH(lexer_corpus_mixed)
+{
+    auto lines = corpusLines(corpus_kind::mixed, 1000);
+    std::vector<token_view> t;
+    state.set_items(double(lines.size()));
+    state.set_label("lines/s");
+    while (state.keep_running()) {
+        for (auto &l : lines) {
+            tokenize(l.data(), l.size(), t);
+            do_not_optimize(t);
+        }
+    }
+}
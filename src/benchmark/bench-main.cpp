@@ -0,0 +1,113 @@
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench.h"
+#include "corpus.h"
+#include "load.h"
+
+std::vector<bench_case> &bench_registry()
+{
+    static std::vector<bench_case> r;
+    return r;
+}
+
+// run one benchmark with growing iteration counts until it takes at least 'min_time'
+static void run_case(const bench_case &c, double min_time)
+{
+    using clock = std::chrono::steady_clock;
+
+    for (uint64_t n = 1;; n *= 4) {
+        bench_state state(n);
+
+        state.start = clock::now();
+        c.fn(state);
+        double elapsed = std::chrono::duration<double>(clock::now() - state.start).count();
+
+        if (elapsed >= min_time || n >= (uint64_t(1) << 40)) {
+            double per_iter = elapsed / n;
+            std::cout << std::left << std::setw(40) << c.name
+                      << std::right << std::setw(12) << n
+                      << std::setw(14) << std::fixed << std::setprecision(1) << per_iter * 1e9 << " ns"
+                      << std::setw(16) << std::setprecision(0) << state.items / per_iter << " items/s";
+            if (!state.label.empty()) std::cout << "  " << state.label;
+            std::cout << std::endl;
+            return;
+        }
+    }
+}
+
+static int loadUsage()
+{
+    std::cerr << "usage: benchmark --load (--unix PATH | --port N) [--connections N] [--depth N]\n"
+                 "                        [--requests N] [--kind mixed|nesting|wide|variables|errors]" << std::endl;
+    return 1;
+}
+
+// load generator mode: options after '--load'
+static int load(int argc, char *argv[], int first)
+{
+    load_options o;
+    for (int i = first; i < argc; i++) {
+        if      (!strcmp(argv[i], "--unix") && i + 1 < argc)        o.unix_path = argv[++i];
+        else if (!strcmp(argv[i], "--port") && i + 1 < argc)        o.tcp_port = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--connections") && i + 1 < argc) o.connections = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--depth") && i + 1 < argc)       o.depth = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--requests") && i + 1 < argc)    o.requests = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--kind") && i + 1 < argc && corpusKind(argv[i + 1], o.kind)) i++;
+        else return loadUsage();
+    }
+    if (o.unix_path.empty() == (o.tcp_port < 0)) return loadUsage();
+
+    load_report r;
+    std::string error;
+    if (!runLoad(o, r, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(0)
+              << r.requests << " requests in " << std::setprecision(3) << r.seconds << " s: "
+              << std::setprecision(0) << r.requests / r.seconds << " requests/s, "
+              << std::setprecision(1) << r.bytes / r.seconds / 1e6 << " MB/s of answers\n"
+              << "latency (us): p50 " << r.percentile(0.5) << "  p90 " << r.percentile(0.9)
+              << "  p99 " << r.percentile(0.99) << "  p99.9 " << r.percentile(0.999)
+              << "  max " << (r.latency.empty() ? 0 : r.latency.back()) << std::endl;
+    return 0;
+}
+
+// usage: benchmark [--min-time seconds] [name-filter...]
+//        benchmark --corpus kind lines [seed]    writes a generated corpus to stdout
+//        benchmark --load ...                    load generator for the calculator server
+int main(int argc, char *argv[])
+{
+    double min_time = 0.5;
+    std::vector<const char*> filters;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--min-time") && i + 1 < argc) min_time = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--corpus") && i + 2 < argc) {
+            corpus_kind kind;
+            if (!corpusKind(argv[i + 1], kind)) {
+                std::cerr << "corpus kinds: mixed, nesting, wide, variables, errors, redundant" << std::endl;
+                return 1;
+            }
+            size_t lines = strtoul(argv[i + 2], nullptr, 10);
+            uint64_t seed = i + 3 < argc ? strtoull(argv[i + 3], nullptr, 10) : 1;
+            std::cout << makeCorpus(kind, lines, seed);
+            return 0;
+        }
+        else if (!strcmp(argv[i], "--load")) return load(argc, argv, i + 1);
+        else filters.push_back(argv[i]);
+    }
+
+    for (auto &c : bench_registry()) {
+        bool selected = filters.empty();
+        for (auto f : filters) selected = selected || strstr(c.name, f) != nullptr;
+        if (selected) run_case(c, min_time);
+    }
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdio>
+
+#include "bench.h"
+
+#include "numbers.h"
+
+// number literal conversion: parseNumber against the stream extraction it replaces,
+// %g and shortest formatting against printf / ostream
+
+namespace {
+
+// typical literals of the corpus and a few long ones that take the slow path
+const std::vector<std::string> literals = {
+    "0", "1", "42", "999", "3.14", "0.5", "123.45", "2.5e3", "1e-7", "0.001",
+    "12345678.901", "6.02214076e23", "0.1234567890123456789", "1.7976931348623157e308"
+};
+
+const std::vector<double> values = {
+    0, 1, 42, 0.1, 1.0 / 3, 2.5e-7, 123456.789, 6.02214076e23, -17.25, 1e100
+};
+
+}
+
+BENCH(numbers_parse)
+{
+    state.set_items(double(literals.size()));
+    state.set_label("literals/s");
+    double v;
+    while (state.keep_running()) {
+        for (auto &l : literals) {
+            parseNumber(l.data(), l.data() + l.size(), v);
+            do_not_optimize(v);
+        }
+    }
+}
+
+BENCH(numbers_parse_istringstream)
+{
+    state.set_items(double(literals.size()));
+    state.set_label("literals/s");
+    double v;
+    while (state.keep_running()) {
+        for (auto &l : literals) {
+            std::istringstream ss(l);
+            ss >> v;
+            do_not_optimize(v);
+        }
+    }
+}
+
+BENCH(numbers_format_general)
+{
+    state.set_items(double(values.size()));
+    state.set_label("numbers/s");
+    char buf[number_buffer];
+    while (state.keep_running()) {
+        for (double v : values) {
+            do_not_optimize(formatGeneral(buf, v));
+        }
+    }
+}
+
+BENCH(numbers_format_ostringstream)
+{
+    state.set_items(double(values.size()));
+    state.set_label("numbers/s");
+    while (state.keep_running()) {
+        for (double v : values) {
+            std::ostringstream ss;
+            ss << v;
+            do_not_optimize(ss);
+        }
+    }
+}
+
+BENCH(numbers_format_shortest)
+{
+    state.set_items(double(values.size()));
+    state.set_label("numbers/s");
+    char buf[number_buffer];
+    while (state.keep_running()) {
+        for (double v : values) {
+            do_not_optimize(formatShortest(buf, v));
+        }
+    }
+}
+
+BENCH(numbers_format_printf17)
+{
+    state.set_items(double(values.size()));
+    state.set_label("numbers/s");
+    char buf[number_buffer];
+    while (state.keep_running()) {
+        for (double v : values) {
+            do_not_optimize(snprintf(buf, sizeof(buf), "%.17g", v));
+        }
+    }
+}
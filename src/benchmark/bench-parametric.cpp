@@ -0,0 +1,96 @@
+#include <vector>
+#include <string>
+
+#include "bench.h"
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "numbers.h"
+#include "format.h"
+#include "parametric.h"
+
+// one equation shape for many parameter rows: a parsed line per row vs. the template solved in bulk
+
+namespace {
+
+const size_t rows = 1 << 14;
+
+const std::string equation = "a*x + b = c*x - d";
+
+column_table parameters()
+{
+    column_table t;
+    t.names = { "a", "b", "c", "d" };
+    t.data.resize(4);
+    for (size_t i = 0; i < rows; i++) {
+        t.data[0].push_back(1.0 + (i % 977) * 0.25);
+        t.data[1].push_back(2.0 + (i % 613) * 0.125);
+        t.data[2].push_back(double(i % 7));
+        t.data[3].push_back(0.5 * i);
+    }
+    t.rows = rows;
+    return t;
+}
+
+// the line of every row is written, parsed and its solution printed
+void bench_lines(bench_state &state)
+{
+    auto t = parameters();
+    result_formatter<double> f;
+    std::vector<token_view> tokens;
+    std::vector<parser<affine<double>>::result> results;
+    std::string line, text;
+    char buf[number_buffer];
+
+    state.set_items(double(rows));
+    state.set_label("rows/s");
+    while (state.keep_running()) {
+        text.clear();
+        for (size_t i = 0; i < rows; i++) {
+            line.clear();
+            for (size_t k = 0; k < 4; k++) {
+                line.append(buf, formatShortest(buf, t.data[k][i]));
+                line += k == 0 ? "*x + " : k == 1 ? " = " : k == 2 ? "*x - " : "";
+            }
+            tokenize(line.data(), line.size(), tokens);
+            parser<affine<double>>::try_parse(tokens, results);
+            f.equation(text, results[0].atom);
+        }
+        do_not_optimize(text.data());
+    }
+}
+
+void bench_template(bench_state &state, simd_isa isa, bool jit, bool print)
+{
+    auto t = parameters();
+    parametric_equation pe(tokenize_view(equation), "x");
+    result_formatter<double> f;
+    std::string text;
+    state.set_label(isaName(isa));
+
+    state.set_items(double(rows));
+    while (state.keep_running()) {
+        auto r = pe.solve(t, isa, jit);
+        if (print) {
+            text.clear();
+            for (size_t i = 0; i < rows; i++) {
+                if (r.coef[i] != 0) f.solution(text, pe.unknown(), r.x[i]);
+                else                f.cancelled(text, pe.unknown(), r.constant[i] == 0);
+            }
+        }
+        do_not_optimize(r.x.data());
+        do_not_optimize(text.data());
+    }
+}
+
+}
+
+BENCH(parametric_lines)           { bench_lines(state); }
+BENCH(parametric_template_scalar) { bench_template(state, simd_isa::scalar, false, true); }
+BENCH(parametric_template_avx2)   { bench_template(state, simd_isa::avx2, false, true); }
+
+// the solutions alone, without the text
+BENCH(parametric_solve_scalar)    { bench_template(state, simd_isa::scalar, false, false); }
+BENCH(parametric_solve_avx2)      { bench_template(state, simd_isa::avx2, false, false); }
+BENCH(parametric_solve_jit)       { bench_template(state, simd_isa::avx2, true, false); }
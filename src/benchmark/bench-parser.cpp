@@ -0,0 +1,84 @@
+#include <vector>
+#include <string>
+
+#include "bench.h"
+#include "corpus.h"
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+
+// parser throughput of the double and affine<double> backends: iterative and recursive parser,
+// throwing and non-throwing interface
+
+namespace {
+
+// numeric expressions, valid for both backends
+const std::vector<std::string> numeric = {
+    "(3+(4-1))*5",
+    "log(100)^2 - 2^-0.5*7",
+    "1.5*2.5/3.5 + 4.5 - -5.5, 6/7",
+    "((((1+2)*3+4)*5+6)*7+8)/9",
+};
+
+template<typename T>
+void parseLines(bench_state &state, const std::vector<std::string> &lines, parse_method method = parse_method::iterative)
+{
+    std::vector<std::vector<token_view>> tokens;
+    for (auto &l : lines) tokens.push_back(tokenize_view(l));
+
+    state.set_items(double(lines.size()));
+    state.set_label("lines/s");
+    while (state.keep_running()) {
+        for (auto &t : tokens) {
+            try {
+                auto r = parser<T>::parse(t, method);
+                do_not_optimize(r);
+            }
+            catch (typename parser<T>::error &e) {
+                do_not_optimize(e.t.pos);
+            }
+        }
+    }
+}
+
+// the same through the non-throwing interface
+template<typename T>
+void tryParseLines(bench_state &state, const std::vector<std::string> &lines)
+{
+    std::vector<std::vector<token_view>> tokens;
+    for (auto &l : lines) tokens.push_back(tokenize_view(l));
+
+    state.set_items(double(lines.size()));
+    state.set_label("lines/s");
+    std::vector<typename parser<T>::result> r;
+    while (state.keep_running()) {
+        for (auto &t : tokens) {
+            r.clear();
+            auto s = parser<T>::try_parse(t, r);
+            do_not_optimize(s);
+            do_not_optimize(r);
+        }
+    }
+}
+
+}
+
+BENCH(parser_numeric_double) { parseLines<double>(state, numeric); }
+BENCH(parser_numeric_affine) { parseLines<affine<double>>(state, numeric); }
+
+BENCH(parser_mixed_affine)     { parseLines<affine<double>>(state, corpusLines(corpus_kind::mixed, 1000)); }
+BENCH(parser_nesting_affine)   { parseLines<affine<double>>(state, corpusLines(corpus_kind::nesting, 200)); }
+BENCH(parser_wide_affine)      { parseLines<affine<double>>(state, corpusLines(corpus_kind::wide, 100)); }
+BENCH(parser_variables_affine) { parseLines<affine<double>>(state, corpusLines(corpus_kind::variables, 200)); }
+BENCH(parser_errors_affine)    { parseLines<affine<double>>(state, corpusLines(corpus_kind::errors, 1000)); }
+
+// the recursive descent parser, for comparison
+BENCH(parser_numeric_double_recursive)   { parseLines<double>(state, numeric, parse_method::recursive); }
+BENCH(parser_numeric_affine_recursive)   { parseLines<affine<double>>(state, numeric, parse_method::recursive); }
+BENCH(parser_mixed_affine_recursive)     { parseLines<affine<double>>(state, corpusLines(corpus_kind::mixed, 1000), parse_method::recursive); }
+BENCH(parser_nesting_affine_recursive)   { parseLines<affine<double>>(state, corpusLines(corpus_kind::nesting, 200), parse_method::recursive); }
+BENCH(parser_wide_affine_recursive)      { parseLines<affine<double>>(state, corpusLines(corpus_kind::wide, 100), parse_method::recursive); }
+
+BENCH(parser_mixed_affine_try)  { tryParseLines<affine<double>>(state, corpusLines(corpus_kind::mixed, 1000)); }
+BENCH(parser_errors_affine_try) { tryParseLines<affine<double>>(state, corpusLines(corpus_kind::errors, 1000)); }
@@ -0,0 +1,117 @@
+#include <vector>
+#include <string>
+#include <sstream>
+
+#include "bench.h"
+#include "corpus.h"
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "system.h"
+#include "double_double.h"
+#include "float128.h"
+#include "rational.h"
+
+#if defined(__has_include)
+#if __has_include(<boost/multiprecision/cpp_dec_float.hpp>)
+#include <boost/multiprecision/cpp_dec_float.hpp>
+#define BENCH_CPP_DEC_FLOAT
+#endif
+#endif
+
+// number types of the affine backend on the same input: double, double_double, float128 (with
+// libquadmath), the exact rational and boost's 50 digit cpp_dec_float (when its headers are
+// installed); the rational functions benchmark is left out, its log and powers are errors
+
+namespace {
+
+// evaluate the lines and print their results, as the driver does
+template<typename T>
+void mixedLines(bench_state &state)
+{
+    std::vector<std::vector<token_view>> tokens;
+    auto lines = corpusLines(corpus_kind::mixed, 1000);
+    for (auto &l : lines) tokens.push_back(tokenize_view(l));
+
+    state.set_items(double(lines.size()));
+    state.set_label("lines/s");
+    std::vector<typename parser<affine<T>>::result> r;
+    std::ostringstream out;
+    while (state.keep_running()) {
+        out.str(std::string());
+        for (auto &t : tokens) {
+            r.clear();
+            parser<affine<T>>::try_parse(t, r);
+            for (auto &z : r) out << z.atom << '\n';
+        }
+        do_not_optimize(out);
+    }
+}
+
+// the n x n Hilbert system, whose condition number grows as e^(3.5 n)
+std::string hilbert(int n)
+{
+    std::string eqs;
+    for (int i = 1; i <= n; i++) {
+        for (int j = 1; j <= n; j++) eqs += (j > 1 ? " + x" : "x") + std::to_string(j) + "/" + std::to_string(i + j - 1);
+        eqs += i < n ? " = 1, " : " = 1";
+    }
+    return eqs;
+}
+
+// parse and solve the system
+template<typename T>
+void hilbertSystem(bench_state &state)
+{
+    std::string eqs = hilbert(10);
+    auto tokens = tokenize_view(eqs);
+
+    state.set_label("systems/s");
+    while (state.keep_running()) {
+        sparse_system<T> system;
+        for (auto &r : parser<affine<T>>::parse(tokens)) system.add(r.atom);
+        auto s = system.solve();
+        do_not_optimize(s);
+    }
+}
+
+// log and pow of the constants
+template<typename T>
+void functions(bench_state &state)
+{
+    std::string expr = "log(2.5) + 1.5^0.3 - log(7)^2 + 2^-1.5";
+    auto tokens = tokenize_view(expr);
+
+    state.set_label("lines/s");
+    while (state.keep_running()) {
+        auto r = parser<T>::parse(tokens);
+        do_not_optimize(r);
+    }
+}
+
+}
+
+BENCH(precision_mixed_double)          { mixedLines<double>(state); }
+BENCH(precision_mixed_double_double)   { mixedLines<double_double>(state); }
+BENCH(precision_hilbert_double)        { hilbertSystem<double>(state); }
+BENCH(precision_hilbert_double_double) { hilbertSystem<double_double>(state); }
+BENCH(precision_functions_double)        { functions<double>(state); }
+BENCH(precision_functions_double_double) { functions<double_double>(state); }
+BENCH(precision_mixed_rational)        { mixedLines<rational>(state); }
+BENCH(precision_hilbert_rational)      { hilbertSystem<rational>(state); }
+
+#ifdef CALCULATOR_FLOAT128
+BENCH(precision_mixed_float128)        { mixedLines<float128>(state); }
+BENCH(precision_hilbert_float128)      { hilbertSystem<float128>(state); }
+BENCH(precision_functions_float128)    { functions<float128>(state); }
+#endif
+
+#ifdef BENCH_CPP_DEC_FLOAT
+// without expression templates, whose result types std::max in system.h can't deduce
+using dec_float_50 = boost::multiprecision::number<boost::multiprecision::cpp_dec_float<50>, boost::multiprecision::et_off>;
+
+BENCH(precision_mixed_cpp_dec_float)     { mixedLines<dec_float_50>(state); }
+BENCH(precision_hilbert_cpp_dec_float)   { hilbertSystem<dec_float_50>(state); }
+BENCH(precision_functions_cpp_dec_float) { functions<dec_float_50>(state); }
+#endif
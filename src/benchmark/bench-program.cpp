@@ -0,0 +1,176 @@
+#include <vector>
+#include <string>
+#include <sstream>
+
+#include "bench.h"
+#include "corpus.h"
+
+#include "lexer.h"
+#include "parser.h"
+#include "program.h"
+#include "affine.h"
+
+// repeated evaluation of one formula: reparsing the substituted text vs. a compiled program;
+// lines with repeated subterms: compiled programs with and without optimize(), and its cost
+
+namespace {
+
+const std::string formula = "2.5*a + b/3 - log(c)*(a-b)^2";
+const size_t rows = 1024;
+
+struct binding { double a, b, c; };
+
+std::vector<binding> make_bindings()
+{
+    std::vector<binding> r;
+    for (size_t i = 0; i < rows; i++) r.push_back({ 1.0 + i * 0.25, 2.0 - i * 0.125, 1.5 + i });
+    return r;
+}
+
+// formula text with the values substituted for the variables
+std::vector<std::string> make_lines(const std::vector<binding> &bs)
+{
+    std::vector<std::string> r;
+    for (auto &b : bs) {
+        std::ostringstream ss;
+        ss.precision(17);
+        ss << "2.5*" << b.a << " + " << b.b << "/3 - log(" << b.c << ")*(" << b.a << "-" << b.b << ")^2";
+        r.push_back(ss.str());
+    }
+    return r;
+}
+
+}
+
+BENCH(program_reparse_double)
+{
+    auto lines = make_lines(make_bindings());
+    std::vector<token_view> t;
+
+    for (size_t i = 0; state.keep_running(); i++) {
+        auto &line = lines[i % rows];
+        tokenize(line.data(), line.size(), t);
+        auto r = parser<double>::parse(t);
+        do_not_optimize(r[0].atom);
+    }
+}
+
+BENCH(program_compile_double)
+{
+    auto t = tokenize_view(formula);
+
+    while (state.keep_running()) {
+        auto p = program<double>::compile(t);
+        do_not_optimize(p.code);
+    }
+}
+
+BENCH(program_eval_double)
+{
+    auto bs = make_bindings();
+    auto p = program<double>::compile(tokenize_view(formula));
+    evaluator<double> ev(p);
+
+    int sa = p.slot("a"), sb = p.slot("b"), sc = p.slot("c");
+    double values[3];
+
+    for (size_t i = 0; state.keep_running(); i++) {
+        auto &b = bs[i % rows];
+        values[sa] = b.a; values[sb] = b.b; values[sc] = b.c;
+        auto &r = ev.run(values);
+        do_not_optimize(r[0].atom);
+    }
+}
+
+BENCH(program_reparse_affine)
+{
+    auto lines = make_lines(make_bindings());
+    std::vector<token_view> t;
+
+    for (size_t i = 0; state.keep_running(); i++) {
+        auto &line = lines[i % rows];
+        tokenize(line.data(), line.size(), t);
+        auto r = parser<affine<double>>::parse(t);
+        do_not_optimize(r[0].atom);
+    }
+}
+
+BENCH(program_eval_affine)
+{
+    using atom = affine<double>;
+
+    auto bs = make_bindings();
+    auto p = program<atom>::compile(tokenize_view(formula));
+    evaluator<atom> ev(p);
+
+    int sa = p.slot("a"), sb = p.slot("b"), sc = p.slot("c");
+    atom values[3];
+
+    for (size_t i = 0; state.keep_running(); i++) {
+        auto &b = bs[i % rows];
+        values[sa] = atom(b.a); values[sb] = atom(b.b); values[sc] = atom(b.c);
+        auto &r = ev.run(values);
+        do_not_optimize(r[0].atom);
+    }
+}
+
+namespace {
+
+// value bound to a variable
+template<typename T>
+T variable(const std::string &) { return T(1.5); }
+
+template<>
+affine<double> variable<affine<double>>(const std::string &name) { return affine<double>(1, name); }
+
+// the programs of the redundant corpus, each evaluated once per iteration; the variables are
+// bound to numbers for double and stand for themselves for affine
+template<typename T>
+void redundantPrograms(bench_state &state, bool optimize)
+{
+    std::vector<program<T>> programs;
+    std::vector<std::vector<T>> bindings;
+    size_t before = 0, after = 0;
+    for (auto &l : corpusLines(corpus_kind::redundant, 200)) {
+        programs.push_back(program<T>::compile(tokenize_view(l)));
+        size_t ops = programs.back().code.size();
+        before += ops;
+        after += optimize ? ops - programs.back().optimize().eliminated() : ops;
+        bindings.emplace_back();
+        for (auto &v : programs.back().vars) bindings.back().push_back(variable<T>(v));
+    }
+
+    std::vector<evaluator<T>> evaluators(programs.begin(), programs.end());
+    state.set_items(double(programs.size()));
+    state.set_label("lines/s, " + std::to_string(after * 100 / before) + "% of the ops");
+    while (state.keep_running()) {
+        for (size_t i = 0; i < programs.size(); i++) do_not_optimize(evaluators[i].run(bindings[i].data()));
+    }
+}
+
+// the cost of the optimization: compiling the lines with and without it
+void redundantCompile(bench_state &state, bool optimize)
+{
+    std::vector<std::vector<token_view>> tokens;
+    auto lines = corpusLines(corpus_kind::redundant, 200);
+    for (auto &l : lines) tokens.push_back(tokenize_view(l));
+
+    state.set_items(double(lines.size()));
+    state.set_label("lines/s");
+    while (state.keep_running()) {
+        for (auto &t : tokens) {
+            auto p = program<affine<double>>::compile(t);
+            if (optimize) p.optimize();
+            do_not_optimize(p.code);
+        }
+    }
+}
+
+}
+
+BENCH(program_redundant_double)           { redundantPrograms<double>(state, false); }
+BENCH(program_redundant_double_optimized) { redundantPrograms<double>(state, true); }
+BENCH(program_redundant_affine)           { redundantPrograms<affine<double>>(state, false); }
+BENCH(program_redundant_affine_optimized) { redundantPrograms<affine<double>>(state, true); }
+BENCH(program_redundant_compile)          { redundantCompile(state, false); }
+BENCH(program_redundant_compile_optimize) { redundantCompile(state, true); }
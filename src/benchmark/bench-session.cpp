@@ -0,0 +1,84 @@
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+#include "lexer.h"
+#include "session.h"
+#include "arena.h"
+
+// worksheet updates: replaying every definition vs. the incremental recomputation of a session
+
+namespace {
+
+const int inputs = 100;
+const int chain = 10;
+
+// 'rate' and 100 inputs, each feeding a chain of 10 definitions
+std::vector<std::string> make_worksheet()
+{
+    std::vector<std::string> r{ "rate = 0.05" };
+    for (int i = 0; i < inputs; i++) {
+        auto in = "in" + std::to_string(i), c = "c" + std::to_string(i) + "n";
+        r.push_back(in + " = " + std::to_string(i + 1));
+        r.push_back(c + "0 = " + in + "*rate + 2");
+        for (int j = 1; j < chain; j++) {
+            r.push_back(c + std::to_string(j) + " = " + c + std::to_string(j - 1) + "*1.01 + " + in);
+        }
+    }
+    return r;
+}
+
+class worksheet_runner {
+public:
+    void assign(const std::string &line) {
+        {
+            arena_scope scope(&scratch);
+            tokenize(line.data(), line.size(), tokens);
+            auto &updated = ws.assign(tokens, line.data(), line.size());
+            do_not_optimize(updated);
+        }
+        scratch.reset();
+    }
+
+    session<double> ws;
+
+private:
+    std::vector<token_view> tokens;
+    arena scratch;
+};
+
+// change one definition per iteration, alternating between two values
+void update(bench_state &state, const std::string &name)
+{
+    worksheet_runner run;
+    for (auto &line : make_worksheet()) run.assign(line);
+    const std::string lines[] = { name + " = 0.5", name + " = 0.25" };
+
+    state.set_label("updates/s");
+    for (size_t i = 0; state.keep_running(); i++) run.assign(lines[i % 2]);
+}
+
+}
+
+// the whole worksheet assigned again after a change
+BENCH(session_replay)
+{
+    auto sheet = make_worksheet();
+
+    state.set_label("updates/s");
+    while (state.keep_running()) {
+        worksheet_runner run;
+        for (auto &line : sheet) run.assign(line);
+        do_not_optimize(run.ws);
+    }
+}
+
+// one input: its chain of 10 definitions is recomputed
+BENCH(session_update_input) { update(state, "in42"); }
+
+// input of every chain: 1000 definitions are recomputed
+BENCH(session_update_rate)  { update(state, "rate"); }
+
+// a definition at the end of a chain: nothing depends on it
+BENCH(session_update_leaf)  { update(state, "c42n9"); }
@@ -0,0 +1,162 @@
+#include <vector>
+#include <string>
+#include <cstdio>
+
+#include "bench.h"
+#include "corpus.h"
+
+#include "lexer.h"
+#include "program.h"
+#include "store.h"
+
+// warm start with a library of 200k named formulas: compiling the text vs. opening a store
+// (with and without the checksum); lookups and evaluation in place vs. a loaded program
+
+namespace {
+
+const size_t formulas = 200000;
+const char *path = "bench-store.tmp";
+
+// 'name: expression' lines of the valid lines of the 'mixed' corpus
+const std::string& library()
+{
+    static std::string s;
+    if (s.empty()) {
+        auto lines = corpusLines(corpus_kind::mixed, formulas + formulas / 8);
+        size_t n = 0;
+        for (auto &l : lines) {
+            try {
+                program<double>::compile(tokenize(l));
+            }
+            catch (program<double>::error &) {
+                continue;
+            }
+            s += "f" + std::to_string(n) + ": " + l + "\n";
+            if (++n == formulas) break;
+        }
+    }
+    return s;
+}
+
+// written once, removed at exit
+void writeStore()
+{
+    static struct store_file {
+        store_file()
+        {
+            expression_store::builder b;
+            b.addLines(library().data(), library().size());
+            b.write(path);
+        }
+        ~store_file() { std::remove(path); }
+    } file;
+}
+
+// the evaluation of one formula, as a server answering its first request
+void bench_open(bench_state &state, expression_store::check c)
+{
+    writeStore();
+    std::vector<double> bindings(16, 1.5);
+
+    state.set_items(double(formulas));
+    state.set_label("formulas/s");
+    state.reset_timer();
+    while (state.keep_running()) {
+        expression_store store(path, c);
+        stored_evaluator ev(store[size_t(store.find("f12345"))]);
+        do_not_optimize(ev.run(bindings.data())[0].atom);
+    }
+}
+
+}
+
+BENCH(store_startup_compile)
+{
+    auto &lib = library();
+    std::vector<token_view> t;
+    std::vector<program<double>> programs;
+
+    state.set_items(double(formulas));
+    state.set_label("formulas/s");
+    state.reset_timer();
+    while (state.keep_running()) {
+        programs.clear();
+        for (size_t start = 0, end; start < lib.size(); start = end + 1) {
+            end = lib.find('\n', start);
+            size_t colon = lib.find(':', start);
+            tokenize(lib.data() + colon + 1, end - colon - 1, t);
+            programs.push_back(program<double>::compile(t));
+            programs.back().optimize();
+        }
+        do_not_optimize(programs.back().code.data());
+    }
+}
+
+BENCH(store_startup_open_full)   { bench_open(state, expression_store::check::full); }
+BENCH(store_startup_open_header) { bench_open(state, expression_store::check::header); }
+
+BENCH(store_build)
+{
+    auto &lib = library();
+    state.set_items(double(formulas));
+    state.set_label("formulas/s");
+    state.reset_timer();
+    while (state.keep_running()) {
+        expression_store::builder b;
+        b.addLines(lib.data(), lib.size());
+        auto image = b.image();
+        do_not_optimize(image.data());
+    }
+}
+
+BENCH(store_lookup)
+{
+    writeStore();
+    expression_store store(path);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 1024; i++) names.push_back("f" + std::to_string(i * 193 % formulas));
+
+    state.set_items(double(names.size()));
+    state.set_label("lookups/s");
+    state.reset_timer();
+    while (state.keep_running()) {
+        for (auto &n : names) do_not_optimize(store.find(n));
+    }
+}
+
+// every formula of the store evaluated once: in place vs. loaded into a program<double>
+BENCH(store_evaluate_inplace)
+{
+    writeStore();
+    expression_store store(path);
+    std::vector<double> bindings(64, 1.5);
+
+    state.set_items(double(store.size()));
+    state.set_label("formulas/s");
+    state.reset_timer();
+    while (state.keep_running()) {
+        for (size_t i = 0; i < store.size(); i++) {
+            stored_evaluator ev(store[i]);
+            do_not_optimize(ev.run(bindings.data())[0].atom);
+        }
+    }
+}
+
+BENCH(store_evaluate_loaded)
+{
+    writeStore();
+    expression_store store(path);
+    std::vector<program<double>> programs;
+    for (size_t i = 0; i < store.size(); i++) programs.push_back(store[i].load());
+    std::vector<double> bindings(64, 1.5);
+
+    state.set_items(double(programs.size()));
+    state.set_label("formulas/s");
+    state.reset_timer();
+    while (state.keep_running()) {
+        for (auto &p : programs) {
+            evaluator<double> ev(p);
+            do_not_optimize(ev.run(bindings.data())[0].atom);
+        }
+    }
+}
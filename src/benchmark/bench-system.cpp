@@ -0,0 +1,93 @@
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+
+#include "bench.h"
+
+#include "affine.h"
+#include "system.h"
+
+// simultaneous solve of sparse affine systems
+
+namespace {
+
+using atom = affine<double>;
+
+std::vector<var_id> makeIds(const char *prefix, int n)
+{
+    std::vector<var_id> ids;
+    for (int i = 0; i < n; i++) ids.push_back(symbol_table::intern(prefix + std::to_string(i)));
+    return ids;
+}
+
+// 5-point stencil on an m x m grid, variables and equations in random order
+std::vector<atom> gridSystem(int m)
+{
+    int n = m * m;
+    auto ids = makeIds("g", n);
+    std::mt19937 rng(1);
+    std::shuffle(ids.begin(), ids.end(), rng);
+
+    std::vector<atom> eqs;
+    for (int i = 0; i < n; i++) {
+        int r = i / m, c = i % m;
+        atom eq(4.5, ids[i]);
+        if (r > 0)     eq -= atom(1, ids[i - m]);
+        if (r < m - 1) eq -= atom(1, ids[i + m]);
+        if (c > 0)     eq -= atom(1, ids[i - 1]);
+        if (c < m - 1) eq -= atom(1, ids[i + 1]);
+        eq -= atom(1);
+        eqs.push_back(std::move(eq));
+    }
+    std::shuffle(eqs.begin(), eqs.end(), rng);
+    return eqs;
+}
+
+// chain of equations x(i) - x(i+1) = 1 with a few long-range couplings
+std::vector<atom> chainSystem(int n)
+{
+    auto ids = makeIds("c", n);
+    std::mt19937 rng(2);
+    std::uniform_int_distribution<int> col(0, n - 1);
+
+    std::vector<atom> eqs;
+    for (int i = 0; i + 1 < n; i++) {
+        atom eq = atom(3, ids[i]) - atom(1, ids[i + 1]) - atom(1);
+        if (i % 50 == 0) eq += atom(0.5, ids[col(rng)]);
+        eqs.push_back(std::move(eq));
+    }
+    eqs.push_back(atom(1, ids[n - 1]) - atom(2));
+    return eqs;
+}
+
+void solveAll(bench_state &state, const std::vector<atom> &eqs)
+{
+    size_t fill = 0;
+    while (state.keep_running()) {
+        sparse_system<double> s;
+        for (auto &e : eqs) s.add(e);
+        auto r = s.solve();
+        fill = s.fill_in();
+        do_not_optimize(r);
+    }
+    state.set_items(double(eqs.size()));
+    state.set_label("fill-in " + std::to_string(fill));
+}
+
+}
+
+BENCH(system_grid_30x30)
+{
+    solveAll(state, gridSystem(30));
+}
+
+BENCH(system_grid_100x100)
+{
+    solveAll(state, gridSystem(100));
+}
+
+BENCH(system_chain_10000)
+{
+    solveAll(state, chainSystem(10000));
+}
@@ -0,0 +1,69 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+   minimal benchmark harness
+   a benchmark is a function registered with the BENCH macro; it loops while
+   state.keep_running() returns true, and the runner repeats it with growing
+   iteration counts until the measured time is long enough
+*/
+
+class bench_state {
+public:
+    explicit bench_state(uint64_t n) : iterations(n), left(n) {};
+
+    bool keep_running() { return left-- != 0; }
+
+    // number of processed items (lines, rows, ...) per iteration, for the throughput column
+    void set_items(double n) { items = n; }
+    void set_label(const std::string &l) { label = l; }
+
+    // the time is measured from here: excludes a setup done before the loop
+    void reset_timer() { start = std::chrono::steady_clock::now(); }
+
+    std::chrono::steady_clock::time_point start;
+
+    const uint64_t iterations;
+    double items = 1;
+    std::string label;
+
+private:
+    uint64_t left;
+};
+
+using bench_fn = void(*)(bench_state &);
+
+struct bench_case {
+    const char *name;
+    bench_fn    fn;
+};
+
+std::vector<bench_case> &bench_registry();
+
+struct bench_registrar {
+    bench_registrar(const char *name, bench_fn fn) { bench_registry().push_back({ name, fn }); }
+};
+
+#define BENCH(name) \
+    static void bench_##name(bench_state &); \
+    static bench_registrar bench_registrar_##name(#name, bench_##name); \
+    static void bench_##name(bench_state &state)
+
+// keep the compiler from optimizing away a computed value
+template<typename T>
+inline void do_not_optimize(const T &value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+#endif
@@ -0,0 +1,297 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "corpus.h"
+
+namespace {
+
+// splitmix64: tiny and fully specified, unlike the std distributions
+class rng {
+public:
+    explicit rng(uint64_t seed) : s(seed) {};
+
+    uint64_t next() {
+        uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [lo, hi]
+    int range(int lo, int hi) { return lo + int(next() % uint64_t(hi - lo + 1)); }
+
+    bool chance(int percent) { return range(0, 99) < percent; }
+
+private:
+    uint64_t s;
+};
+
+// random input lines; the pieces of a line are appended one by one, since the evaluation
+// order of the operands of '+' is unspecified and would make the output compiler dependent
+class generator {
+public:
+    generator(uint64_t seed) : r(seed) {};
+
+    std::string line(corpus_kind kind);
+
+private:
+    rng r;
+
+    std::string number();
+    std::string variable(int count);
+    std::string term(int vars);
+    std::string nested(int depth);
+    std::string sum(int terms, int vars);
+    std::string mixed();
+    std::string error();
+    std::string redundant();
+};
+
+// integer or decimal literal
+std::string generator::number()
+{
+    std::string s = std::to_string(r.range(0, 999));
+    if (r.chance(40)) s += "." + std::to_string(r.range(0, 99));
+    return s;
+}
+
+std::string generator::variable(int count)
+{
+    static const char *names[] = { "x", "y", "z", "a", "b", "speed", "t", "rate" };
+    int i = r.range(0, count - 1);
+    if (i < 8) return names[i];
+    return "v" + std::to_string(i);
+}
+
+// term of an affine expression: number, variable or their product
+std::string generator::term(int vars)
+{
+    std::string s;
+    switch (r.range(0, 3)) {
+    case 0:  return number();
+    case 1:  return variable(vars);
+    case 2:
+        s = number() + "*";
+        s += variable(vars);
+        return s;
+    default:
+        s = variable(vars) + "/";
+        s += std::to_string(r.range(1, 9));
+        return s;
+    }
+}
+
+std::string generator::nested(int depth)
+{
+    if (depth == 0) return term(4);
+
+    static const char *ops[] = { " + ", " - ", "*", "/" };
+    int op = r.range(0, 3);
+    std::string inner = nested(depth - 1);
+    // products and quotients keep the expression affine: the other operand is a number
+    if (op >= 2) return "(" + inner + ")" + ops[op] + std::to_string(r.range(1, 9));
+    return "(" + inner + ops[op] + term(4) + ")";
+}
+
+std::string generator::sum(int terms, int vars)
+{
+    std::string s = term(vars);
+    for (int i = 1; i < terms; i++) {
+        s += r.chance(50) ? " + " : " - ";
+        s += term(vars);
+    }
+    return s;
+}
+
+std::string generator::mixed()
+{
+    std::string s;
+    switch (r.range(0, 9)) {
+    case 0:
+        s = number();
+        s += std::string(" ") + "+-*/"[r.range(0, 3)] + " ";
+        s += number();
+        break;
+    case 1:
+        s = "log(" + number() + ")^2 + ";
+        s += number() + "^0.5";
+        break;
+    case 2:
+        s = sum(r.range(2, 4), 3) + " = ";
+        s += number();
+        break;
+    case 3:
+        s = number() + "*";
+        s += variable(3) + " + ";
+        s += number() + " = ";
+        s += number() + " - ";
+        s += variable(3);
+        break;
+    case 4:
+        s = "(" + number() + " + ";
+        s += number() + ")*";
+        s += number() + ", ";
+        s += number() + "/";
+        s += std::to_string(r.range(1, 9));
+        break;
+    case 5:
+        s = sum(r.range(3, 6), 8);
+        break;
+    case 6:
+        s = "-" + variable(4) + " = ";
+        s += number() + "*(";
+        s += variable(4) + " - ";
+        s += number() + ")";
+        break;
+    case 7:
+        s = nested(r.range(2, 5));
+        break;
+    case 8:
+        s = sum(r.range(2, 3), 2) + " = ";
+        s += sum(r.range(2, 3), 2) + ", ";
+        s += sum(2, 2) + " = ";
+        s += number();
+        break;
+    default:
+        if (r.chance(50)) return error();
+        s = number() + "^";
+        s += std::to_string(r.range(0, 4));
+        break;
+    }
+    return s;
+}
+
+std::string generator::error()
+{
+    std::string s;
+    switch (r.range(0, 7)) {
+    case 0:     // missing right parenthesis
+        s = "(" + sum(r.range(1, 4), 3);
+        break;
+    case 1:     // unexpected input
+        s = sum(r.range(1, 3), 3) + ")";
+        break;
+    case 2:     // polynomial of order > 1
+        s = variable(4) + "*";
+        s += variable(4) + " + ";
+        s += number();
+        break;
+    case 3:     // log of polynomial
+        s = "log(" + variable(4) + ")";
+        break;
+    case 4:     // division by zero
+        s = number() + "/0";
+        break;
+    case 5:     // missing operand
+        s = sum(r.range(1, 3), 3) + " + ";
+        break;
+    case 6:     // unexpected input
+        s = number() + " $ ";
+        s += number();
+        break;
+    default:    // polynomial fraction
+        s = number() + "/";
+        s += variable(4);
+        break;
+    }
+    return s;
+}
+
+std::string generator::redundant()
+{
+    // constant and affine subterms
+    std::string pool[4];
+    int n = r.range(2, 4);
+    for (int i = 0; i < n; i++) {
+        switch (r.range(0, 3)) {
+        case 0:
+            pool[i] = "log(" + number() + " + 1)^2";
+            break;
+        case 1:
+            pool[i] = "(" + sum(r.range(3, 5), 4) + ")";
+            break;
+        case 2:
+            pool[i] = "(" + number() + " + ";
+            pool[i] += number() + ")^3*(";
+            pool[i] += variable(4) + " - ";
+            pool[i] += number() + ")";
+            break;
+        default:
+            pool[i] = "log(" + number() + " + 1)*(";
+            pool[i] += sum(3, 4) + ")";
+            break;
+        }
+    }
+
+    std::string s = pool[r.range(0, n - 1)];
+    for (int k = r.range(20, 60); k > 1; k--) {
+        s += r.chance(50) ? " + " : " - ";
+        s += number() + "*";
+        s += pool[r.range(0, n - 1)];
+    }
+    if (r.chance(30)) s += " = " + number();
+    return s;
+}
+
+std::string generator::line(corpus_kind kind)
+{
+    std::string s;
+    switch (kind) {
+    case corpus_kind::nesting:
+        s = nested(r.range(10, 40));
+        if (r.chance(50)) s += " = " + number();
+        break;
+    case corpus_kind::wide:
+        s = sum(r.range(50, 200), 32) + " = ";
+        s += number();
+        break;
+    case corpus_kind::variables:
+        s = sum(r.range(10, 30), 5000) + " = ";
+        s += number();
+        break;
+    case corpus_kind::errors:
+        s = error();
+        break;
+    case corpus_kind::redundant:
+        s = redundant();
+        break;
+    default:
+        s = mixed();
+        break;
+    }
+    return s;
+}
+
+}
+
+bool corpusKind(const std::string &name, corpus_kind &kind)
+{
+    if      (name == "mixed")     kind = corpus_kind::mixed;
+    else if (name == "nesting")   kind = corpus_kind::nesting;
+    else if (name == "wide")      kind = corpus_kind::wide;
+    else if (name == "variables") kind = corpus_kind::variables;
+    else if (name == "errors")    kind = corpus_kind::errors;
+    else if (name == "redundant") kind = corpus_kind::redundant;
+    else return false;
+    return true;
+}
+
+std::string makeCorpus(corpus_kind kind, size_t lines, uint64_t seed)
+{
+    generator g(seed);
+    std::string s;
+    for (size_t i = 0; i < lines; i++) {
+        s += g.line(kind);
+        s += '\n';
+    }
+    return s;
+}
+
+std::vector<std::string> corpusLines(corpus_kind kind, size_t lines, uint64_t seed)
+{
+    generator g(seed);
+    std::vector<std::string> r;
+    for (size_t i = 0; i < lines; i++) r.push_back(g.line(kind));
+    return r;
+}
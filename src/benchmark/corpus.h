@@ -0,0 +1,33 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+   deterministic generator of synthetic calculator input
+   the corpus depends only on its kind, line count and seed (the generator has its own
+   random number engine and formats numbers from integers), so results measured on it
+   are comparable across runs, compilers and platforms
+*/
+
+enum class corpus_kind {
+    mixed,      // short expressions and equations as typed by users, a few errors
+    nesting,    // deeply nested parentheses
+    wide,       // long sums over a moderate set of variables
+    variables,  // many distinct variable names
+    errors,     // every line has a syntax or evaluation error
+    redundant,  // machine generated: long sums of multiples of a few large repeated subterms
+};
+
+// kind of the given name; false for unknown names
+bool corpusKind(const std::string &name, corpus_kind &kind);
+
+// 'lines' newline terminated input lines
+std::string makeCorpus(corpus_kind kind, size_t lines, uint64_t seed = 1);
+
+// the same lines as separate strings
+std::vector<std::string> corpusLines(corpus_kind kind, size_t lines, uint64_t seed = 1);
+
+#endif
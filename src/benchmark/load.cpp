@@ -0,0 +1,197 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "load.h"
+
+double load_report::percentile(double p) const
+{
+    if (latency.empty()) return 0;
+    size_t i = std::min(latency.size() - 1, size_t(p * latency.size()));
+    return latency[i];
+}
+
+#ifdef __linux__
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct client_result {
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    std::vector<double> latency;
+    std::string error;
+};
+
+int connectTo(const load_options &o)
+{
+    int fd;
+    if (!o.unix_path.empty()) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, o.unix_path.c_str(), sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    else {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(uint16_t(o.tcp_port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        int one = 1;
+        if (fd >= 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// one connection: send the lines keeping 'depth' of them in flight, time their answers
+void runClient(const load_options &o, size_t index, size_t requests, client_result &r)
+{
+    int fd = connectTo(o);
+    if (fd < 0) {
+        r.error = std::string("unable to connect: ") + strerror(errno);
+        return;
+    }
+
+    auto lines = corpusLines(o.kind, requests, index + 1);
+    std::deque<clock_type::time_point> in_flight;
+    std::string out;
+    size_t out_pos = 0, next = 0;
+    std::vector<char> buf(64 * 1024);
+    bool header = true;     // reading the byte count of an answer
+    uint64_t left = 0;      // bytes of the answer text still to come
+
+    r.latency.reserve(requests);
+    while (r.requests < requests) {
+        while (next < requests && in_flight.size() < o.depth) {
+            out += lines[next++];
+            out += '\n';
+            in_flight.push_back(clock_type::now());
+        }
+
+        pollfd p = { fd, short(POLLIN | (out_pos < out.size() ? POLLOUT : 0)), 0 };
+        if (poll(&p, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            r.error = std::string("poll failed: ") + strerror(errno);
+            break;
+        }
+
+        if (p.revents & POLLOUT) {
+            ssize_t w = send(fd, out.data() + out_pos, out.size() - out_pos, MSG_NOSIGNAL);
+            if (w < 0 && errno != EAGAIN && errno != EINTR) {
+                r.error = std::string("send failed: ") + strerror(errno);
+                break;
+            }
+            if (w > 0) out_pos += w;
+            if (out_pos == out.size()) {
+                out.clear();
+                out_pos = 0;
+            }
+        }
+
+        if (p.revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = recv(fd, buf.data(), buf.size(), 0);
+            if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            if (n <= 0) {
+                r.error = n == 0 ? "connection closed by the server" : std::string("recv failed: ") + strerror(errno);
+                break;
+            }
+
+            auto now = clock_type::now();
+            for (ssize_t i = 0; i < n;) {
+                if (header) {
+                    char c = buf[i++];
+                    if (c != '\n') {
+                        left = left * 10 + (c - '0');
+                        continue;
+                    }
+                    header = false;
+                }
+                else {
+                    size_t take = std::min<uint64_t>(left, n - i);
+                    i += take;
+                    left -= take;
+                    r.bytes += take;
+                }
+                if (!header && left == 0) {
+                    r.latency.push_back(std::chrono::duration<double, std::micro>(now - in_flight.front()).count());
+                    in_flight.pop_front();
+                    r.requests++;
+                    header = true;
+                }
+            }
+        }
+    }
+
+    close(fd);
+}
+
+}
+
+bool runLoad(const load_options &o, load_report &report, std::string &error)
+{
+    size_t connections = std::max<size_t>(o.connections, 1);
+    std::vector<client_result> results(connections);
+    std::vector<std::thread> clients;
+
+    auto start = clock_type::now();
+    for (size_t i = 0; i < connections; i++) {
+        size_t requests = o.requests / connections + (i < o.requests % connections);
+        clients.emplace_back(runClient, std::cref(o), i, requests, std::ref(results[i]));
+    }
+    for (auto &c : clients) c.join();
+    report.seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    report.requests = 0;
+    report.bytes = 0;
+    report.latency.clear();
+    for (auto &r : results) {
+        if (!r.error.empty()) {
+            error = r.error;
+            return false;
+        }
+        report.requests += r.requests;
+        report.bytes += r.bytes;
+        report.latency.insert(report.latency.end(), r.latency.begin(), r.latency.end());
+    }
+    std::sort(report.latency.begin(), report.latency.end());
+    return true;
+}
+
+#else
+
+bool runLoad(const load_options &, load_report &, std::string &error)
+{
+    error = "the load generator is not supported on this platform";
+    return false;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef LOAD_H
+#define LOAD_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "corpus.h"
+
+/*
+   load generator for the calculator server (see server.h)
+   every connection runs on its own thread and keeps up to 'depth' lines of a generated corpus
+   in flight; the latency of a line is the time from queueing it for sending to receiving the
+   whole of its answer
+*/
+
+struct load_options {
+    std::string unix_path;          // Unix domain socket of the server, or
+    int         tcp_port = -1;      // its TCP port on localhost
+    size_t      connections = 4;
+    size_t      depth = 16;         // pipelined lines per connection
+    size_t      requests = 100000;  // lines in total
+    corpus_kind kind = corpus_kind::mixed;
+};
+
+struct load_report {
+    uint64_t requests;
+    uint64_t bytes;                 // answer text received
+    double   seconds;
+    std::vector<double> latency;    // microseconds, sorted
+
+    // latency at the given fraction (0.5 = median)
+    double percentile(double p) const;
+};
+
+// false with a message in 'error' if a connection fails
+bool runLoad(const load_options &options, load_report &report, std::string &error);
+
+#endif
@@ -7,13 +7,31 @@
 #include <string>
 #include <cmath>
 #include <exception>
-#include <map>
+#include <vector>
+
+#include "symbols.h"
+#include "small_map.h"
+#include "numbers.h"
+#include "arena.h"
 
 /*
    affine expression class (constant + linear)
-   the linear part is implemented as a map from variable name to its coefficient value
+   the linear part is implemented as a flat map from interned variable id to its coefficient value,
+   sorted by id; up to 4 variables are stored without heap allocation.
+   Terms whose coefficient becomes zero are removed from the map and remembered in 'z', so the
+   equation solver can still report them as free variables.
+   Storage beyond the inline terms comes from the current arena of the thread, if there is one
+   (see arena.h), so the temporaries of a line are freed at once.
 */
 
+template<typename T, typename A = arena_allocator<std::pair<var_id, T>>>
+struct affine_terms : public small_map<var_id, T, 4, A> {
+    using small_map<var_id, T, 4, A>::operator[];
+
+    // access by variable name
+    T& operator[] (const std::string &name) { return (*this)[symbol_table::intern(name)]; }
+};
+
 template<typename T>
 class affine {
 public:
@@ -28,17 +46,49 @@ public:
     };
 
     affine(const T& id = 0) : d(id) {};
-    affine(const T& ix, const std::string& iname) : d(0) { x[iname] = ix; };
-    template<typename U>
-    friend std::ostream& operator << (std::ostream& os, const affine<U>& b);
-    
-    bool isConstant() const { return std::all_of(x.begin(), x.end(), [](auto &x) {return x.second == 0;}); };
+    affine(const T& ix, const std::string& iname) : affine(ix, symbol_table::intern(iname)) {};
+    affine(const T& ix, var_id iid) : d(0) {
+        if (ix == 0) z.push_back(iid);
+        else         x.push_back(iid, ix);
+    };
+
+    bool isConstant() const { return x.empty(); };
+
+    // in-place arithmetic; these reuse the storage of the left operand
+    affine& operator += (const affine &b) { d += b.d; addTerms(b.x, false); mergeCancelled(b.z); return *this; };
+    affine& operator -= (const affine &b) { d -= b.d; addTerms(b.x, true);  mergeCancelled(b.z); return *this; };
+    affine& operator *= (const affine &b);
+    affine& operator /= (const affine &b);
+    affine& operator *= (const T &c);
+    affine& operator /= (const T &c);
+    affine& negate();
+
+    // in-place operations that can fail: the error message or nullptr, without throwing;
+    // on failure the value is left unchanged
+    const char* multiply(const affine &b);
+    const char* divide(const affine &b);
+    const char* divide(const T &c);
+    const char* logarithm();
+    const char* power(const affine &b);
+
+    using id_list = std::vector<var_id, arena_allocator<var_id>>;
+    using term_list = std::vector<const typename affine_terms<T>::value_type*, arena_allocator<const typename affine_terms<T>::value_type*>>;
 
-    std::map<std::string, T> x;
+    // the terms with a non-zero coefficient in name order, independent of the interning order
+    void sortedTerms(term_list &terms) const;
+
+    // append the text of 'os << *this'
+    void appendTo(std::string &s) const;
+
+    affine_terms<T> x;
+    id_list z;  // sorted ids of variables whose coefficient cancelled to zero
     T d;
 
 private:
-    std::string prettyPrintTerm(const std::pair<std::string, T> & t) const;
+
+    void addTerms(const affine_terms<T> &bx, bool subtract);
+    void cancel(var_id id);
+    void mergeCancelled(const id_list &bz);
 };
 
 template<typename T>
@@ -49,58 +99,94 @@ std::istream& operator>> (std::istream& is, affine<T>& b)
         std::string name;
         is >> name;
         b.x.clear();
+        b.z.clear();
         b.d = 0;
-        b.x[name] = 1;
+        b.x.push_back(symbol_table::intern(name), 1);
     }
     else {
         // value
         b.x.clear();
+        b.z.clear();
         is >> b.d;
     }
     return is;
 }
 
+// parser atom traits: numbers are read as T, variables are interned
 template<typename T>
-std::string affine<T>::prettyPrintTerm(const std::pair<std::string, T> & t) const
-{
-    std::ostringstream ss;
-
-    if (t.first == "") ss << t.second;
-    else {
-        if (t.second == -1) ss << '-';
-        else if (t.second == 1);
-        else ss << t.second << "*";
+struct atom_traits<affine<T>> {
+    static bool number(const char *first, const char *last, affine<T> &value) {
+        T v;
+        if (!atom_traits<T>::number(first, last, v)) return false;
+        value = affine<T>(v);
+        return true;
+    }
 
-        ss << t.first;
+    static bool variable(const char *name, size_t len, affine<T> &value) {
+        value = affine<T>(T(1), symbol_table::intern(name, len));
+        return true;
     }
 
-    return ss.str();
+    static void print(std::ostream &os, const affine<T> &value) { os << value; }
+
+    static const char* add(affine<T> &a, const affine<T> &b) { a += b; return nullptr; }
+    static const char* sub(affine<T> &a, const affine<T> &b) { a -= b; return nullptr; }
+    static const char* mul(affine<T> &a, const affine<T> &b) { return a.multiply(b); }
+    static const char* div(affine<T> &a, const affine<T> &b) { return a.divide(b); }
+    static const char* negate(affine<T> &a) { a.negate(); return nullptr; }
+    static const char* logarithm(affine<T> &a) { return a.logarithm(); }
+    static const char* power(affine<T> &a, const affine<T> &b) { return a.power(b); }
+};
+
+template<typename T>
+void affine<T>::sortedTerms(term_list &terms) const
+{
+    terms.clear();
+    terms.reserve(x.size());
+    for (auto &t : x) {
+        if (t.second != 0) terms.push_back(&t);
+    }
+    std::sort(terms.begin(), terms.end(), [](auto t1, auto t2) {
+        return symbol_table::name(t1->first) < symbol_table::name(t2->first);
+    });
 }
 
 template<typename T>
-std::ostream& operator<< (std::ostream& os, const affine<T>& b)
+void affine<T>::appendTo(std::string &s) const
 {
+    term_list terms;
+    sortedTerms(terms);
+
+    // the sign of a term after the first is printed as its operator
     bool is_first = true;
-    for (auto &x: b.x) {
-        if (x.second == 0) continue;
-        if (!is_first) {
-            if(x.second > 0) os << " + ";
-            else os << " - ";
+    for (auto t : terms) {
+        auto &c = t->second;
+        if (!is_first) s += c > 0 ? " + " : " - ";
+        size_t start = s.size();
+        if (c == -1) s += '-';
+        else if (c != 1) {
+            appendNumber(s, c);
+            s += '*';
         }
-        os << b.prettyPrintTerm(x).substr(!is_first && x.second < 0);
+        s += symbol_table::name(t->first);
+        if (!is_first && c < 0) s.erase(start, 1);
         is_first = false;
     }
 
-    if (b.d != 0 || is_first) {
-        if (!is_first) {
-            if (b.d > 0) os << " + ";
-            else os << " - ";
-        }
-        os << b.prettyPrintTerm(std::make_pair("", b.d)).substr(!is_first && b.d < 0);
+    if (d != 0 || is_first) {
+        if (!is_first) s += d > 0 ? " + " : " - ";
+        size_t start = s.size();
+        appendNumber(s, d);
+        if (!is_first && d < 0) s.erase(start, 1);
     }
+}
 
-
-    return os;
+template<typename T>
+std::ostream& operator<< (std::ostream& os, const affine<T>& b)
+{
+    std::string s;
+    b.appendTo(s);
+    return os.write(s.data(), s.size());
 }
 
 template<typename T>
@@ -111,81 +197,275 @@ bool operator==(const affine<T> &b1, const affine<T> &b2)
     return (diff.d == 0) && diff.isConstant();
 }
 
+// remember a variable whose coefficient cancelled to zero
 template<typename T>
-affine<T> operator+(const affine<T> &b1, const affine<T> &b2)
+void affine<T>::cancel(var_id id)
 {
-    affine<T> res(b1.d + b2.d);
+    auto i = std::lower_bound(z.begin(), z.end(), id);
+    if (i == z.end() || *i != id) z.insert(i, id);
+}
 
-    res.x = b1.x;
-    for (auto &x: b2.x) {
-        res.x[x.first] = res.x[x.first] + x.second;
+// take over the cancelled variables of the other operand, unless they are still used here
+template<typename T>
+void affine<T>::mergeCancelled(const id_list &bz)
+{
+    for (auto id : bz) {
+        if (x.find(id) == x.end()) cancel(id);
     }
-    
-    return res;
 }
 
+// x = x + bx  or  x = x - bx; zero coefficients are pruned
 template<typename T>
-affine<T> operator-(const affine<T> &b1, const affine<T> &b2)
+void affine<T>::addTerms(const affine_terms<T> &bx, bool subtract)
 {
-    affine<T> res(b1.d - b2.d);
+    if (bx.empty()) return;
+
+    if (bx.size() <= 2 || (x.size() > 0 && x.back().first < bx.begin()->first)) {
+        // few terms or all of them past the end - update in place
+        for (auto &t : bx) {
+            auto i = x.lower_bound(t.first);
+            if (i != x.end() && i->first == t.first) {
+                if (subtract) i->second -= t.second;
+                else          i->second += t.second;
+                if (i->second == 0) {
+                    x.erase(i);
+                    cancel(t.first);
+                }
+            }
+            else {
+                x.insert(i, t.first, subtract ? T(0) - t.second : t.second);
+            }
+        }
+    }
+    else {
+        // linear merge into a new map
+        affine_terms<T> res;
+        res.reserve(x.size() + bx.size());
+
+        auto i1 = x.begin(), i2 = bx.begin();
+        while (i1 != x.end() || i2 != bx.end()) {
+            if (i2 == bx.end() || (i1 != x.end() && i1->first < i2->first)) {
+                res.push_back(i1->first, std::move(i1->second));
+                ++i1;
+            }
+            else if (i1 == x.end() || i2->first < i1->first) {
+                res.push_back(i2->first, subtract ? T(0) - i2->second : i2->second);
+                ++i2;
+            }
+            else {
+                T v = subtract ? i1->second - i2->second : i1->second + i2->second;
+                if (v == 0) cancel(i1->first);
+                else        res.push_back(i1->first, v);
+                ++i1; ++i2;
+            }
+        }
+        x = std::move(res);
+    }
 
-    res.x = b1.x;
-    for (auto &x : b2.x) {
-        res.x[x.first] = res.x[x.first] - x.second;
+    // variables that became live again are no longer cancelled
+    if (!z.empty()) {
+        z.erase(std::remove_if(z.begin(), z.end(), [this](var_id id) {return x.find(id) != x.end();}), z.end());
     }
+}
 
-    return res;
+template<typename T>
+affine<T>& affine<T>::operator*=(const T &c)
+{
+    d *= c;
+    for (auto i = x.begin(); i != x.end();) {
+        i->second *= c;
+        if (i->second == 0) {
+            cancel(i->first);
+            i = x.erase(i);
+        }
+        else ++i;
+    }
+    return *this;
 }
 
+// multiplies by the reciprocal, like operator/
 template<typename T>
-affine<T> operator*(const affine<T> &b1, const affine<T> &b2)
+const char* affine<T>::divide(const T &c)
 {
-    affine<T> res(b1.d * b2.d);
+    if (c == 0) return "division by zero";
+
+    *this *= T(1 / c);
+    return nullptr;
+}
 
-    if (b1.isConstant()) {
-        for (auto &x:b2.x)  res.x[x.first] = x.second * b1.d;
+template<typename T>
+const char* affine<T>::multiply(const affine &b)
+{
+    if (isConstant()) {
+        T c = d;
+        *this = b;
+        *this *= c;
     }
-    else if (b2.isConstant()) {
-        for (auto &x : b1.x)  res.x[x.first] = x.second * b2.d;
+    else if (b.isConstant()) {
+        *this *= b.d;
     }
-    else throw typename affine<T>::error("polynomial of order > 1 not allowed");
+    else return "polynomial of order > 1 not allowed";
 
-    return res;
+    return nullptr;
+}
+
+template<typename T>
+const char* affine<T>::divide(const affine &b)
+{
+    if (!b.isConstant()) return "polynomial fraction not allowed";
+
+    return divide(b.d);
+}
+
+// the result is a constant; cancelled variables are not kept
+template<typename T>
+const char* affine<T>::logarithm()
+{
+    if (!isConstant()) return "log of polynomial not allowed";
+
+    d = log(d);
+    z.clear();
+    return nullptr;
+}
+
+template<typename T>
+const char* affine<T>::power(const affine &b)
+{
+    if (!b.isConstant()) return "polynomial exponent not allowed";
+    if (!isConstant()) return "power of polynomial not allowed";
+
+    d = pow(d, b.d);
+    z.clear();
+    return nullptr;
 }
 
+template<typename T>
+affine<T>& affine<T>::operator/=(const T &c)
+{
+    if (auto msg = divide(c)) throw error(msg);
+    return *this;
+}
+
+template<typename T>
+affine<T>& affine<T>::operator*=(const affine &b)
+{
+    if (auto msg = multiply(b)) throw error(msg);
+    return *this;
+}
+
+template<typename T>
+affine<T>& affine<T>::operator/=(const affine &b)
+{
+    if (auto msg = divide(b)) throw error(msg);
+    return *this;
+}
+
+// computed as 0 - b, so that the sign of zero matches the subtraction
+template<typename T>
+affine<T>& affine<T>::negate()
+{
+    d = T(0) - d;
+    for (auto &t : x) t.second = T(0) - t.second;
+    return *this;
+}
+
+template<typename T>
+affine<T> operator+(const affine<T> &b1, const affine<T> &b2)
+{
+    affine<T> res(b1);
+    return res += b2;
+}
+
+template<typename T>
+affine<T> operator+(affine<T> &&b1, const affine<T> &b2)
+{
+    b1 += b2;
+    return std::move(b1);
+}
+
+template<typename T>
+affine<T> operator+(const affine<T> &b1, affine<T> &&b2)
+{
+    b2 += b1;
+    return std::move(b2);
+}
+
+template<typename T>
+affine<T> operator+(affine<T> &&b1, affine<T> &&b2)
+{
+    b1 += b2;
+    return std::move(b1);
+}
+
+template<typename T>
+affine<T> operator-(const affine<T> &b1, const affine<T> &b2)
+{
+    affine<T> res(b1);
+    return res -= b2;
+}
+
+template<typename T>
+affine<T> operator-(affine<T> &&b1, const affine<T> &b2)
+{
+    b1 -= b2;
+    return std::move(b1);
+}
+
+template<typename T>
+affine<T> operator*(const affine<T> &b1, const affine<T> &b2)
+{
+    affine<T> res(b1);
+    return res *= b2;
+}
+
+template<typename T>
+affine<T> operator*(affine<T> &&b1, const affine<T> &b2)
+{
+    b1 *= b2;
+    return std::move(b1);
+}
 
 template<typename T>
 affine<T> operator/(const affine<T> &b1, const affine<T> &b2)
 {
-    if (!b2.isConstant()) throw typename affine<T>::error("polynomial fraction not allowed"); 
-    else if(b2.d == 0)    throw typename affine<T>::error("division by zero");
-    
-    affine<T> q(1 / b2.d);
-    return  q * b1;
+    affine<T> res(b1);
+    return res /= b2;
+}
+
+template<typename T>
+affine<T> operator/(affine<T> &&b1, const affine<T> &b2)
+{
+    b1 /= b2;
+    return std::move(b1);
 }
 
 template<typename T>
 affine<T> operator-(const affine<T> &b)
 {
-    affine<T> zero(0);
-    
-    return zero - b;
+    affine<T> res(b);
+    return res.negate();
 }
 
 template<typename T>
-affine<T> log(const affine<T> &b)
+affine<T> operator-(affine<T> &&b)
 {
-    if (!b.isConstant()) throw typename affine<T>::error("log of polynomial not allowed");
+    b.negate();
+    return std::move(b);
+}
 
-    return log(b.d);
+template<typename T>
+affine<T> log(const affine<T> &b)
+{
+    affine<T> res(b);
+    if (auto msg = res.logarithm()) throw typename affine<T>::error(msg);
+    return res;
 }
 
 template<typename T>
 affine<T> pow(const affine<T> &b1, const affine<T> &b2)
 {
-    if (!b2.isConstant()) throw typename affine<T>::error("polynomial exponent not allowed");
-    if (!b1.isConstant()) throw typename affine<T>::error("power of polynomial not allowed");
-
-    return pow(b1.d, b2.d);
+    affine<T> res(b1);
+    if (auto msg = res.power(b2)) throw typename affine<T>::error(msg);
+    return res;
 }
 #endif
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <new>
+
+#include "arena.h"
+
+const size_t arena::max_retained;
+
+arena::arena(size_t iblock_size)
+    : block_size(iblock_size), cur(nullptr), end(nullptr), spent(0), next_size(iblock_size), peak(0), allocated(0)
+{
+}
+
+arena::~arena()
+{
+    releaseBlocks();
+}
+
+// the current block is full: continue in a new one, twice as large as the previous
+void* arena::allocateBlock(size_t n, size_t align)
+{
+    addBlock(std::max(next_size, n + align));
+    next_size *= 2;
+    return allocate(n, align);
+}
+
+void arena::addBlock(size_t size)
+{
+    if (!blocks.empty()) spent += cur - blocks.back().p;
+
+    block b = { static_cast<char*>(::operator new(size)), size };
+    blocks.push_back(b);
+    cur = b.p;
+    end = b.p + size;
+    allocated++;
+}
+
+void arena::releaseBlocks()
+{
+    for (auto &b : blocks) ::operator delete(b.p);
+    blocks.clear();
+    cur = end = nullptr;
+    spent = 0;
+}
+
+void arena::reset()
+{
+    peak = std::max(peak, stats().used);
+
+    // one block that fits what the line needed, so the next similar line doesn't grow
+    size_t total = 0;
+    for (auto &b : blocks) total += b.size;
+    if (blocks.size() > 1 || total > max_retained) {
+        releaseBlocks();
+        addBlock(std::max(block_size, std::min(total, size_t(max_retained))));
+    }
+
+    spent = 0;
+    next_size = block_size;
+    if (!blocks.empty()) cur = blocks[0].p;
+}
+
+arena::statistics arena::stats() const
+{
+    statistics s;
+    s.used = blocks.empty() ? 0 : spent + (cur - blocks.back().p);
+    s.peak = std::max(peak, s.used);
+    s.capacity = 0;
+    for (auto &b : blocks) s.capacity += b.size;
+    s.blocks = allocated;
+    return s;
+}
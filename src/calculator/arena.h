@@ -0,0 +1,136 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+/*
+   monotonic arena for the temporaries of one input line
+   memory is handed out by bumping a pointer through large blocks; deallocation is a no-op and
+   everything is reclaimed at once by reset(). A reset coalesces the blocks into one block of
+   the size reached (up to max_retained), so in the steady state lines allocate nothing from
+   the heap.
+   Every thread has a current arena (none by default), selected by arena_scope. Containers with
+   arena_allocator take their memory from the arena that was current when they were created,
+   or from the heap if there was none. Copies take the allocator of the scope where they are
+   made, moves keep it; objects that outlive a reset (cached results) must therefore be copied
+   out under arena_scope(nullptr).
+*/
+
+class arena {
+public:
+    struct statistics {
+        size_t used;        // bytes handed out since the last reset
+        size_t peak;        // largest 'used' so far
+        size_t capacity;    // bytes of the blocks held
+        size_t blocks;      // blocks allocated from the heap so far
+    };
+
+    static const size_t max_retained = 1 << 20;    // a reset keeps at most this much memory
+
+    explicit arena(size_t block_size = 16 * 1024);
+    ~arena();
+
+    arena(const arena &) = delete;
+    arena& operator = (const arena &) = delete;
+
+    void* allocate(size_t n, size_t align) {
+        auto p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~uintptr_t(align - 1);
+        auto e = reinterpret_cast<uintptr_t>(end);
+        if (p > e || n > e - p) return allocateBlock(n, align);
+        cur = reinterpret_cast<char*>(p + n);
+        return reinterpret_cast<void*>(p);
+    }
+
+    // release everything allocated since the last reset
+    void reset();
+
+    statistics stats() const;
+
+    // arena of the calling thread; nullptr means the heap
+    static arena* current() { return current_ref(); }
+
+private:
+    friend class arena_scope;
+
+    struct block {
+        char  *p;
+        size_t size;
+    };
+
+    std::vector<block> blocks;  // the last one is being filled
+    size_t block_size;          // size of the first block
+    char  *cur;
+    char  *end;
+    size_t spent;               // bytes used in the blocks before the last one
+    size_t next_size;           // size of the next block
+    size_t peak;
+    size_t allocated;
+
+    void* allocateBlock(size_t n, size_t align);
+    void  addBlock(size_t size);
+    void  releaseBlocks();
+
+    static arena*& current_ref() {
+        static thread_local arena *a = nullptr;
+        return a;
+    }
+};
+
+// makes 'a' the current arena of the thread for the lifetime of the scope (nullptr: the heap)
+class arena_scope {
+public:
+    explicit arena_scope(arena *a) : prev(arena::current()) { arena::current_ref() = a; };
+    ~arena_scope() { arena::current_ref() = prev; };
+
+    arena_scope(const arena_scope &) = delete;
+    arena_scope& operator = (const arena_scope &) = delete;
+
+private:
+    arena *prev;
+};
+
+// allocator of the current arena, falling back to the heap (see above)
+template<typename T>
+class arena_allocator {
+public:
+    using value_type = T;
+
+    // containers never move their memory between arenas; copies follow the current scope
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::false_type;
+    using propagate_on_container_swap            = std::false_type;
+    using is_always_equal                        = std::false_type;
+
+    arena_allocator() noexcept : a(arena::current()) {};
+    explicit arena_allocator(arena *ia) noexcept : a(ia) {};
+    template<typename U>
+    arena_allocator(const arena_allocator<U> &o) noexcept : a(o.resource()) {};
+
+    T* allocate(size_t n) {
+        if (a) return static_cast<T*>(a->allocate(n * sizeof(T), alignof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t) noexcept {
+        if (!a) ::operator delete(p);
+    }
+
+    arena_allocator select_on_container_copy_construction() const { return arena_allocator(); }
+
+    arena* resource() const { return a; }
+
+private:
+    arena *a;
+};
+
+template<typename T, typename U>
+bool operator == (const arena_allocator<T> &a, const arena_allocator<U> &b) { return a.resource() == b.resource(); }
+
+template<typename T, typename U>
+bool operator != (const arena_allocator<T> &a, const arena_allocator<U> &b) { return a.resource() != b.resource(); }
+
+#endif
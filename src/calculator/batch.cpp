@@ -0,0 +1,153 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "batch.h"
+#include "thread_pool.h"
+
+namespace {
+
+const size_t block_size = 256 * 1024;   // bytes per block
+
+struct block {
+    std::string  data;              // owned copy of the lines, if they are not in a caller buffer
+    const char  *begin = nullptr;   // complete lines
+    size_t       size = 0;
+    block_output out;
+    bool         done = false;      // guarded by the runner mutex
+};
+
+void processBlock(block &b, size_t worker, const line_handler &handler)
+{
+    const char *s = b.begin;
+    const char *e = s + b.size;
+
+    while (s < e) {
+        const char *eol = s;
+        while (eol < e && *eol != '\n') eol++;
+        if (eol > s) handler(s, eol - s, worker, b.out);
+        s = eol + 1;
+    }
+}
+
+// hands blocks to the pool and writes their output in submission order
+class runner {
+public:
+    runner(output_sink &isink, size_t threads, const line_handler &ihandler)
+        : sink(isink), handler(ihandler), pool(threads), max_pending(4 * pool.size()) {};
+
+    void submit(std::string &&data) {
+        auto &b = add();
+        b.data = std::move(data);
+        b.begin = b.data.data();
+        b.size = b.data.size();
+        start(b);
+    }
+
+    void submit(const char *p, size_t n) {
+        auto &b = add();
+        b.begin = p;
+        b.size = n;
+        start(b);
+    }
+
+    // write all output and wait for the workers
+    void finish() {
+        while (!pending.empty()) flush(true);
+        sink.flush();
+    }
+
+private:
+    output_sink        &sink;
+    const line_handler &handler;
+    std::mutex              m;
+    std::condition_variable cv;
+    std::deque<std::unique_ptr<block>> pending;     // blocks in input order
+    thread_pool  pool;
+    const size_t max_pending;
+
+    block& add() {
+        // limit the memory held by finished blocks waiting for their predecessors
+        while (pending.size() >= max_pending) flush(true);
+        flush(false);
+
+        pending.emplace_back(new block);
+        return *pending.back();
+    }
+
+    void start(block &b) {
+        block *pb = &b;
+        pool.submit([this, pb](size_t worker) {
+            processBlock(*pb, worker, handler);
+            std::lock_guard<std::mutex> lock(m);
+            pb->done = true;
+            cv.notify_all();
+        });
+    }
+
+    // write finished blocks from the front; with 'wait' the front block is waited for
+    void flush(bool wait) {
+        while (!pending.empty()) {
+            {
+                std::unique_lock<std::mutex> lock(m);
+                if (wait) cv.wait(lock, [this] { return pending.front()->done; });
+                else if (!pending.front()->done) return;
+            }
+            pending.front()->out.flush_to(sink);
+            pending.pop_front();
+            if (wait) return;
+        }
+    }
+};
+
+}
+
+void processBatch(std::istream &in, output_sink &sink, size_t threads, const line_handler &handler)
+{
+    runner r(sink, threads, handler);
+
+    std::vector<char> buf(block_size);
+    std::string carry;      // incomplete last line of the previous read
+
+    for (;;) {
+        in.read(buf.data(), buf.size());
+        size_t n = size_t(in.gcount());
+        if (n == 0) break;
+
+        size_t last = n;
+        while (last > 0 && buf[last - 1] != '\n') last--;
+
+        if (last == 0) {
+            carry.append(buf.data(), n);    // no line end in this read
+            continue;
+        }
+
+        std::string data = std::move(carry);
+        data.append(buf.data(), last);
+        carry.assign(buf.data() + last, n - last);
+        r.submit(std::move(data));
+    }
+    if (!carry.empty()) r.submit(std::move(carry));
+
+    r.finish();
+}
+
+void processBatch(const char *data, size_t n, output_sink &sink, size_t threads, const line_handler &handler)
+{
+    runner r(sink, threads, handler);
+
+    // blocks are views into the buffer, ending after a newline (or at the end of the data)
+    for (size_t start = 0; start < n;) {
+        size_t end = std::min(start + block_size, n);
+        while (end < n && data[end - 1] != '\n') end++;
+
+        r.submit(data + start, end - start);
+        start = end;
+    }
+
+    r.finish();
+}
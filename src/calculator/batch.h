@@ -0,0 +1,30 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <functional>
+#include <istream>
+#include <ostream>
+
+#include "output.h"
+
+// line processing callback: line text (without the newline), index of the worker thread, output
+using line_handler = std::function<void(const char *s, size_t n, size_t worker, block_output &out)>;
+
+/*
+   batch processing of the whole input
+   the input is split into blocks of complete lines, which are processed by a pool of 'threads'
+   workers; the output of every block is written in input order once it is ready.
+   Empty lines are skipped.
+*/
+void processBatch(std::istream &in, output_sink &sink, size_t threads, const line_handler &handler);
+
+// input already in memory (i.e. a mapped file); blocks are views into the buffer, without copying
+void processBatch(const char *data, size_t n, output_sink &sink, size_t threads, const line_handler &handler);
+
+inline void processBatch(std::istream &in, std::ostream &out, std::ostream &err, size_t threads, const line_handler &handler)
+{
+    stream_sink sink(out, err);
+    processBatch(in, sink, threads, handler);
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <vector>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+
+/*
+   bounded LRU cache of parse results
+   the key is the normalized token stream of an input line (token texts joined by a separator),
+   so lines differing only in whitespace share an entry. Errors are stored with the index of the
+   token they refer to, which gives the right caret position for any spacing of the line.
+   The cache is split into independently locked shards, each holding an equal part of the
+   memory budget, so it can be shared by the worker threads of the batch mode.
+*/
+
+// approximate memory held by a cached atom
+template<typename T>
+size_t memoryUsage(const T &) { return sizeof(T); }
+
+template<typename T>
+size_t memoryUsage(const affine<T> &a)
+{
+    size_t n = sizeof(a) + a.z.capacity() * sizeof(var_id);
+    if (!a.x.is_inline()) n += a.x.capacity() * sizeof(std::pair<var_id, T>);
+    return n;
+}
+
+template<typename T>
+class result_cache {
+public:
+    using result = typename parser<T>::result;
+
+    struct value {
+        std::vector<result> results;
+        bool        failed = false;
+        size_t      error_token = 0;    // index of the token the error refers to
+        std::string error_msg;
+    };
+
+    struct statistics {
+        uint64_t hits, misses, evictions;
+        size_t   entries, bytes;
+    };
+
+    explicit result_cache(size_t max_bytes, size_t shards = 16);
+
+    // cache key of a token stream
+    static void normalize(const std::vector<token_view> &tokens, std::string &key);
+
+    // cached value of the key or nullptr; the value stays valid after eviction
+    std::shared_ptr<const value> find(const std::string &key);
+
+    void insert(const std::string &key, std::shared_ptr<const value> v);
+
+    statistics stats() const;
+
+private:
+    struct entry {
+        std::string                  key;
+        std::shared_ptr<const value> v;
+        size_t                       bytes;
+    };
+
+    struct shard {
+        mutable std::mutex   lock;
+        std::list<entry>     lru;       // most recently used first
+        std::unordered_map<size_t, typename std::list<entry>::iterator> index;  // by key hash
+        size_t               bytes = 0;
+    };
+
+    std::vector<shard>    shards;
+    size_t                shard_bytes;  // memory budget of one shard
+    std::atomic<uint64_t> hits{ 0 }, misses{ 0 }, evictions{ 0 };
+
+    static size_t footprint(const std::string &key, const value &v);
+};
+
+template<typename T>
+result_cache<T>::result_cache(size_t max_bytes, size_t n) : shards(n ? n : 1)
+{
+    shard_bytes = max_bytes / shards.size();
+}
+
+template<typename T>
+void result_cache<T>::normalize(const std::vector<token_view> &tokens, std::string &key)
+{
+    key.clear();
+    for (auto &t : tokens) {
+        if (t.type == tok_t::end) break;
+        key.append(t.s, t.len);
+        key.push_back('\x1f');  // keeps "1 2" apart from "12"
+    }
+}
+
+template<typename T>
+std::shared_ptr<const typename result_cache<T>::value> result_cache<T>::find(const std::string &key)
+{
+    size_t h = std::hash<std::string>()(key);
+    shard &s = shards[h % shards.size()];
+
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto i = s.index.find(h);
+    if (i == s.index.end() || i->second->key != key) {
+        misses++;
+        return nullptr;
+    }
+    s.lru.splice(s.lru.begin(), s.lru, i->second);
+    hits++;
+    return i->second->v;
+}
+
+template<typename T>
+void result_cache<T>::insert(const std::string &key, std::shared_ptr<const value> v)
+{
+    size_t bytes = footprint(key, *v);
+    if (bytes > shard_bytes) return;
+
+    size_t h = std::hash<std::string>()(key);
+    shard &s = shards[h % shards.size()];
+
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto i = s.index.find(h);
+    if (i != s.index.end()) {
+        // same line inserted by another thread, or a hash collision: replace
+        s.bytes -= i->second->bytes;
+        s.lru.erase(i->second);
+        s.index.erase(i);
+    }
+    while (!s.lru.empty() && s.bytes + bytes > shard_bytes) {
+        auto &old = s.lru.back();
+        s.bytes -= old.bytes;
+        s.index.erase(std::hash<std::string>()(old.key));
+        s.lru.pop_back();
+        evictions++;
+    }
+
+    s.lru.push_front({ key, std::move(v), bytes });
+    s.index.emplace(h, s.lru.begin());
+    s.bytes += bytes;
+}
+
+template<typename T>
+typename result_cache<T>::statistics result_cache<T>::stats() const
+{
+    statistics r{ hits, misses, evictions, 0, 0 };
+    for (auto &s : shards) {
+        std::lock_guard<std::mutex> guard(s.lock);
+        r.entries += s.lru.size();
+        r.bytes += s.bytes;
+    }
+    return r;
+}
+
+template<typename T>
+size_t result_cache<T>::footprint(const std::string &key, const value &v)
+{
+    // list and hash map nodes, shared_ptr control block
+    const size_t overhead = 4 * sizeof(void*) + sizeof(entry) + 2 * sizeof(void*) + 32;
+
+    size_t n = overhead + key.capacity() + sizeof(value) + v.error_msg.capacity();
+    for (auto &r : v.results) n += memoryUsage(r.atom) + sizeof(r) - sizeof(r.atom);
+    return n;
+}
+
+#endif
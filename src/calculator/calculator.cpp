@@ -1,111 +1,529 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include <deque>
+#include <csignal>
+#include <fstream>
+#include <iterator>
+#include <new>
 
 #include "lexer.h"
-#include "parser.h"
-#include "affine.h"
+#include "program.h"
+#include "numbers.h"
+#include "columnar.h"
+#include "jit.h"
+#include "driver.h"
+#include "output.h"
+#include "batch.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "server.h"
+#include "stats.h"
+#include "format.h"
+#include "parametric.h"
+#include "store.h"
 
 
-//#include <boost/multiprecision/cpp_dec_float.hpp>
-//using numtype  = boost::multiprecision::cpp_dec_float_50;
-using numtype  = double;
-using atomtype = affine<numtype>;
-using restype  = parser<atomtype>::result;
+// evaluate the results of 'p' for every row of the table; prints one line of values per row
+static void printColumns(const program<double> &p, const column_table &table, simd_isa isa, bool jit)
+{
+    std::vector<std::vector<double>> values(p.results, std::vector<double>(table.rows));
+    for (size_t r = 0; r < p.results; r++) {
+        if (jit) {
+            auto f = jit_cache::shared().get(p, r, isa);
+            f->run(f->bind(table).data(), table.rows, values[r].data());
+            continue;
+        }
+        column_evaluator ev(p, r, isa);
+        ev.run(ev.bind(table).data(), table.rows, values[r].data());
+    }
 
+    fd_sink sink;
+    std::string line;
+    char buf[number_buffer];
+    for (size_t i = 0; i < table.rows; i++) {
+        line.clear();
+        for (size_t r = 0; r < p.results; r++) {
+            if (r > 0) line += ", ";
+            line.append(buf, formatShortest(buf, values[r][i]));
+        }
+        line += '\n';
+        sink.write(false, line.data(), line.size());
+    }
+}
 
-// Print solution to equation   'a=0'
-template<typename T>
-void printEq(const T &a)
+// evaluate the expressions of 'expr' for every row of the table
+static int processColumns(const std::string &expr, const column_table &table, simd_isa isa, bool jit)
 {
-    if (a == 0) std::cout << "True.";
-    else        std::cout << "Not true.";
+    auto tokens = tokenize_view(expr);
+    try {
+        auto p = program<double>::compile(tokens);
+        p.optimize();
+        printColumns(p, table, isa, jit);
+    }
+    catch (program<double>::error &e) {
+        printError(std::cerr, expr.data(), expr.size(), e.t.pos, e.msg);
+        return 1;
+    }
+    catch (column_error &e) {
+        std::cerr << e.msg << std::endl;
+        return 1;
+    }
+    return 0;
 }
 
-// specialization for affine 'a'
-template<>
-void printEq(const affine<numtype> &a)
+// evaluate the expression 'name' of a compiled store for every row of the table
+static int processStored(const std::string &path, const std::string &name, const column_table &table, simd_isa isa, bool jit)
 {
-    //equation
-    auto d = a.d; // rhs
-    auto x = a.x;
-
-    // collect free variables
-    std::vector<std::string> free_vars;
-    for (auto i = begin(x); i != end(x);) {
-        if (i->second == numtype(0)) {
-            free_vars.push_back(i->first);
-            i = x.erase(i);
+    try {
+        expression_store store(path);
+        auto i = store.find(name);
+        if (i < 0) {
+            std::cerr << "no expression " << name << " in " << path << std::endl;
+            return 1;
         }
-        else ++i;
-    }
-
-    // no fixed variables
-    if (x.size() == 0) {
-        if (d == 0) std::cout << "True.";
-        else        std::cout << "Not true.";
+        printColumns(store[size_t(i)].load(), table, isa, jit);
     }
-    // 1 fixed variable
-    else if (x.size() == 1) {
-        std::cout << begin(x)->first << " = " << -d / begin(x)->second;
+    catch (expression_store::error &e) {
+        std::cerr << e.msg << std::endl;
+        return 1;
     }
-    // more than 1 fixed variable
-    else {
-        std::cout << a << " = 0";
+    catch (column_error &e) {
+        std::cerr << e.msg << std::endl;
+        return 1;
     }
+    return 0;
+}
 
-    // list free vars
-    if (free_vars.size() != 0) {
-        std::cout << "    This holds for any ";
-        std::copy(begin(free_vars), end(free_vars), std::ostream_iterator<std::string>(std::cout, ","));
-        std::cout << "\b.";
+// compile the 'name: expression' lines of the library into the store 'path'
+static int buildStore(const std::string &path, const char *s, size_t n)
+{
+    try {
+        expression_store::builder b;
+        b.addLines(s, n);
+        b.write(path);
+        std::cerr << b.size() << " expressions stored in " << path << std::endl;
     }
+    catch (expression_store::builder::line_error &e) {
+        std::cerr << "line " << e.line << ":";
+        printError(std::cerr, e.text.data(), e.text.size(), e.pos, e.msg);
+        return 1;
+    }
+    catch (expression_store::error &e) {
+        std::cerr << e.msg << std::endl;
+        return 1;
+    }
+    return 0;
 }
 
-// print parser result
-template<typename T>
-void printResult(const T &z)
+// solve the equation 'eq' in 'unknown' for every row of parameters of the table; one record per row
+static int processTemplate(const std::string &eq, const std::string &unknown, const column_table &table, simd_isa isa, bool jit,
+                           output_format format)
 {
-    std::cout << "Result: ";
+    auto tokens = tokenize_view(eq);
+    try {
+        parametric_equation pe(tokens, unknown);
+        auto rows = pe.solve(table, isa, jit);
 
-    if (!z.equal_to_zero) 
-    {
-        // expression
-        std::cout << z.atom;
+        fd_sink sink;
+        std::string text, errors;
+        result_formatter<double> f(format);
+        auto &failed = f.errorsInOutput() ? text : errors;
+        for (size_t i = 0; i < rows.size(); i++) {
+            f.line();
+            if (rows.zero_divisor[i] >= 0) {
+                f.error(failed, eq.data(), eq.size(), pe.divisor(size_t(rows.zero_divisor[i])).pos, "division by zero");
+            }
+            else if (rows.coef[i] != 0) f.solution(text, pe.unknown(), rows.x[i]);
+            else                        f.cancelled(text, pe.unknown(), rows.constant[i] == 0);
+            if (text.size() + errors.size() >= 1 << 16) {
+                sink.write(false, text.data(), text.size());
+                sink.write(true, errors.data(), errors.size());
+                text.clear();
+                errors.clear();
+            }
+        }
+        sink.write(false, text.data(), text.size());
+        sink.write(true, errors.data(), errors.size());
     }
-    else 
-    {
-        printEq(z.atom);
+    catch (parametric_equation::error &e) {
+        printError(std::cerr, eq.data(), eq.size(), e.t.pos, e.msg);
+        return 1;
+    }
+    catch (column_error &e) {
+        std::cerr << e.msg << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#if CALCULATOR_STATS
+// the heap allocations of every thread are counted for the --stats report; the memory comes from
+// malloc as with the default operator new, so the default operator delete releases it
+void* operator new(size_t n)
+{
+    allocationCounter()++;
+    for (;;) {
+        if (void *p = malloc(n ? n : 1)) return p;
+        auto handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
     }
+}
+#endif
+
+// server stopped by SIGINT/SIGTERM
+static server *running_server = nullptr;
 
-    std::cout << std::endl;
+extern "C" void stopServer(int)
+{
+    if (running_server) running_server->stop();
 }
 
+static int usage()
+{
+    std::cerr << "usage: calculator [--system] [--threads N] [--file PATH] [--cache MB] [--cache-stats]\n"
+                 "                  [--no-arena] [--arena-stats] [--parser recursive|iterative] [--session] [--session-stats]\n"
+                 "                  [--listen PATH | --port N] [--stats] [--trace PATH] [--trace-every N]\n"
+                 "                  [--format text|json|binary]\n"
+                 "       calculator --eval EXPR (--csv PATH | --raw PATH --names A,B,...) [--isa scalar|sse2|avx2] [--jit]\n"
+                 "       calculator --solve EQUATION --unknown X (--csv PATH | --raw PATH --names A,B,...) [--isa ...] [--jit]\n"
+                 "                  [--format text|json|binary]\n"
+                 "       calculator --build-store PATH [--file LIBRARY]\n"
+                 "       calculator --store PATH --eval NAME (--csv PATH | --raw PATH --names A,B,...) [--isa ...] [--jit]\n"
+                 "    without options, lines are read from stdin until an empty line\n"
+                 "    --system      solve all equations of a line as one system\n"
+                 "    --threads N   batch mode: process all of the input with N worker threads (0 = all cores)\n"
+                 "    --file PATH   batch mode: read the input from a memory-mapped file instead of stdin\n"
+                 "    --cache MB    reuse the parse results of repeated lines, keeping up to MB megabytes\n"
+                 "    --cache-stats print the cache counters to stderr at exit\n"
+                 "    --no-arena    allocate the temporaries of a line from the heap instead of a per-line arena\n"
+                 "    --arena-stats print the peak per-line arena usage to stderr at exit\n"
+                 "    --parser NAME parsing algorithm (default: iterative, which has no nesting limit)\n"
+                 "    --session     lines 'name = expression' define variables used by the following lines;\n"
+                 "                  a changed definition updates the ones depending on it (one thread only, no --cache)\n"
+                 "    --session-stats print the definition and recomputation counters to stderr at exit\n"
+                 "    --listen PATH server mode: answer the lines of clients of a Unix domain socket, evaluated by\n"
+                 "                  --threads workers; every answer is its byte count, a newline and the output text;\n"
+                 "                  a client sending a line longer than 1 MiB is disconnected\n"
+                 "    --port N      server mode on TCP port N of localhost (0 = any free port)\n"
+                 "    --stats       print the time of the line processing stages, token, variable and allocation\n"
+                 "                  counts and the line latency histogram to stderr at exit\n"
+                 "    --trace PATH  write every Nth line as Chrome trace events (JSON) to PATH at exit\n"
+                 "    --trace-every N  lines between the traced ones (default: 100)\n"
+                 "    --format NAME output of the results: text (default), json (one object per line) or\n"
+                 "                  binary (length-prefixed records); errors are then records of stdout\n"
+                 "    --eval EXPR   columnar mode: evaluate EXPR for every row of a table, the variables\n"
+                 "                  are taken from the columns of the same name\n"
+                 "    --solve EQUATION  template mode: solve the equation in the unknown X for every row of a table,\n"
+                 "                  the other variables (parameters) are taken from the columns of the same name\n"
+                 "    --csv PATH    table in CSV format with a header line of column names\n"
+                 "    --raw PATH    table of native doubles stored column after column\n"
+                 "    --names LIST  comma separated column names of the raw table\n"
+                 "    --isa NAME    vector instruction set of the columnar mode (default: best available)\n"
+                 "    --jit         columnar mode with native code compiled for the expression (x86-64 Linux;\n"
+                 "                  elsewhere the scalar kernels); results are those of the scalar evaluation\n"
+                 "    --build-store PATH  compile the 'name: expression' lines of LIBRARY (or stdin) into a\n"
+                 "                  memory-mapped store of compiled expressions\n"
+                 "    --store PATH  columnar mode: --eval NAME evaluates the expression NAME of the store\n";
+    return 1;
+}
 
 // main program
-int main()
+int main(int argc, char *argv[])
 {
-    for (;;) {
-        std::string input;
+    bool        batch   = false;
+    bool        system  = false;
+    size_t      threads = 1;
+    std::string file;
+    std::string expr, csv, raw, names;
+    std::string equation, unknown;
+    std::string store_path, build_store;
+    simd_isa    isa = detectIsa();
+    size_t      cache_mb = 0;
+    bool        cache_stats = false;
+    bool        use_arena = true;
+    bool        arena_stats = false;
+    parse_method method = parse_method::iterative;
+    bool        use_session = false;
+    bool        session_stats = false;
+    std::string listen_path;
+    int         port = -1;
+    bool        jit = false;
+    bool        stats_report = false;
+    std::string trace_path;
+    size_t      trace_every = 100;
+    output_format format = output_format::text;
 
-        std::getline(std::cin, input);
-        if (input.empty()) break;       // empty input line exits the application 
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            batch = true;
+            threads = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--file") && i + 1 < argc) {
+            batch = true;
+            file = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--system")) {
+            system = true;
+        }
+        else if (!strcmp(argv[i], "--cache") && i + 1 < argc) {
+            cache_mb = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--cache-stats")) {
+            cache_stats = true;
+        }
+        else if (!strcmp(argv[i], "--no-arena")) {
+            use_arena = false;
+        }
+        else if (!strcmp(argv[i], "--arena-stats")) {
+            arena_stats = true;
+        }
+        else if (!strcmp(argv[i], "--session")) {
+            use_session = true;
+        }
+        else if (!strcmp(argv[i], "--session-stats")) {
+            session_stats = true;
+        }
+        else if (!strcmp(argv[i], "--listen") && i + 1 < argc) {
+            listen_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--port") && i + 1 < argc) {
+            port = atoi(argv[++i]);
+            if (port < 0 || port > 65535) return usage();
+        }
+        else if (!strcmp(argv[i], "--stats")) {
+            stats_report = true;
+        }
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--trace-every") && i + 1 < argc) {
+            trace_every = strtoul(argv[++i], nullptr, 10);
+            if (trace_every == 0) return usage();
+        }
+        else if (!strcmp(argv[i], "--format") && i + 1 < argc) {
+            std::string name = argv[++i];
+            if      (name == "text")   format = output_format::text;
+            else if (name == "json")   format = output_format::json;
+            else if (name == "binary") format = output_format::binary;
+            else return usage();
+        }
+        else if (!strcmp(argv[i], "--parser") && i + 1 < argc) {
+            std::string name = argv[++i];
+            if      (name == "recursive") method = parse_method::recursive;
+            else if (name == "iterative") method = parse_method::iterative;
+            else return usage();
+        }
+        else if (!strcmp(argv[i], "--eval") && i + 1 < argc) expr  = argv[++i];
+        else if (!strcmp(argv[i], "--solve") && i + 1 < argc) equation = argv[++i];
+        else if (!strcmp(argv[i], "--unknown") && i + 1 < argc) unknown = argv[++i];
+        else if (!strcmp(argv[i], "--store") && i + 1 < argc) store_path = argv[++i];
+        else if (!strcmp(argv[i], "--build-store") && i + 1 < argc) build_store = argv[++i];
+        else if (!strcmp(argv[i], "--csv")  && i + 1 < argc) csv   = argv[++i];
+        else if (!strcmp(argv[i], "--raw")  && i + 1 < argc) raw   = argv[++i];
+        else if (!strcmp(argv[i], "--names") && i + 1 < argc) names = argv[++i];
+        else if (!strcmp(argv[i], "--jit")) {
+            jit = true;
+        }
+        else if (!strcmp(argv[i], "--isa") && i + 1 < argc) {
+            std::string name = argv[++i];
+            if      (name == "scalar") isa = simd_isa::scalar;
+            else if (name == "sse2")   isa = simd_isa::sse2;
+            else if (name == "avx2")   isa = simd_isa::avx2;
+            else return usage();
+        }
+        else return usage();
+    }
 
-        auto t = tokenize(input);
+    if (!build_store.empty()) {
+        if (!file.empty()) {
+            try {
+                mapped_file input(file);
+                return buildStore(build_store, input.data(), input.size());
+            }
+            catch (mapped_file::error &e) {
+                std::cerr << e.msg << std::endl;
+                return 1;
+            }
+        }
+        std::string library((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        return buildStore(build_store, library.data(), library.size());
+    }
+
+    if (!expr.empty() || !equation.empty()) {
+        if (csv.empty() == raw.empty() || !expr.empty() == !equation.empty() || equation.empty() != unknown.empty()) return usage();
+        if (!store_path.empty() && expr.empty()) return usage();
         try {
-            auto result = parser<atomtype>::parse(t);
-            for (auto &z : result) {
-                // iterate over all comma-separated equations/expressions
-                printResult(z);
+            mapped_file input(csv.empty() ? raw : csv);
+            column_table table;
+            if (!csv.empty()) {
+                table = column_table::readCsv(input.data(), input.size());
+            }
+            else {
+                std::vector<std::string> list;
+                for (size_t start = 0, end; start <= names.size(); start = end + 1) {
+                    end = std::min(names.find(',', start), names.size());
+                    list.push_back(names.substr(start, end - start));
+                }
+                table = column_table::readBinary(input.data(), input.size(), list);
             }
+            if (!equation.empty()) return processTemplate(equation, unknown, table, isa, jit, format);
+            if (!store_path.empty()) return processStored(store_path, expr, table, isa, jit);
+            return processColumns(expr, table, isa, jit);
+        }
+        catch (mapped_file::error &e) {
+            std::cerr << e.msg << std::endl;
+            return 1;
+        }
+        catch (column_error &e) {
+            std::cerr << e.msg << std::endl;
+            return 1;
+        }
+    }
+
+    // the result of a session line depends on the definitions before it, not only on its text
+    if (use_session && cache_mb > 0) return usage();
+
+    std::unique_ptr<line_cache> cache;
+    if (cache_mb > 0) cache.reset(new line_cache(cache_mb << 20));
+    std::unique_ptr<line_session> worksheet;
+    if (use_session) worksheet.reset(new line_session);
+    // counters of every worker (a deque keeps them in place)
+    std::deque<line_stats> worker_stats;
+    bool instrumented = stats_report || !trace_path.empty();
+    if (instrumented && !CALCULATOR_STATS) std::cerr << "stats: not compiled in (CALCULATOR_NO_STATS)" << std::endl;
 
+    auto report = [&](const line_context *ctx, size_t contexts) {
+        if (cache && cache_stats) {
+            auto st = cache->stats();
+            std::cerr << "cache: " << st.hits << " hits, " << st.misses << " misses, " << st.evictions << " evictions, "
+                      << st.entries << " entries, " << st.bytes << " bytes" << std::endl;
         }
-        catch (parser<atomtype>::error &e) {
-            auto pos = e.t.pos;
-            std::cerr << std::endl << input << std::endl;
-            std::cerr << std::string(pos, ' ') << "^~~~~ " << e.msg << std::endl;
+        if (arena_stats) {
+            // the peak is per line (the largest of the threads), the memory held is the total
+            arena::statistics total = {};
+            for (size_t i = 0; i < contexts; i++) {
+                auto st = ctx[i].scratch.stats();
+                total.peak = std::max(total.peak, st.peak);
+                total.capacity += st.capacity;
+                total.blocks += st.blocks;
+            }
+            std::cerr << "arena: " << total.peak << " bytes peak per line, " << total.capacity << " bytes held, "
+                      << total.blocks << " blocks allocated" << std::endl;
+        }
+        if (worksheet && session_stats) {
+            auto st = worksheet->stats();
+            std::cerr << "session: " << st.definitions << " definitions, " << st.assignments << " assignments, "
+                      << st.recomputed << " recomputed, " << st.unchanged << " unchanged, "
+                      << st.eliminated << " ops eliminated" << std::endl;
+        }
+        if (stats_report && !worker_stats.empty()) {
+            line_stats total;
+            for (auto &st : worker_stats) total.merge(st);
+            total.report(std::cerr);
+        }
+        if (!trace_path.empty() && !worker_stats.empty()) {
+            std::vector<const line_stats*> traced;
+            for (auto &st : worker_stats) traced.push_back(&st);
+            std::ofstream trace(trace_path);
+            writeTrace(trace, traced);
+            if (!trace) std::cerr << "unable to write the trace to " << trace_path << std::endl;
+        }
+    };
+
+    auto configure = [&](line_context &c) {
+        c.solve_system = system;
+        c.cache = cache.get();
+        c.use_arena = use_arena;
+        c.method = method;
+        c.session = worksheet.get();
+        c.formatter = result_formatter<numtype>(format);
+        if (instrumented && CALCULATOR_STATS) {
+            worker_stats.emplace_back(uint32_t(worker_stats.size()), trace_every);
+            c.stats = &worker_stats.back();
         }
+    };
+
+    if (!listen_path.empty() || port >= 0) {
+        if (worksheet || !listen_path.empty() == (port >= 0)) return usage();
+        if (threads == 0) threads = thread_pool::default_threads();
+
+        std::vector<line_context> ctx(threads);
+        for (auto &c : ctx) configure(c);
+        auto handler = [&ctx](const char *s, size_t n, size_t worker, block_output &out) {
+            processLine(s, n, ctx[worker], out);
+        };
+
+        try {
+            server srv({ listen_path, port, threads }, handler);
+            std::cerr << "listening on " << (listen_path.empty() ? "127.0.0.1:" + std::to_string(srv.port()) : listen_path) << std::endl;
+
+            running_server = &srv;
+            std::signal(SIGINT, stopServer);
+            std::signal(SIGTERM, stopServer);
+            srv.run();
+            running_server = nullptr;
+        }
+        catch (server::error &e) {
+            std::cerr << e.msg << std::endl;
+            return 1;
+        }
+        report(ctx.data(), ctx.size());
+        return 0;
+    }
+
+    if (batch) {
+        if (threads == 0) threads = thread_pool::default_threads();
+        if (worksheet && threads != 1) return usage();   // the lines of a session depend on each other
+
+        std::vector<line_context> ctx(threads);
+        for (auto &c : ctx) configure(c);
+        auto handler = [&ctx](const char *s, size_t n, size_t worker, block_output &out) {
+            processLine(s, n, ctx[worker], out);
+        };
+        fd_sink sink;
+
+        if (file.empty()) {
+            std::ios::sync_with_stdio(false);
+            processBatch(std::cin, sink, threads, handler);
+        }
+        else {
+            try {
+                mapped_file input(file);
+                processBatch(input.data(), input.size(), sink, threads, handler);
+            }
+            catch (mapped_file::error &e) {
+                std::cerr << e.msg << std::endl;
+                return 1;
+            }
+        }
+        sink.flush();
+        report(ctx.data(), ctx.size());
+        return 0;
+    }
+
+    // interactive mode
+    line_context ctx;
+    configure(ctx);
+    block_output out;
+
+    for (;;) {
+        std::string input;
+
+        std::getline(std::cin, input);
+        if (input.empty()) break;       // empty input line exits the application 
+
+        processLine(input.data(), input.size(), ctx, out);
+        out.flush_to(std::cout, std::cerr);
+        std::cout.flush();
     }
+    report(&ctx, 1);
 
     return 0;
 }
@@ -0,0 +1,514 @@
+#include <cmath>
+#include <cctype>
+#include <cfloat>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLUMNAR_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define COLUMNAR_AVX2
+#include <immintrin.h>
+#endif
+
+// AVX2 code is compiled per function, so the rest of the program runs on any x86-64 CPU
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+#include "columnar.h"
+
+struct column_evaluator::kernels {
+    void (*add)(const double *a, const double *b, double *r, size_t n);
+    void (*sub)(const double *a, const double *b, double *r, size_t n);
+    void (*mul)(const double *a, const double *b, double *r, size_t n);
+    void (*div)(const double *a, const double *b, double *r, size_t n);
+    void (*pow)(const double *a, const double *b, double *r, size_t n);
+    void (*neg)(const double *a, double *r, size_t n);
+    void (*log)(const double *a, double *r, size_t n);
+};
+
+namespace {
+
+//-------------------------------------------------------
+// scalar kernels; these are also used for the tails of the vector kernels
+
+void addScalar(const double *a, const double *b, double *r, size_t n) { for (size_t i = 0; i < n; i++) r[i] = a[i] + b[i]; }
+void subScalar(const double *a, const double *b, double *r, size_t n) { for (size_t i = 0; i < n; i++) r[i] = a[i] - b[i]; }
+void mulScalar(const double *a, const double *b, double *r, size_t n) { for (size_t i = 0; i < n; i++) r[i] = a[i] * b[i]; }
+void divScalar(const double *a, const double *b, double *r, size_t n) { for (size_t i = 0; i < n; i++) r[i] = a[i] / b[i]; }
+void powScalar(const double *a, const double *b, double *r, size_t n) { for (size_t i = 0; i < n; i++) r[i] = std::pow(a[i], b[i]); }
+void negScalar(const double *a, double *r, size_t n) { for (size_t i = 0; i < n; i++) r[i] = -a[i]; }
+void logScalar(const double *a, double *r, size_t n) { for (size_t i = 0; i < n; i++) r[i] = std::log(a[i]); }
+
+const column_evaluator::kernels scalar_kernels = {
+    addScalar, subScalar, mulScalar, divScalar, powScalar, negScalar, logScalar
+};
+
+/*
+   constants of the vectorized log and exp (fdlibm e_log.c / e_exp.c)
+   log: x = 2^k * m with m in [sqrt(2)/2, sqrt(2)), log(m) = f - f^2/2 + s*(f^2/2 + R(s^2)), s = f/(2+f)
+   exp: y = k*ln2 + r with |r| <= ln2/2, exp(r) from a rational approximation, scaled by 2^k
+*/
+const double ln2_hi = 6.93147180369123816490e-01;
+const double ln2_lo = 1.90821492927058770002e-10;
+const double log2e  = 1.44269504088896338700e+00;
+const double sqrt2  = 1.41421356237309504880e+00;
+const double Lg1 = 6.666666666666735130e-01, Lg2 = 3.999999999940941908e-01,
+             Lg3 = 2.857142874366239149e-01, Lg4 = 2.222219843214978396e-01,
+             Lg5 = 1.818357216161805012e-01, Lg6 = 1.531383769920937332e-01,
+             Lg7 = 1.479819860511658591e-01;
+const double P1 = 1.66666666666666019037e-01, P2 = -2.77777777770155933842e-03,
+             P3 = 6.61375632143793436117e-05, P4 = -1.65339022054652515390e-06,
+             P5 = 4.13813679705723846039e-08;
+const double exp_min = -708, exp_max = 709;     // exp() of this range is a normal number
+const double round_shift = 6755399441055744.0;  // 1.5 * 2^52: adding it rounds to an integer
+const double two52 = 4503599627370496.0;
+
+#ifdef COLUMNAR_SSE2
+
+//-------------------------------------------------------
+// SSE2 kernels, 2 rows per instruction
+
+#define SSE2_BINARY(name, intrinsic) \
+void name##Sse2(const double *a, const double *b, double *r, size_t n) \
+{ \
+    size_t i = 0; \
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(r + i, intrinsic(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))); \
+    name##Scalar(a + i, b + i, r + i, n - i); \
+}
+
+SSE2_BINARY(add, _mm_add_pd)
+SSE2_BINARY(sub, _mm_sub_pd)
+SSE2_BINARY(mul, _mm_mul_pd)
+SSE2_BINARY(div, _mm_div_pd)
+
+void negSse2(const double *a, double *r, size_t n)
+{
+    const __m128d sign = _mm_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(r + i, _mm_xor_pd(_mm_loadu_pd(a + i), sign));
+    negScalar(a + i, r + i, n - i);
+}
+
+inline __m128d select(__m128d mask, __m128d t, __m128d f)
+{
+    return _mm_or_pd(_mm_and_pd(mask, t), _mm_andnot_pd(mask, f));
+}
+
+// lanes which are not positive normal numbers
+inline __m128d notNormal(__m128d x)
+{
+    return _mm_or_pd(_mm_cmpnge_pd(x, _mm_set1_pd(DBL_MIN)), _mm_cmpnle_pd(x, _mm_set1_pd(DBL_MAX)));
+}
+
+// log of positive normal numbers
+inline __m128d logCore(__m128d x)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    __m128i bits = _mm_castpd_si128(x);
+
+    // exponent: the biased exponent bits placed into the mantissa of 2^52
+    __m128d k = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), _mm_castpd_si128(_mm_set1_pd(two52))));
+    k = _mm_sub_pd(k, _mm_set1_pd(two52 + 1023));
+
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)), _mm_castpd_si128(one)));
+    __m128d big = _mm_cmpgt_pd(m, _mm_set1_pd(sqrt2));
+    m = _mm_mul_pd(m, select(big, _mm_set1_pd(0.5), one));
+    k = _mm_add_pd(k, _mm_and_pd(big, one));
+
+    __m128d f = _mm_sub_pd(m, one);
+    __m128d s = _mm_div_pd(f, _mm_add_pd(_mm_set1_pd(2.0), f));
+    __m128d z = _mm_mul_pd(s, s);
+    __m128d w = _mm_mul_pd(z, z);
+    __m128d t1 = _mm_mul_pd(w, _mm_add_pd(_mm_set1_pd(Lg2), _mm_mul_pd(w, _mm_add_pd(_mm_set1_pd(Lg4), _mm_mul_pd(w, _mm_set1_pd(Lg6))))));
+    __m128d t2 = _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(Lg1), _mm_mul_pd(w, _mm_add_pd(_mm_set1_pd(Lg3),
+                            _mm_mul_pd(w, _mm_add_pd(_mm_set1_pd(Lg5), _mm_mul_pd(w, _mm_set1_pd(Lg7))))))));
+    __m128d R = _mm_add_pd(t1, t2);
+    __m128d hfsq = _mm_mul_pd(_mm_set1_pd(0.5), _mm_mul_pd(f, f));
+
+    // k*ln2_hi - ((hfsq - (s*(hfsq+R) + k*ln2_lo)) - f)
+    __m128d lo = _mm_add_pd(_mm_mul_pd(s, _mm_add_pd(hfsq, R)), _mm_mul_pd(k, _mm_set1_pd(ln2_lo)));
+    return _mm_sub_pd(_mm_mul_pd(k, _mm_set1_pd(ln2_hi)), _mm_sub_pd(_mm_sub_pd(hfsq, lo), f));
+}
+
+// exp of numbers in [exp_min, exp_max]
+inline __m128d expCore(__m128d y)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+
+    __m128d t = _mm_add_pd(_mm_mul_pd(y, _mm_set1_pd(log2e)), _mm_set1_pd(round_shift));
+    __m128d k = _mm_sub_pd(t, _mm_set1_pd(round_shift));
+
+    __m128d hi = _mm_sub_pd(y, _mm_mul_pd(k, _mm_set1_pd(ln2_hi)));
+    __m128d lo = _mm_mul_pd(k, _mm_set1_pd(ln2_lo));
+    __m128d r = _mm_sub_pd(hi, lo);
+    __m128d rr = _mm_mul_pd(r, r);
+    __m128d c = _mm_sub_pd(r, _mm_mul_pd(rr, _mm_add_pd(_mm_set1_pd(P1), _mm_mul_pd(rr, _mm_add_pd(_mm_set1_pd(P2),
+                           _mm_mul_pd(rr, _mm_add_pd(_mm_set1_pd(P3), _mm_mul_pd(rr, _mm_add_pd(_mm_set1_pd(P4), _mm_mul_pd(rr, _mm_set1_pd(P5)))))))))));
+    // 1 - ((lo - (r*c)/(2-c)) - hi)
+    __m128d e = _mm_sub_pd(one, _mm_sub_pd(_mm_sub_pd(lo, _mm_div_pd(_mm_mul_pd(r, c), _mm_sub_pd(_mm_set1_pd(2.0), c))), hi));
+
+    // 2^k: k is in the low bits of t
+    __m128i kb = _mm_add_epi64(_mm_castpd_si128(t), _mm_set1_epi64x(1023));
+    return _mm_mul_pd(e, _mm_castsi128_pd(_mm_slli_epi64(kb, 52)));
+}
+
+void logSse2(const double *a, double *r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        __m128d y = logCore(x);
+        if (_mm_movemask_pd(notNormal(x))) {
+            double xs[2], ys[2];
+            _mm_storeu_pd(xs, x);
+            _mm_storeu_pd(ys, y);
+            for (int j = 0; j < 2; j++) if (!(xs[j] >= DBL_MIN && xs[j] <= DBL_MAX)) ys[j] = std::log(xs[j]);
+            y = _mm_loadu_pd(ys);
+        }
+        _mm_storeu_pd(r + i, y);
+    }
+    logScalar(a + i, r + i, n - i);
+}
+
+// a^b = exp(b*log(a)) for positive normal a and results in the normal range
+void powSse2(const double *a, const double *b, double *r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        __m128d e = _mm_loadu_pd(b + i);
+        __m128d y = _mm_mul_pd(e, logCore(x));
+        __m128d special = _mm_or_pd(notNormal(x),
+                          _mm_or_pd(_mm_cmpnge_pd(y, _mm_set1_pd(exp_min)), _mm_cmpnle_pd(y, _mm_set1_pd(exp_max))));
+        // keep the polynomial evaluation of special lanes finite
+        __m128d p = expCore(select(special, _mm_setzero_pd(), y));
+        if (_mm_movemask_pd(special)) {
+            double xs[2], es[2], ps[2];
+            _mm_storeu_pd(xs, x);
+            _mm_storeu_pd(es, e);
+            _mm_storeu_pd(ps, p);
+            int mask = _mm_movemask_pd(special);
+            for (int j = 0; j < 2; j++) if (mask & (1 << j)) ps[j] = std::pow(xs[j], es[j]);
+            p = _mm_loadu_pd(ps);
+        }
+        _mm_storeu_pd(r + i, p);
+    }
+    powScalar(a + i, b + i, r + i, n - i);
+}
+
+const column_evaluator::kernels sse2_kernels = {
+    addSse2, subSse2, mulSse2, divSse2, powScalar, negSse2, logScalar
+};
+
+const column_evaluator::kernels sse2_approximate_kernels = {
+    addSse2, subSse2, mulSse2, divSse2, powSse2, negSse2, logSse2
+};
+
+#endif
+
+#ifdef COLUMNAR_AVX2
+
+//-------------------------------------------------------
+// AVX2 kernels, 4 rows per instruction; same algorithms as the SSE2 ones
+
+#define AVX2_BINARY(name, intrinsic) \
+TARGET_AVX2 void name##Avx2(const double *a, const double *b, double *r, size_t n) \
+{ \
+    size_t i = 0; \
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(r + i, intrinsic(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); \
+    name##Scalar(a + i, b + i, r + i, n - i); \
+}
+
+AVX2_BINARY(add, _mm256_add_pd)
+AVX2_BINARY(sub, _mm256_sub_pd)
+AVX2_BINARY(mul, _mm256_mul_pd)
+AVX2_BINARY(div, _mm256_div_pd)
+
+TARGET_AVX2 void negAvx2(const double *a, double *r, size_t n)
+{
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(r + i, _mm256_xor_pd(_mm256_loadu_pd(a + i), sign));
+    negScalar(a + i, r + i, n - i);
+}
+
+TARGET_AVX2 inline __m256d notNormal(__m256d x)
+{
+    return _mm256_or_pd(_mm256_cmp_pd(x, _mm256_set1_pd(DBL_MIN), _CMP_NGE_UQ), _mm256_cmp_pd(x, _mm256_set1_pd(DBL_MAX), _CMP_NLE_UQ));
+}
+
+TARGET_AVX2 inline __m256d logCore(__m256d x)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256i bits = _mm256_castpd_si256(x);
+
+    __m256d k = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_castpd_si256(_mm256_set1_pd(two52))));
+    k = _mm256_sub_pd(k, _mm256_set1_pd(two52 + 1023));
+
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)), _mm256_castpd_si256(one)));
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(sqrt2), _CMP_GT_OQ);
+    m = _mm256_mul_pd(m, _mm256_blendv_pd(one, _mm256_set1_pd(0.5), big));
+    k = _mm256_add_pd(k, _mm256_and_pd(big, one));
+
+    __m256d f = _mm256_sub_pd(m, one);
+    __m256d s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+    __m256d z = _mm256_mul_pd(s, s);
+    __m256d w = _mm256_mul_pd(z, z);
+    __m256d t1 = _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(Lg2), _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(Lg4), _mm256_mul_pd(w, _mm256_set1_pd(Lg6))))));
+    __m256d t2 = _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(Lg1), _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(Lg3),
+                               _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(Lg5), _mm256_mul_pd(w, _mm256_set1_pd(Lg7))))))));
+    __m256d R = _mm256_add_pd(t1, t2);
+    __m256d hfsq = _mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(f, f));
+
+    __m256d lo = _mm256_add_pd(_mm256_mul_pd(s, _mm256_add_pd(hfsq, R)), _mm256_mul_pd(k, _mm256_set1_pd(ln2_lo)));
+    return _mm256_sub_pd(_mm256_mul_pd(k, _mm256_set1_pd(ln2_hi)), _mm256_sub_pd(_mm256_sub_pd(hfsq, lo), f));
+}
+
+TARGET_AVX2 inline __m256d expCore(__m256d y)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    __m256d t = _mm256_add_pd(_mm256_mul_pd(y, _mm256_set1_pd(log2e)), _mm256_set1_pd(round_shift));
+    __m256d k = _mm256_sub_pd(t, _mm256_set1_pd(round_shift));
+
+    __m256d hi = _mm256_sub_pd(y, _mm256_mul_pd(k, _mm256_set1_pd(ln2_hi)));
+    __m256d lo = _mm256_mul_pd(k, _mm256_set1_pd(ln2_lo));
+    __m256d r = _mm256_sub_pd(hi, lo);
+    __m256d rr = _mm256_mul_pd(r, r);
+    __m256d c = _mm256_sub_pd(r, _mm256_mul_pd(rr, _mm256_add_pd(_mm256_set1_pd(P1), _mm256_mul_pd(rr, _mm256_add_pd(_mm256_set1_pd(P2),
+                              _mm256_mul_pd(rr, _mm256_add_pd(_mm256_set1_pd(P3), _mm256_mul_pd(rr, _mm256_add_pd(_mm256_set1_pd(P4), _mm256_mul_pd(rr, _mm256_set1_pd(P5)))))))))));
+    __m256d e = _mm256_sub_pd(one, _mm256_sub_pd(_mm256_sub_pd(lo, _mm256_div_pd(_mm256_mul_pd(r, c), _mm256_sub_pd(_mm256_set1_pd(2.0), c))), hi));
+
+    __m256i kb = _mm256_add_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(1023));
+    return _mm256_mul_pd(e, _mm256_castsi256_pd(_mm256_slli_epi64(kb, 52)));
+}
+
+TARGET_AVX2 void logAvx2(const double *a, double *r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        __m256d y = logCore(x);
+        if (_mm256_movemask_pd(notNormal(x))) {
+            double xs[4], ys[4];
+            _mm256_storeu_pd(xs, x);
+            _mm256_storeu_pd(ys, y);
+            for (int j = 0; j < 4; j++) if (!(xs[j] >= DBL_MIN && xs[j] <= DBL_MAX)) ys[j] = std::log(xs[j]);
+            y = _mm256_loadu_pd(ys);
+        }
+        _mm256_storeu_pd(r + i, y);
+    }
+    logScalar(a + i, r + i, n - i);
+}
+
+TARGET_AVX2 void powAvx2(const double *a, const double *b, double *r, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        __m256d e = _mm256_loadu_pd(b + i);
+        __m256d y = _mm256_mul_pd(e, logCore(x));
+        __m256d special = _mm256_or_pd(notNormal(x),
+                          _mm256_or_pd(_mm256_cmp_pd(y, _mm256_set1_pd(exp_min), _CMP_NGE_UQ), _mm256_cmp_pd(y, _mm256_set1_pd(exp_max), _CMP_NLE_UQ)));
+        __m256d p = expCore(_mm256_blendv_pd(y, _mm256_setzero_pd(), special));
+        int mask = _mm256_movemask_pd(special);
+        if (mask) {
+            double xs[4], es[4], ps[4];
+            _mm256_storeu_pd(xs, x);
+            _mm256_storeu_pd(es, e);
+            _mm256_storeu_pd(ps, p);
+            for (int j = 0; j < 4; j++) if (mask & (1 << j)) ps[j] = std::pow(xs[j], es[j]);
+            p = _mm256_loadu_pd(ps);
+        }
+        _mm256_storeu_pd(r + i, p);
+    }
+    powScalar(a + i, b + i, r + i, n - i);
+}
+
+const column_evaluator::kernels avx2_kernels = {
+    addAvx2, subAvx2, mulAvx2, divAvx2, powScalar, negAvx2, logScalar
+};
+
+const column_evaluator::kernels avx2_approximate_kernels = {
+    addAvx2, subAvx2, mulAvx2, divAvx2, powAvx2, negAvx2, logAvx2
+};
+
+#endif
+
+const column_evaluator::kernels& kernelsFor(simd_isa isa, bool approximate)
+{
+    switch (isa) {
+#ifdef COLUMNAR_AVX2
+    case simd_isa::avx2: return approximate ? avx2_approximate_kernels : avx2_kernels;
+#endif
+#ifdef COLUMNAR_SSE2
+    case simd_isa::sse2: return approximate ? sse2_approximate_kernels : sse2_kernels;
+#endif
+    default:             return scalar_kernels;
+    }
+}
+
+}
+
+//-------------------------------------------------------
+
+const size_t column_evaluator::tile;
+
+column_evaluator::column_evaluator(const program<double> &ip, size_t result, simd_isa isa, bool approximate) : p(ip)
+{
+    if (!p.range(result, first, last)) throw column_error("the program has no result " + std::to_string(result));
+
+    // fall back to the best available kernels
+    if (isa == simd_isa::avx2 && detectIsa() != simd_isa::avx2) isa = detectIsa();
+#ifndef COLUMNAR_SSE2
+    if (isa == simd_isa::sse2) isa = simd_isa::scalar;
+#endif
+    target = isa;
+    k = &kernelsFor(isa, approximate);
+
+    operands.resize(p.depth);
+    scratch.resize(p.depth * tile);
+    saved.resize(p.temps * tile);
+    consts.resize(p.consts.size() * tile);
+    for (size_t i = 0; i < p.consts.size(); i++) {
+        std::fill(consts.begin() + i * tile, consts.begin() + (i + 1) * tile, p.consts[i]);
+    }
+}
+
+void column_evaluator::run(const double * const *columns, size_t rows, double *out)
+{
+    for (size_t row = 0; row < rows; row += tile) {
+        size_t n = std::min(tile, rows - row);
+        const double **sp = operands.data();    // next free operand slot
+
+        for (size_t pc = first; pc < last; pc++) {
+            const op &o = p.code[pc];
+
+            // the last op writes straight into the output, the others into the tile of their stack level
+            auto target = [&](const double **operand) {
+                return pc + 1 == last ? out + row : &scratch[(operand - operands.data()) * tile];
+            };
+            double *r;
+
+            switch (o.code) {
+            case op_t::push_const: *sp++ = &consts[o.arg * tile]; break;
+            case op_t::push_var:   *sp++ = columns[o.arg] + row; break;
+            case op_t::add: sp--; r = target(sp - 1); k->add(sp[-1], sp[0], r, n); sp[-1] = r; break;
+            case op_t::sub: sp--; r = target(sp - 1); k->sub(sp[-1], sp[0], r, n); sp[-1] = r; break;
+            case op_t::mul: sp--; r = target(sp - 1); k->mul(sp[-1], sp[0], r, n); sp[-1] = r; break;
+            case op_t::div: sp--; r = target(sp - 1); k->div(sp[-1], sp[0], r, n); sp[-1] = r; break;
+            case op_t::pow: sp--; r = target(sp - 1); k->pow(sp[-1], sp[0], r, n); sp[-1] = r; break;
+            case op_t::neg: r = target(sp - 1); k->neg(sp[-1], r, n); sp[-1] = r; break;
+            case op_t::log: r = target(sp - 1); k->log(sp[-1], r, n); sp[-1] = r; break;
+            case op_t::result: sp--; break;     // of an earlier result
+            case op_t::store: std::copy(sp[-1], sp[-1] + n, &saved[o.arg * tile]); break;
+            case op_t::load:  *sp++ = &saved[o.arg * tile]; break;
+            }
+        }
+
+        // a lone variable or constant
+        if (sp[-1] != out + row) std::copy(sp[-1], sp[-1] + n, out + row);
+    }
+}
+
+std::vector<const double*> column_evaluator::bind(const column_table &t) const
+{
+    std::vector<const double*> r;
+    for (auto &v : p.vars) r.push_back(t.column(v).data());
+    return r;
+}
+
+//-------------------------------------------------------
+
+const std::vector<double>& column_table::column(const std::string &name) const
+{
+    auto i = std::find(names.begin(), names.end(), name);
+    if (i == names.end()) throw column_error("no column for the variable " + name);
+    return data[i - names.begin()];
+}
+
+namespace {
+
+// next line of the buffer without the line end
+bool nextLine(const char *&p, const char *end, const char *&line, size_t &n)
+{
+    if (p == end) return false;
+    const char *eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!eol) eol = end;
+    line = p;
+    n = eol - p;
+    if (n > 0 && line[n - 1] == '\r') n--;
+    p = eol == end ? end : eol + 1;
+    return true;
+}
+
+// comma separated fields of a line, with surrounding spaces removed
+void splitFields(const char *line, size_t n, std::vector<std::string> &fields)
+{
+    fields.clear();
+    size_t start = 0;
+    for (size_t i = 0; i <= n; i++) {
+        if (i < n && line[i] != ',') continue;
+        size_t b = start, e = i;
+        while (b < e && isspace((unsigned char)line[b])) b++;
+        while (e > b && isspace((unsigned char)line[e - 1])) e--;
+        fields.emplace_back(line + b, e - b);
+        start = i + 1;
+    }
+}
+
+}
+
+column_table column_table::readCsv(const char *p, size_t n)
+{
+    column_table t;
+    const char *end = p + n, *line;
+    size_t len, line_no = 1;
+    std::vector<std::string> fields;
+
+    if (!nextLine(p, end, line, len)) throw column_error("missing header line");
+    splitFields(line, len, t.names);
+    t.data.resize(t.names.size());
+
+    while (nextLine(p, end, line, len)) {
+        line_no++;
+        if (len == 0) continue;
+
+        splitFields(line, len, fields);
+        if (fields.size() != t.names.size()) {
+            throw column_error("line " + std::to_string(line_no) + ": expected " + std::to_string(t.names.size()) + " values");
+        }
+        for (size_t i = 0; i < fields.size(); i++) {
+            char *e;
+            double v = strtod(fields[i].c_str(), &e);
+            if (fields[i].empty() || *e) throw column_error("line " + std::to_string(line_no) + ": invalid number '" + fields[i] + "'");
+            t.data[i].push_back(v);
+        }
+        t.rows++;
+    }
+    return t;
+}
+
+column_table column_table::readBinary(const char *p, size_t n, const std::vector<std::string> &names)
+{
+    if (names.empty() || n % (names.size() * sizeof(double)) != 0) {
+        throw column_error("the input size is not a multiple of " + std::to_string(names.size()) + " columns of doubles");
+    }
+
+    column_table t;
+    t.names = names;
+    t.rows = n / (names.size() * sizeof(double));
+    for (size_t i = 0; i < names.size(); i++) {
+        t.data.emplace_back(t.rows);
+        if (t.rows) memcpy(t.data.back().data(), p + i * t.rows * sizeof(double), t.rows * sizeof(double));
+    }
+    return t;
+}
@@ -0,0 +1,78 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <vector>
+#include <string>
+#include <exception>
+
+#include "program.h"
+#include "cpu.h"
+
+/*
+   columnar evaluation of a compiled expression
+   one result of a program<double> is evaluated for many rows at once: variables are bound to
+   columns of values (structure of arrays) and every op runs as a vector kernel over a tile of
+   rows. Kernels exist for AVX2, SSE2 and plain scalar code; the best one supported by the CPU
+   is selected at run time.
+   All kernels give exactly the results of evaluator<double>: log and pow call the library
+   functions for every row. Vectorized polynomial log and pow are used only when asked for
+   ('approximate'); they are accurate to a few ulps (pow: relative error grows with |b*log(a)|),
+   so even integer powers may be off in the last digit. Their lanes outside of the domain
+   (non-positive or non-finite log arguments, negative bases, results out of the normal range)
+   are computed with the library functions, so special values match the scalar path.
+*/
+
+struct column_error : public std::exception {
+    const std::string msg;
+    column_error(const std::string & im) :msg(im) {};
+
+    virtual const char* what() const throw()
+    {
+        return msg.c_str();
+    }
+};
+
+// named columns of double values, all of the same length
+struct column_table {
+    std::vector<std::string>         names;
+    std::vector<std::vector<double>> data;
+    size_t rows = 0;
+
+    // CSV text with a header line of column names
+    static column_table readCsv(const char *p, size_t n);
+
+    // raw native doubles, column after column
+    static column_table readBinary(const char *p, size_t n, const std::vector<std::string> &names);
+
+    const std::vector<double>& column(const std::string &name) const;
+};
+
+class column_evaluator {
+public:
+    // evaluates the 'result'-th comma separated expression of the program
+    column_evaluator(const program<double> &p, size_t result = 0, simd_isa isa = detectIsa(), bool approximate = false);
+
+    // columns[i] holds the values of variable slot i of the program; 'out' receives 'rows' values
+    void run(const double * const *columns, size_t rows, double *out);
+
+    // bind the program variables to the columns of the same name
+    std::vector<const double*> bind(const column_table &t) const;
+
+    simd_isa isa() const { return target; };
+
+    struct kernels;
+
+private:
+    static const size_t tile = 512;     // rows evaluated by one kernel call
+
+    const program<double> &p;
+    size_t           first, last;       // op range of the selected result
+    simd_isa         target;
+    const kernels   *k;
+    std::vector<const double*> operands;  // stack of operand tiles
+    std::vector<double> scratch;        // one tile per stack level
+    std::vector<double> saved;          // one tile per temporary of the program
+    std::vector<double> consts;         // one tile per constant, filled with its value
+};
+
+#endif
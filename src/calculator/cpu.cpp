@@ -0,0 +1,58 @@
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_SSE2
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPU_AVX2
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+#include "cpu.h"
+
+namespace {
+
+#ifdef CPU_AVX2
+
+bool hasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;   // OS saves the YMM registers
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+}
+
+simd_isa detectIsa()
+{
+#ifdef CPU_AVX2
+    if (hasAvx2()) return simd_isa::avx2;
+#endif
+#ifdef CPU_SSE2
+    return simd_isa::sse2;
+#else
+    return simd_isa::scalar;
+#endif
+}
+
+const char* isaName(simd_isa isa)
+{
+    switch (isa) {
+    case simd_isa::avx2: return "avx2";
+    case simd_isa::sse2: return "sse2";
+    default:             return "scalar";
+    }
+}
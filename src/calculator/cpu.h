@@ -0,0 +1,19 @@
+#ifndef CPU_H
+#define CPU_H
+
+/*
+   vector instruction sets, detected at run time
+   the lexer, the columnar evaluator and the native code select their SSE2 or AVX2 code by
+   detectIsa(). SSE2 is part of x86-64; AVX2 is checked with cpuid (and that the OS saves the
+   YMM registers).
+*/
+
+enum class simd_isa {
+    scalar, sse2, avx2
+};
+
+// the best instruction set of this CPU that the build has code for
+simd_isa detectIsa();
+const char* isaName(simd_isa);
+
+#endif
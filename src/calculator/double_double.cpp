@@ -0,0 +1,271 @@
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+
+#include "double_double.h"
+
+namespace {
+
+const double_double ln2 = double_double::sum(6.931471805599452862e-01, 2.319046813846299558e-17);
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// a * 2^e, exact unless the result leaves the normal range
+double_double scale(const double_double &a, int e)
+{
+    return double_double::sum(std::ldexp(a.high(), e), std::ldexp(a.low(), e));
+}
+
+// 10^n, n >= 0; the powers up to 10^44 are exact
+double_double pow10(int n)
+{
+    static const struct table {
+        double_double p[45];
+        table() {
+            p[0] = 1;
+            for (int i = 1; i < 45; i++) p[i] = p[i - 1] * 10;
+        }
+    } t;
+
+    double_double r = t.p[n % 44];
+    for (; n >= 44; n -= 44) r *= t.p[44];
+    return r;
+}
+
+// a * 10^e, dividing by the exact powers for negative e
+double_double scale10(double_double a, int e)
+{
+    for (; e > 300; e -= 300) a *= pow10(300);
+    for (; e < -300; e += 300) a /= pow10(300);
+    return e >= 0 ? a * pow10(e) : a / pow10(-e);
+}
+
+}
+
+double_double floor(const double_double &a)
+{
+    double h = std::floor(a.high());
+    if (h != a.high()) return h;
+    return double_double::sum(h, std::floor(a.low()));
+}
+
+double_double exp(const double_double &a)
+{
+    // 1/i! for the series
+    static const struct table {
+        double_double f[16];
+        table() {
+            f[0] = 1;
+            for (int i = 1; i < 16; i++) f[i] = f[i - 1] / i;
+        }
+    } t;
+
+    double x = a.high();
+    if (std::isnan(x)) return a;
+    if (x >= 709.8) return std::numeric_limits<double>::infinity();
+    if (x <= -745.2) return 0.0;
+    if (a == 0) return 1.0;
+
+    // a = k ln 2 + 512 r, |r| <= ln 2 / 1024; exp(r) - 1 from the series, then squared 9 times
+    double k = std::floor(x / ln2.high() + 0.5);
+    double_double r = scale(a - ln2 * k, -9);
+
+    double_double s = r, p = r;
+    for (int i = 2; i < 16; i++) {
+        p *= r;
+        double_double term = p * t.f[i];
+        s += term;
+        if (std::fabs(term.high()) <= 1e-33 * std::fabs(s.high())) break;
+    }
+    for (int i = 0; i < 9; i++) s = s * 2 + s * s;     // exp(2r) - 1 = (exp(r) - 1)(exp(r) + 1)
+
+    return scale(s + 1, int(k));
+}
+
+double_double log(const double_double &a)
+{
+    double x = a.high();
+    if (std::isnan(x) || x == std::numeric_limits<double>::infinity()) return a;
+    if (x < 0) return std::numeric_limits<double>::quiet_NaN();
+    if (x == 0) return -std::numeric_limits<double>::infinity();
+
+    // exp(-y) below stays in the normal range
+    if (x < 1e-290) return log(scale(a, 600)) - ln2 * 600;
+    if (x > 1e290) return log(scale(a, -600)) + ln2 * 600;
+
+    // y + log(1 + t) for a = exp(y) (1 + t); t of the double logarithm is below 2e-13, so
+    // two terms of the series suffice
+    double_double y = std::log(x);
+    double_double t = a * exp(-y) - 1;
+    return y + (t - t.high() * t.high() / 2);
+}
+
+double_double pow(const double_double &a, const double_double &b)
+{
+    if (b == 0 || a == 1) return 1.0;
+    if (std::isnan(a.high()) || std::isnan(b.high())) return std::numeric_limits<double>::quiet_NaN();
+
+    double_double x = a;
+    if (floor(b) == b) {
+        if (std::fabs(b.high()) < 4.6e18) {
+            int64_t n = int64_t(b.high()) + int64_t(b.low());
+            uint64_t m = n < 0 ? uint64_t(-n) : uint64_t(n);
+            auto power = [m](double_double f) {
+                double_double r = 1.0;
+                for (uint64_t k = m;;) {
+                    if (k & 1) r *= f;
+                    k >>= 1;
+                    if (!k) return r;
+                    f *= f;
+                }
+            };
+
+            double_double r = power(a);
+            if (n > 0) return r;
+            // a^|n| beyond the normal range (2^-1030 is not 1 / inf): the powers of 1/a
+            if (isfinite(r) && std::fabs(r.high()) >= std::numeric_limits<double>::min()) return 1 / r;
+            return power(1 / a);
+        }
+        x = abs(a);     // larger integers are even
+    }
+
+    if (x < 0) return std::numeric_limits<double>::quiet_NaN();
+    if (x == 0) return b > 0 ? 0.0 : std::numeric_limits<double>::infinity();
+    if (!isfinite(x)) return b > 0 ? x : 0.0;
+    return exp(b * log(x));
+}
+
+
+bool parseNumber(const char *first, const char *last, double_double &value)
+{
+    const int max_digits = 34;          // the rest can't change the value
+
+    double_double m = 0.0;
+    int digits = 0, significant = 0;
+    long exponent = 0;
+    const char *p = first;
+
+    auto digit = [&](int d, bool fraction) {
+        digits++;
+        if (significant == 0 && d == 0) exponent -= fraction;
+        else if (significant < max_digits) {
+            m = m * 10 + d;
+            significant++;
+            exponent -= fraction;
+        }
+        else exponent += !fraction;
+    };
+
+    for (; p != last && isDigit(*p); p++) digit(*p - '0', false);
+    if (p != last && *p == '.') {
+        for (p++; p != last && isDigit(*p); p++) digit(*p - '0', true);
+    }
+    if (!digits) return false;
+
+    if (p != last && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative = p != last && *p == '-';
+        if (p != last && (*p == '-' || *p == '+')) p++;
+        if (p == last || !isDigit(*p)) return false;
+        long e = 0;
+        for (; p != last && isDigit(*p); p++) e = std::min(e * 10 + (*p - '0'), 100000L);
+        exponent += negative ? -e : e;
+    }
+    if (p != last) return false;
+
+    if (significant == 0) {
+        value = 0.0;
+        return true;
+    }
+    // out of range either way; the significant digits are below 10^34
+    if (exponent > 400 || exponent < -400) return false;
+
+    value = scale10(m, int(exponent));
+    return isfinite(value) && value != 0;
+}
+
+char* formatGeneral(char *p, const double_double &value, int precision)
+{
+    // doubles, which include the zeros and non-finite values, are printed exactly
+    if (value.low() == 0 && precision <= 17) return formatGeneral(p, value.high(), precision);
+    if (!isfinite(value)) return formatGeneral(p, value.high(), 6);
+    precision = std::max(1, std::min(precision, 32));
+
+    // |value| = r * 10^e, 1 <= r < 10
+    double_double r = abs(value);
+    int e = int(std::floor(std::log10(r.high())));
+    r = scale10(r, -e);
+    if (r >= 10) { r /= 10; e++; }
+    else if (r < 1) { r *= 10; e--; }
+
+    // two digits beyond the precision; the errors of the last bits may leave digits outside
+    // 0-9, which are carried to the ones before
+    const int n = precision + 2;
+    int d[40];
+    for (int i = 0; i < n; i++) {
+        double f = std::floor(r.high());
+        d[i] = int(f);
+        r = (r - f) * 10;
+    }
+    for (int i = n - 1; i > 0; i--) {
+        while (d[i] < 0) { d[i] += 10; d[i - 1]--; }
+        while (d[i] > 9) { d[i] -= 10; d[i - 1]++; }
+    }
+    if (d[0] > 9) {
+        std::copy_backward(d, d + n - 1, d + n);
+        d[0] = 1;
+        d[1] -= 10;
+        e++;
+    }
+    else if (d[0] == 0) {
+        std::copy(d + 1, d + n, d);
+        d[n - 1] = 0;
+        e--;
+    }
+
+    // round half up on the first digit beyond the precision
+    if (d[precision] >= 5) {
+        int i = precision - 1;
+        for (d[i]++; i > 0 && d[i] > 9; i--) {
+            d[i] = 0;
+            d[i - 1]++;
+        }
+        if (d[0] > 9) {
+            d[0] = 1;
+            e++;
+        }
+    }
+
+    char digits[40];
+    int count = precision;
+    for (int i = 0; i < count; i++) digits[i] = char('0' + d[i]);
+    while (count > 1 && digits[count - 1] == '0') count--;
+    return formatDigits(p, value < 0, digits, count, e, precision);
+}
+
+std::ostream& operator<<(std::ostream &os, const double_double &value)
+{
+    char buf[64];
+    return os << std::string(buf, formatGeneral(buf, value, int(os.precision())));
+}
+
+std::istream& operator>>(std::istream &is, double_double &value)
+{
+    std::istream::sentry s(is);
+    if (!s) return is;
+
+    std::string text;
+    for (int c = is.peek(); c != std::char_traits<char>::eof(); c = is.peek()) {
+        char last = text.empty() ? 'e' : text.back();
+        bool sign = (c == '-' || c == '+') && (last == 'e' || last == 'E');
+        if (!sign && !isDigit(char(c)) && c != '.' && c != 'e' && c != 'E') break;
+        text += char(is.get());
+    }
+
+    size_t start = !text.empty() && (text[0] == '-' || text[0] == '+');
+    double_double v;
+    if (!parseNumber(text.data() + start, text.data() + text.size(), v)) is.setstate(std::ios::failbit);
+    else value = start && text[0] == '-' ? -v : v;
+    return is;
+}
@@ -0,0 +1,198 @@
+#ifndef DOUBLE_DOUBLE_H
+#define DOUBLE_DOUBLE_H
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <istream>
+#include <ostream>
+
+#include "numbers.h"
+
+/*
+   double-double numbers: the unevaluated sum hi + lo of two doubles, |lo| <= ulp(hi) / 2, for
+   106 significant bits (about 32 decimal digits) with the exponent range of double
+   the arithmetic uses error-free transformations of double operations (the two-sum and the
+   two-product, with fma where the hardware has it) and is accurate to a few units of the last
+   bit of lo; log and exp to about 31 digits, pow with an error growing with the magnitude of
+   the logarithm of its result. Infinities and NaN are kept in hi with a zero lo.
+   It is a number type for affine<T> and parser<T>: it has the arithmetic and comparison
+   operators, log, pow and abs for argument dependent lookup, numeric_limits, stream I/O
+   ('%g' layout at the stream precision) and the fast paths of atom_traits.
+*/
+
+class double_double {
+public:
+    double_double() : hi(0), lo(0) {};
+    double_double(double v) : hi(v), lo(0) {};
+
+    // the exact sum of a and b
+    static double_double sum(double a, double b);
+    // the exact product of a and b
+    static double_double product(double a, double b);
+
+    explicit operator double() const { return hi; };
+
+    double high() const { return hi; };
+    double low() const { return lo; };
+
+    double_double& operator+=(const double_double &b);
+    double_double& operator-=(const double_double &b) { return *this += -b; };
+    double_double& operator*=(const double_double &b);
+    double_double& operator/=(const double_double &b);
+
+    double_double operator-() const { return double_double(-hi, -lo); };
+
+    friend bool operator==(const double_double &a, const double_double &b) { return a.hi == b.hi && a.lo == b.lo; };
+    friend bool operator<(const double_double &a, const double_double &b) { return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo); };
+
+private:
+    double_double(double h, double l) : hi(h), lo(l) {};
+
+    // hi + lo for |a| >= |b| or a == 0
+    static double_double quickSum(double a, double b);
+
+    double hi, lo;
+};
+
+inline double_double double_double::quickSum(double a, double b)
+{
+    double s = a + b;
+    if (!std::isfinite(s)) return double_double(s, 0);
+    return double_double(s, b - (s - a));
+}
+
+inline double_double double_double::sum(double a, double b)
+{
+    double s = a + b;
+    if (!std::isfinite(s)) return double_double(s, 0);
+    double bb = s - a;
+    return double_double(s, (a - (s - bb)) + (b - bb));
+}
+
+inline double_double double_double::product(double a, double b)
+{
+    double p = a * b;
+    if (!std::isfinite(p)) return double_double(p, 0);
+#ifdef __FMA__
+    return double_double(p, std::fma(a, b, -p));
+#else
+    // Dekker: both factors split into 26-bit halves whose products are exact; the split
+    // overflows for the largest magnitudes, left to the library fma
+    if (std::fabs(a) > 1e299 || std::fabs(b) > 1e299) return double_double(p, std::fma(a, b, -p));
+    const double split = 134217729.0;       // 2^27 + 1
+    double t = split * a, ah = t - (t - a), al = a - ah;
+    t = split * b;
+    double bh = t - (t - b), bl = b - bh;
+    return double_double(p, ((ah * bh - p) + ah * bl + al * bh) + al * bl);
+#endif
+}
+
+inline double_double operator+(double_double a, const double_double &b) { return a += b; }
+inline double_double operator-(double_double a, const double_double &b) { return a -= b; }
+inline double_double operator*(double_double a, const double_double &b) { return a *= b; }
+inline double_double operator/(double_double a, const double_double &b) { return a /= b; }
+
+inline double_double& double_double::operator+=(const double_double &b)
+{
+    double_double s = sum(hi, b.hi), t = sum(lo, b.lo);
+    if (!std::isfinite(s.hi)) return *this = s;
+    s = quickSum(s.hi, s.lo + t.hi);
+    return *this = quickSum(s.hi, s.lo + t.lo);
+}
+
+inline double_double& double_double::operator*=(const double_double &b)
+{
+    double_double p = product(hi, b.hi);
+    if (!std::isfinite(p.hi) || p.hi == 0) return *this = p;     // keeps the sign of zeros
+    return *this = quickSum(p.hi, p.lo + (hi * b.lo + lo * b.hi));
+}
+
+inline double_double& double_double::operator/=(const double_double &b)
+{
+    double q1 = hi / b.hi;
+    if (!std::isfinite(q1) || q1 == 0) return *this = double_double(q1, 0);
+
+    // long division: each quotient digit from the remainder of the previous ones
+    double_double r = *this - b * q1;
+    double q2 = r.hi / b.hi;
+    r -= b * q2;
+    double q3 = r.hi / b.hi;
+    return *this = quickSum(q1, q2) + q3;
+}
+
+inline bool operator!=(const double_double &a, const double_double &b) { return !(a == b); }
+inline bool operator>(const double_double &a, const double_double &b) { return b < a; }
+inline bool operator<=(const double_double &a, const double_double &b) { return a < b || a == b; }
+inline bool operator>=(const double_double &a, const double_double &b) { return b < a || a == b; }
+
+inline double_double abs(const double_double &a) { return a.high() < 0 ? -a : a; }
+inline bool isfinite(const double_double &a) { return std::isfinite(a.high()); }
+
+// the largest integer not above a
+double_double floor(const double_double &a);
+double_double exp(const double_double &a);
+// NaN for a < 0, -inf for 0
+double_double log(const double_double &a);
+// the special cases of std::pow; integer exponents by repeated squaring
+double_double pow(const double_double &a, const double_double &b);
+
+// parse a lexer literal as parseNumber does for double
+bool parseNumber(const char *first, const char *last, double_double &value);
+
+// '%g' with up to 32 significant digits, the last of which may be off by one (doubles are
+// printed exactly, other ties are rounded up); the buffer
+// needs precision + 10 chars
+char* formatGeneral(char *first, const double_double &value, int precision = 6);
+
+// the stream precision is used for all float fields
+std::ostream& operator<<(std::ostream &os, const double_double &value);
+// a literal with an optional sign
+std::istream& operator>>(std::istream &is, double_double &value);
+
+inline void appendNumber(std::string &s, const double_double &value)
+{
+    char buf[number_buffer];
+    s.append(buf, formatGeneral(buf, value));
+}
+
+inline void appendPrecise(std::string &s, const double_double &value)
+{
+    char buf[32 + 10];
+    s.append(buf, formatGeneral(buf, value, 32));
+}
+
+template<>
+struct atom_traits<double_double> : atom_arithmetic<double_double> {
+    static bool number(const char *first, const char *last, double_double &value) {
+        return parseNumber(first, last, value);
+    }
+
+    static bool variable(const char *, size_t, double_double &) { return false; }
+
+    static void print(std::ostream &os, const double_double &value) { os << value; }
+};
+
+namespace std {
+
+template<>
+class numeric_limits<double_double> : public numeric_limits<double> {
+public:
+    static constexpr int digits = 106;
+    static constexpr int digits10 = 31;
+    static constexpr int max_digits10 = 32;
+
+    static double_double min() noexcept { return numeric_limits<double>::min(); }
+    static double_double max() noexcept { return numeric_limits<double>::max(); }
+    static double_double lowest() noexcept { return numeric_limits<double>::lowest(); }
+    static double_double epsilon() noexcept { return std::ldexp(1.0, -104); }
+    static double_double round_error() noexcept { return 0.5; }
+    static double_double infinity() noexcept { return numeric_limits<double>::infinity(); }
+    static double_double quiet_NaN() noexcept { return numeric_limits<double>::quiet_NaN(); }
+    static double_double signaling_NaN() noexcept { return numeric_limits<double>::signaling_NaN(); }
+    static double_double denorm_min() noexcept { return numeric_limits<double>::denorm_min(); }
+};
+
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+
+#include "driver.h"
+#include "system.h"
+#include "format.h"
+
+
+// error report: the input line with a caret under the error position
+void printError(std::ostream &err, const char *s, size_t n, size_t pos, const std::string &msg)
+{
+    std::string text;
+    appendError(text, s, n, pos, msg);
+    err.write(text.data(), text.size());
+}
+
+// errors are written to stderr, or to stdout as the records of the machine formats
+static std::string& errorText(line_context &ctx, block_output &out)
+{
+    return ctx.formatter.errorsInOutput() ? out.out_text() : out.err_text();
+}
+
+static void printResults(line_context &ctx, block_output &out, const std::vector<restype> &result)
+{
+    auto &f = ctx.formatter;
+    if (ctx.solve_system) {
+        // expressions are printed in order, the equations are solved together at the end
+        sparse_system<numtype> system;
+        for (auto &z : result) {
+            if (z.equal_to_zero) {
+                system.add(z.atom);
+            }
+            else {
+                STATS_STAGE(ctx.stats, stage::format);
+                f.expression(out.out_text(), z.atom);
+            }
+        }
+        if (system.equations() > 0) {
+            STATS_STAGE(ctx.stats, stage::solve);
+            auto solution = system.solve();
+            f.system(out.out_text(), solution);
+        }
+    }
+    else {
+        for (auto &z : result) {
+            // iterate over all comma-separated equations/expressions
+            STATS_STAGE(ctx.stats, z.equal_to_zero ? stage::solve : stage::format);
+            if (z.equal_to_zero) f.equation(out.out_text(), z.atom);
+            else                 f.expression(out.out_text(), z.atom);
+        }
+    }
+}
+
+// error report of a line, timed as output formatting
+static void printLineError(line_context &ctx, block_output &out, const char *s, size_t n, size_t pos, const std::string &msg)
+{
+    STATS_STAGE(ctx.stats, stage::format);
+    ctx.formatter.error(errorText(ctx, out), s, n, pos, msg);
+}
+
+// parse result of a line through the cache; errors are kept as the index of their token
+static std::shared_ptr<const line_cache::value> cachedParse(line_context &ctx)
+{
+    line_cache::normalize(ctx.tokens, ctx.key);
+    auto cached = ctx.cache->find(ctx.key);
+    if (cached) return cached;
+
+    auto v = std::make_shared<line_cache::value>();
+    std::vector<restype> results;
+    auto st = parser<atomtype>::try_parse(ctx.tokens, results, ctx.method);
+    if (st.ok()) {
+        arena_scope persistent(nullptr);    // the cached copy outlives the line arena
+        v->results = results;
+    }
+    else {
+        v->failed = true;
+        v->error_msg = st.msg;
+        v->error_token = st.where - ctx.tokens.data();
+    }
+    ctx.cache->insert(ctx.key, v);
+    return v;
+}
+
+// session mode: assignments update the worksheet, other lines are evaluated with its values
+static void evaluateSessionLine(const char *s, size_t n, line_context &ctx, block_output &out)
+{
+    try {
+        if (line_session::isAssignment(ctx.tokens)) {
+            const std::vector<const line_session::definition*> *updates;
+            {
+                STATS_STAGE(ctx.stats, stage::parse);
+                updates = &ctx.session->assign(ctx.tokens, s, n);
+            }
+
+            STATS_STAGE(ctx.stats, stage::format);
+            auto d = ctx.session->find(ctx.tokens[0].str());
+            ctx.formatter.definition(out.out_text(), d->name, d->value, false);
+
+            // dependents whose value changed
+            for (auto u : *updates) {
+                if (u->failed) ctx.formatter.error(errorText(ctx, out), u->text.data(), u->text.size(), u->error_pos, u->error_msg);
+                else           ctx.formatter.definition(out.out_text(), u->name, u->value, true);
+            }
+        }
+        else {
+            std::vector<restype> results;
+            {
+                STATS_STAGE(ctx.stats, stage::parse);
+                results = ctx.session->evaluate(ctx.tokens);
+            }
+            printResults(ctx, out, results);
+        }
+    }
+    catch (line_session::error &e) {
+        printLineError(ctx, out, s, n, e.t.pos, e.msg);
+    }
+    catch (symbol_table::error &e) {
+        printLineError(ctx, out, s, n, 0, e.msg);
+    }
+}
+
+static void evaluateLine(const char *s, size_t n, line_context &ctx, block_output &out)
+{
+    if (ctx.session) {
+        evaluateSessionLine(s, n, ctx, out);
+        return;
+    }
+
+    if (ctx.cache) {
+        std::shared_ptr<const line_cache::value> v;
+        {
+            STATS_STAGE(ctx.stats, stage::parse);
+            v = cachedParse(ctx);
+        }
+        if (v->failed) printLineError(ctx, out, s, n, ctx.tokens[v->error_token].pos, v->error_msg);
+        else           printResults(ctx, out, v->results);
+        return;
+    }
+
+    std::vector<restype> results;
+    parser<atomtype>::status st;
+    {
+        STATS_STAGE(ctx.stats, stage::parse);
+        st = parser<atomtype>::try_parse(ctx.tokens, results, ctx.method);
+    }
+    if (st.ok()) printResults(ctx, out, results);
+    else         printLineError(ctx, out, s, n, st.where->pos, st.msg);
+}
+
+#if CALCULATOR_STATS
+// token and variable reference counts of a line
+static void countTokens(const std::vector<token_view> &tokens, line_stats *stats)
+{
+    size_t variables = 0;
+    for (auto &t : tokens) variables += t.type == tok_t::id && t.kind != tok_kind::kw_log;
+    stats->countTokens(tokens.size() - 1, variables);
+}
+#endif
+
+// evaluate one input line and print its results or the error report
+void processLine(const char *s, size_t n, line_context &ctx, block_output &out)
+{
+    STATS_LINE(ctx.stats);
+    ctx.formatter.line();
+    {
+        STATS_STAGE(ctx.stats, stage::tokenize);
+        tokenize(s, n, ctx.tokens);
+    }
+#if CALCULATOR_STATS
+    if (ctx.stats) countTokens(ctx.tokens, ctx.stats);
+#endif
+
+    {
+        arena_scope scope(ctx.use_arena ? &ctx.scratch : nullptr);
+        evaluateLine(s, n, ctx, out);
+    }
+    ctx.scratch.reset();
+}
@@ -0,0 +1,70 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "cache.h"
+#include "output.h"
+#include "arena.h"
+#include "session.h"
+#include "stats.h"
+#include "format.h"
+
+/*
+   line processing of the calculator driver
+   a line is tokenized, parsed with the affine backend and its results or the error report
+   are written to the output of its block by the formatter of the context, as text, JSON or
+   binary records (see format.h). The temporaries of a line are allocated in the
+   arena of its context, which is reset when the line is done.
+   In session mode, assignments 'name = expression' are kept in the worksheet of the context
+   and the other lines are evaluated with its values (see session.h).
+   With a line_stats in the context, the stages of every line are timed and counted (see stats.h).
+*/
+
+// the number type is chosen at build time: double, or the wider or exact types of 'make NUMBER=...'
+#if defined(CALCULATOR_NUMBER_DOUBLE_DOUBLE)
+#include "double_double.h"
+using numtype  = double_double;
+#elif defined(CALCULATOR_NUMBER_FLOAT128)
+#include "float128.h"
+using numtype  = float128;
+#elif defined(CALCULATOR_NUMBER_RATIONAL)
+#include "rational.h"
+using numtype  = rational;
+#else
+//#include <boost/multiprecision/cpp_dec_float.hpp>
+//using numtype  = boost::multiprecision::cpp_dec_float_50;
+using numtype  = double;
+#endif
+using atomtype = affine<numtype>;
+using restype  = parser<atomtype>::result;
+
+using line_cache = result_cache<atomtype>;
+using line_session = session<numtype>;
+
+// per-thread scratch state of the line processing
+struct line_context {
+    std::vector<token_view> tokens;     // token buffer reused across lines
+    bool solve_system = false;          // solve all equations of a line together
+    parse_method method = parse_method::iterative;
+    line_cache *cache = nullptr;        // shared parse result cache (optional)
+    std::string key;                    // cache key buffer
+    bool use_arena = true;              // allocate the temporaries of a line in 'scratch'
+    arena scratch;                      // per-line arena, reset after every line
+    line_session *session = nullptr;    // worksheet of the session mode (optional, not shared)
+    line_stats *stats = nullptr;        // instrumentation counters (optional, not shared)
+    result_formatter<numtype> formatter;  // output format of the results
+};
+
+// evaluate one input line and print its results or the error report
+void processLine(const char *s, size_t n, line_context &ctx, block_output &out);
+
+// error report: the input line with a caret under the error position
+void printError(std::ostream &err, const char *s, size_t n, size_t pos, const std::string &msg);
+
+#endif
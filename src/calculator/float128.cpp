@@ -0,0 +1,111 @@
+#include "float128.h"
+
+#ifdef CALCULATOR_FLOAT128
+
+#include <cstring>
+#include <clocale>
+#include <algorithm>
+
+#include <quadmath.h>
+
+namespace {
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// libquadmath reads and writes the decimal point of the current locale
+char decimalPoint()
+{
+    const char *p = localeconv()->decimal_point;
+    return p && p[0] && !p[1] ? p[0] : '.';
+}
+
+}
+
+float128 abs(const float128 &a) { return float128::fromRaw(fabsq(a.raw())); }
+bool isfinite(const float128 &a) { return finiteq(a.raw()); }
+float128 log(const float128 &a) { return float128::fromRaw(logq(a.raw())); }
+float128 pow(const float128 &a, const float128 &b) { return float128::fromRaw(powq(a.raw(), b.raw())); }
+
+bool parseNumber(const char *first, const char *last, float128 &value)
+{
+    // the grammar of the lexer, checked here as strtoflt128 accepts more
+    const char *p = first;
+    bool digits = false, nonzero = false;
+    for (; p != last && isDigit(*p); p++) digits = true, nonzero |= *p != '0';
+    if (p != last && *p == '.') {
+        for (p++; p != last && isDigit(*p); p++) digits = true, nonzero |= *p != '0';
+    }
+    if (!digits) return false;
+    if (p != last && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p != last && (*p == '-' || *p == '+')) p++;
+        if (p == last || !isDigit(*p)) return false;
+        while (p != last && isDigit(*p)) p++;
+    }
+    if (p != last) return false;
+
+    // a NUL-terminated copy, on the heap only for the rare long literals
+    char buf[128];
+    std::string long_text;
+    size_t n = last - first;
+    char *text = buf;
+    if (n < sizeof(buf)) {
+        memcpy(buf, first, n);
+        buf[n] = 0;
+    }
+    else text = &(long_text = std::string(first, last))[0];
+
+    char point = decimalPoint();
+    if (point != '.') std::replace(text, text + n, '.', point);
+
+    __float128 v = strtoflt128(text, nullptr);
+    if (isinfq(v) || (v == 0 && nonzero)) return false;
+    value = float128::fromRaw(v);
+    return true;
+}
+
+char* formatGeneral(char *p, const float128 &value, int precision)
+{
+    precision = std::max(1, std::min(precision, 36));
+    int n = quadmath_snprintf(p, precision + 10, "%.*Qg", precision, value.raw());
+    char point = decimalPoint();
+    if (point != '.') std::replace(p, p + n, point, '.');
+    return p + n;
+}
+
+std::ostream& operator<<(std::ostream &os, const float128 &value)
+{
+    char buf[64];
+    return os << std::string(buf, formatGeneral(buf, value, int(os.precision())));
+}
+
+std::istream& operator>>(std::istream &is, float128 &value)
+{
+    std::istream::sentry s(is);
+    if (!s) return is;
+
+    std::string text;
+    for (int c = is.peek(); c != std::char_traits<char>::eof(); c = is.peek()) {
+        char last = text.empty() ? 'e' : text.back();
+        bool sign = (c == '-' || c == '+') && (last == 'e' || last == 'E');
+        if (!sign && !isDigit(char(c)) && c != '.' && c != 'e' && c != 'E') break;
+        text += char(is.get());
+    }
+
+    size_t start = !text.empty() && (text[0] == '-' || text[0] == '+');
+    float128 v;
+    if (!parseNumber(text.data() + start, text.data() + text.size(), v)) is.setstate(std::ios::failbit);
+    else value = start && text[0] == '-' ? -v : v;
+    return is;
+}
+
+namespace std {
+
+float128 numeric_limits<float128>::min() noexcept { return float128::fromRaw(ldexpq(1, -16382)); }
+float128 numeric_limits<float128>::max() noexcept { return float128::fromRaw(ldexpq(2 - ldexpq(1, -112), 16383)); }
+float128 numeric_limits<float128>::epsilon() noexcept { return float128::fromRaw(ldexpq(1, -112)); }
+float128 numeric_limits<float128>::denorm_min() noexcept { return float128::fromRaw(ldexpq(1, -16494)); }
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef FLOAT128_H
+#define FLOAT128_H
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <istream>
+#include <ostream>
+
+#include "numbers.h"
+
+/*
+   IEEE quadruple precision numbers (113 significant bits, about 34 decimal digits) of GCC's
+   __float128 and libquadmath, defined with CALCULATOR_FLOAT128 (the Makefile sets it, and links
+   the library, when quadmath.h is found)
+   the operations are done in software, so it is slower than double_double (see
+   double_double.h), but correctly rounded and with the exponent range of quadruple precision.
+   The wrapper gives the builtin type what affine<T> and parser<T> need: log, pow and abs for
+   argument dependent lookup, numeric_limits, stream I/O and the fast paths of atom_traits.
+*/
+
+#ifdef CALCULATOR_FLOAT128
+
+class float128 {
+public:
+    float128() : v(0) {};
+    float128(double d) : v(d) {};
+
+    static float128 fromRaw(__float128 q) { float128 r; r.v = q; return r; };
+    __float128 raw() const { return v; };
+
+    explicit operator double() const { return double(v); };
+
+    float128& operator+=(const float128 &b) { v += b.v; return *this; };
+    float128& operator-=(const float128 &b) { v -= b.v; return *this; };
+    float128& operator*=(const float128 &b) { v *= b.v; return *this; };
+    float128& operator/=(const float128 &b) { v /= b.v; return *this; };
+
+    float128 operator-() const { return fromRaw(-v); };
+
+    friend bool operator==(const float128 &a, const float128 &b) { return a.v == b.v; };
+    friend bool operator<(const float128 &a, const float128 &b) { return a.v < b.v; };
+
+private:
+    __float128 v;
+};
+
+inline float128 operator+(float128 a, const float128 &b) { return a += b; }
+inline float128 operator-(float128 a, const float128 &b) { return a -= b; }
+inline float128 operator*(float128 a, const float128 &b) { return a *= b; }
+inline float128 operator/(float128 a, const float128 &b) { return a /= b; }
+
+inline bool operator!=(const float128 &a, const float128 &b) { return a.raw() != b.raw(); }
+inline bool operator>(const float128 &a, const float128 &b) { return a.raw() > b.raw(); }
+inline bool operator<=(const float128 &a, const float128 &b) { return a.raw() <= b.raw(); }
+inline bool operator>=(const float128 &a, const float128 &b) { return a.raw() >= b.raw(); }
+
+float128 abs(const float128 &a);
+bool isfinite(const float128 &a);
+float128 log(const float128 &a);
+float128 pow(const float128 &a, const float128 &b);
+
+// parse a lexer literal as parseNumber does for double, correctly rounded
+bool parseNumber(const char *first, const char *last, float128 &value);
+
+// '%g' with up to 36 significant digits; the buffer needs precision + 10 chars
+char* formatGeneral(char *first, const float128 &value, int precision = 6);
+
+// the stream precision is used for all float fields
+std::ostream& operator<<(std::ostream &os, const float128 &value);
+// a literal with an optional sign
+std::istream& operator>>(std::istream &is, float128 &value);
+
+inline void appendNumber(std::string &s, const float128 &value)
+{
+    char buf[number_buffer];
+    s.append(buf, formatGeneral(buf, value));
+}
+
+inline void appendPrecise(std::string &s, const float128 &value)
+{
+    char buf[36 + 10];
+    s.append(buf, formatGeneral(buf, value, 36));
+}
+
+template<>
+struct atom_traits<float128> : atom_arithmetic<float128> {
+    static bool number(const char *first, const char *last, float128 &value) {
+        return parseNumber(first, last, value);
+    }
+
+    static bool variable(const char *, size_t, float128 &) { return false; }
+
+    static void print(std::ostream &os, const float128 &value) { os << value; }
+};
+
+namespace std {
+
+template<>
+class numeric_limits<float128> : public numeric_limits<double> {
+public:
+    static constexpr int digits = 113;
+    static constexpr int digits10 = 33;
+    static constexpr int max_digits10 = 36;
+    static constexpr int min_exponent = -16381;
+    static constexpr int min_exponent10 = -4931;
+    static constexpr int max_exponent = 16384;
+    static constexpr int max_exponent10 = 4932;
+
+    static float128 min() noexcept;
+    static float128 max() noexcept;
+    static float128 lowest() noexcept { return -max(); }
+    static float128 epsilon() noexcept;
+    static float128 round_error() noexcept { return 0.5; }
+    static float128 infinity() noexcept { return numeric_limits<double>::infinity(); }
+    static float128 quiet_NaN() noexcept { return numeric_limits<double>::quiet_NaN(); }
+    static float128 signaling_NaN() noexcept { return numeric_limits<double>::signaling_NaN(); }
+    static float128 denorm_min() noexcept;
+};
+
+}
+
+#endif
+
+#endif
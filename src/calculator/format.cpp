@@ -0,0 +1,92 @@
+#include <string>
+
+#include "format.h"
+
+const char* recordName(record_kind k)
+{
+    switch (k) {
+    case record_kind::expression:    return "expression";
+    case record_kind::identity:      return "true";
+    case record_kind::contradiction: return "false";
+    case record_kind::solution:      return "solution";
+    case record_kind::equation:      return "equation";
+    case record_kind::system:        return "system";
+    case record_kind::definition:    return "definition";
+    case record_kind::update:        return "update";
+    case record_kind::error:         return "error";
+    }
+    return "";
+}
+
+void appendError(std::string &s, const char *line, size_t n, size_t pos, const std::string &msg)
+{
+    s += '\n';
+    s.append(line, n);
+    s += '\n';
+    s.append(pos, ' ');
+    s += "^~~~~ ";
+    s += msg;
+    s += '\n';
+}
+
+void appendJsonString(std::string &s, const char *p, size_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    s += '"';
+    const char *e = p + n;
+    while (p < e) {
+        // runs of characters that need no escape are copied at once
+        const char *q = p;
+        while (q < e && (unsigned char)*q >= 0x20 && *q != '"' && *q != '\\') q++;
+        s.append(p, q - p);
+        if (q == e) break;
+
+        unsigned char c = (unsigned char)*q;
+        switch (c) {
+        case '"':  s += "\\\""; break;
+        case '\\': s += "\\\\"; break;
+        case '\n': s += "\\n"; break;
+        case '\r': s += "\\r"; break;
+        case '\t': s += "\\t"; break;
+        default:
+            s += "\\u00";
+            s += hex[c >> 4];
+            s += hex[c & 15];
+            break;
+        }
+        p = q + 1;
+    }
+    s += '"';
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool isJsonNumber(const char *p, const char *e)
+{
+    auto digits = [&]() {
+        const char *start = p;
+        while (p < e && *p >= '0' && *p <= '9') p++;
+        return p > start;
+    };
+
+    if (p < e && *p == '-') p++;
+    if (p < e && *p == '0') p++;
+    else if (!digits()) return false;
+    if (p < e && *p == '.') {
+        p++;
+        if (!digits()) return false;
+    }
+    if (p < e && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < e && (*p == '+' || *p == '-')) p++;
+        if (!digits()) return false;
+    }
+    return p == e;
+}
+
+void quoteJsonNumber(std::string &s, size_t start)
+{
+    if (isJsonNumber(s.data() + start, s.data() + s.size())) return;
+    s.insert(s.begin() + start, '"');
+    s += '"';
+}
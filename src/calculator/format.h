@@ -0,0 +1,471 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "symbols.h"
+#include "affine.h"
+#include "system.h"
+
+/*
+   formatting of the results of a line into a byte buffer
+   The records are appended to a caller string (the text of a block_output), whose capacity is
+   reused from line to line; numbers and names are written in place, without streams.
+   Three formats:
+   - text:   the human-readable output, "Result: x = 2"; errors are the input line with a caret
+             under the error position, written to the error buffer
+   - json:   one JSON object per line (NDJSON). Every record has "result", its index among the
+             records of its input line, and "kind", followed by the fields of the kind:
+               expression   "terms": {"x": 2, ...}, "constant": 0.5
+               true         "free": ["y", ...]              (an equation that holds)
+               false                                        (an equation that does not)
+               solution     "var": "x", "value": 2, "free": [...]
+               equation     "terms", "constant", "free"     (several variables remain, = 0)
+               system       "values": [{"var": "x", "terms", "constant"}, ...], "free"
+               definition   "var", "terms", "constant"      (session assignment)
+               update       "var", "terms", "constant"      (recomputed session dependent)
+               error        "pos", "message", "input"
+             Terms and free variables are in name order. Numbers a JSON number can't represent
+             exactly (non-finite values, fractions of NUMBER=rational) are strings.
+   - binary: length-prefixed records with the fields above in the same order; all integers
+             are unsigned 32-bit little-endian:
+               record       size of the rest, kind (1 byte, record_kind), result, fields
+               string       length, bytes
+               number       8 bytes of an IEEE double (little-endian); the other number types
+                            are strings with their text
+               terms        count, count * (string name, number coefficient)
+               list         count, count * element
+             'values' of a system is a list of (string var, terms, number constant).
+   In the machine formats the errors are records of the output, so the records of a line stay
+   together and in order. Numbers are written with all their digits (see appendPrecise).
+*/
+
+enum class output_format { text, json, binary };
+
+enum class record_kind : uint8_t {
+    expression, identity, contradiction, solution, equation, system, definition, update, error,
+};
+
+// JSON name of a record kind
+const char* recordName(record_kind k);
+
+// error report: the input line with a caret under the error position
+void appendError(std::string &s, const char *line, size_t n, size_t pos, const std::string &msg);
+
+// JSON string literal of [p, p + n)
+void appendJsonString(std::string &s, const char *p, size_t n);
+
+// quote the number text s[start..] unless it is a JSON number
+void quoteJsonNumber(std::string &s, size_t start);
+
+inline void appendUint32(std::string &s, uint32_t v)
+{
+    char b[4] = { char(v), char(v >> 8), char(v >> 16), char(v >> 24) };
+    s.append(b, 4);
+}
+
+inline void patchUint32(std::string &s, size_t at, uint32_t v)
+{
+    s[at] = char(v);
+    s[at + 1] = char(v >> 8);
+    s[at + 2] = char(v >> 16);
+    s[at + 3] = char(v >> 24);
+}
+
+inline void appendBinaryString(std::string &s, const char *p, size_t n)
+{
+    appendUint32(s, uint32_t(n));
+    s.append(p, n);
+}
+
+// the text of the value as a binary string
+template<typename T>
+void appendBinaryNumber(std::string &s, const T &value)
+{
+    size_t at = s.size();
+    appendUint32(s, 0);
+    appendPrecise(s, value);
+    patchUint32(s, at, uint32_t(s.size() - at - 4));
+}
+
+inline void appendBinaryNumber(std::string &s, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    appendUint32(s, uint32_t(bits));
+    appendUint32(s, uint32_t(bits >> 32));
+}
+
+template<typename T>
+class result_formatter {
+public:
+    using atom = affine<T>;
+    using solution_type = typename sparse_system<T>::solution;
+
+    explicit result_formatter(output_format f = output_format::text) : format(f) {};
+
+    output_format kind() const { return format; };
+
+    // the errors are records of the output (else they go to the error buffer)
+    bool errorsInOutput() const { return format != output_format::text; };
+
+    // start the records of the next input line
+    void line() { index = 0; };
+
+    // 'Result: a'
+    void expression(std::string &s, const atom &a);
+    // the solution of 'a = 0'
+    void equation(std::string &s, const atom &a);
+    // the same for an equation in the single unknown x: its solution, or the outcome when the
+    // coefficient of x cancelled (x is then free)
+    void solution(std::string &s, var_id x, const T &value);
+    void cancelled(std::string &s, var_id x, bool holds);
+    // the solution of a system; its lists are sorted by name
+    void system(std::string &s, solution_type &solution);
+    // session assignment 'name = value', or the new value of a dependent
+    void definition(std::string &s, var_id name, const atom &value, bool update);
+    // error at 'pos' of the input line [line, line + n)
+    void error(std::string &s, const char *line, size_t n, size_t pos, const std::string &msg);
+
+private:
+    output_format format;
+    uint32_t      index = 0;
+    size_t        start = 0;    // of the binary record being written
+    std::vector<var_id> names;
+
+    void begin(std::string &s, record_kind k);
+    void end(std::string &s);
+    void outcome(std::string &s, record_kind k, const atom *a, var_id x, const T &value);
+
+    void name(std::string &s, const char *field, var_id id);
+    void number(std::string &s, const char *field, const T &value);
+    void terms(std::string &s, const atom &a);
+    void freeVars(std::string &s, const std::vector<var_id> &ids);
+    void sortFree(const typename atom::id_list &ids);
+
+    void field(std::string &s, const char *name) {
+        s += ",\"";
+        s += name;
+        s += "\":";
+    };
+};
+
+template<typename T>
+void result_formatter<T>::begin(std::string &s, record_kind k)
+{
+    switch (format) {
+    case output_format::text:
+        break;
+    case output_format::json:
+        s += "{\"result\":";
+        s += std::to_string(index);
+        s += ",\"kind\":\"";
+        s += recordName(k);
+        s += '"';
+        break;
+    case output_format::binary:
+        start = s.size();
+        appendUint32(s, 0);
+        s += char(k);
+        appendUint32(s, index);
+        break;
+    }
+    index++;
+}
+
+template<typename T>
+void result_formatter<T>::end(std::string &s)
+{
+    switch (format) {
+    case output_format::text:
+        s += '\n';
+        break;
+    case output_format::json:
+        s += "}\n";
+        break;
+    case output_format::binary:
+        patchUint32(s, start, uint32_t(s.size() - start - 4));
+        break;
+    }
+}
+
+template<typename T>
+void result_formatter<T>::name(std::string &s, const char *f, var_id id)
+{
+    auto &n = symbol_table::name(id);
+    if (format == output_format::json) {
+        field(s, f);
+        appendJsonString(s, n.data(), n.size());
+    }
+    else appendBinaryString(s, n.data(), n.size());
+}
+
+template<typename T>
+void result_formatter<T>::number(std::string &s, const char *f, const T &value)
+{
+    if (format == output_format::json) {
+        if (f) field(s, f);
+        size_t at = s.size();
+        appendPrecise(s, value);
+        quoteJsonNumber(s, at);
+    }
+    else appendBinaryNumber(s, value);
+}
+
+// the terms and the constant of 'a'
+template<typename T>
+void result_formatter<T>::terms(std::string &s, const atom &a)
+{
+    typename atom::term_list list;
+    a.sortedTerms(list);
+
+    if (format == output_format::json) {
+        field(s, "terms");
+        s += '{';
+        for (size_t i = 0; i < list.size(); i++) {
+            if (i > 0) s += ',';
+            auto &n = symbol_table::name(list[i]->first);
+            appendJsonString(s, n.data(), n.size());
+            s += ':';
+            number(s, nullptr, list[i]->second);
+        }
+        s += '}';
+    }
+    else {
+        appendUint32(s, uint32_t(list.size()));
+        for (auto t : list) {
+            auto &n = symbol_table::name(t->first);
+            appendBinaryString(s, n.data(), n.size());
+            number(s, nullptr, t->second);
+        }
+    }
+    number(s, "constant", a.d);
+}
+
+template<typename T>
+void result_formatter<T>::freeVars(std::string &s, const std::vector<var_id> &ids)
+{
+    if (format == output_format::json) {
+        field(s, "free");
+        s += '[';
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (i > 0) s += ',';
+            auto &n = symbol_table::name(ids[i]);
+            appendJsonString(s, n.data(), n.size());
+        }
+        s += ']';
+    }
+    else {
+        appendUint32(s, uint32_t(ids.size()));
+        for (auto id : ids) {
+            auto &n = symbol_table::name(id);
+            appendBinaryString(s, n.data(), n.size());
+        }
+    }
+}
+
+template<typename T>
+void result_formatter<T>::sortFree(const typename atom::id_list &ids)
+{
+    names.assign(ids.begin(), ids.end());
+    std::sort(names.begin(), names.end(), [](var_id v1, var_id v2) {
+        return symbol_table::name(v1) < symbol_table::name(v2);
+    });
+}
+
+template<typename T>
+void result_formatter<T>::expression(std::string &s, const atom &a)
+{
+    begin(s, record_kind::expression);
+    if (format == output_format::text) {
+        s += "Result: ";
+        a.appendTo(s);
+    }
+    else terms(s, a);
+    end(s);
+}
+
+template<typename T>
+void result_formatter<T>::equation(std::string &s, const atom &a)
+{
+    auto &x = a.x;
+
+    // free variables: their coefficients cancelled to zero
+    sortFree(a.z);
+
+    if (x.size() == 0)      outcome(s, a.d == 0 ? record_kind::identity : record_kind::contradiction, nullptr, 0, a.d);
+    else if (x.size() == 1) outcome(s, record_kind::solution, nullptr, x.begin()->first, T(-a.d / x.begin()->second));
+    else                    outcome(s, record_kind::equation, &a, 0, a.d);
+}
+
+template<typename T>
+void result_formatter<T>::solution(std::string &s, var_id x, const T &value)
+{
+    names.clear();
+    outcome(s, record_kind::solution, nullptr, x, value);
+}
+
+template<typename T>
+void result_formatter<T>::cancelled(std::string &s, var_id x, bool holds)
+{
+    names.assign(1, x);
+    outcome(s, holds ? record_kind::identity : record_kind::contradiction, nullptr, x, T(0));
+}
+
+// an equation record: identity, contradiction, solution (x = value) or equation (a = 0),
+// with the free variables in 'names'
+template<typename T>
+void result_formatter<T>::outcome(std::string &s, record_kind k, const atom *a, var_id x, const T &value)
+{
+    begin(s, k);
+
+    if (format == output_format::text) {
+        s += "Result: ";
+        switch (k) {
+        case record_kind::identity:      s += "True."; break;
+        case record_kind::contradiction: s += "Not true."; break;
+        case record_kind::solution:
+            s += symbol_table::name(x);
+            s += " = ";
+            appendNumber(s, value);
+            break;
+        default:
+            a->appendTo(s);
+            s += " = 0";
+            break;
+        }
+        for (size_t i = 0; i < names.size(); i++) {
+            s += i == 0 ? "    This holds for any " : ",";
+            s += symbol_table::name(names[i]);
+        }
+        if (!names.empty()) s += '.';
+        end(s);
+        return;
+    }
+
+    switch (k) {
+    case record_kind::identity:
+        freeVars(s, names);
+        break;
+    case record_kind::contradiction:
+        break;
+    case record_kind::solution:
+        name(s, "var", x);
+        number(s, "value", value);
+        freeVars(s, names);
+        break;
+    default:
+        terms(s, *a);
+        freeVars(s, names);
+        break;
+    }
+    end(s);
+}
+
+template<typename T>
+void result_formatter<T>::system(std::string &s, solution_type &solution)
+{
+    if (solution.kind == sparse_system<T>::status::inconsistent) {
+        begin(s, record_kind::contradiction);
+        if (format == output_format::text) s += "Result: Not true.";
+        end(s);
+        return;
+    }
+
+    auto &values = solution.values;
+    auto &free = solution.free_vars;
+    std::sort(values.begin(), values.end(), [](const auto &v1, const auto &v2) {
+        return symbol_table::name(v1.first) < symbol_table::name(v2.first);
+    });
+    std::sort(free.begin(), free.end(), [](var_id v1, var_id v2) {
+        return symbol_table::name(v1) < symbol_table::name(v2);
+    });
+
+    begin(s, record_kind::system);
+    switch (format) {
+    case output_format::text:
+        if (values.empty()) s += "Result: True.";
+        for (size_t i = 0; i < values.size(); i++) {
+            if (i > 0) s += '\n';
+            s += "Result: ";
+            s += symbol_table::name(values[i].first);
+            s += " = ";
+            values[i].second.appendTo(s);
+        }
+        for (size_t i = 0; i < free.size(); i++) {
+            s += i == 0 ? "    This holds for any " : ",";
+            s += symbol_table::name(free[i]);
+        }
+        if (!free.empty()) s += '.';
+        break;
+    case output_format::json:
+        s += ",\"values\":[";
+        for (size_t i = 0; i < values.size(); i++) {
+            s += i > 0 ? ",{\"var\":" : "{\"var\":";
+            auto &n = symbol_table::name(values[i].first);
+            appendJsonString(s, n.data(), n.size());
+            terms(s, values[i].second);
+            s += '}';
+        }
+        s += ']';
+        freeVars(s, free);
+        break;
+    case output_format::binary:
+        appendUint32(s, uint32_t(values.size()));
+        for (auto &v : values) {
+            name(s, "var", v.first);
+            terms(s, v.second);
+        }
+        freeVars(s, free);
+        break;
+    }
+    end(s);
+}
+
+template<typename T>
+void result_formatter<T>::definition(std::string &s, var_id id, const atom &value, bool update)
+{
+    begin(s, update ? record_kind::update : record_kind::definition);
+    if (format == output_format::text) {
+        s += update ? "Updated: " : "Result: ";
+        s += symbol_table::name(id);
+        s += " = ";
+        value.appendTo(s);
+    }
+    else {
+        name(s, "var", id);
+        terms(s, value);
+    }
+    end(s);
+}
+
+template<typename T>
+void result_formatter<T>::error(std::string &s, const char *line, size_t n, size_t pos, const std::string &msg)
+{
+    if (format == output_format::text) {
+        appendError(s, line, n, pos, msg);
+        return;
+    }
+
+    begin(s, record_kind::error);
+    if (format == output_format::json) {
+        field(s, "pos");
+        s += std::to_string(pos);
+        field(s, "message");
+        appendJsonString(s, msg.data(), msg.size());
+        field(s, "input");
+        appendJsonString(s, line, n);
+    }
+    else {
+        appendUint32(s, uint32_t(pos));
+        appendBinaryString(s, msg.data(), msg.size());
+        appendBinaryString(s, line, n);
+    }
+    end(s);
+}
+
+#endif
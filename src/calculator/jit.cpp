@@ -0,0 +1,490 @@
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_X86_64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "jit.h"
+#include "cache.h"
+
+#ifdef JIT_X86_64
+
+namespace {
+
+// general purpose registers
+enum gpr { rax = 0, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8, r9, r10, r11, r12, r13, r14, r15 };
+
+const int max_slots = 16;               // stack slots held in xmm0-xmm15 / ymm0-ymm15
+const int max_temps = 1024;             // values of store ops, in the frame after the spill area
+
+// memory operand: [base + index*8 + disp], or a constant of the pool addressed relative to rip
+struct mem {
+    int     base = rax;
+    int     index = -1;
+    int32_t disp = 0;
+    int     pool = -1;                  // byte offset in the constant pool
+
+    static mem at(int base, int32_t disp = 0) { mem m; m.base = base; m.disp = disp; return m; }
+    static mem row(int base, int index) { mem m; m.base = base; m.index = index; return m; }
+    static mem constant(int offset) { mem m; m.pool = offset; return m; }
+};
+
+/*
+   encoder of the few instructions the code generator needs
+   legacy SSE2 for the scalar code, 3-byte VEX for the packed AVX code; rip-relative operands
+   are patched when the constant pool is placed after the code
+*/
+class assembler {
+public:
+    std::vector<uint8_t> code;
+
+    void byte(int b) { code.push_back(uint8_t(b)); };
+    void dword(uint32_t v) { for (int i = 0; i < 4; i++) byte(v >> (8 * i)); };
+    void qword(uint64_t v) { for (int i = 0; i < 8; i++) byte(int(v >> (8 * i))); };
+
+    // scalar double: prefix (66/F2) 0F op, xmm register and memory
+    void sse(int prefix, int op, int reg, const mem &m) {
+        byte(prefix);
+        rex(0, reg, m.pool < 0 && m.index >= 0 ? m.index : 0, m.pool < 0 ? m.base : 0);
+        byte(0x0f);
+        byte(op);
+        modrm(reg, m);
+    };
+
+    // scalar double: register to register
+    void sse(int prefix, int op, int reg, int rm) {
+        byte(prefix);
+        rex(0, reg, 0, rm);
+        byte(0x0f);
+        byte(op);
+        byte(0xc0 | (reg & 7) << 3 | (rm & 7));
+    };
+
+    // packed double on ymm registers: VEX.256.66.0F op; vvvv is the first source (0 when unused:
+    // the field is stored inverted, 1111b)
+    void avx(int op, int reg, int vvvv, const mem &m) {
+        vex(reg, m.pool < 0 && m.index >= 0 ? m.index : 0, m.pool < 0 ? m.base : 0, vvvv);
+        byte(op);
+        modrm(reg, m);
+    };
+
+    void avx(int op, int reg, int vvvv, int rm) {
+        vex(reg, 0, rm, vvvv);
+        byte(op);
+        byte(0xc0 | (reg & 7) << 3 | (rm & 7));
+    };
+
+    void push(int r) { if (r >= 8) byte(0x41); byte(0x50 | (r & 7)); };
+    void pop(int r)  { if (r >= 8) byte(0x41); byte(0x58 | (r & 7)); };
+
+    // mov dst, src (64 bit registers)
+    void mov(int dst, int src) {
+        rex(1, src, 0, dst);
+        byte(0x89);
+        byte(0xc0 | (src & 7) << 3 | (dst & 7));
+    };
+
+    // mov reg, qword [m]
+    void load(int reg, const mem &m) {
+        rex(1, reg, m.index >= 0 ? m.index : 0, m.base);
+        byte(0x8b);
+        modrm(reg, m);
+    };
+
+    // lea reg, [m]
+    void lea(int reg, const mem &m) {
+        rex(1, reg, m.index >= 0 ? m.index : 0, m.base);
+        byte(0x8d);
+        modrm(reg, m);
+    };
+
+    // cmp a, b (64 bit registers)
+    void cmp(int a, int b) {
+        rex(1, b, 0, a);
+        byte(0x39);
+        byte(0xc0 | (b & 7) << 3 | (a & 7));
+    };
+
+    // xor r, r
+    void zero(int r) {
+        rex(1, r, 0, r);
+        byte(0x31);
+        byte(0xc0 | (r & 7) << 3 | (r & 7));
+    };
+
+    // add r, imm32 (negative: sub)
+    void add(int r, int32_t imm) {
+        rex(1, 0, 0, r);
+        byte(0x81);
+        byte(0xc0 | (imm < 0 ? 5 : 0) << 3 | (r & 7));
+        dword(uint32_t(imm < 0 ? -imm : imm));
+    };
+
+    void call(const void *f) {
+        byte(0x48);                     // mov rax, imm64
+        byte(0xb8);
+        qword(uint64_t(reinterpret_cast<uintptr_t>(f)));
+        byte(0xff);                     // call rax
+        byte(0xd0);
+    };
+
+    void vzeroupper() { byte(0xc5); byte(0xf8); byte(0x77); };
+    void ret() { byte(0xc3); };
+
+    // jumps with a 32-bit displacement: the position of the displacement, to be bound later
+    size_t jump(int cc) {
+        if (cc < 0) byte(0xe9);
+        else { byte(0x0f); byte(0x80 | cc); }
+        dword(0);
+        return code.size() - 4;
+    };
+
+    void bind(size_t disp, size_t target) {
+        int32_t rel = int32_t(target) - int32_t(disp + 4);
+        memcpy(&code[disp], &rel, 4);
+    };
+
+    // append the constant pool (32-byte aligned) and resolve the rip-relative operands
+    void place(const std::vector<uint8_t> &pool) {
+        while (code.size() % 32) byte(0xcc);
+        size_t base = code.size();
+        code.insert(code.end(), pool.begin(), pool.end());
+        for (auto &f : fixups) bind(f.first, base + f.second);
+    };
+
+private:
+    std::vector<std::pair<size_t, size_t>> fixups;  // displacement position, pool offset
+
+    void rex(int w, int reg, int index, int base) {
+        int r = 0x40 | w << 3 | (reg >> 3) << 2 | (index >> 3) << 1 | (base >> 3);
+        if (r != 0x40) byte(r);
+    };
+
+    void vex(int reg, int index, int base, int vvvv) {
+        byte(0xc4);
+        byte((~reg >> 3 & 1) << 7 | (~index >> 3 & 1) << 6 | (~base >> 3 & 1) << 5 | 0x01);   // map 0F
+        byte((~vvvv & 15) << 3 | 1 << 2 | 0x01);    // W0, L = 256, pp = 66
+    };
+
+    void modrm(int reg, const mem &m) {
+        if (m.pool >= 0) {
+            byte(0x05 | (reg & 7) << 3);
+            fixups.push_back({ code.size(), size_t(m.pool) });
+            dword(0);
+            return;
+        }
+        int mod = m.disp == 0 && (m.base & 7) != rbp ? 0 : m.disp >= -128 && m.disp < 128 ? 1 : 2;
+        if (m.index >= 0 || (m.base & 7) == rsp) {
+            byte(mod << 6 | (reg & 7) << 3 | 4);
+            byte((m.index >= 0 ? 3 << 6 | (m.index & 7) << 3 : 4 << 3) | (m.base & 7));   // scale 8
+        }
+        else {
+            byte(mod << 6 | (reg & 7) << 3 | (m.base & 7));
+        }
+        if (mod == 1) byte(m.disp);
+        if (mod == 2) dword(uint32_t(m.disp));
+    };
+};
+
+// opcodes (0F map)
+const int op_load = 0x10, op_store = 0x11, op_movapd = 0x28, op_xor = 0x57;
+const int op_add = 0x58, op_mul = 0x59, op_sub = 0x5c, op_div = 0x5e;
+const int cc_ae = 0x3, cc_a = 0x7;
+
+double callLog(double a) { return std::log(a); }
+double callPow(double a, double b) { return std::pow(a, b); }
+
+/*
+   code generator: the kernel (columns, rows, out) keeps columns in rbx, rows in r12, out in r13
+   and the row index in r14; stack slot i of the program is xmm(i) or ymm(i)
+*/
+class generator {
+public:
+    generator(const program<double> &ip, size_t ifirst, size_t ilast) : p(ip), first(ifirst), last(ilast) {
+        // spill area and temporaries; keeps rsp 16-byte aligned at calls
+        frame = 32 * (max_slots + int32_t(p.temps)) + 8;
+
+        // every constant 4 times, for the packed code; then the sign mask of the negation
+        for (double c : p.consts) for (int i = 0; i < 4; i++) append(c);
+        sign = int(pool.size());
+        for (int i = 0; i < 4; i++) append(-0.0);
+    };
+
+    std::vector<uint8_t> generate(bool packed) {
+        a.push(rbx);
+        a.push(r12);
+        a.push(r13);
+        a.push(r14);
+        a.add(rsp, -frame);
+        a.mov(rbx, rdi);
+        a.mov(r12, rsi);
+        a.mov(r13, rdx);
+        a.zero(r14);
+
+        if (packed) {
+            // while (row + 4 <= rows)
+            size_t loop = a.code.size();
+            a.lea(rax, mem::at(r14, 4));
+            a.cmp(rax, r12);
+            size_t tail = a.jump(cc_a);
+            body(true);
+            a.add(r14, 4);
+            a.bind(a.jump(-1), loop);
+            a.bind(tail, a.code.size());
+            a.vzeroupper();             // no AVX to SSE transition penalty in the scalar loop
+        }
+
+        // while (row < rows)
+        size_t loop = a.code.size();
+        a.cmp(r14, r12);
+        size_t done = a.jump(cc_ae);
+        body(false);
+        a.add(r14, 1);
+        a.bind(a.jump(-1), loop);
+        a.bind(done, a.code.size());
+
+        a.add(rsp, frame);
+        a.pop(r14);
+        a.pop(r13);
+        a.pop(r12);
+        a.pop(rbx);
+        a.ret();
+
+        a.place(pool);
+        return std::move(a.code);
+    };
+
+private:
+    const program<double> &p;
+    size_t first, last;
+    int32_t frame;
+    assembler a;
+    std::vector<uint8_t> pool;
+    int sign;
+
+    void append(double v) {
+        uint8_t b[8];
+        memcpy(b, &v, 8);
+        pool.insert(pool.end(), b, b + 8);
+    };
+
+    // one row (or four) of the result
+    void body(bool packed) {
+        int sp = 0;
+        for (size_t pc = first; pc < last; pc++) {
+            const op &o = p.code[pc];
+            switch (o.code) {
+            case op_t::push_const:
+                load(packed, sp++, mem::constant(int(o.arg) * 32));
+                break;
+            case op_t::push_var:
+                a.load(rax, mem::at(rbx, int32_t(o.arg) * 8));
+                load(packed, sp++, mem::row(rax, r14));
+                break;
+            case op_t::add: sp--; arith(packed, op_add, sp - 1, sp); break;
+            case op_t::sub: sp--; arith(packed, op_sub, sp - 1, sp); break;
+            case op_t::mul: sp--; arith(packed, op_mul, sp - 1, sp); break;
+            case op_t::div: sp--; arith(packed, op_div, sp - 1, sp); break;
+            case op_t::neg:
+                if (packed) a.avx(op_xor, sp - 1, sp - 1, mem::constant(sign));
+                else        a.sse(0x66, op_xor, sp - 1, mem::constant(sign));
+                break;
+            case op_t::log: call(packed, reinterpret_cast<const void*>(&callLog), sp - 1, false); break;
+            case op_t::pow: sp--; call(packed, reinterpret_cast<const void*>(&callPow), sp - 1, true); break;
+            case op_t::result: sp--; break;     // of an earlier result
+            case op_t::store:
+                if (packed) a.avx(op_store, sp - 1, 0, temp(o.arg));
+                else        a.sse(0xf2, op_store, sp - 1, temp(o.arg));
+                break;
+            case op_t::load: load(packed, sp++, temp(o.arg)); break;
+            }
+        }
+
+        if (packed) a.avx(op_store, 0, 0, mem::row(r13, r14));
+        else        a.sse(0xf2, op_store, 0, mem::row(r13, r14));
+    };
+
+    static mem temp(unsigned i) { return mem::at(rsp, 32 * (max_slots + int32_t(i))); };
+
+    void load(bool packed, int slot, const mem &m) {
+        if (packed) a.avx(op_load, slot, 0, m);
+        else        a.sse(0xf2, op_load, slot, m);
+    };
+
+    void arith(bool packed, int op, int dst, int src) {
+        if (packed) a.avx(op, dst, dst, src);
+        else        a.sse(0xf2, op, dst, src);
+    };
+
+    // f(slot x [, slot x+1]) into slot x; the slots below are saved around the call
+    void call(bool packed, const void *f, int x, bool binary) {
+        if (!packed) {
+            for (int i = 0; i < x; i++) a.sse(0xf2, op_store, i, mem::at(rsp, 8 * i));
+            if (x != 0) {
+                a.sse(0x66, op_movapd, 0, x);
+                if (binary) a.sse(0x66, op_movapd, 1, x + 1);
+            }
+            a.call(f);
+            if (x != 0) a.sse(0x66, op_movapd, x, 0);
+            for (int i = 0; i < x; i++) a.sse(0xf2, op_load, i, mem::at(rsp, 8 * i));
+            return;
+        }
+
+        // the four lanes one by one through the spill area
+        int live = x + (binary ? 2 : 1);
+        for (int i = 0; i < live; i++) a.avx(op_store, i, 0, mem::at(rsp, 32 * i));
+        a.vzeroupper();
+        for (int lane = 0; lane < 4; lane++) {
+            a.sse(0xf2, op_load, 0, mem::at(rsp, 32 * x + 8 * lane));
+            if (binary) a.sse(0xf2, op_load, 1, mem::at(rsp, 32 * (x + 1) + 8 * lane));
+            a.call(f);
+            a.sse(0xf2, op_store, 0, mem::at(rsp, 32 * x + 8 * lane));
+        }
+        for (int i = 0; i <= x; i++) a.avx(op_load, i, 0, mem::at(rsp, 32 * i));
+    };
+};
+
+}
+
+#endif
+
+//-------------------------------------------------------
+
+jit_function::jit_function(const program<double> &ip, size_t iresult, simd_isa isa) : p(ip), result(iresult)
+{
+    size_t first, last;
+    if (!p.range(result, first, last)) throw column_error("the program has no result " + std::to_string(result));
+
+#ifdef JIT_X86_64
+    if (p.depth > size_t(max_slots) || p.temps > size_t(max_temps)) return;
+
+    vectorized = isa == simd_isa::avx2 && detectIsa() == simd_isa::avx2;
+    auto code = generator(p, first, last).generate(vectorized);
+
+    size_t page = size_t(sysconf(_SC_PAGESIZE));
+    size_t n = (code.size() + page - 1) / page * page;
+    void *m = mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) {
+        vectorized = false;
+        return;
+    }
+    memcpy(m, code.data(), code.size());
+    if (mprotect(m, n, PROT_READ | PROT_EXEC) != 0) {
+        munmap(m, n);
+        vectorized = false;
+        return;
+    }
+
+    mapping = m;
+    mapped = n;
+    size = code.size();
+    entry = reinterpret_cast<kernel>(m);
+#else
+    (void)first;
+    (void)last;
+    (void)isa;
+#endif
+}
+
+jit_function::~jit_function()
+{
+#ifdef JIT_X86_64
+    if (mapping) munmap(mapping, mapped);
+#endif
+}
+
+void jit_function::run(const double * const *columns, size_t rows, double *out) const
+{
+    if (entry) {
+        entry(columns, rows, out);
+        return;
+    }
+
+    // the scalar kernels give the results of evaluator<double>, as the native code does
+    column_evaluator ev(p, result, simd_isa::scalar);
+    ev.run(columns, rows, out);
+}
+
+std::vector<const double*> jit_function::bind(const column_table &t) const
+{
+    std::vector<const double*> r;
+    for (auto &v : p.vars) r.push_back(t.column(v).data());
+    return r;
+}
+
+//-------------------------------------------------------
+
+template<typename F>
+std::shared_ptr<const jit_function> jit_cache::find(const std::string &key, F compile)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto i = functions.find(key);
+        if (i != functions.end()) {
+            hits++;
+            return i->second;
+        }
+        misses++;
+    }
+
+    // compiled outside of the lock; a concurrent miss of the same key compiles it twice
+    std::shared_ptr<const jit_function> f = compile();
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (functions.emplace(key, f).second) {
+        order.push_back(key);
+        if (order.size() > capacity) {
+            functions.erase(order.front());
+            order.pop_front();
+        }
+    }
+    return f;
+}
+
+std::shared_ptr<const jit_function> jit_cache::get(const std::string &expr, size_t result)
+{
+    auto tokens = tokenize_view(expr);
+    std::string key;
+    result_cache<double>::normalize(tokens, key);
+    key.insert(0, "e");         // apart from the keys of programs
+    key += std::to_string(result);
+
+    return find(key, [&] {
+        auto p = program<double>::compile(tokens);
+        p.optimize();
+        return std::make_shared<const jit_function>(p, result);
+    });
+}
+
+std::shared_ptr<const jit_function> jit_cache::get(const program<double> &p, size_t result, simd_isa isa)
+{
+    // everything the generated code depends on
+    std::string key = "p" + std::to_string(result) + "/" + std::to_string(int(isa)) + "/";
+    for (auto &o : p.code) {
+        key += char(o.code);
+        key.append(reinterpret_cast<const char*>(&o.arg), sizeof(o.arg));
+    }
+    key.append(reinterpret_cast<const char*>(p.consts.data()), p.consts.size() * sizeof(double));
+    for (auto &v : p.vars) {
+        key += '\0';
+        key += v;
+    }
+
+    return find(key, [&] { return std::make_shared<const jit_function>(p, result, isa); });
+}
+
+jit_cache& jit_cache::shared()
+{
+    static jit_cache c;
+    return c;
+}
+
+jit_cache::statistics jit_cache::stats() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return { hits, misses, functions.size() };
+}
@@ -0,0 +1,96 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <unordered_map>
+
+#include "program.h"
+#include "columnar.h"
+#include "cpu.h"
+
+/*
+   native code for compiled double programs (x86-64 Linux)
+   one result of a program<double> is translated into a function evaluating it for a range of
+   rows, the variables bound to columns as in the columnar mode. The value stack of the program
+   lives in the xmm/ymm registers, the temporaries of an optimized program in the stack frame. With AVX, four rows are computed per iteration with packed
+   instructions; the remaining rows (and all of them without AVX) with scalar SSE2 code. log and
+   pow call the library functions lane by lane, so the results are those of evaluator<double>
+   bit for bit.
+   The code is written to an anonymous mapping that is made executable, and no longer writable,
+   with mprotect once it is complete. On other platforms, and for programs whose stack does not
+   fit the 16 registers, the same interface runs the scalar kernels of the columnar mode.
+*/
+
+class jit_function {
+public:
+    // compiles the 'result'-th comma separated expression of the program; 'isa' below avx2 leaves
+    // out the packed loop
+    jit_function(const program<double> &p, size_t result = 0, simd_isa isa = detectIsa());
+    ~jit_function();
+
+    jit_function(const jit_function&) = delete;
+    jit_function& operator = (const jit_function&) = delete;
+
+    // columns[i] holds the values of variable slot i of the program; 'out' receives 'rows' values
+    void run(const double * const *columns, size_t rows, double *out) const;
+
+    // bind the program variables to the columns of the same name
+    std::vector<const double*> bind(const column_table &t) const;
+
+    bool native() const { return entry != nullptr; };
+    bool packed() const { return vectorized; };
+    size_t code_size() const { return size; };
+
+private:
+    using kernel = void (*)(const double * const *columns, size_t rows, double *out);
+
+    program<double> p;                  // own copy, for the fallback
+    size_t   result;
+    kernel   entry = nullptr;
+    void    *mapping = nullptr;
+    size_t   mapped = 0;                // bytes of the mapping
+    size_t   size = 0;                  // bytes of code and constants
+    bool     vectorized = false;
+};
+
+/*
+   compiled functions by expression, shared by threads
+   the key is the normalized token stream of the expression (see cache.h) and the result index,
+   or for a compiled program its ops, constants and variables, the result index and the
+   instruction set; the oldest entry is dropped when the capacity is reached
+*/
+class jit_cache {
+public:
+    struct statistics {
+        size_t hits, misses, entries;
+    };
+
+    explicit jit_cache(size_t icapacity = 256) : capacity(icapacity) {};
+
+    // the function of the 'result'-th expression of 'expr', compiled on first use;
+    // throws program<double>::error if the expression does not compile
+    std::shared_ptr<const jit_function> get(const std::string &expr, size_t result = 0);
+    // the function of the 'result'-th expression of a compiled program
+    std::shared_ptr<const jit_function> get(const program<double> &p, size_t result = 0, simd_isa isa = detectIsa());
+
+    // the cache of the process, used by the columnar modes of the calculator
+    static jit_cache& shared();
+
+    statistics stats() const;
+
+private:
+    const size_t capacity;
+    mutable std::mutex lock;
+    std::unordered_map<std::string, std::shared_ptr<const jit_function>> functions;
+    std::deque<std::string> order;      // keys, oldest first
+    size_t hits = 0, misses = 0;
+
+    template<typename F>
+    std::shared_ptr<const jit_function> find(const std::string &key, F compile);
+};
+
+#endif
@@ -1,81 +1,296 @@
+
 #include <vector>
 #include <string>
-#include <cctype>
 #include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEXER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LEXER_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
 
 #include "lexer.h"
+#include "cpu.h"
 
 using std::vector;
 using std::string;
 
-// helper function
-static inline void skipDigits_(const string &s, size_t &i)
+namespace {
+
+/*
+   character classes of the "C" locale, which the calculator never changes: isspace, isdigit and
+   isalpha without the locale lookup and the call; bytes above 127 are in no class
+*/
+enum : unsigned char { S = 1, D = 2, A = 4 };
+
+const unsigned char char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+const unsigned char space = S, digit = D, alpha = A, alnum = D | A;
+
+inline bool is(unsigned char cls, char c) { return (char_class[(unsigned char)c] & cls) != 0; }
+
+inline unsigned lowestBit(unsigned m)
 {
-  for (; i < s.size() && isdigit(s[i]); i++) {}
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return unsigned(i);
+#else
+    return unsigned(__builtin_ctz(m));
+#endif
 }
 
+/*
+   the end of a run of characters of a class from 'i' on, for runs longer than the ones of
+   ordinary expressions: a huge literal, a long identifier or a block of whitespace
+*/
+typedef size_t (*run_scanner)(const char *s, size_t n, size_t i, unsigned char cls);
 
-vector<token> tokenize(const string &s)
+size_t runScalar(const char *s, size_t n, size_t i, unsigned char cls)
 {
-    vector<token> result;
-    
-    for (size_t i = 0; i < s.size();) {
+    for (; i < n && is(cls, s[i]); i++) {}
+    return i;
+}
+
+#ifdef LEXER_SSE2
+
+// lo <= c <= hi; signed compares, so the bytes above 127 are in no range
+inline __m128i inRangeSse2(__m128i c, char lo, char hi)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(char(lo - 1))), _mm_cmpgt_epi8(_mm_set1_epi8(char(hi + 1)), c));
+}
+
+// 0xff in the bytes of 'c' that are of the class
+inline __m128i classMaskSse2(__m128i c, unsigned char cls)
+{
+    if (cls == space) return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), inRangeSse2(c, '\t', '\r'));
+    __m128i m = inRangeSse2(c, '0', '9');
+    if (cls == alnum) m = _mm_or_si128(m, inRangeSse2(_mm_or_si128(c, _mm_set1_epi8(0x20)), 'a', 'z'));
+    return m;
+}
+
+// 16 bytes per step
+size_t runSse2(const char *s, size_t n, size_t i, unsigned char cls)
+{
+    for (; i + 16 <= n; i += 16) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        unsigned out = ~unsigned(_mm_movemask_epi8(classMaskSse2(c, cls))) & 0xffff;
+        if (out) return i + lowestBit(out);
+    }
+    return runScalar(s, n, i, cls);
+}
+
+#endif
+
+#ifdef LEXER_AVX2
+
+TARGET_AVX2 inline __m256i inRangeAvx2(__m256i c, char lo, char hi)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(char(lo - 1))), _mm256_cmpgt_epi8(_mm256_set1_epi8(char(hi + 1)), c));
+}
+
+TARGET_AVX2 inline __m256i classMaskAvx2(__m256i c, unsigned char cls)
+{
+    if (cls == space) return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), inRangeAvx2(c, '\t', '\r'));
+    __m256i m = inRangeAvx2(c, '0', '9');
+    if (cls == alnum) m = _mm256_or_si256(m, inRangeAvx2(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 'z'));
+    return m;
+}
+
+// 32 bytes per step, the rest by the SSE2 scanner
+TARGET_AVX2 size_t runAvx2(const char *s, size_t n, size_t i, unsigned char cls)
+{
+    for (; i + 32 <= n; i += 32) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        unsigned out = ~unsigned(_mm256_movemask_epi8(classMaskAvx2(c, cls)));
+        if (out) return i + lowestBit(out);
+    }
+    return runSse2(s, n, i, cls);
+}
+
+#endif
+
+run_scanner scannerFor(simd_isa isa)
+{
+    switch (isa) {
+#ifdef LEXER_AVX2
+    case simd_isa::avx2: return runAvx2;
+#endif
+#ifdef LEXER_SSE2
+    case simd_isa::sse2: return runSse2;
+#endif
+    default:             return runScalar;
+    }
+}
+
+// the first 16 characters of a run by the table, the rest by the scanner
+inline size_t skip(const char *s, size_t n, size_t i, unsigned char cls, run_scanner run)
+{
+    const size_t head = n - i < 16 ? n : i + 16;
+    for (; i < head; i++) {
+        if (!is(cls, s[i])) return i;
+    }
+    return i < n ? run(s, n, i, cls) : i;
+}
+
+void tokenize_(const char *s, size_t n, vector<token_view> &result, run_scanner run)
+{
+    result.clear();
+
+    for (size_t i = 0; i < n;) {
         char c = s[i];
-        if (isspace(c)) {
-            i++; 
+        if (is(space, c)) {
+            i = skip(s, n, i + 1, space, run);
             continue;
         }
 
-        if (isdigit(c) || c == '.') {
+        if (is(digit, c) || c == '.') {
             // number
             const size_t numstart = i;
 
-            // fractional 
-            skipDigits_(s, i);
-            if (s[i] == '.') { 
+            // fractional
+            i = skip(s, n, i, digit, run);
+            if (i < n && s[i] == '.') {
                 i++;
-                skipDigits_(s, i);
+                i = skip(s, n, i, digit, run);
 
                 if (i == numstart + 1) {
                     // this was just a dot
-                    result.push_back({ tok_t::punct,{ c }, numstart });
+                    result.push_back({ tok_t::punct, tok_kind::none, s + numstart, 1, numstart });
                     continue;
                 }
             }
 
             // exponent
             const size_t expstart = i;
-            if (i < s.size() && tolower(s[i]) == 'e') {
+            if (i < n && (s[i] == 'e' || s[i] == 'E')) {
                 i++;
-                if (i < s.size() && (s[i] == '+' || s[i] == '-')) { i++; }
-                if (i == s.size() || !isdigit(s[i])) {
+                if (i < n && (s[i] == '+' || s[i] == '-')) { i++; }
+                if (i == n || !is(digit, s[i])) {
                     i = expstart; // invalid exponent, recover to fractional only
                 }
                 else {
-                    skipDigits_(s, i);
+                    i = skip(s, n, i, digit, run);
                 }
             }
 
-            result.push_back({ tok_t::num, s.substr(numstart,i-numstart), numstart });
+            result.push_back({ tok_t::num, tok_kind::none, s + numstart, i - numstart, numstart });
         }
-        else if (isalpha(c)) {
+        else if (is(alpha, c)) {
             // identifier
-            const size_t idstart = i++;
-            for (; i < s.size() && isalnum(s[i]); i++) {};
-            result.push_back({ tok_t::id, s.substr(idstart,i-idstart), idstart});
+            const size_t idstart = i;
+            i = skip(s, n, i + 1, alnum, run);
+            result.push_back({ tok_t::id, classify(tok_t::id, s + idstart, i - idstart), s + idstart, i - idstart, idstart });
         }
         else {
             // 1-character punctuator
-            result.push_back({ tok_t::punct,{c}, i++ });
+            result.push_back({ tok_t::punct, classify(tok_t::punct, s + i, 1), s + i, 1, i });
+            i++;
         }
     }
 
-    result.push_back({ tok_t::end, "", s.size() });
+    result.push_back({ tok_t::end, tok_kind::none, s + n, 0, n });
+}
+
+}
+
+void tokenize(const char *s, size_t n, vector<token_view> &result)
+{
+    static const run_scanner run = scannerFor(detectIsa());
+    tokenize_(s, n, result, run);
+}
+
+void tokenize(const char *s, size_t n, vector<token_view> &result, simd_isa isa)
+{
+    tokenize_(s, n, result, scannerFor(isa));
+}
+
+vector<token_view> tokenize_view(const string &s)
+{
+    vector<token_view> result;
+    tokenize(s.data(), s.size(), result);
+    return result;
+}
+
+// compatibility wrapper - copies every token string
+vector<token> tokenize(const string &s)
+{
+    vector<token_view> views;
+    tokenize(s.data(), s.size(), views);
+
+    vector<token> result;
+    result.reserve(views.size());
+    for (auto &v : views) result.push_back(make_token(v));
     return result;
 }
 
 //-------------------------------------------------------------------
 
+tok_kind classify(tok_t type, const char *s, size_t len)
+{
+    if (type == tok_t::id) {
+        if (len == 3 && memcmp(s, "log", 3) == 0) return tok_kind::kw_log;
+        return tok_kind::none;
+    }
+
+    if (type != tok_t::punct || len != 1) return tok_kind::none;
+
+    switch (s[0]) {
+    case '+': return tok_kind::plus;
+    case '-': return tok_kind::minus;
+    case '*': return tok_kind::star;
+    case '/': return tok_kind::slash;
+    case '^': return tok_kind::caret;
+    case '(': return tok_kind::lparen;
+    case ')': return tok_kind::rparen;
+    case ',': return tok_kind::comma;
+    case '=': return tok_kind::equal;
+    default:  return tok_kind::none;
+    }
+}
+
+token_view make_view(const token &t)
+{
+    return { t.type, classify(t.type, t.s.data(), t.s.size()), t.s.data(), t.s.size(), t.pos };
+}
+
+token make_token(const token_view &v)
+{
+    return { v.type, v.str(), v.pos };
+}
+
 bool operator == (const token & t1, const token & t2)
 {
     return (t1.type == t2.type) && (t1.s == t2.s) && (t1.pos == t2.pos);
@@ -4,11 +4,21 @@
 #include <string>
 #include <vector>
 
+#include "cpu.h"
+
 // token types
 enum class tok_t {
     end, num, id, punct
 };
 
+// operator/keyword kinds - lets the parser dispatch without string compares
+enum class tok_kind {
+    none,       // numbers, variables, end of input and unknown punctuators
+    plus, minus, star, slash, caret,
+    lparen, rparen, comma, equal,
+    kw_log
+};
+
 
 struct token {
       tok_t type;
@@ -16,8 +26,32 @@ struct token {
       size_t pos;    // position in the original string
 };
 
+// zero-copy token - 's' points into the input buffer, which must outlive it
+struct token_view {
+      tok_t    type;
+      tok_kind kind;
+      const char *s; // start of the token in the input buffer
+      size_t len;    // token length
+      size_t pos;    // position in the original string
+
+      std::string str() const { return std::string(s, len); }
+};
+
 std::vector<token> tokenize(const std::string &);
 
+// zero-copy lexer; the output vector is cleared and reused
+// Runs of digits, whitespace and identifier characters longer than 16 bytes are scanned 16 or
+// 32 bytes at a time with SSE2/AVX2, as the CPU supports; the overload with 'isa' uses the
+// scanner of the given instruction set, with the same tokens.
+void tokenize(const char *s, size_t n, std::vector<token_view> &out);
+void tokenize(const char *s, size_t n, std::vector<token_view> &out, simd_isa isa);
+std::vector<token_view> tokenize_view(const std::string &);
+std::vector<token_view> tokenize_view(std::string &&) = delete; // views would dangle
+
+tok_kind classify(tok_t type, const char *s, size_t len);
+token_view make_view(const token &);
+token make_token(const token_view &);
+
 bool operator == (const token & t1, const token & t2);
 
 #endif
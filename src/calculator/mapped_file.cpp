@@ -0,0 +1,76 @@
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const std::string &path)
+{
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        throw error("unable to open " + path);
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    n = size_t(size.QuadPart);
+    if (n == 0) return;     // empty files can't be mapped
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) p = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!p) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        throw error("unable to map " + path);
+    }
+}
+
+mapped_file::~mapped_file()
+{
+    if (p) UnmapViewOfFile(p);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+}
+
+#else
+
+mapped_file::mapped_file(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw error("unable to open " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw error("unable to read " + path);
+    }
+    n = size_t(st.st_size);
+    if (n == 0) {
+        close(fd);
+        return;             // empty files can't be mapped
+    }
+
+    void *m = mmap(nullptr, n, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) throw error("unable to map " + path);
+
+    madvise(m, n, MADV_SEQUENTIAL);
+    p = static_cast<const char*>(m);
+}
+
+mapped_file::~mapped_file()
+{
+    if (p) munmap(const_cast<char*>(p), n);
+}
+
+#endif
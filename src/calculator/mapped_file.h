@@ -0,0 +1,41 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <exception>
+
+/*
+   read-only memory mapping of a whole file
+*/
+
+class mapped_file {
+public:
+    struct error : public std::exception {
+        const std::string msg;
+        error(const std::string & im) :msg(im) {};
+
+        virtual const char* what() const throw()
+        {
+            return msg.c_str();
+        }
+    };
+
+    explicit mapped_file(const std::string &path);
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator = (const mapped_file&) = delete;
+
+    const char* data() const { return p; };
+    size_t      size() const { return n; };
+
+private:
+    const char *p = nullptr;
+    size_t      n = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
+
+#endif
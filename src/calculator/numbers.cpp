@@ -0,0 +1,252 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <clocale>
+#include <string>
+#include <algorithm>
+
+#include <locale.h>
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
+
+#include "numbers.h"
+
+namespace {
+
+const double pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const uint64_t max_exact = uint64_t(1) << 53;   // integers up to this are exact doubles
+
+// strtod independent of the current locale
+double strtodC(const char *s)
+{
+#ifdef _WIN32
+    static _locale_t c = _create_locale(LC_NUMERIC, "C");
+    return _strtod_l(s, nullptr, c);
+#else
+    static locale_t c = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+    return strtod_l(s, nullptr, c);
+#endif
+}
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// decimal digits and exponent of |value| rounded to 'precision' significant digits
+int decimalDigits(double value, int precision, char *digits)
+{
+    // "d.ddde+x" from printf; the decimal point may be locale dependent, so only the digits
+    // and the exponent are taken from it
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*e", precision - 1, std::fabs(value));
+
+    int n = 0;
+    const char *p = buf;
+    for (; *p && *p != 'e'; p++) {
+        if (isDigit(*p)) digits[n++] = *p;
+    }
+    return atoi(p + 1);
+}
+
+char* writeNonFinite(char *p, double value)
+{
+    if (std::signbit(value)) *p++ = '-';
+    const char *s = std::isnan(value) ? "nan" : "inf";
+    memcpy(p, s, 3);
+    return p + 3;
+}
+
+char* writeExponent(char *p, int exponent)
+{
+    *p++ = 'e';
+    *p++ = exponent < 0 ? '-' : '+';
+    unsigned e = exponent < 0 ? -exponent : exponent;
+    char tmp[8];
+    int n = 0;
+    do { tmp[n++] = char('0' + e % 10); e /= 10; } while (e);
+    if (n < 2) tmp[n++] = '0';
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+// d.ddde+xx
+char* writeScientific(char *p, const char *digits, int n, int exponent)
+{
+    *p++ = digits[0];
+    if (n > 1) {
+        *p++ = '.';
+        memcpy(p, digits + 1, n - 1);
+        p += n - 1;
+    }
+    return writeExponent(p, exponent);
+}
+
+// digits with the decimal point placed by the exponent
+char* writeFixed(char *p, const char *digits, int n, int exponent)
+{
+    if (exponent < 0) {
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = 0; i < -exponent - 1; i++) *p++ = '0';
+        memcpy(p, digits, n);
+        return p + n;
+    }
+    for (int i = 0; i <= exponent || i < n; i++) {
+        if (i == exponent + 1) *p++ = '.';
+        *p++ = i < n ? digits[i] : '0';
+    }
+    return p;
+}
+
+// number of significant digits without the trailing zeros
+int stripZeros(const char *digits, int n)
+{
+    while (n > 1 && digits[n - 1] == '0') n--;
+    return n;
+}
+
+}
+
+bool parseNumber(const char *first, const char *last, double &value)
+{
+    const char *p = first;
+    uint64_t m = 0;         // up to 19 significant digits
+    int  digits = 0;
+    int  e10 = 0;           // decimal exponent of m
+    bool truncated = false; // non-zero digits beyond the 19 kept ones
+    bool any = false;
+
+    for (; p < last && isDigit(*p); p++) {
+        any = true;
+        int d = *p - '0';
+        if (digits < 19) {
+            if (m != 0 || d != 0) { m = m * 10 + d; digits++; }
+        }
+        else {
+            e10++;
+            truncated |= d != 0;
+        }
+    }
+    if (p < last && *p == '.') {
+        for (p++; p < last && isDigit(*p); p++) {
+            any = true;
+            int d = *p - '0';
+            if (digits < 19) {
+                if (m != 0 || d != 0) { m = m * 10 + d; digits++; }
+                e10--;
+            }
+            else truncated |= d != 0;
+        }
+    }
+    if (!any) return false;
+
+    if (p < last && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative = false;
+        if (p < last && (*p == '+' || *p == '-')) negative = *p++ == '-';
+        if (p == last || !isDigit(*p)) return false;
+        int e = 0;
+        for (; p < last && isDigit(*p); p++) {
+            if (e < 100000) e = e * 10 + (*p - '0');
+        }
+        e10 += negative ? -e : e;
+    }
+    if (p != last) return false;
+
+    if (m == 0) {
+        value = 0;
+        return true;
+    }
+
+    // exact operands, one correctly rounded operation (Clinger's fast path)
+    if (!truncated && m <= max_exact) {
+        if (e10 >= 0 && e10 <= 22) {
+            value = double(m) * pow10[e10];
+            return true;
+        }
+        if (e10 < 0 && e10 >= -22) {
+            value = double(m) / pow10[-e10];
+            return true;
+        }
+        if (e10 > 22 && e10 <= 22 + 15) {
+            // move the excess exponent into the mantissa while it stays exact
+            uint64_t scale = uint64_t(pow10[e10 - 22]);
+            if (m <= max_exact / scale) {
+                value = double(m * scale) * 1e22;
+                return true;
+            }
+        }
+    }
+
+    char small[64];
+    std::string large;
+    const char *s;
+    size_t n = last - first;
+    if (n < sizeof(small)) {
+        memcpy(small, first, n);
+        small[n] = 0;
+        s = small;
+    }
+    else {
+        large.assign(first, last);
+        s = large.c_str();
+    }
+
+    double v = strtodC(s);
+    if (std::isinf(v) || v == 0) return false;     // overflow or underflow of a non-zero literal
+    value = v;
+    return true;
+}
+
+char* formatGeneral(char *p, double value, int precision)
+{
+    if (!std::isfinite(value)) return writeNonFinite(p, value);
+    if (precision <= 0) precision = 1;
+    if (precision > 17) precision = 17;
+
+    char digits[20];
+    int exponent = decimalDigits(value, precision, digits);
+
+    return formatDigits(p, std::signbit(value), digits, stripZeros(digits, precision), exponent, precision);
+}
+
+char* formatDigits(char *p, bool negative, const char *digits, int n, int exponent, int precision)
+{
+    if (negative) *p++ = '-';
+    if (exponent < precision && exponent >= -4) return writeFixed(p, digits, n, exponent);
+    return writeScientific(p, digits, n, exponent);
+}
+
+char* formatShortest(char *p, double value)
+{
+    if (!std::isfinite(value)) return writeNonFinite(p, value);
+
+    // two decimals of 15 digits are more than an ulp of a normal double apart, so if the one
+    // nearest to the value parses back, no shorter decimal does unless it is the same one
+    // without trailing zeros. Subnormals have fewer digits and are searched from 1 on.
+    char digits[20];
+    int n = 0, exponent = 0;
+    int precision = value == 0 || std::isnormal(value) ? 15 : 1;
+    for (; precision <= 17; precision++) {
+        exponent = decimalDigits(value, precision, digits);
+        n = stripZeros(digits, precision);
+
+        char text[number_buffer];
+        double back;
+        char *end = writeScientific(text, digits, n, exponent);
+        if (precision == 17 || (parseNumber(text, end, back) && back == std::fabs(value))) break;
+    }
+
+    if (std::signbit(value)) *p++ = '-';
+
+    // fixed notation unless the scientific one is shorter
+    int sci = n + (n > 1) + 2 + (exponent <= -100 || exponent >= 100 ? 3 : 2);
+    int fixed = exponent < 0 ? n + 1 - exponent : std::max(n, exponent + 1) + (n > exponent + 1);
+    if (fixed <= sci) return writeFixed(p, digits, n, exponent);
+    return writeScientific(p, digits, n, exponent);
+}
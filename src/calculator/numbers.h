@@ -0,0 +1,138 @@
+#ifndef NUMBERS_H
+#define NUMBERS_H
+
+#include <cstddef>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <ostream>
+
+/*
+   locale-free conversion between number literals and double
+   parseNumber accepts the literals produced by the lexer (digits, optional fraction and
+   exponent) and is correctly rounded: short literals are converted exactly with one
+   floating point operation, others fall back to strtod in the "C" locale.
+   Values out of the range of double (overflow to infinity or underflow of a non-zero
+   literal to zero) are errors.
+   The formatters write into a caller buffer of at least number_buffer chars and return
+   the end of the written text (not NUL-terminated).
+*/
+
+const size_t number_buffer = 32;
+
+// parse the whole of [first, last); false on a syntax error or a value out of range
+bool parseNumber(const char *first, const char *last, double &value);
+
+// like printf "%.<precision>g" (the default ostream output for precision 6); precision <= 17
+char* formatGeneral(char *first, double value, int precision = 6);
+
+// shortest text that parses back to the same value (the fewest significant digits, subnormals
+// included); fixed or scientific notation, whichever is shorter
+char* formatShortest(char *first, double value);
+
+// '%g' layout of a finite value given by its decimal digits: the 'n' significant digits of |value|
+// (n <= precision, without trailing zeros), the first of them at 10^exponent; for number types
+// producing their own digits. The buffer needs n + 10 chars.
+char* formatDigits(char *first, bool negative, const char *digits, int n, int exponent, int precision);
+
+// append the text of 'os << value' on a default formatted stream
+template<typename T>
+void appendNumber(std::string &s, const T &value)
+{
+    std::ostringstream ss;
+    ss << value;
+    s += ss.str();
+}
+
+inline void appendNumber(std::string &s, double value)
+{
+    char buf[number_buffer];
+    s.append(buf, formatGeneral(buf, value));
+}
+
+// append the value with all the digits of its type, for machine-readable output; the text
+// of appendNumber unless the type has its own version
+template<typename T>
+void appendPrecise(std::string &s, const T &value)
+{
+    appendNumber(s, value);
+}
+
+// the shortest text that parses back to the same double
+inline void appendPrecise(std::string &s, double value)
+{
+    char buf[number_buffer];
+    s.append(buf, formatShortest(buf, value));
+}
+
+/*
+   arithmetic of the parser atoms, in place: the error message of a failed operation or nullptr.
+   The generic version applies the operators of T and never reports an error (exceptions
+   they throw are handled by the parser).
+*/
+template<typename T>
+struct atom_arithmetic {
+    static const char* add(T &a, const T &b) { a += b; return nullptr; }
+    static const char* sub(T &a, const T &b) { a -= b; return nullptr; }
+    static const char* mul(T &a, const T &b) { a *= b; return nullptr; }
+    static const char* div(T &a, const T &b) { a /= b; return nullptr; }
+    static const char* negate(T &a) { a = -a; return nullptr; }
+
+    static const char* logarithm(T &a) {
+        using std::log;
+        a = log(a);
+        return nullptr;
+    }
+
+    static const char* power(T &a, const T &b) {
+        using std::pow;
+        a = pow(a, b);
+        return nullptr;
+    }
+};
+
+/*
+   customization point of the parser atoms: reading number literals and variables, printing
+   numbers and the arithmetic above. The generic version goes through streams; double has
+   the fast paths above.
+*/
+template<typename T>
+struct atom_traits : atom_arithmetic<T> {
+    // number literal [first, last)
+    static bool number(const char *first, const char *last, T &value) {
+        std::istringstream ss(std::string(first, last));
+        ss >> value;
+        return !ss.fail();
+    }
+
+    // variable name; false if the atom type can't represent variables
+    static bool variable(const char *name, size_t len, T &value) {
+        std::istringstream ss(std::string(name, len));
+        ss >> value;
+        return !ss.fail();
+    }
+
+    static void print(std::ostream &os, const T &value) { os << value; }
+};
+
+template<>
+struct atom_traits<double> : atom_arithmetic<double> {
+    static bool number(const char *first, const char *last, double &value) {
+        return parseNumber(first, last, value);
+    }
+
+    static bool variable(const char *, size_t, double &) { return false; }
+
+    static void print(std::ostream &os, double value) {
+        // non-default stream formatting is left to the stream
+        const auto custom = std::ios_base::floatfield | std::ios_base::showpos | std::ios_base::showpoint | std::ios_base::uppercase;
+        if ((os.flags() & custom) || os.precision() > 17) {
+            os << value;
+            return;
+        }
+        char buf[number_buffer];
+        os.write(buf, formatGeneral(buf, value, int(os.precision())) - buf);
+    }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include <string>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "output.h"
+
+namespace {
+
+bool sameFile(int fd1, int fd2)
+{
+#ifdef _WIN32
+    return true;    // keep the order, can't tell cheaply
+#else
+    struct stat s1, s2;
+    if (fstat(fd1, &s1) != 0 || fstat(fd2, &s2) != 0) return true;
+    return s1.st_dev == s2.st_dev && s1.st_ino == s2.st_ino;
+#endif
+}
+
+void writeAll(int fd, const char *p, size_t n)
+{
+    while (n > 0) {
+#ifdef _WIN32
+        int w = _write(fd, p, unsigned(n));
+#else
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+#endif
+        if (w <= 0) return;     // nowhere to report the failure
+        p += w;
+        n -= size_t(w);
+    }
+}
+
+}
+
+fd_sink::fd_sink(int out_fd, int err_fd, size_t icapacity) : capacity(icapacity), same_file(sameFile(out_fd, err_fd))
+{
+    bufs[0].fd = out_fd;
+    bufs[1].fd = err_fd;
+    bufs[0].data.reserve(capacity);
+}
+
+void fd_sink::write(bool to_err, const char *p, size_t n)
+{
+    if (same_file && to_err != last_err) flush(bufs[last_err]);
+    last_err = to_err;
+
+    auto &b = bufs[to_err];
+    if (b.data.size() + n > capacity) {
+        flush(b);
+        if (n >= capacity) {
+            writeAll(b.fd, p, n);
+            return;
+        }
+    }
+    b.data.append(p, n);
+}
+
+void fd_sink::flush()
+{
+    flush(bufs[last_err ? 0 : 1]);
+    flush(bufs[last_err ? 1 : 0]);
+}
+
+void fd_sink::flush(buffer &b)
+{
+    writeAll(b.fd, b.data.data(), b.data.size());
+    b.data.clear();
+}
@@ -0,0 +1,141 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <streambuf>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// stream buffer appending everything to a std::string
+class string_buf : public std::streambuf {
+public:
+    explicit string_buf(std::string &is) : s(is) {};
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) s.push_back(char(c));
+        return c;
+    }
+    std::streamsize xsputn(const char *p, std::streamsize n) override {
+        s.append(p, size_t(n));
+        return n;
+    }
+
+private:
+    std::string &s;
+};
+
+// destination of the stdout/stderr output of the driver
+class output_sink {
+public:
+    virtual ~output_sink() {};
+    virtual void write(bool to_err, const char *p, size_t n) = 0;
+    virtual void flush() = 0;
+};
+
+// sink writing to a pair of streams
+class stream_sink : public output_sink {
+public:
+    stream_sink(std::ostream &io, std::ostream &ie) : o(io), e(ie) {};
+
+    void write(bool to_err, const char *p, size_t n) override { (to_err ? e : o).write(p, n); };
+    void flush() override { o.flush(); e.flush(); };
+
+private:
+    std::ostream &o, &e;
+};
+
+/*
+   sink writing to a pair of file descriptors through large reusable buffers
+   every buffer is written with a single system call once it is full; when both
+   descriptors refer to the same file, switching between them flushes the other
+   buffer first so that the relative order is kept
+*/
+class fd_sink : public output_sink {
+public:
+    explicit fd_sink(int out_fd = 1, int err_fd = 2, size_t capacity = 1 << 20);
+    ~fd_sink() override { flush(); };
+
+    void write(bool to_err, const char *p, size_t n) override;
+    void flush() override;
+
+private:
+    struct buffer {
+        int         fd;
+        std::string data;
+    };
+
+    buffer bufs[2];
+    size_t capacity;
+    bool   same_file;   // stdout and stderr go to the same file
+    bool   last_err = false;
+
+    void flush(buffer &b);
+};
+
+/*
+   buffered output of a block of input lines
+   stdout and stderr text is collected in one buffer together with the points where
+   the target stream changes, so that it can be written later in the original order
+*/
+
+class block_output {
+public:
+    block_output() : buf(text), os(&buf) {};
+    block_output(const block_output&) = delete;
+    block_output& operator = (const block_output&) = delete;
+
+    std::ostream& out() { target(false); return os; };
+    std::ostream& err() { target(true);  return os; };
+
+    // the same buffer for direct appends, without the stream
+    std::string& out_text() { target(false); return text; };
+    std::string& err_text() { target(true);  return text; };
+
+    bool empty() const { return text.empty(); };
+
+    size_t size() const { return text.size(); };
+
+    // write the collected output to the sink and clear it
+    void flush_to(output_sink &sink) {
+        size_t start = 0;
+        segments.push_back({ to_err, text.size() });
+        for (auto &s : segments) {
+            if (s.end > start) sink.write(s.to_err, text.data() + start, s.end - start);
+            start = s.end;
+        }
+        clear();
+    }
+
+    void flush_to(std::ostream &o, std::ostream &e) {
+        stream_sink sink(o, e);
+        flush_to(sink);
+    }
+
+    void clear() {
+        text.clear();
+        segments.clear();
+        to_err = false;
+    }
+
+private:
+    struct segment {
+        bool   to_err;
+        size_t end;     // end offset of the segment in 'text'
+    };
+
+    std::string          text;
+    std::vector<segment> segments;
+    bool                 to_err = false;
+    string_buf           buf;
+    std::ostream         os;
+
+    void target(bool e) {
+        if (e != to_err) {
+            segments.push_back({ to_err, text.size() });
+            to_err = e;
+        }
+    }
+};
+
+#endif
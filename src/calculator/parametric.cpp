@@ -0,0 +1,280 @@
+#include <vector>
+#include <string>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include "parametric.h"
+#include "jit.h"
+
+// split of every value of the compiled equation into c0 + c1*x, following the postfix code;
+// c1 is absent where affine<double> would have no x term
+struct parametric_equation::reducer {
+    // postfix code of a value; empty for a coefficient of x that is zero by construction (the
+    // value has no x term)
+    struct fragment {
+        std::vector<op>    code;
+        std::vector<token> where;
+
+        bool zero() const { return code.empty(); };
+    };
+
+    struct value {
+        fragment c0, c1;
+    };
+
+    const program<double> &src;
+    program<double>       &out;
+    unsigned               unknown;     // slot of x in 'src'
+    std::vector<unsigned>  slots;       // slot in 'out' of every other variable of 'src'
+    std::vector<value>     stack;
+    std::vector<std::pair<fragment, token>> divisors;   // the c0 of every divisor, with its '/'
+
+    reducer(const program<double> &isrc, program<double> &iout, unsigned iunknown)
+        : src(isrc), out(iout), unknown(iunknown) {};
+
+    unsigned constant(double v);
+    void emit(fragment &to, op_t code, unsigned arg, const token &t);
+    void append(fragment &to, const fragment &from);
+    fragment materialize(fragment a, const token &t);
+    fragment unary(fragment a, op_t code, const token &t);
+    fragment binary(fragment a, fragment b, op_t code, const token &t);
+    void run();
+};
+
+unsigned parametric_equation::reducer::constant(double v)
+{
+    for (size_t i = 0; i < out.consts.size(); i++) {
+        if (sameConstant(out.consts[i], v)) return unsigned(i);
+    }
+    out.consts.push_back(v);
+    return unsigned(out.consts.size() - 1);
+}
+
+void parametric_equation::reducer::emit(fragment &to, op_t code, unsigned arg, const token &t)
+{
+    to.code.push_back({ code, arg });
+    to.where.push_back(t);
+}
+
+void parametric_equation::reducer::append(fragment &to, const fragment &from)
+{
+    to.code.insert(to.code.end(), from.code.begin(), from.code.end());
+    to.where.insert(to.where.end(), from.where.begin(), from.where.end());
+}
+
+// the code of a zero fragment is a 0 constant
+parametric_equation::reducer::fragment parametric_equation::reducer::materialize(fragment a, const token &t)
+{
+    if (a.zero()) emit(a, op_t::push_const, constant(0), t);
+    return a;
+}
+
+parametric_equation::reducer::fragment parametric_equation::reducer::unary(fragment a, op_t code, const token &t)
+{
+    if (code == op_t::neg) {
+        if (a.zero()) return a;
+        // 0 - a as affine<double> negates, which gives 0 - 0 = 0
+        fragment r;
+        emit(r, op_t::push_const, constant(0), t);
+        append(r, a);
+        emit(r, op_t::sub, 0, t);
+        return r;
+    }
+    a = materialize(std::move(a), t);
+    emit(a, code, 0, t);
+    return a;
+}
+
+parametric_equation::reducer::fragment parametric_equation::reducer::binary(fragment a, fragment b, op_t code, const token &t)
+{
+    switch (code) {
+    case op_t::add:
+        if (a.zero()) return b;
+        if (b.zero()) return a;
+        break;
+    case op_t::sub:
+        if (b.zero()) return a;
+        if (a.zero()) return unary(std::move(b), op_t::neg, t);
+        break;
+    case op_t::mul:
+        if (a.zero()) return a;
+        if (b.zero()) return b;
+        break;
+    case op_t::div:
+        if (a.zero()) return a;
+        break;
+    default:
+        break;
+    }
+    a = materialize(std::move(a), t);
+    append(a, materialize(std::move(b), t));
+    emit(a, code, 0, t);
+    return a;
+}
+
+void parametric_equation::reducer::run()
+{
+    for (size_t i = 0; i < src.code.size(); i++) {
+        auto &o = src.code[i];
+        auto &t = src.where[i];
+        value v;
+
+        switch (o.code) {
+        case op_t::push_const:
+            emit(v.c0, op_t::push_const, o.arg, t);
+            stack.push_back(std::move(v));
+            continue;
+        case op_t::push_var:
+            if (o.arg == unknown) {
+                // 0 + 1*x, the signed zeros then come out as with affine<double>
+                emit(v.c0, op_t::push_const, constant(0), t);
+                emit(v.c1, op_t::push_const, constant(1), t);
+            }
+            else emit(v.c0, op_t::push_var, slots[o.arg], t);
+            stack.push_back(std::move(v));
+            continue;
+        case op_t::neg:
+            stack.back().c0 = unary(std::move(stack.back().c0), op_t::neg, t);
+            stack.back().c1 = unary(std::move(stack.back().c1), op_t::neg, t);
+            continue;
+        case op_t::log:
+            if (!stack.back().c1.zero()) throw error(t, "log of polynomial not allowed");
+            stack.back().c0 = unary(std::move(stack.back().c0), op_t::log, t);
+            continue;
+        case op_t::result:
+            continue;
+        case op_t::store:
+        case op_t::load:
+            assert(false);      // the source is not optimized
+            continue;
+        default:
+            break;
+        }
+
+        // binary operators, affine<double> rules
+        value b = std::move(stack.back());
+        stack.pop_back();
+        value &a = stack.back();
+        switch (o.code) {
+        case op_t::add:
+        case op_t::sub:
+            a.c0 = binary(std::move(a.c0), std::move(b.c0), o.code, t);
+            a.c1 = binary(std::move(a.c1), std::move(b.c1), o.code, t);
+            break;
+        case op_t::mul:
+            if (!a.c1.zero() && !b.c1.zero()) throw error(t, "polynomial of order > 1 not allowed");
+            if (a.c1.zero()) a.c1 = binary(a.c0, std::move(b.c1), op_t::mul, t);
+            else             a.c1 = binary(std::move(a.c1), b.c0, op_t::mul, t);
+            a.c0 = binary(std::move(a.c0), std::move(b.c0), op_t::mul, t);
+            break;
+        case op_t::div:
+            if (!b.c1.zero()) throw error(t, "polynomial fraction not allowed");
+            divisors.push_back({ materialize(b.c0, t), t });
+            a.c1 = binary(std::move(a.c1), b.c0, op_t::div, t);
+            a.c0 = binary(std::move(a.c0), std::move(b.c0), op_t::div, t);
+            break;
+        case op_t::pow:
+            if (!b.c1.zero()) throw error(t, "polynomial exponent not allowed");
+            if (!a.c1.zero()) throw error(t, "power of polynomial not allowed");
+            a.c0 = binary(std::move(a.c0), std::move(b.c0), op_t::pow, t);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+parametric_equation::parametric_equation(const std::vector<token_view> &tokens, const std::string &unknown)
+    : unknown_id(symbol_table::intern(unknown))
+{
+    auto src = program<double>::compile(tokens);
+
+    if (src.results != 1) {
+        auto comma = std::find_if(tokens.begin(), tokens.end(), [](const token_view &t) { return t.kind == tok_kind::comma; });
+        throw error(comma == tokens.end() ? &tokens.back() : &*comma, "a single equation expected");
+    }
+    if (src.code.back().arg == 0) throw error(src.where.back(), "equation expected");
+    int slot = src.slot(unknown);
+    if (slot < 0) throw error(&tokens[0], "the equation does not contain " + unknown);
+
+    p.consts = src.consts;
+    reducer r(src, p, unsigned(slot));
+    for (size_t i = 0; i < src.vars.size(); i++) {
+        r.slots.push_back(unsigned(p.vars.size()));
+        if (int(i) != slot) p.vars.push_back(src.vars[i]);
+    }
+    r.run();
+
+    // coef, constant, the divisors that can be 0
+    auto &eq = src.where.back();
+    auto &v = r.stack.back();
+    auto add = [&](const reducer::fragment &f, const token &t) {
+        p.code.insert(p.code.end(), f.code.begin(), f.code.end());
+        p.where.insert(p.where.end(), f.where.begin(), f.where.end());
+        p.code.push_back({ op_t::result, 0 });
+        p.where.push_back(t);
+        p.results++;
+    };
+    add(r.materialize(std::move(v.c1), eq), eq);
+    add(r.materialize(std::move(v.c0), eq), eq);
+    for (auto &d : r.divisors) {
+        auto &f = d.first;
+        if (f.code.size() == 1 && f.code[0].code == op_t::push_const && p.consts[f.code[0].arg] != 0) continue;
+        add(f, d.second);
+        divisor_ops.push_back(d.second);
+    }
+
+    size_t sp = 0;
+    for (auto &o : p.code) {
+        switch (o.code) {
+        case op_t::push_const: case op_t::push_var: sp++; break;
+        case op_t::add: case op_t::sub: case op_t::mul: case op_t::div: case op_t::pow: sp--; break;
+        case op_t::result: sp--; continue;
+        default: break;
+        }
+        p.depth = std::max(p.depth, sp);
+    }
+
+    p.optimize();
+}
+
+parametric_equation::rows parametric_equation::solve(const column_table &t, simd_isa isa, bool jit) const
+{
+    rows r;
+    r.coef.resize(t.rows);
+    r.constant.resize(t.rows);
+    r.x.resize(t.rows);
+    r.zero_divisor.assign(t.rows, -1);
+
+    auto evaluate = [&](size_t i, double *out) {
+        if (jit) {
+            auto f = jit_cache::shared().get(p, i, isa);
+            f->run(f->bind(t).data(), t.rows, out);
+        }
+        else {
+            column_evaluator ev(p, i, isa);
+            ev.run(ev.bind(t).data(), t.rows, out);
+        }
+    };
+    evaluate(coefficient, r.coef.data());
+    evaluate(constant, r.constant.data());
+
+    // the first divisor that is 0, in the order of evaluation
+    std::vector<double> d(divisor_ops.empty() ? 0 : t.rows);
+    int *zero = r.zero_divisor.data();
+    for (size_t k = 0; k < divisor_ops.size(); k++) {
+        evaluate(divisors + k, d.data());
+        for (size_t i = 0; i < t.rows; i++) {
+            if (d[i] == 0 && zero[i] < 0) zero[i] = int(k);
+        }
+    }
+
+    // as printEq: -constant/coef, the negation first
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double *c1 = r.coef.data(), *c0 = r.constant.data();
+    double *x = r.x.data();
+    for (size_t i = 0; i < t.rows; i++) x[i] = c1[i] != 0 && zero[i] < 0 ? -c0[i] / c1[i] : nan;
+
+    return r;
+}
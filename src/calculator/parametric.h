@@ -0,0 +1,68 @@
+#ifndef PARAMETRIC_H
+#define PARAMETRIC_H
+
+#include <vector>
+#include <string>
+
+#include "lexer.h"
+#include "program.h"
+#include "symbols.h"
+#include "columnar.h"
+
+/*
+   equation template solved for many rows of parameters
+   An equation such as 'a*x + b = c*x - d' in one unknown x, whose other variables are
+   parameters, is compiled once and reduced to the closed form coef(params)*x + constant(params) = 0:
+   every value of the difference of the sides is split into its part linear in x and the rest,
+   with the arithmetic of affine<double>. The unknown must occur linearly by the structure of
+   the equation; x*x, 1/x, log(x) and powers of x are the errors of affine<double>, reported
+   at compile time.
+   The reduced program has the results coef and constant, with the parameters as its variables;
+   it is optimized, so the subexpressions they share are computed once. For a table of parameter
+   rows both are evaluated by the columnar kernels (or the native code of jit.h) a tile of rows
+   per op, and the solution -constant/coef of all rows in one loop. Rows with coef = 0 have no
+   solution: the equation holds for any x if constant = 0 and never otherwise, as the line
+   parser reports it.
+   The divisors of the equation are further results of the reduced program (but the constants
+   other than 0). A row where one is 0 has the error of the line, division by zero at its '/';
+   the first of them in the order of evaluation.
+*/
+
+class parametric_equation {
+public:
+    using error = program<double>::error;
+
+    // the results of the reduced program; the divisors follow
+    enum part { coefficient, constant, divisors };
+
+    // values of the rows of a table
+    struct rows {
+        std::vector<double> coef, constant, x;
+        std::vector<int>    zero_divisor;   // index of the divisor that is 0 in the row, or -1
+        size_t size() const { return x.size(); };
+    };
+
+    // compiles the equation 'tokens' in the variable 'unknown'
+    parametric_equation(const std::vector<token_view> &tokens, const std::string &unknown);
+
+    var_id unknown() const { return unknown_id; };
+
+    // coef and constant of the parameters (the variables of the program)
+    const program<double>& reduced() const { return p; };
+
+    // the '/' of the divisor k, result divisors + k of the reduced program
+    const token& divisor(size_t k) const { return divisor_ops[k]; };
+
+    // the values of every row, the parameters bound to the columns of the same name; x is NaN
+    // where coef is 0 or a divisor is 0
+    rows solve(const column_table &t, simd_isa isa = detectIsa(), bool jit = false) const;
+
+private:
+    struct reducer;
+
+    var_id unknown_id;
+    program<double> p;
+    std::vector<token> divisor_ops;
+};
+
+#endif
@@ -14,8 +14,138 @@
 #include <iostream>
 
 #include "lexer.h"
+#include "numbers.h"
+
+// parsing algorithm, both implement the grammar in the README with the same results and errors
+enum class parse_method {
+    recursive,  // recursive descent, one call per grammar rule and operand
+    iterative,  // precedence climbing over an explicit stack; any nesting depth
+};
+
+//-------------------------------------------------------
+/*
+   iterative parse of Additive by precedence climbing, shared by parser<T> and the compiler of
+   program<T> (program.h), so that both see the operators in the same order and stop at the
+   same error.
+   Operands are passed to the handler as they are read, operators wait in 'ops' until an
+   operator that binds less tightly (or the end of the expression or of a parenthesis) follows;
+   then they are passed on, in the same order as the recursive descent applies them. '^' is
+   right associative; a unary minus binds less tightly than '^' and more than '*', which matches
+   Unary <- '-' Unary | Power.
+   The handler 'h' provides
+       bool number(const token_view *t)             a number literal is the next operand
+       bool variable(const token_view *t)           an identifier (not log) is the next operand
+       bool apply_pending(const climb_pending &o)   o applies to the last operand(s)
+       bool fail(const token_view *t, const char *msg)   records an error, returns false
+   each returning false on an error, which stops the parse. 'pt' is left after the expression.
+*/
+
+// pending operator; 'paren' and 'log' mark open parentheses
+enum class climb_op { add, sub, mul, div, pow, neg, paren, log };
+
+struct climb_pending {
+    climb_op          kind;
+    const token_view* t;
+};
+
+// operator precedence: the grammar levels from Additive to Power; open parentheses are never
+// reduced by an operator
+inline int climbPrecedence(climb_op k)
+{
+    static const int prec[] = { 1, 1, 2, 2, 4, 3, 0, 0 };
+    return prec[int(k)];
+}
+
+// apply the pending operators of precedence 'prec' or higher
+template<typename H>
+bool climbReduce(std::vector<climb_pending> &ops, int prec, H &h)
+{
+    while (!ops.empty() && climbPrecedence(ops.back().kind) >= prec) {
+        auto o = ops.back();
+        ops.pop_back();
+        if (!h.apply_pending(o)) return false;
+    }
+    return true;
+}
+
+template<typename H>
+bool climbAdditive(const token_view *&pt, std::vector<climb_pending> &ops, H &h)
+{
+    ops.clear();
+
+    for (;;) {
+        // operand, after any prefix operators
+        if (pt->kind == tok_kind::minus) {
+            ops.push_back({ climb_op::neg, pt });
+            pt++;
+            continue;
+        }
+        if (pt->kind == tok_kind::plus) {
+            pt++;
+            continue;
+        }
+        if (pt->type == tok_t::num) {
+            if (!h.number(pt)) return false;
+        }
+        else if (pt->kind == tok_kind::kw_log) {
+            ops.push_back({ climb_op::log, pt });
+            pt++;
+            if (pt->kind != tok_kind::lparen) return h.fail(pt, "missing left parenthesis");
+            pt++;
+            continue;
+        }
+        else if (pt->type == tok_t::id) {
+            if (!h.variable(pt)) return false;
+        }
+        else if (pt->kind == tok_kind::lparen) {
+            ops.push_back({ climb_op::paren, pt });
+            pt++;
+            continue;
+        }
+        else return h.fail(pt, "missing operand");
+        pt++;
+
+        // binary operator, or the end of the operand's parenthesis or expression
+        for (;;) {
+            climb_op k;
+            switch (pt->kind) {
+            case tok_kind::plus:  k = climb_op::add; break;
+            case tok_kind::minus: k = climb_op::sub; break;
+            case tok_kind::star:  k = climb_op::mul; break;
+            case tok_kind::slash: k = climb_op::div; break;
+            case tok_kind::caret: k = climb_op::pow; break;
+            default:              k = climb_op::paren; break;
+            }
+
+            if (k != climb_op::paren) {
+                int prec = climbPrecedence(k);
+                if (!climbReduce(ops, k == climb_op::pow ? prec + 1 : prec, h)) return false;
+                ops.push_back({ k, pt });
+                pt++;
+                break;
+            }
+
+            if (!climbReduce(ops, 1, h)) return false;
+            if (ops.empty()) return true;
+            if (pt->kind != tok_kind::rparen) return h.fail(pt, "missing right parenthesis");
+            pt++;
+
+            // the parenthesis is an operand now
+            auto open = ops.back();
+            ops.pop_back();
+            if (open.kind == climb_op::log && !h.apply_pending(open)) return false;
+        }
+    }
+}
 
 //-------------------------------------------------------
+/*
+   errors are propagated without exceptions: the parse functions return false and the
+   first error is recorded in the parser with the token it refers to. Atom operations report
+   their errors through atom_traits<T> (numbers.h) as messages; atom types whose operators
+   throw are still supported - the exception is caught once at the top and reported at the
+   operator being applied.
+*/
 template<typename T>
 class parser {
 public:
@@ -27,10 +157,24 @@ public:
     struct error {
         const std::string msg;
         const token  t;
-        error(const token *it, const std::string &im) :msg(im), t(*it) {};
+        error(const token_view *it, const std::string &im) :msg(im), t(make_token(*it)) {};
+        error(const token &it, const std::string &im) :msg(im), t(it) {};
     };
 
-    static std::vector<result> parse(const std::vector<token>&);
+    // outcome of try_parse; on failure 'where' points to the token the error refers to
+    struct status {
+        const token_view *where = nullptr;
+        std::string       msg;
+
+        bool ok() const { return where == nullptr; }
+    };
+
+    // non-throwing interface: the results are appended to 'out' (incomplete on failure)
+    static status try_parse(const std::vector<token_view>&, std::vector<result> &out,
+                            parse_method method = parse_method::iterative);
+
+    static std::vector<result> parse(const std::vector<token_view>&, parse_method method = parse_method::iterative);
+    static std::vector<result> parse(const std::vector<token>&, parse_method method = parse_method::iterative);
 private:
 
     enum class expr_rule {
@@ -42,173 +186,317 @@ private:
         parentheses,
     };
 
+    using op_kind = climb_op;
+    using pending = climb_pending;
+
+    // operand and operator stacks of the iterative parser; kept per thread, so their memory
+    // is reused by the following parses
+    struct stacks {
+        std::vector<T>       values;
+        std::vector<pending> ops;
+    };
+
+    static stacks& thread_stacks() {
+        static thread_local stacks s;
+        return s;
+    }
+
     // parser current token pointer
-    const token* pt;
+    const token_view* pt;
+    parse_method method;
+
+    std::vector<T>       &values;
+    std::vector<pending> &ops;
+
+    // first error and the operator token of the atom operation being applied
+    const token_view* err_at = nullptr;
+    const char*       err_msg = nullptr;
+    const token_view* op = nullptr;
 
     // private constructor - parser objects are used only temporarily in the 'parse' function
-    parser(const token* it) : pt(it) {};
-    T parse_expr(const expr_rule);
-    result parse_eq();
-    std::vector<result> parse_list();
+    parser(const token_view* it, parse_method im, stacks &st) : pt(it), method(im), values(st.values), ops(st.ops) {};
+    bool parse_additive(T &result);
+    bool parse_expr(const expr_rule, T &result);
+    bool parse_climbing(T &result);
+
+    // handler of climbAdditive: operands and operators go to 'values'
+    template<typename H> friend bool climbAdditive(const token_view *&, std::vector<climb_pending> &, H &);
+    template<typename H> friend bool climbReduce(std::vector<climb_pending> &, int, H &);
+    bool number(const token_view *t);
+    bool variable(const token_view *t);
+    bool apply_pending(const pending &o);
+
+    bool parse_eq(std::vector<result> &r);
+    bool parse_list(std::vector<result> &r);
+
+    // record an error; returns false to be passed up
+    bool fail(const token_view *at, const char *msg) {
+        err_at = at;
+        err_msg = msg;
+        return false;
+    }
+
+    // apply an atom operation of the operator token 'ot'; f returns the error message or nullptr
+    template<typename F>
+    bool apply(const token_view *ot, F f) {
+        op = ot;
+        const char *msg = f();
+        return msg ? fail(ot, msg) : true;
+    }
 };
 
 // parse expression
 template<typename T>
-T parser<T>::parse_expr(const expr_rule cr)
+bool parser<T>::parse_expr(const expr_rule cr, T &result)
 {
-    auto ot = pt;   // operator token (for diagnostics)
-    T result{ 0 };
-    try {
-        switch (cr) {
-        case expr_rule::additive:
-            result = parse_expr(expr_rule::multiplicative);
-            for (;;) {
-                if (pt->s == "+") {
-                    ot = pt;
-                    pt++;
-                    result = result + parse_expr(expr_rule::multiplicative);
-                }
-                else if (pt->s == "-") {
-                    ot = pt;
-                    pt++;
-                    result = result - parse_expr(expr_rule::multiplicative);
-                }
-                else break;
-            }
-            break;
-        case expr_rule::multiplicative:
-            result = parse_expr(expr_rule::unary);
-            for (;;) {
-                if (pt->s == "*") {
-                    ot = pt;
-                    pt++;
-                    result = result * parse_expr(expr_rule::unary);
-                }
-                else if (pt->s == "/") {
-                    ot = pt;
-                    pt++;
-                    result = result / parse_expr(expr_rule::unary);
-                }
-                else break;
-            }
-            break;
-        case expr_rule::unary:
-            if (pt->s == "-") {
-                ot = pt;
+    using traits = atom_traits<T>;
+
+    switch (cr) {
+    case expr_rule::additive:
+        if (!parse_expr(expr_rule::multiplicative, result)) return false;
+        for (;;) {
+            auto ot = pt;   // operator token (for diagnostics)
+            if (pt->kind == tok_kind::plus) {
                 pt++;
-                result = -parse_expr(expr_rule::unary);
+                T rhs{ 0 };
+                if (!parse_expr(expr_rule::multiplicative, rhs)) return false;
+                if (!apply(ot, [&] { return traits::add(result, rhs); })) return false;
             }
-            else if (pt->s == "+") {
-                ot = pt;
+            else if (pt->kind == tok_kind::minus) {
                 pt++;
-                result = parse_expr(expr_rule::unary);
-            }
-            else {
-                result = parse_expr(expr_rule::power);
+                T rhs{ 0 };
+                if (!parse_expr(expr_rule::multiplicative, rhs)) return false;
+                if (!apply(ot, [&] { return traits::sub(result, rhs); })) return false;
             }
-            break;
-        case expr_rule::power:
-            result = parse_expr(expr_rule::primary);
-            if (pt->s == "^") {
-                ot = pt;
+            else break;
+        }
+        break;
+    case expr_rule::multiplicative:
+        if (!parse_expr(expr_rule::unary, result)) return false;
+        for (;;) {
+            auto ot = pt;
+            if (pt->kind == tok_kind::star) {
                 pt++;
-                result = pow(result, parse_expr(expr_rule::unary));
+                T rhs{ 0 };
+                if (!parse_expr(expr_rule::unary, rhs)) return false;
+                if (!apply(ot, [&] { return traits::mul(result, rhs); })) return false;
             }
-            break;
-        case expr_rule::primary:
-            if (pt->type == tok_t::num) {
-                std::istringstream ss(pt->s);
-                ss >> result;
-                if(ss.fail()) throw error(pt, "unable to parse the input as a floating point number");
+            else if (pt->kind == tok_kind::slash) {
                 pt++;
+                T rhs{ 0 };
+                if (!parse_expr(expr_rule::unary, rhs)) return false;
+                if (!apply(ot, [&] { return traits::div(result, rhs); })) return false;
             }
-            else if (pt->type == tok_t::id) {
-                if (pt->s == "log") {
-                    // function
-                    ot = pt;
-                    pt++;
-                    T arg = parse_expr(expr_rule::parentheses);
-                    result = log(arg);
-                }
-                else {
-                    //variable
-                    std::istringstream ss(pt->s);
-                    ot = pt;
-                    ss >> result;
-                    if (ss.fail()) throw  error(pt, "backend can't handle variables");
-                    pt++;
-                }
-            }
-            else if (pt->s == "(") {
-                result = parse_expr(expr_rule::parentheses);
-            }
-            else throw error(pt, "missing operand");
-            break;
-        case expr_rule::parentheses:
-            if (pt->s != "(") throw error(pt, "missing left parenthesis");
+            else break;
+        }
+        break;
+    case expr_rule::unary:
+        if (pt->kind == tok_kind::minus) {
+            auto ot = pt;
             pt++;
-            result = parse_expr(expr_rule::additive);
-            if (pt->s != ")") throw error(pt, "missing right parenthesis");
+            if (!parse_expr(expr_rule::unary, result)) return false;
+            if (!apply(ot, [&] { return traits::negate(result); })) return false;
+        }
+        else if (pt->kind == tok_kind::plus) {
             pt++;
-            break;
+            if (!parse_expr(expr_rule::unary, result)) return false;
         }
-    }
-    catch (std::exception &e) {
-        throw error(ot, e.what());
+        else {
+            if (!parse_expr(expr_rule::power, result)) return false;
+        }
+        break;
+    case expr_rule::power:
+        if (!parse_expr(expr_rule::primary, result)) return false;
+        if (pt->kind == tok_kind::caret) {
+            auto ot = pt;
+            pt++;
+            T exponent{ 0 };
+            if (!parse_expr(expr_rule::unary, exponent)) return false;
+            if (!apply(ot, [&] { return traits::power(result, exponent); })) return false;
+        }
+        break;
+    case expr_rule::primary:
+        if (pt->type == tok_t::num) {
+            if (!traits::number(pt->s, pt->s + pt->len, result)) return fail(pt, "unable to parse the input as a floating point number");
+            pt++;
+        }
+        else if (pt->type == tok_t::id) {
+            if (pt->kind == tok_kind::kw_log) {
+                // function
+                auto ot = pt;
+                pt++;
+                if (!parse_expr(expr_rule::parentheses, result)) return false;
+                if (!apply(ot, [&] { return traits::logarithm(result); })) return false;
+            }
+            else {
+                //variable
+                if (!traits::variable(pt->s, pt->len, result)) return fail(pt, "backend can't handle variables");
+                pt++;
+            }
+        }
+        else if (pt->kind == tok_kind::lparen) {
+            if (!parse_expr(expr_rule::parentheses, result)) return false;
+        }
+        else return fail(pt, "missing operand");
+        break;
+    case expr_rule::parentheses:
+        if (pt->kind != tok_kind::lparen) return fail(pt, "missing left parenthesis");
+        pt++;
+        if (!parse_expr(expr_rule::additive, result)) return false;
+        if (pt->kind != tok_kind::rparen) return fail(pt, "missing right parenthesis");
+        pt++;
+        break;
     }
 
-    return result;
+    return true;
 }
 
-// parse equation
+// parse Additive: the whole expression
 template<typename T>
-typename parser<T>::result parser<T>::parse_eq()
+bool parser<T>::parse_additive(T &result)
 {
-    T lhs = parse_expr(expr_rule::additive);
+    if (method == parse_method::recursive) return parse_expr(expr_rule::additive, result);
+    return parse_climbing(result);
+}
 
-    if (pt->s != "=") return result{ lhs, false };
-    
-    const token* ot = pt;
-    pt++;
+// iterative parser of Additive, see climbAdditive
+template<typename T>
+bool parser<T>::parse_climbing(T &result)
+{
+    values.clear();
+    if (!climbAdditive(pt, ops, *this)) return false;
+    result = std::move(values.back());
+    return true;
+}
 
-    try {
-        lhs = lhs - parse_expr(expr_rule::additive);
+template<typename T>
+bool parser<T>::number(const token_view *t)
+{
+    values.emplace_back(0);
+    if (!atom_traits<T>::number(t->s, t->s + t->len, values.back())) return fail(t, "unable to parse the input as a floating point number");
+    return true;
+}
+
+template<typename T>
+bool parser<T>::variable(const token_view *t)
+{
+    values.emplace_back(0);
+    if (!atom_traits<T>::variable(t->s, t->len, values.back())) return fail(t, "backend can't handle variables");
+    return true;
+}
+
+// apply a pending operator to the top operands
+template<typename T>
+bool parser<T>::apply_pending(const pending &o)
+{
+    using traits = atom_traits<T>;
+
+    if (o.kind == op_kind::neg) return apply(o.t, [&] { return traits::negate(values.back()); });
+    if (o.kind == op_kind::log) return apply(o.t, [&] { return traits::logarithm(values.back()); });
+
+    // the result replaces the left operand in place
+    T &lhs = values[values.size() - 2];
+    T &rhs = values.back();
+    bool ok;
+    switch (o.kind) {
+    case op_kind::add: ok = apply(o.t, [&] { return traits::add(lhs, rhs); }); break;
+    case op_kind::sub: ok = apply(o.t, [&] { return traits::sub(lhs, rhs); }); break;
+    case op_kind::mul: ok = apply(o.t, [&] { return traits::mul(lhs, rhs); }); break;
+    case op_kind::div: ok = apply(o.t, [&] { return traits::div(lhs, rhs); }); break;
+    default:           ok = apply(o.t, [&] { return traits::power(lhs, rhs); }); break;
     }
-    catch (std::exception &e) {
-        throw error(ot, e.what());
+    values.pop_back();
+    return ok;
+}
+
+// parse equation
+template<typename T>
+bool parser<T>::parse_eq(std::vector<result> &r)
+{
+    T lhs{ 0 };
+    if (!parse_additive(lhs)) return false;
+
+    if (pt->kind != tok_kind::equal) {
+        r.push_back(result{ std::move(lhs), false });
+        return true;
     }
 
-    return result{ lhs, true };
+    const token_view* ot = pt;
+    pt++;
+
+    T rhs{ 0 };
+    if (!parse_additive(rhs)) return false;
+    if (!apply(ot, [&] { return atom_traits<T>::sub(lhs, rhs); })) return false;
+
+    r.push_back(result{ std::move(lhs), true });
+    return true;
 }
 
 // parse list of equations
 template<typename T>
-std::vector<typename parser<T>::result> parser<T>::parse_list()
+bool parser<T>::parse_list(std::vector<result> &r)
 {
-    std::vector<result> r;
+    if (pt->type == tok_t::end) return true;
 
-    if (pt->type == tok_t::end) return r;
-
-    r.push_back(parse_eq());
+    if (!parse_eq(r)) return false;
 
     for (;;) {
-        if (pt->type == tok_t::end) return r;
-        if (pt->s != ",") throw error(pt, "unexpected input");
+        if (pt->type == tok_t::end) return true;
+        if (pt->kind != tok_kind::comma) return fail(pt, "unexpected input");
         pt++;
-        r.push_back(parse_eq());
+        if (!parse_eq(r)) return false;
     }
 }
 
 
-// parse vector of tokens - class interface
+// parse vector of tokens without exceptions
 template<typename T>
-std::vector<typename parser<T>::result> parser<T>::parse(const std::vector<token>& vt)
+typename parser<T>::status parser<T>::try_parse(const std::vector<token_view>& vt, std::vector<result> &out, parse_method method)
 {
     assert(vt.back().type == tok_t::end);
 
-    parser<T> p(&vt[0]);
+    auto &st = thread_stacks();
+    parser<T> p(&vt[0], method, st);
+    status s;
+
+    try {
+        if (!p.parse_list(out)) {
+            s.where = p.err_at;
+            s.msg = p.err_msg;
+        }
+    }
+    catch (std::exception &e) {
+        // an operator of the atom type threw
+        s.where = p.op ? p.op : p.pt;
+        s.msg = e.what();
+    }
+
+    // no operands are kept past the parse (they may live in the arena of the line)
+    st.values.clear();
+    st.ops.clear();
+    return s;
+}
+
+// parse vector of tokens - class interface
+template<typename T>
+std::vector<typename parser<T>::result> parser<T>::parse(const std::vector<token_view>& vt, parse_method method)
+{
+    std::vector<result> r;
+    auto s = try_parse(vt, r, method);
+    if (!s.ok()) throw error(s.where, s.msg);
+
+    return r;
+}
+
+// compatibility interface for owning tokens
+template<typename T>
+std::vector<typename parser<T>::result> parser<T>::parse(const std::vector<token>& vt, parse_method method)
+{
+    std::vector<token_view> views;
+    views.reserve(vt.size());
+    for (auto &t : vt) views.push_back(make_view(t));
 
-    return p.parse_list();
+    return parse(views, method);
 }
 
 #endif
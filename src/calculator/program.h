@@ -0,0 +1,666 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <sstream>
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <exception>
+#include <algorithm>
+#include <type_traits>
+#include <unordered_map>
+
+#include "lexer.h"
+#include "parser.h"
+#include "numbers.h"
+#include "symbols.h"
+
+/*
+   compiled form of a parsed input line
+   the expression is flattened into a postfix op sequence running on a value stack;
+   numbers are kept in a constant pool and variables are referred to by slot index,
+   so the same program can be evaluated for any number of variable bindings.
+   The compiler runs the precedence climbing loop of the parser (climbAdditive), so any nesting
+   depth compiles and the ops come in the order in which the parser applies the operators;
+   on a syntax error, the ops before it are the operations the parser has done before it.
+   optimize() rewrites a compiled program for repeated evaluation: identical subexpressions
+   are computed once and kept in temporaries (store/load), operations on constants are done
+   at compile time and the identities x*1, 1*x, x/1, x+0, 0+x, x-0, x^1 and --x are dropped.
+   The results and errors are those of the original program, except that x+0 is x also for
+   x = -0.
+*/
+
+enum class op_t : unsigned char {
+    push_const,  // push consts[arg]
+    push_var,    // push bindings[arg]
+    add, sub, mul, div, pow,
+    neg, log,
+    result,      // pop the value as result; arg != 0 marks an equation 'value = 0'
+    store,       // copy the top of the stack to temps[arg]
+    load,        // push temps[arg]
+};
+
+struct op {
+    op_t     code;
+    unsigned arg;
+};
+
+template<typename T>
+class program {
+public:
+    using result = typename parser<T>::result;
+    using error  = typename parser<T>::error;
+    using status = typename parser<T>::status;
+
+    // what optimize() did; ops are counted without the result ops
+    struct optimization {
+        size_t before = 0, after = 0;   // ops, the loads and stores included
+        size_t shared = 0;              // subexpressions computed once for several uses
+        size_t folded = 0;              // operations on constants done at compile time
+        size_t simplified = 0;          // identities dropped
+
+        size_t eliminated() const { return before > after ? before - after : 0; }
+    };
+
+    static program compile(const std::vector<token_view>&);
+    static program compile(const std::vector<token>&);
+
+    // non-throwing interface: on failure 'p' holds the ops compiled before the error
+    static status try_compile(const std::vector<token_view>&, program &p);
+
+    optimization optimize();
+
+    // slot of the variable 'name' or -1 if the program does not use it
+    int slot(const std::string &name) const;
+
+    // ops [first, last) computing the 'r'-th result on their own, 'last' being its result op;
+    // they start after the previous result op, or at the beginning if they load a value stored
+    // before (the earlier result ops then only drop their value). False if there is no such result.
+    bool range(size_t r, size_t &first, size_t &last) const;
+
+    std::vector<op>          code;
+    std::vector<T>           consts;
+    std::vector<std::string> vars;      // variable name for each slot
+    std::vector<token>       where;     // operator token of each op (for diagnostics)
+    size_t                   depth = 0; // maximum stack depth
+    size_t                   results = 0;
+    size_t                   temps = 0; // values kept by store ops
+
+private:
+    // compiler state - used only temporarily in the 'compile' function
+    struct compiler;
+    // the same for 'optimize'
+    struct optimizer;
+};
+
+template<typename T> class affine;
+
+// x^1 is x for all atoms except affine ones, whose powers need a constant base
+template<typename T> struct power_identity : std::true_type {};
+template<typename T> struct power_identity<affine<T>> : std::false_type {};
+
+// constants are pooled by value; doubles by representation, which keeps 0 and -0 apart.
+// Equal constants have equal hashes; the hash 0 leaves the constants of a type to comparisons
+template<typename T>
+bool sameConstant(const T &a, const T &b) { return a == b; }
+inline bool sameConstant(double a, double b) { return memcmp(&a, &b, sizeof(double)) == 0; }
+template<typename T>
+bool sameConstant(const affine<T> &a, const affine<T> &b) { return a.isConstant() && b.isConstant() ? sameConstant(a.d, b.d) : a == b; }
+
+template<typename T>
+size_t constantHash(const T &) { return 0; }
+inline size_t constantHash(double a)
+{
+    uint64_t u;
+    memcpy(&u, &a, sizeof(double));
+    return size_t(u ^ u >> 32);
+}
+template<typename T>
+size_t constantHash(const affine<T> &a) { return a.isConstant() ? constantHash(a.d) : 0; }
+
+//-------------------------------------------------------
+// compiler: the handler of climbAdditive emits the ops of the operands and operators
+
+template<typename T>
+struct program<T>::compiler {
+    program &p;
+    const token_view* pt;
+    size_t sp = 0;       // current stack depth
+    std::vector<climb_pending> ops;
+    std::unordered_map<var_id, unsigned> slots;     // of the variables in 'p.vars'
+
+    const token_view* err_at = nullptr;
+    const char*       err_msg = nullptr;
+
+    compiler(program &ip, const token_view *it) : p(ip), pt(it) {};
+
+    void emit(op_t code, unsigned arg, const token_view *ot, int delta);
+    bool fail(const token_view *at, const char *msg) {
+        err_at = at;
+        err_msg = msg;
+        return false;
+    }
+
+    bool number(const token_view *t);
+    bool variable(const token_view *t);
+    bool apply_pending(const climb_pending &o);
+
+    bool compile_eq();
+    bool compile_list();
+};
+
+template<typename T>
+void program<T>::compiler::emit(op_t code, unsigned arg, const token_view *ot, int delta)
+{
+    p.code.push_back({ code, arg });
+    p.where.push_back(make_token(*ot));
+    sp += delta;
+    p.depth = std::max(p.depth, sp);
+}
+
+template<typename T>
+bool program<T>::compiler::number(const token_view *t)
+{
+    T value{ 0 };
+    if (!atom_traits<T>::number(t->s, t->s + t->len, value)) return fail(t, "unable to parse the input as a floating point number");
+    p.consts.push_back(value);
+    emit(op_t::push_const, unsigned(p.consts.size() - 1), t, 1);
+    return true;
+}
+
+template<typename T>
+bool program<T>::compiler::variable(const token_view *t)
+{
+    var_id id;
+    try {
+        id = symbol_table::intern(t->s, t->len);
+    }
+    catch (symbol_table::error &) {
+        return fail(t, "too many variable names");
+    }
+    auto i = slots.emplace(id, unsigned(p.vars.size()));
+    if (i.second) p.vars.push_back(t->str());
+    emit(op_t::push_var, i.first->second, t, 1);
+    return true;
+}
+
+template<typename T>
+bool program<T>::compiler::apply_pending(const climb_pending &o)
+{
+    switch (o.kind) {
+    case climb_op::add: emit(op_t::add, 0, o.t, -1); break;
+    case climb_op::sub: emit(op_t::sub, 0, o.t, -1); break;
+    case climb_op::mul: emit(op_t::mul, 0, o.t, -1); break;
+    case climb_op::div: emit(op_t::div, 0, o.t, -1); break;
+    case climb_op::pow: emit(op_t::pow, 0, o.t, -1); break;
+    case climb_op::neg: emit(op_t::neg, 0, o.t, 0); break;
+    default:            emit(op_t::log, 0, o.t, 0); break;
+    }
+    return true;
+}
+
+template<typename T>
+bool program<T>::compiler::compile_eq()
+{
+    if (!climbAdditive(pt, ops, *this)) return false;
+
+    if (pt->kind != tok_kind::equal) {
+        emit(op_t::result, 0, pt, -1);
+    }
+    else {
+        const token_view* ot = pt;
+        pt++;
+        if (!climbAdditive(pt, ops, *this)) return false;
+        emit(op_t::sub, 0, ot, -1);
+        emit(op_t::result, 1, ot, -1);
+    }
+    p.results++;
+    return true;
+}
+
+template<typename T>
+bool program<T>::compiler::compile_list()
+{
+    if (pt->type == tok_t::end) return true;
+
+    if (!compile_eq()) return false;
+
+    for (;;) {
+        if (pt->type == tok_t::end) return true;
+        if (pt->kind != tok_kind::comma) return fail(pt, "unexpected input");
+        pt++;
+        if (!compile_eq()) return false;
+    }
+}
+
+//-------------------------------------------------------
+
+template<typename T>
+typename program<T>::status program<T>::try_compile(const std::vector<token_view>& vt, program &p)
+{
+    assert(vt.back().type == tok_t::end);
+
+    p = program();
+    compiler c(p, &vt[0]);
+    status s;
+    if (!c.compile_list()) {
+        s.where = c.err_at;
+        s.msg = c.err_msg;
+    }
+    return s;
+}
+
+template<typename T>
+program<T> program<T>::compile(const std::vector<token_view>& vt)
+{
+    program p;
+    auto s = try_compile(vt, p);
+    if (!s.ok()) throw error(s.where, s.msg);
+
+    return p;
+}
+
+template<typename T>
+program<T> program<T>::compile(const std::vector<token>& vt)
+{
+    std::vector<token_view> views;
+    views.reserve(vt.size());
+    for (auto &t : vt) views.push_back(make_view(t));
+
+    return compile(views);
+}
+
+template<typename T>
+int program<T>::slot(const std::string &name) const
+{
+    auto i = std::find(vars.begin(), vars.end(), name);
+    return i == vars.end() ? -1 : int(i - vars.begin());
+}
+
+template<typename T>
+bool program<T>::range(size_t r, size_t &first, size_t &last) const
+{
+    size_t n = 0;
+    first = 0;
+    for (last = 0; last < code.size(); last++) {
+        if (code[last].code != op_t::result) continue;
+        if (n++ == r) break;
+        first = last + 1;
+    }
+    if (last == code.size()) return false;
+
+    std::vector<bool> stored(temps);
+    for (size_t pc = first; pc < last; pc++) {
+        if (code[pc].code == op_t::store) stored[code[pc].arg] = true;
+        if (code[pc].code == op_t::load && !stored[code[pc].arg]) {
+            first = 0;
+            break;
+        }
+    }
+    return true;
+}
+
+//-------------------------------------------------------
+// optimizer: the postfix code is read into a graph of hash-consed nodes, simplified while it is
+// built, and written out again in the original evaluation order, so that the first error of the
+// program is still the first one evaluated
+
+template<typename T>
+struct program<T>::optimizer {
+    struct node {
+        op_t     code;
+        unsigned arg;           // constant, variable slot
+        int      a, b;          // operands, -1 if none
+        size_t   pc;            // op of the original program, for its token
+        size_t   uses = 0;
+        int      temp = -1;     // once stored
+    };
+
+    explicit optimizer(program &ip) : p(ip) {};
+
+    program &p;
+    program out;
+    std::vector<node> nodes;
+    std::vector<int> index;         // open addressing hash table of the nodes, -1 if free
+    std::unordered_multimap<size_t, unsigned> pooled;   // constants by hash
+    optimization stats;
+    size_t sp = 0;
+    std::vector<std::pair<int, bool>> work;     // of emit(n)
+
+    int  make(op_t code, unsigned arg, int a, int b, size_t pc);
+    int  constant(const T &value, size_t pc);
+    bool is(int n, int value) const;
+    bool isNegativeZero(int n) const;
+    int  simplified(int n) { stats.simplified++; return n; }
+    int  unary(op_t code, int a, size_t pc);
+    int  binary(op_t code, int a, int b, size_t pc);
+    void emit(op_t code, unsigned arg, size_t pc, int delta);
+    void emit(int n);
+    void run();
+};
+
+template<typename T>
+int program<T>::optimizer::make(op_t code, unsigned arg, int a, int b, size_t pc)
+{
+    uint64_t h = uint64_t(code) | uint64_t(arg) << 8;
+    h = (h ^ uint32_t(a)) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ uint32_t(b)) * 0x9E3779B97F4A7C15ULL;
+
+    // at most one node per op of the program, the table is at least twice as large
+    size_t mask = index.size() - 1;
+    for (size_t i = size_t(h >> 32) & mask;; i = (i + 1) & mask) {
+        int n = index[i];
+        if (n < 0) {
+            index[i] = int(nodes.size());
+            nodes.push_back({ code, arg, a, b, pc });
+            return index[i];
+        }
+        auto &nd = nodes[n];
+        if (nd.code == code && nd.arg == arg && nd.a == a && nd.b == b) return n;
+    }
+}
+
+template<typename T>
+int program<T>::optimizer::constant(const T &value, size_t pc)
+{
+    size_t h = constantHash(value);
+    auto range = pooled.equal_range(h);
+    auto i = std::find_if(range.first, range.second, [&](const std::pair<const size_t, unsigned> &c) {
+        return sameConstant(out.consts[c.second], value);
+    });
+    if (i != range.second) return make(op_t::push_const, i->second, -1, -1, pc);
+
+    out.consts.push_back(value);
+    pooled.emplace(h, unsigned(out.consts.size() - 1));
+    return make(op_t::push_const, unsigned(out.consts.size() - 1), -1, -1, pc);
+}
+
+// node n is the constant 'value'
+template<typename T>
+bool program<T>::optimizer::is(int n, int value) const
+{
+    return nodes[n].code == op_t::push_const && sameConstant(out.consts[nodes[n].arg], T(value));
+}
+
+// x + -0 is x for every x, x + 0 is not for x = -0 (where T has signed zeros)
+template<typename T>
+bool program<T>::optimizer::isNegativeZero(int n) const
+{
+    return nodes[n].code == op_t::push_const && sameConstant(out.consts[nodes[n].arg], -T(0));
+}
+
+template<typename T>
+int program<T>::optimizer::unary(op_t code, int a, size_t pc)
+{
+    if (nodes[a].code == op_t::push_const) {
+        // a failing operation is left to the evaluation, to report its error there
+        T v = out.consts[nodes[a].arg];
+        try {
+            auto msg = code == op_t::neg ? atom_traits<T>::negate(v) : atom_traits<T>::logarithm(v);
+            if (!msg) {
+                stats.folded++;
+                return constant(v, pc);
+            }
+        }
+        catch (std::exception &) {}
+    }
+    if (code == op_t::neg && nodes[a].code == op_t::neg) return simplified(nodes[a].a);
+
+    return make(code, 0, a, -1, pc);
+}
+
+template<typename T>
+int program<T>::optimizer::binary(op_t code, int a, int b, size_t pc)
+{
+    using traits = atom_traits<T>;
+
+    if (nodes[a].code == op_t::push_const && nodes[b].code == op_t::push_const) {
+        T v = out.consts[nodes[a].arg];
+        const T &w = out.consts[nodes[b].arg];
+        try {
+            const char *msg = nullptr;
+            switch (code) {
+            case op_t::add: msg = traits::add(v, w); break;
+            case op_t::sub: msg = traits::sub(v, w); break;
+            case op_t::mul: msg = traits::mul(v, w); break;
+            case op_t::div: msg = traits::div(v, w); break;
+            default:        msg = traits::power(v, w); break;
+            }
+            if (!msg) {
+                stats.folded++;
+                return constant(v, pc);
+            }
+        }
+        catch (std::exception &) {}
+    }
+
+    switch (code) {
+    case op_t::add:
+        if (isNegativeZero(b)) return simplified(a);
+        if (isNegativeZero(a)) return simplified(b);
+        break;
+    case op_t::sub:
+        if (is(b, 0)) return simplified(a);
+        break;
+    case op_t::mul:
+        if (is(b, 1)) return simplified(a);
+        if (is(a, 1)) return simplified(b);
+        break;
+    case op_t::div:
+        if (is(b, 1)) return simplified(a);
+        break;
+    default:
+        if (power_identity<T>::value && is(b, 1)) return simplified(a);
+        break;
+    }
+
+    return make(code, 0, a, b, pc);
+}
+
+template<typename T>
+void program<T>::optimizer::emit(op_t code, unsigned arg, size_t pc, int delta)
+{
+    out.code.push_back({ code, arg });
+    out.where.push_back(p.where[pc]);
+    sp += delta;
+    out.depth = std::max(out.depth, sp);
+}
+
+// the code of node n; the first use of a shared node stores its value, the others load it.
+// Post-order walk on the heap stack 'work' (node, operands done), so any depth of the graph is fine
+template<typename T>
+void program<T>::optimizer::emit(int n)
+{
+    work.clear();
+    work.push_back({ n, false });
+    while (!work.empty()) {
+        auto w = work.back();
+        work.pop_back();
+        auto &nd = nodes[w.first];     // the graph is complete, the reference stays valid
+
+        if (!w.second) {
+            if (nd.temp >= 0) {
+                emit(op_t::load, unsigned(nd.temp), nd.pc, 1);
+                continue;
+            }
+            // the operands first, a before b
+            work.push_back({ w.first, true });
+            if (nd.b >= 0) work.push_back({ nd.b, false });
+            if (nd.a >= 0) work.push_back({ nd.a, false });
+            continue;
+        }
+
+        switch (nd.code) {
+        case op_t::push_const: case op_t::push_var: emit(nd.code, nd.arg, nd.pc, 1); continue;
+        case op_t::neg: case op_t::log:             emit(nd.code, 0, nd.pc, 0); break;
+        default:                                    emit(nd.code, 0, nd.pc, -1); break;
+        }
+
+        if (nd.uses > 1) {
+            nd.temp = int(out.temps++);
+            emit(op_t::store, unsigned(nd.temp), nd.pc, 0);
+        }
+    }
+}
+
+template<typename T>
+void program<T>::optimizer::run()
+{
+    std::vector<int> stack, temps;
+    std::vector<std::pair<int, size_t>> results;     // node, result op
+    temps.resize(p.temps);
+    nodes.reserve(p.code.size());
+    size_t size = 16;
+    while (size < 2 * p.code.size()) size *= 2;
+    index.assign(size, -1);
+    out.code.reserve(p.code.size());
+    out.where.reserve(p.code.size());
+
+    for (size_t pc = 0; pc < p.code.size(); pc++) {
+        const op &o = p.code[pc];
+        int b;
+        switch (o.code) {
+        case op_t::push_const: stack.push_back(constant(p.consts[o.arg], pc)); break;
+        case op_t::push_var:   stack.push_back(make(op_t::push_var, o.arg, -1, -1, pc)); break;
+        case op_t::neg: case op_t::log:
+            stack.back() = unary(o.code, stack.back(), pc);
+            break;
+        case op_t::result:
+            results.push_back({ stack.back(), pc });
+            stack.pop_back();
+            break;
+        case op_t::store: temps[o.arg] = stack.back(); break;
+        case op_t::load:  stack.push_back(temps[o.arg]); break;
+        default:
+            b = stack.back();
+            stack.pop_back();
+            stack.back() = binary(o.code, stack.back(), b, pc);
+            break;
+        }
+    }
+
+    // uses from the results and the reachable nodes; operands precede the nodes using them
+    for (auto &r : results) nodes[r.first].uses++;
+    for (size_t n = nodes.size(); n-- > 0;) {
+        if (nodes[n].uses == 0) continue;
+        if (nodes[n].a >= 0) nodes[nodes[n].a].uses++;
+        if (nodes[n].b >= 0) nodes[nodes[n].b].uses++;
+    }
+
+    for (auto &r : results) {
+        emit(r.first);
+        emit(op_t::result, p.code[r.second].arg, r.second, -1);
+    }
+
+    // the constants that are left
+    std::vector<T> pool;
+    std::vector<int> renumbered(out.consts.size(), -1);
+    for (auto &o : out.code) {
+        if (o.code != op_t::push_const) continue;
+        if (renumbered[o.arg] < 0) {
+            renumbered[o.arg] = int(pool.size());
+            pool.push_back(out.consts[o.arg]);
+        }
+        o.arg = unsigned(renumbered[o.arg]);
+    }
+    out.consts = std::move(pool);
+
+    stats.before = p.code.size() - p.results;
+    stats.after = out.code.size() - p.results;
+    stats.shared = out.temps;
+}
+
+template<typename T>
+typename program<T>::optimization program<T>::optimize()
+{
+    optimizer o(*this);
+    o.run();
+
+    code = std::move(o.out.code);
+    where = std::move(o.out.where);
+    consts = std::move(o.out.consts);
+    depth = o.out.depth;
+    temps = o.out.temps;
+    return o.stats;
+}
+
+//-------------------------------------------------------
+// evaluator of compiled programs
+// owns the value stack and the result vector, so repeated runs do not allocate
+// (as long as copying T does not)
+
+// runs the ops [0, n) of 'code'; 'stack', 'temps' and 'out' are as large as the program needs.
+// Returns the error message of a failing op, whose index is left in 'pc', or nullptr;
+// exceptions of the atom operations are passed on, also with 'pc' at the failing op
+template<typename T>
+const char* execute(const op *code, size_t n, const T *consts, const T *bindings,
+                    T *stack, T *temps, typename parser<T>::result *out, size_t &pc)
+{
+    T *sp = stack;   // next free stack slot
+    size_t r = 0;
+
+    using traits = atom_traits<T>;
+
+    for (pc = 0; pc < n; pc++) {
+        const op &o = code[pc];
+        const char *msg = nullptr;
+        switch (o.code) {
+        case op_t::push_const: *sp++ = consts[o.arg]; break;
+        case op_t::push_var:   *sp++ = bindings[o.arg]; break;
+        case op_t::add: sp--; msg = traits::add(sp[-1], sp[0]); break;
+        case op_t::sub: sp--; msg = traits::sub(sp[-1], sp[0]); break;
+        case op_t::mul: sp--; msg = traits::mul(sp[-1], sp[0]); break;
+        case op_t::div: sp--; msg = traits::div(sp[-1], sp[0]); break;
+        case op_t::pow: sp--; msg = traits::power(sp[-1], sp[0]); break;
+        case op_t::neg: msg = traits::negate(sp[-1]); break;
+        case op_t::log: msg = traits::logarithm(sp[-1]); break;
+        case op_t::result:
+            sp--;
+            out[r].atom = sp[0];
+            out[r].equal_to_zero = o.arg != 0;
+            r++;
+            break;
+        case op_t::store: temps[o.arg] = sp[-1]; break;
+        case op_t::load:  *sp++ = temps[o.arg]; break;
+        }
+        if (msg) return msg;
+    }
+    return nullptr;
+}
+
+template<typename T>
+class evaluator {
+public:
+    using result = typename parser<T>::result;
+
+    evaluator(const program<T> &ip) : p(ip), stack(ip.depth), temps(ip.temps), out(ip.results) {};
+
+    // evaluate the program; bindings[i] is the value of variable slot i
+    const std::vector<result>& run(const T *bindings);
+
+private:
+    const program<T> &p;
+    std::vector<T>      stack;
+    std::vector<T>      temps;
+    std::vector<result> out;
+};
+
+template<typename T>
+const std::vector<typename evaluator<T>::result>& evaluator<T>::run(const T *bindings)
+{
+    size_t pc = 0;
+    const char *msg;
+    try {
+        msg = execute(p.code.data(), p.code.size(), p.consts.data(), bindings, stack.data(), temps.data(), out.data(), pc);
+    }
+    catch (std::exception &e) {
+        throw typename parser<T>::error(p.where[pc], e.what());
+    }
+    if (msg) throw typename parser<T>::error(p.where[pc], msg);
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,694 @@
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "rational.h"
+
+namespace {
+
+const int64_t int64_min = std::numeric_limits<int64_t>::min();
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+#if defined(__GNUC__)
+inline bool addOverflow(int64_t a, int64_t b, int64_t &r) { return __builtin_add_overflow(a, b, &r); }
+inline bool mulOverflow(int64_t a, int64_t b, int64_t &r) { return __builtin_mul_overflow(a, b, &r); }
+#else
+inline bool addOverflow(int64_t a, int64_t b, int64_t &r)
+{
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) return true;
+    r = a + b;
+    return false;
+}
+
+inline bool mulOverflow(int64_t a, int64_t b, int64_t &r)
+{
+    if (a != 0 && b != 0) {
+        if (a > 0 ? (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a)
+                  : (b > 0 ? a < INT64_MIN / b : a < INT64_MAX / b)) return true;
+    }
+    r = a * b;
+    return false;
+}
+#endif
+
+// of non-negative values
+int64_t gcd(int64_t a, int64_t b)
+{
+    while (b) {
+        int64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+   arbitrary precision integers: sign and magnitude, 32-bit limbs from the least significant,
+   without leading zero limbs (zero has none)
+*/
+using limbs = std::vector<uint32_t>;
+
+struct bigint {
+    limbs m;
+    bool negative = false;
+
+    bigint() {}
+    bigint(int64_t v) {
+        negative = v < 0;
+        for (uint64_t u = negative ? 0 - uint64_t(v) : uint64_t(v); u; u >>= 32) m.push_back(uint32_t(u));
+    }
+
+    bool zero() const { return m.empty(); }
+    bool fits() const { return bits() < 64; }       // in int64, leaving out its minimum
+    int64_t value() const {
+        uint64_t u = 0;
+        for (size_t i = m.size(); i-- > 0;) u = (u << 32) | m[i];
+        return negative ? -int64_t(u) : int64_t(u);
+    }
+
+    size_t bits() const {
+        if (m.empty()) return 0;
+        size_t b = 32 * (m.size() - 1);
+        for (uint32_t top = m.back(); top; top >>= 1) b++;
+        return b;
+    }
+};
+
+void trim(limbs &a)
+{
+    while (!a.empty() && a.back() == 0) a.pop_back();
+}
+
+int compare(const limbs &a, const limbs &b)
+{
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (size_t i = a.size(); i-- > 0;) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+limbs add(const limbs &a, const limbs &b)
+{
+    const limbs &l = a.size() >= b.size() ? a : b, &s = a.size() >= b.size() ? b : a;
+    limbs r(l.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < l.size(); i++) {
+        carry += uint64_t(l[i]) + (i < s.size() ? s[i] : 0);
+        r[i] = uint32_t(carry);
+        carry >>= 32;
+    }
+    r[l.size()] = uint32_t(carry);
+    trim(r);
+    return r;
+}
+
+// a - b for a >= b
+limbs sub(const limbs &a, const limbs &b)
+{
+    limbs r(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        int64_t t = int64_t(a[i]) - borrow - (i < b.size() ? b[i] : 0);
+        borrow = t < 0;
+        r[i] = uint32_t(t);
+    }
+    trim(r);
+    return r;
+}
+
+limbs mul(const limbs &a, const limbs &b)
+{
+    if (a.empty() || b.empty()) return limbs();
+    limbs r(a.size() + b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); j++) {
+            carry += r[i + j] + uint64_t(a[i]) * b[j];
+            r[i + j] = uint32_t(carry);
+            carry >>= 32;
+        }
+        r[i + b.size()] = uint32_t(carry);
+    }
+    trim(r);
+    return r;
+}
+
+// q = u / v, r = u % v for v != 0 (Knuth, algorithm D)
+void divide(const limbs &u, const limbs &v, limbs &q, limbs &r)
+{
+    if (compare(u, v) < 0) {
+        q.clear();
+        r = u;
+        return;
+    }
+
+    size_t n = v.size(), m = u.size();
+    if (n == 1) {
+        uint64_t rem = 0;
+        q.assign(m, 0);
+        for (size_t j = m; j-- > 0;) {
+            uint64_t cur = (rem << 32) | u[j];
+            q[j] = uint32_t(cur / v[0]);
+            rem = cur % v[0];
+        }
+        trim(q);
+        r.clear();
+        if (rem) r.push_back(uint32_t(rem));
+        return;
+    }
+
+    // normalized so that the top limb of the divisor has its high bit set
+    int s = 0;
+    while (!(v[n - 1] << s & 0x80000000u)) s++;
+    auto shifted = [s](const limbs &a, size_t i) {
+        uint32_t lowbits = i > 0 && s ? uint32_t(uint64_t(a[i - 1]) >> (32 - s)) : 0;
+        return i < a.size() ? (a[i] << s) | lowbits : lowbits;
+    };
+    limbs vn(n), un(m + 1);
+    for (size_t i = 0; i < n; i++) vn[i] = shifted(v, i);
+    for (size_t i = 0; i <= m; i++) un[i] = shifted(u, i);
+
+    q.assign(m - n + 1, 0);
+    for (size_t j = m - n + 1; j-- > 0;) {
+        // estimate of the quotient digit, at most one too large after the correction
+        uint64_t top = (uint64_t(un[j + n]) << 32) | un[j + n - 1];
+        uint64_t qhat = top / vn[n - 1], rhat = top % vn[n - 1];
+        while (qhat >> 32 || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+            qhat--;
+            rhat += vn[n - 1];
+            if (rhat >> 32) break;
+        }
+
+        // un[j..j+n] -= qhat * vn
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t p = qhat * vn[i] + carry;
+            carry = p >> 32;
+            int64_t t = int64_t(un[i + j]) - borrow - int64_t(p & 0xffffffffu);
+            un[i + j] = uint32_t(t);
+            borrow = t < 0;
+        }
+        int64_t t = int64_t(un[j + n]) - borrow - int64_t(carry);
+        un[j + n] = uint32_t(t);
+
+        q[j] = uint32_t(qhat);
+        if (t < 0) {
+            // one too many: add the divisor back
+            q[j]--;
+            uint64_t c = 0;
+            for (size_t i = 0; i < n; i++) {
+                c += uint64_t(un[i + j]) + vn[i];
+                un[i + j] = uint32_t(c);
+                c >>= 32;
+            }
+            un[j + n] += uint32_t(c);
+        }
+    }
+
+    r.assign(n, 0);
+    for (size_t i = 0; i < n; i++) r[i] = (un[i] >> s) | (s ? uint32_t(uint64_t(un[i + 1]) << (32 - s)) : 0);
+    trim(q);
+    trim(r);
+}
+
+bigint operator*(const bigint &a, const bigint &b)
+{
+    bigint r;
+    r.m = mul(a.m, b.m);
+    r.negative = !r.zero() && a.negative != b.negative;
+    return r;
+}
+
+bigint operator+(const bigint &a, const bigint &b)
+{
+    bigint r;
+    if (a.negative == b.negative) {
+        r.m = add(a.m, b.m);
+        r.negative = a.negative;
+    }
+    else if (compare(a.m, b.m) >= 0) {
+        r.m = sub(a.m, b.m);
+        r.negative = a.negative;
+    }
+    else {
+        r.m = sub(b.m, a.m);
+        r.negative = b.negative;
+    }
+    if (r.zero()) r.negative = false;
+    return r;
+}
+
+// truncating division
+bigint operator/(const bigint &a, const bigint &b)
+{
+    bigint q;
+    limbs r;
+    divide(a.m, b.m, q.m, r);
+    q.negative = !q.zero() && a.negative != b.negative;
+    return q;
+}
+
+// of the magnitudes
+limbs gcd(limbs a, limbs b)
+{
+    limbs q, r;
+    while (!b.empty()) {
+        divide(a, b, q, r);
+        a.swap(b);
+        b.swap(r);
+    }
+    return a;
+}
+
+// a * f + c for small f and c
+void mulAdd(limbs &a, uint32_t f, uint32_t c)
+{
+    uint64_t carry = c;
+    for (auto &l : a) {
+        carry += uint64_t(l) * f;
+        l = uint32_t(carry);
+        carry >>= 32;
+    }
+    if (carry) a.push_back(uint32_t(carry));
+}
+
+bigint pow10(int n)
+{
+    bigint r(1);
+    for (; n >= 9; n -= 9) mulAdd(r.m, 1000000000u, 0);
+    static const uint32_t small[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+    mulAdd(r.m, small[n], 0);
+    return r;
+}
+
+void appendBig(std::string &s, const bigint &a)
+{
+    // base 10^9 digits from the least significant
+    std::vector<uint32_t> chunks;
+    limbs m = a.m;
+    while (!m.empty()) {
+        uint64_t rem = 0;
+        for (size_t j = m.size(); j-- > 0;) {
+            uint64_t cur = (rem << 32) | m[j];
+            m[j] = uint32_t(cur / 1000000000u);
+            rem = cur % 1000000000u;
+        }
+        trim(m);
+        chunks.push_back(uint32_t(rem));
+    }
+
+    if (a.negative) s += '-';
+    if (chunks.empty()) s += '0';
+    for (size_t i = chunks.size(); i-- > 0;) {
+        std::string c = std::to_string(chunks[i]);
+        if (i + 1 < chunks.size()) s.append(9 - c.size(), '0');
+        s += c;
+    }
+}
+
+// |a| approximately as m * 2^e, from the top three limbs
+double scaled(const bigint &a, int &e)
+{
+    size_t used = std::min<size_t>(a.m.size(), 3);
+    double m = 0;
+    for (size_t i = 0; i < used; i++) m = m * 4294967296.0 + a.m[a.m.size() - 1 - i];
+    e = int(32 * (a.m.size() - used));
+    return m;
+}
+
+void appendInt(std::string &s, int64_t v)
+{
+    char buf[24], *p = buf + sizeof(buf);
+    uint64_t u = v < 0 ? 0 - uint64_t(v) : uint64_t(v);
+    do { *--p = char('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) *--p = '-';
+    s.append(p, buf + sizeof(buf) - p);
+}
+
+}
+
+
+struct rational::big_value {
+    bigint num, den;        // den > 0
+};
+
+rational rational::fromBig(big_value &&v)
+{
+    if (v.den.zero()) throw error("division by zero");
+    if (v.den.negative) {
+        v.den.negative = false;
+        v.num.negative = !v.num.zero() && !v.num.negative;
+    }
+
+    limbs g = gcd(v.num.m, v.den.m);
+    if (!(g.size() == 1 && g[0] == 1) && !g.empty()) {
+        bigint gb;
+        gb.m = std::move(g);
+        v.num = v.num / gb;
+        v.den = v.den / gb;
+    }
+
+    if (v.num.fits() && v.den.fits()) {
+        rational r;
+        r.num = v.num.value();
+        r.den = v.den.value();
+        return r;
+    }
+    if (v.num.bits() > max_bits || v.den.bits() > max_bits) throw error("rational number too large");
+    return rational(std::make_shared<const big_value>(std::move(v)));
+}
+
+rational::big_value rational::toBig() const
+{
+    if (big) return *big;
+    return big_value{ bigint(num), bigint(den) };
+}
+
+rational rational::fraction(int64_t n, int64_t d)
+{
+    if (d == 0) throw error("division by zero");
+    if (n == int64_min || d == int64_min) return fromBig(big_value{ bigint(n), bigint(d) });
+    if (d < 0) { n = -n; d = -d; }
+    int64_t g = gcd(n < 0 ? -n : n, d);
+    rational r;
+    r.num = n / g;
+    r.den = d / g;
+    return r;
+}
+
+bool rational::integer() const
+{
+    return big ? big->den.m.size() == 1 && big->den.m[0] == 1 : den == 1;
+}
+
+int rational::sign() const
+{
+    if (big) return big->num.negative ? -1 : 1;
+    return num < 0 ? -1 : num > 0;
+}
+
+std::string rational::numerator() const
+{
+    std::string s;
+    if (big) appendBig(s, big->num);
+    else appendInt(s, num);
+    return s;
+}
+
+std::string rational::denominator() const
+{
+    std::string s;
+    if (big) appendBig(s, big->den);
+    else appendInt(s, den);
+    return s;
+}
+
+rational::operator double() const
+{
+    if (!big) return double(num) / double(den);
+    int en, ed;
+    double mn = scaled(big->num, en), md = scaled(big->den, ed);
+    return (big->num.negative ? -1 : 1) * std::ldexp(mn / md, en - ed);
+}
+
+void rational::appendTo(std::string &s) const
+{
+    if (big) {
+        appendBig(s, big->num);
+        if (!integer()) {
+            s += '/';
+            appendBig(s, big->den);
+        }
+        return;
+    }
+    appendInt(s, num);
+    if (den != 1) {
+        s += '/';
+        appendInt(s, den);
+    }
+}
+
+rational& rational::operator+=(const rational &b)
+{
+    if (!big && !b.big) {
+        // over the least common denominator
+        int64_t g = gcd(den, b.den), n1, n2, n, d;
+        if (!mulOverflow(num, b.den / g, n1) && !mulOverflow(b.num, den / g, n2) &&
+            !addOverflow(n1, n2, n) && !mulOverflow(den / g, b.den, d) && n != int64_min) {
+            int64_t r = gcd(n < 0 ? -n : n, d);
+            num = n / r;
+            den = d / r;
+            return *this;
+        }
+    }
+    auto x = toBig(), y = b.toBig();
+    return *this = fromBig(big_value{ x.num * y.den + y.num * x.den, x.den * y.den });
+}
+
+rational& rational::operator*=(const rational &b)
+{
+    if (!big && !b.big) {
+        // cross-cancelled first, so the result is reduced
+        int64_t g1 = gcd(num < 0 ? -num : num, b.den), g2 = gcd(b.num < 0 ? -b.num : b.num, den);
+        int64_t n, d;
+        if (!mulOverflow(num / g1, b.num / g2, n) && !mulOverflow(den / g2, b.den / g1, d) && n != int64_min) {
+            num = n;
+            den = d;
+            return *this;
+        }
+    }
+    auto x = toBig(), y = b.toBig();
+    return *this = fromBig(big_value{ x.num * y.num, x.den * y.den });
+}
+
+rational& rational::operator/=(const rational &b)
+{
+    if (b.sign() == 0) throw error("division by zero");
+
+    rational reciprocal;
+    if (b.big) reciprocal = fromBig(big_value{ b.big->den, b.big->num });
+    else {
+        reciprocal.num = b.num < 0 ? -b.den : b.den;
+        reciprocal.den = b.num < 0 ? -b.num : b.num;
+    }
+    return *this *= reciprocal;
+}
+
+rational rational::operator-() const
+{
+    if (!big) {
+        rational r;
+        r.num = -num;
+        r.den = den;
+        return r;
+    }
+    auto v = *big;
+    v.num.negative = !v.num.negative;
+    return rational(std::make_shared<const big_value>(std::move(v)));
+}
+
+bool operator==(const rational &a, const rational &b)
+{
+    // the representation is unique
+    if (!a.big && !b.big) return a.num == b.num && a.den == b.den;
+    if (!a.big || !b.big) return false;
+    return a.big->num.negative == b.big->num.negative && a.big->num.m == b.big->num.m && a.big->den.m == b.big->den.m;
+}
+
+bool operator<(const rational &a, const rational &b)
+{
+    int64_t l, r;
+    if (!a.big && !b.big && !mulOverflow(a.num, b.den, l) && !mulOverflow(b.num, a.den, r)) return l < r;
+
+    auto x = a.toBig(), y = b.toBig();
+    bigint d = x.num * y.den + bigint(-1) * (y.num * x.den);
+    return d.negative;
+}
+
+bool rational::parse(const char *first, const char *last, rational &value)
+{
+    std::string digits;     // significant digits
+    long exponent = 0;      // of the last of them
+    const char *p = first;
+    bool any = false;
+
+    for (; p != last && isDigit(*p); p++) {
+        any = true;
+        if (!digits.empty() || *p != '0') digits += *p;
+    }
+    if (p != last && *p == '.') {
+        for (p++; p != last && isDigit(*p); p++) {
+            any = true;
+            if (!digits.empty() || *p != '0') digits += *p;
+            exponent--;
+        }
+    }
+    if (!any) return false;
+
+    if (p != last && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative = p != last && *p == '-';
+        if (p != last && (*p == '-' || *p == '+')) p++;
+        if (p == last || !isDigit(*p)) return false;
+        long e = 0;
+        for (; p != last && isDigit(*p); p++) e = std::min(e * 10 + (*p - '0'), 1000000L);
+        exponent += negative ? -e : e;
+    }
+    if (p != last) return false;
+
+    if (digits.empty()) {
+        value = rational();
+        return true;
+    }
+
+    // trailing zeros only scale
+    while (digits.size() > 1 && digits.back() == '0') {
+        digits.pop_back();
+        exponent++;
+    }
+
+    if (digits.size() <= 18 && exponent > -19 && exponent < 19) {
+        int64_t n = std::stoll(digits), scale = 1;
+        for (long i = 0; i < (exponent < 0 ? -exponent : exponent); i++) scale *= 10;
+        if (exponent < 0) {
+            value = fraction(n, scale);
+            return true;
+        }
+        if (!mulOverflow(n, scale, n)) {
+            value = rational(n);
+            return true;
+        }
+    }
+
+    // 10^e has about 3.3 e bits
+    if (double(digits.size()) + double(exponent < 0 ? -exponent : exponent) > max_bits / 3.33) return false;
+
+    bigint n;
+    for (size_t i = 0; i < digits.size(); i += 9) {
+        size_t k = std::min<size_t>(9, digits.size() - i);
+        mulAdd(n.m, uint32_t(pow10(int(k)).value()), uint32_t(std::stoul(digits.substr(i, k))));
+    }
+    bigint s = pow10(int(exponent < 0 ? -exponent : exponent));
+    try {
+        value = exponent < 0 ? fromBig(big_value{ n, s }) : fromBig(big_value{ n * s, bigint(1) });
+    }
+    catch (error &) {
+        return false;
+    }
+    return true;
+}
+
+rational log(const rational &a)
+{
+    if (a == 1) return 0;
+    throw rational::error("inexact log not allowed in rational arithmetic");
+}
+
+namespace {
+
+// r with r^q = v for v >= 0, if there is one
+bool exactRoot(int64_t v, int64_t q, int64_t &r)
+{
+    if (v < 2 || q == 1) {
+        r = v;
+        return true;
+    }
+    int64_t guess = std::llround(std::pow(double(v), 1.0 / double(q)));
+    for (int64_t c = std::max<int64_t>(guess - 1, 1); c <= guess + 1; c++) {
+        int64_t p = 1;
+        bool over = false;
+        for (int64_t i = 0; i < q && !over; i++) over = mulOverflow(p, c, p) || p > v;
+        if (!over && p == v) {
+            r = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+rational pow(const rational &a, const rational &b)
+{
+    const char *inexact = "inexact power not allowed in rational arithmetic";
+
+    if (!b.integer()) {
+        // a^(p/q) = (a^(1/q))^p when the q-th roots are integers
+        if (!a.inlined() || !b.inlined()) throw rational::error(inexact);
+        int64_t q = std::stoll(b.denominator()), p = std::stoll(b.numerator());
+        int64_t n = std::stoll(a.numerator()), d = std::stoll(a.denominator()), rn, rd;
+        bool odd = q % 2 != 0;
+        if ((n < 0 && !odd) || q > 64 || !exactRoot(n < 0 ? -n : n, q, rn) || !exactRoot(d, q, rd)) throw rational::error(inexact);
+        return pow(rational::fraction(n < 0 ? -rn : rn, rd), rational(p));
+    }
+
+    if (a == 0) {
+        if (b.sign() < 0) throw rational::error("division by zero");
+        return b.sign() == 0 ? 1 : 0;
+    }
+    if (a == 1) return 1;
+    if (a == -1) {
+        std::string n = b.numerator();
+        return (n.back() - '0') % 2 ? -1 : 1;
+    }
+
+    // the result would have at least |b| bits
+    if (!b.inlined()) throw rational::error("rational number too large");
+    int64_t n = std::stoll(b.numerator());
+    uint64_t m = n < 0 ? 0 - uint64_t(n) : uint64_t(n);
+    if (m > rational::max_bits) throw rational::error("rational number too large");
+
+    rational r = 1, f = a;
+    for (;;) {
+        if (m & 1) r *= f;
+        m >>= 1;
+        if (!m) break;
+        f *= f;
+    }
+    return n < 0 ? 1 / r : r;
+}
+
+std::ostream& operator<<(std::ostream &os, const rational &value)
+{
+    std::string s;
+    value.appendTo(s);
+    return os << s;
+}
+
+std::istream& operator>>(std::istream &is, rational &value)
+{
+    std::istream::sentry s(is);
+    if (!s) return is;
+
+    // [sign] literal [/ literal]
+    auto literal = [&is](std::string &t) {
+        for (int c = is.peek(); c != std::char_traits<char>::eof(); c = is.peek()) {
+            bool exponentSign = (c == '-' || c == '+') && !t.empty() && (t.back() == 'e' || t.back() == 'E');
+            if (!exponentSign && !isDigit(char(c)) && c != '.' && c != 'e' && c != 'E') break;
+            t += char(is.get());
+        }
+    };
+
+    std::string text[2];
+    bool negative = is.peek() == '-';
+    if (negative || is.peek() == '+') is.get();
+    literal(text[0]);
+    if (is.peek() == '/') {
+        is.get();
+        literal(text[1]);
+    }
+
+    rational n, d = 1;
+    if (!rational::parse(text[0].data(), text[0].data() + text[0].size(), n) ||
+        (!text[1].empty() && (!rational::parse(text[1].data(), text[1].data() + text[1].size(), d) || d == 0))) {
+        is.setstate(std::ios::failbit);
+        return is;
+    }
+    value = negative ? -(n / d) : n / d;
+    return is;
+}
@@ -0,0 +1,150 @@
+#ifndef RATIONAL_H
+#define RATIONAL_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <limits>
+#include <istream>
+#include <ostream>
+#include <exception>
+
+#include "numbers.h"
+
+/*
+   exact rational numbers
+   a value is kept reduced with a positive denominator. While the numerator and denominator
+   fit, they are two inline 64-bit integers and the arithmetic on them is overflow checked;
+   a result that does not fit is promoted to arbitrary precision integers in a shared
+   immutable block, and demoted again once it fits, so the common case does no allocation.
+   Number literals are exact (0.1 is 1/10). Integer powers are exact, and so are the other
+   powers whose roots are rational ((9/4)^0.5 = 3/2); log (except of 1), the remaining powers
+   and results beyond max_bits throw rational::error, which the parser reports at the operator.
+   It is a number type for affine<T>, parser<T> and sparse_system<T>, whose equations are then
+   solved exactly: x/3 = 1/7 gives x = 3/7.
+*/
+
+class rational {
+public:
+    struct error : public std::exception {
+        const std::string msg;
+        error(const std::string & im) :msg(im) {};
+
+        virtual const char* what() const throw()
+        {
+            return msg.c_str();
+        }
+    };
+
+    // the largest numerator or denominator, in bits
+    static const size_t max_bits = 1 << 16;
+
+    rational() : num(0), den(1) {};
+    rational(int64_t n) : num(n), den(1) { if (n == std::numeric_limits<int64_t>::min()) *this = fraction(n, 1); };
+
+    // n/d reduced; throws on d == 0
+    static rational fraction(int64_t n, int64_t d);
+
+    // exactly, as parseNumber; false on a syntax error or a literal beyond max_bits
+    static bool parse(const char *first, const char *last, rational &value);
+
+    bool inlined() const { return !big; };
+    bool integer() const;
+    int sign() const;
+    std::string numerator() const;
+    std::string denominator() const;
+
+    // the nearest double, approximately
+    explicit operator double() const;
+
+    // 'n' or 'n/d'
+    void appendTo(std::string &s) const;
+
+    rational& operator+=(const rational &b);
+    rational& operator-=(const rational &b) { return *this += -b; };
+    rational& operator*=(const rational &b);
+    rational& operator/=(const rational &b);
+
+    rational operator-() const;
+
+    friend bool operator==(const rational &a, const rational &b);
+    friend bool operator<(const rational &a, const rational &b);
+
+private:
+    struct big_value;
+
+    explicit rational(std::shared_ptr<const big_value> b) : num(0), den(1), big(std::move(b)) {};
+    static rational fromBig(big_value &&v);
+    big_value toBig() const;
+
+    int64_t num, den;                       // when big is null
+    std::shared_ptr<const big_value> big;
+};
+
+inline rational operator+(rational a, const rational &b) { return a += b; }
+inline rational operator-(rational a, const rational &b) { return a -= b; }
+inline rational operator*(rational a, const rational &b) { return a *= b; }
+inline rational operator/(rational a, const rational &b) { return a /= b; }
+
+inline bool operator!=(const rational &a, const rational &b) { return !(a == b); }
+inline bool operator>(const rational &a, const rational &b) { return b < a; }
+inline bool operator<=(const rational &a, const rational &b) { return !(b < a); }
+inline bool operator>=(const rational &a, const rational &b) { return !(a < b); }
+
+inline rational abs(const rational &a) { return a.sign() < 0 ? -a : a; }
+
+// 0 for 1, else throws
+rational log(const rational &a);
+// exact powers only, see above
+rational pow(const rational &a, const rational &b);
+
+inline bool parseNumber(const char *first, const char *last, rational &value)
+{
+    return rational::parse(first, last, value);
+}
+
+// 'n' or 'n/d'
+std::ostream& operator<<(std::ostream &os, const rational &value);
+// an optionally signed literal, optionally followed by '/' and another one
+std::istream& operator>>(std::istream &is, rational &value);
+
+inline void appendNumber(std::string &s, const rational &value)
+{
+    value.appendTo(s);
+}
+
+template<>
+struct atom_traits<rational> : atom_arithmetic<rational> {
+    static bool number(const char *first, const char *last, rational &value) {
+        return rational::parse(first, last, value);
+    }
+
+    static bool variable(const char *, size_t, rational &) { return false; }
+
+    static void print(std::ostream &os, const rational &value) { os << value; }
+};
+
+namespace std {
+
+template<>
+class numeric_limits<rational> {
+public:
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool is_exact = true;
+    static constexpr bool has_infinity = false;
+    static constexpr bool has_quiet_NaN = false;
+    static constexpr bool has_signaling_NaN = false;
+    static constexpr bool is_bounded = false;
+    static constexpr int radix = 2;
+    static constexpr int digits = 0;
+    static constexpr int digits10 = 0;
+
+    static rational epsilon() noexcept { return 0; }
+    static rational round_error() noexcept { return 0; }
+};
+
+}
+
+#endif
@@ -0,0 +1,387 @@
+#include <string>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+#include "server.h"
+
+#ifdef __linux__
+
+namespace {
+
+const uint64_t listen_id = 0;           // epoll data of the listening socket
+const uint64_t wake_id = 1;             // and of the eventfd; connections count from 2
+
+const size_t max_jobs = 64;             // jobs of a connection in the pool before it is not read from
+const size_t max_unsent = 1 << 20;      // unsent bytes of a connection before it is not read from
+
+// sink appending stdout and stderr text to one string
+class append_sink : public output_sink {
+public:
+    explicit append_sink(std::string &is) : s(is) {};
+
+    void write(bool, const char *p, size_t n) override { s.append(p, n); };
+    void flush() override {};
+
+private:
+    std::string &s;
+};
+
+// answers of a block of lines: "<bytes>\n<text>" per line; the last line may lack its newline
+void answerLines(const char *s, size_t n, size_t worker, const line_handler &handler, std::string &out, size_t &lines)
+{
+    block_output text;
+    append_sink sink(out);
+    const char *e = s + n;
+
+    lines = 0;
+    while (s < e) {
+        const char *eol = s;
+        while (eol < e && *eol != '\n') eol++;
+        if (eol > s) handler(s, eol - s, worker, text);
+        out += std::to_string(text.size());
+        out += '\n';
+        text.flush_to(sink);
+        lines++;
+        s = eol + 1;
+    }
+}
+
+}
+
+
+server::server(const server_options &options, const line_handler &ihandler) : handler(ihandler), max_line(options.max_line)
+{
+    if (!options.unix_path.empty()) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (options.unix_path.size() >= sizeof(addr.sun_path)) throw error("socket path too long: " + options.unix_path);
+        memcpy(addr.sun_path, options.unix_path.data(), options.unix_path.size());
+
+        // a socket left behind by a previous server is replaced, other files are not touched
+        struct stat st;
+        if (stat(options.unix_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(options.unix_path.c_str());
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            release();
+            throw error("unable to listen on " + options.unix_path + ": " + strerror(errno));
+        }
+        unix_path = options.unix_path;
+    }
+    else {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(uint16_t(options.tcp_port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        int one = 1;
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd >= 0) setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            release();
+            throw error("unable to listen on port " + std::to_string(options.tcp_port) + ": " + strerror(errno));
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+        tcp_port = ntohs(addr.sin_port);
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = listen_id;
+    bool ok = listen(listen_fd, SOMAXCONN) == 0 && epoll_fd >= 0 && wake_fd >= 0 &&
+              epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == 0;
+    ev.data.u64 = wake_id;
+    if (!ok || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) != 0) {
+        std::string msg = strerror(errno);
+        release();
+        throw error("unable to start the server: " + msg);
+    }
+
+    pool.reset(new thread_pool(options.threads));
+}
+
+server::~server()
+{
+    pool.reset();
+    release();
+}
+
+void server::release()
+{
+    for (auto &c : conns) ::close(c.second->fd);
+    conns.clear();
+    if (listen_fd >= 0) ::close(listen_fd);
+    if (epoll_fd >= 0) ::close(epoll_fd);
+    if (wake_fd >= 0) ::close(wake_fd);
+    listen_fd = epoll_fd = wake_fd = -1;
+    if (!unix_path.empty()) unlink(unix_path.c_str());
+    unix_path.clear();
+}
+
+void server::stop()
+{
+    stopping = true;
+    uint64_t one = 1;
+    ssize_t r = write(wake_fd, &one, sizeof(one));
+    (void)r;
+}
+
+server::statistics server::stats() const
+{
+    return { n_connections.load(), n_requests.load(), n_in.load(), n_out.load() };
+}
+
+void server::run()
+{
+    epoll_event events[64];
+
+    while (!stopping) {
+        int n = epoll_wait(epoll_fd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw error(std::string("epoll_wait failed: ") + strerror(errno));
+        }
+
+        for (int i = 0; i < n; i++) {
+            uint64_t id = events[i].data.u64;
+            if (id == listen_id) {
+                accept();
+                continue;
+            }
+            if (id == wake_id) {
+                uint64_t count;
+                ssize_t r = read(wake_fd, &count, sizeof(count));
+                (void)r;
+                collect();
+                continue;
+            }
+
+            auto c = conns.find(id);
+            if (c == conns.end()) continue;     // closed by an earlier event of this round
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close(id);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+                receive(id, *c->second);
+                c = conns.find(id);
+                if (c == conns.end()) continue;
+            }
+            if (events[i].events & EPOLLOUT) send(id, *c->second);
+        }
+    }
+}
+
+void server::accept()
+{
+    for (;;) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;     // no more pending connections (or out of descriptors: retried on the next event)
+        }
+        if (tcp_port >= 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        uint64_t id = next_id++;
+        epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u64 = id;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            ::close(fd);
+            continue;
+        }
+        std::unique_ptr<connection> c(new connection);
+        c->fd = fd;
+        conns.emplace(id, std::move(c));
+        n_connections++;
+    }
+}
+
+// read what the client has sent; the complete lines of every read are one job
+void server::receive(uint64_t id, connection &c)
+{
+    char buf[64 * 1024];
+
+    while (c.submitted - c.written < max_jobs && c.out.size() - c.sent < max_unsent) {
+        ssize_t r = read(c.fd, buf, sizeof(buf));
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close(id);
+            return;
+        }
+        if (r == 0) {
+            c.eof = true;
+            if (!c.in.empty()) submit(id, c, std::move(c.in));     // last line without a newline
+            break;
+        }
+
+        n_in += r;
+        size_t last = size_t(r);
+        while (last > 0 && buf[last - 1] != '\n') last--;
+        if (last == 0) {
+            c.in.append(buf, r);
+        }
+        else {
+            std::string lines = std::move(c.in);
+            lines.append(buf, last);
+            c.in.assign(buf + last, r - last);
+            submit(id, c, std::move(lines));
+        }
+
+        // a line that does not end: drop the client instead of buffering it
+        if (c.in.size() > max_line) {
+            close(id);
+            return;
+        }
+    }
+
+    update(id, c);
+}
+
+void server::submit(uint64_t id, connection &c, std::string &&lines)
+{
+    uint64_t job = c.submitted++;
+
+    pool->submit([this, id, job, lines](size_t worker) {
+        answer a{ id, job, std::string(), 0 };
+        answerLines(lines.data(), lines.size(), worker, handler, a.text, a.lines);
+
+        bool first;
+        {
+            std::lock_guard<std::mutex> lock(answers_m);
+            first = answers.empty();
+            answers.push_back(std::move(a));
+        }
+        // one wakeup for all answers queued before the event loop collects them
+        if (first) {
+            uint64_t one = 1;
+            ssize_t r = write(wake_fd, &one, sizeof(one));
+            (void)r;
+        }
+    });
+}
+
+// take the finished jobs and send their answers
+void server::collect()
+{
+    std::deque<answer> ready;
+    {
+        std::lock_guard<std::mutex> lock(answers_m);
+        ready.swap(answers);
+    }
+
+    std::vector<uint64_t> touched;
+    for (auto &a : ready) {
+        n_requests += a.lines;
+        auto c = conns.find(a.conn);
+        if (c == conns.end()) continue;     // the client is gone
+        c->second->finished.emplace(a.job, std::move(a.text));
+        touched.push_back(a.conn);
+    }
+
+    for (auto id : touched) {
+        auto c = conns.find(id);
+        if (c != conns.end()) send(id, *c->second);
+    }
+}
+
+// write the answers that are next in request order
+void server::send(uint64_t id, connection &c)
+{
+    if (c.sent > 0) {
+        c.out.erase(0, c.sent);
+        c.sent = 0;
+    }
+    for (auto i = c.finished.begin(); i != c.finished.end() && i->first == c.written; i = c.finished.erase(i)) {
+        if (c.out.empty()) c.out = std::move(i->second);
+        else               c.out += i->second;
+        c.written++;
+    }
+
+    while (c.sent < c.out.size()) {
+        ssize_t w = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close(id);
+            return;
+        }
+        c.sent += w;
+        n_out += w;
+    }
+    if (c.sent == c.out.size()) {
+        c.out.clear();
+        c.sent = 0;
+    }
+
+    update(id, c);
+}
+
+// epoll interest of a connection: read unless it has too much work pending, write while output is left
+// (level-triggered, so lines left unread while it was busy are reported again); closed once the
+// client is done and everything is answered
+void server::update(uint64_t id, connection &c)
+{
+    if (c.eof && c.submitted == c.written && c.out.empty()) {
+        close(id);
+        return;
+    }
+
+    bool reading = !c.eof && c.submitted - c.written < max_jobs && c.out.size() - c.sent < max_unsent;
+    bool writing = c.sent < c.out.size();
+    if (reading == c.reading && writing == c.writing) return;
+
+    epoll_event ev;
+    ev.events = (reading ? uint32_t(EPOLLIN | EPOLLRDHUP) : 0u) | (writing ? uint32_t(EPOLLOUT) : 0u);
+    ev.data.u64 = id;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+    c.reading = reading;
+    c.writing = writing;
+}
+
+void server::close(uint64_t id)
+{
+    auto c = conns.find(id);
+    ::close(c->second->fd);     // also removes it from the epoll set
+    conns.erase(c);
+}
+
+#else
+
+server::server(const server_options &, const line_handler &ihandler) : handler(ihandler)
+{
+    throw error("the server mode is not supported on this platform");
+}
+
+server::~server() {}
+void server::release() {}
+void server::run() {}
+void server::stop() {}
+
+server::statistics server::stats() const
+{
+    return { n_connections.load(), n_requests.load(), n_in.load(), n_out.load() };
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <cstdint>
+
+#include "batch.h"
+#include "thread_pool.h"
+
+/*
+   long-running calculator server (Linux)
+   Clients connect to a Unix domain socket or to a TCP port on localhost and send lines. Every
+   line is answered with the text the calculator prints for it - results and error reports
+   merged in order - framed as the decimal byte count of the text, a newline and the text
+   itself; empty lines get an empty answer ("0\n"). Clients may pipeline any number of lines
+   without waiting for the answers, which always come back in request order.
+   One thread runs an epoll event loop over the listening socket and the connections. The
+   complete lines of every read are handed to the thread pool as one job; finished jobs are
+   passed back to the event loop, which writes them out in order. A connection with too much
+   unsent output is not read from until its client catches up; a client sending a line longer
+   than max_line bytes is disconnected.
+*/
+
+struct server_options {
+    std::string unix_path;      // path of the Unix domain socket, or
+    int         tcp_port = -1;  // TCP port on 127.0.0.1 (0 = any free port)
+    size_t      threads = 1;    // worker threads evaluating the lines
+    size_t      max_line = size_t(1) << 20; // longest line kept while waiting for its newline
+};
+
+class server {
+public:
+    struct error : public std::exception {
+        const std::string msg;
+        error(const std::string & im) :msg(im) {};
+
+        virtual const char* what() const throw()
+        {
+            return msg.c_str();
+        }
+    };
+
+    struct statistics {
+        uint64_t connections;   // accepted so far
+        uint64_t requests;      // lines answered
+        uint64_t bytes_in, bytes_out;
+    };
+
+    // listen on the socket of the options; 'handler' processes the lines on the worker threads
+    server(const server_options &options, const line_handler &handler);
+    ~server();
+
+    server(const server&) = delete;
+    server& operator = (const server&) = delete;
+
+    // TCP port listened on (-1 for a Unix socket)
+    int port() const { return tcp_port; };
+
+    // serve clients until stop() is called
+    void run();
+
+    // make run() return; can be called from any thread or a signal handler
+    void stop();
+
+    statistics stats() const;
+
+private:
+    struct connection {
+        int         fd;
+        std::string in;             // received bytes after the last complete line
+        uint64_t    submitted = 0;  // jobs handed to the pool
+        uint64_t    written = 0;    // jobs whose answers are in 'out'
+        std::map<uint64_t, std::string> finished;  // answers waiting for their predecessors
+        std::string out;            // answers being sent
+        size_t      sent = 0;       // bytes of 'out' already sent
+        bool        eof = false;    // the client has shut down its side
+        bool        reading = true; // EPOLLIN is enabled
+        bool        writing = false;// EPOLLOUT is enabled
+    };
+
+    struct answer {
+        uint64_t    conn;
+        uint64_t    job;
+        std::string text;
+        size_t      lines;
+    };
+
+    line_handler handler;
+    std::string  unix_path;
+    int          tcp_port = -1;
+    size_t       max_line = 0;
+    int          listen_fd = -1;
+    int          epoll_fd = -1;
+    int          wake_fd = -1;          // eventfd: answers are ready or stop() was called
+    std::atomic<bool> stopping{ false };
+
+    std::unordered_map<uint64_t, std::unique_ptr<connection>> conns;   // by id
+    uint64_t next_id = 2;               // 0 and 1 are the listening socket and the eventfd
+
+    std::mutex         answers_m;
+    std::deque<answer> answers;         // finished jobs, guarded by answers_m
+
+    std::atomic<uint64_t> n_connections{ 0 }, n_requests{ 0 }, n_in{ 0 }, n_out{ 0 };
+
+    std::unique_ptr<thread_pool> pool;  // destroyed first: running jobs post their answers
+
+    void accept();
+    void receive(uint64_t id, connection &c);
+    void submit(uint64_t id, connection &c, std::string &&lines);
+    void collect();
+    void send(uint64_t id, connection &c);
+    void update(uint64_t id, connection &c);
+    void close(uint64_t id);
+    void release();
+};
+
+#endif
@@ -0,0 +1,365 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <algorithm>
+#include <cassert>
+
+#include "lexer.h"
+#include "parser.h"
+#include "program.h"
+#include "affine.h"
+#include "arena.h"
+
+/*
+   worksheet of persistent definitions 'name = expression'
+   Every definition is compiled and optimized once (see program.h) and keeps its value as an affine expression
+   of the variables that are not defined. Other definitions and lines refer to it by name.
+   The definitions form a dependency graph: each node knows the nodes it reads (inputs) and the
+   nodes reading it (dependents). When a definition changes, only its dependents are evaluated
+   again, in topological order, and only those with an input whose value actually changed;
+   a recomputed value equal to the previous one stops the propagation.
+   A definition that would make a cycle is rejected, as is one that fails to evaluate; the
+   previous definition is kept. A dependent that fails on recomputation keeps the error, and
+   the definitions reading it fail until it evaluates again.
+   Values live on the heap, never in the arena of a line. Not thread-safe.
+*/
+
+template<typename T>
+class session {
+public:
+    using atom   = affine<T>;
+    using result = typename parser<atom>::result;
+    using error  = typename parser<atom>::error;
+
+    struct definition {
+        var_id      name;
+        std::string text;           // source line, for error reports
+        atom        value;
+        bool        failed = false;
+        std::string error_msg;
+        size_t      error_pos = 0;  // position of the error in 'text'
+    };
+
+    struct statistics {
+        uint64_t assignments;       // definitions made
+        uint64_t recomputed;        // dependents evaluated again after a change of their inputs
+        uint64_t unchanged;         // recomputations that gave the previous value
+        uint64_t last_recomputed;   // 'recomputed' by the last assignment
+        uint64_t eliminated;        // ops removed from the definitions by program<T>::optimize
+        size_t   definitions;       // names defined
+    };
+
+    // 'name = ...' with a single variable on the left side
+    static bool isAssignment(const std::vector<token_view> &tokens);
+
+    // define (or redefine) the variable on the left side and update its dependents;
+    // returns the dependents whose value or error changed, valid until the next call.
+    // Throws 'error' and leaves the session unchanged if the definition is rejected.
+    const std::vector<const definition*>& assign(const std::vector<token_view> &tokens, const char *s, size_t n);
+
+    // results of a line that is not an assignment, with the defined variables substituted
+    std::vector<result> evaluate(const std::vector<token_view> &tokens) const;
+
+    // definition of a variable or nullptr
+    const definition* find(const std::string &name) const;
+
+    statistics stats() const;
+
+private:
+    struct node {
+        definition          def;
+        bool                defined = false;
+        program<atom>       code;
+        std::vector<size_t> inputs;         // node of each variable slot of 'code'
+        std::vector<size_t> dependents;
+        uint64_t            visit = 0;      // traversal mark
+        bool                changed = false;
+    };
+
+    std::vector<node> nodes;
+    std::unordered_map<var_id, size_t> index;   // node of a variable
+    std::vector<const definition*> updates;
+    uint64_t traversal = 0;
+    statistics counters = {};
+
+    size_t nodeOf(var_id id);
+    bool   reaches(const std::vector<size_t> &from, size_t target);
+    void   bind(const program<atom> &p, const std::vector<size_t> &inputs, std::vector<atom> &values) const;
+    void   substitute(const program<atom> &p, std::vector<atom> &values) const;
+    program<atom> compile(const std::vector<token_view> &tokens) const;
+    void   recompute(size_t target);
+
+    static const token& use(const program<atom> &p, size_t slot);
+    static bool store(definition &d, const atom &value);
+    static bool fail(definition &d, const error &e);
+};
+
+//-------------------------------------------------------
+
+template<typename T>
+bool session<T>::isAssignment(const std::vector<token_view> &tokens)
+{
+    return tokens.size() > 2 && tokens[0].type == tok_t::id && tokens[0].kind != tok_kind::kw_log &&
+           tokens[1].kind == tok_kind::equal;
+}
+
+// node of a variable, created on first use; undefined variables stand for themselves
+template<typename T>
+size_t session<T>::nodeOf(var_id id)
+{
+    auto i = index.find(id);
+    if (i != index.end()) return i->second;
+
+    arena_scope persistent(nullptr);
+    nodes.emplace_back();
+    nodes.back().def.name = id;
+    nodes.back().def.value = atom(T(1), id);
+    index.emplace(id, nodes.size() - 1);
+    return nodes.size() - 1;
+}
+
+// true if 'target' is one of the nodes 'from' or their inputs, transitively
+template<typename T>
+bool session<T>::reaches(const std::vector<size_t> &from, size_t target)
+{
+    traversal++;
+    std::vector<size_t> work(from);
+    while (!work.empty()) {
+        size_t k = work.back();
+        work.pop_back();
+        if (k == target) return true;
+        if (nodes[k].visit == traversal) continue;
+        nodes[k].visit = traversal;
+        work.insert(work.end(), nodes[k].inputs.begin(), nodes[k].inputs.end());
+    }
+    return false;
+}
+
+// token of the first use of a variable slot
+template<typename T>
+const token& session<T>::use(const program<atom> &p, size_t slot)
+{
+    size_t pc = 0;
+    while (p.code[pc].code != op_t::push_var || p.code[pc].arg != slot) pc++;
+    return p.where[pc];
+}
+
+// values of the variable slots of 'p' from their nodes; a failed input is an error at its first use
+template<typename T>
+void session<T>::bind(const program<atom> &p, const std::vector<size_t> &inputs, std::vector<atom> &values) const
+{
+    values.clear();
+    values.reserve(inputs.size());
+    for (size_t slot = 0; slot < inputs.size(); slot++) {
+        auto &d = nodes[inputs[slot]].def;
+        if (d.failed) throw error(use(p, slot), "the definition of '" + p.vars[slot] + "' failed");
+        values.push_back(d.value);
+    }
+}
+
+// values of the variable slots of 'p' by name: the defined ones, the others stand for themselves
+template<typename T>
+void session<T>::substitute(const program<atom> &p, std::vector<atom> &values) const
+{
+    values.clear();
+    for (size_t slot = 0; slot < p.vars.size(); slot++) {
+        var_id id = symbol_table::intern(p.vars[slot]);
+        auto i = index.find(id);
+        if (i == index.end()) {
+            values.push_back(atom(T(1), id));
+            continue;
+        }
+        auto &d = nodes[i->second].def;
+        if (d.failed) throw error(use(p, slot), "the definition of '" + p.vars[slot] + "' failed");
+        values.push_back(d.value);
+    }
+}
+
+// compile a line; before a syntax error is reported, the ops compiled before it are evaluated,
+// so that an error of an operation the parser does first is reported as the parser does
+template<typename T>
+program<typename session<T>::atom> session<T>::compile(const std::vector<token_view> &tokens) const
+{
+    program<atom> code;
+    auto st = program<atom>::try_compile(tokens, code);
+    if (st.ok()) return code;
+
+    std::vector<atom> values;
+    substitute(code, values);
+    evaluator<atom> ev(code);
+    ev.run(values.data());
+    throw error(st.where, st.msg);
+}
+
+// set the value of a definition; false if it had the same value already
+template<typename T>
+bool session<T>::store(definition &d, const atom &value)
+{
+    if (!d.failed && d.value.d == value.d && d.value.x.size() == value.x.size() &&
+        std::equal(value.x.begin(), value.x.end(), d.value.x.begin())) return false;
+
+    arena_scope persistent(nullptr);
+    d.value = value;
+    d.failed = false;
+    d.error_msg.clear();
+    return true;
+}
+
+// set the error of a definition; false if it had the same error already
+template<typename T>
+bool session<T>::fail(definition &d, const error &e)
+{
+    if (d.failed && d.error_msg == e.msg && d.error_pos == e.t.pos) return false;
+
+    d.failed = true;
+    d.error_msg = e.msg;
+    d.error_pos = e.t.pos;
+    return true;
+}
+
+template<typename T>
+const std::vector<const typename session<T>::definition*>& session<T>::assign(const std::vector<token_view> &tokens, const char *s, size_t n)
+{
+    assert(isAssignment(tokens));
+
+    program<atom> code;
+    size_t eliminated;
+    {
+        // the program is kept; the right side must be one expression
+        arena_scope persistent(nullptr);
+        std::vector<token_view> rhs(tokens.begin() + 2, tokens.end());
+        code = compile(rhs);
+        if (code.results == 0) throw error(&tokens.back(), "missing operand");
+        for (size_t pc = 0; pc < code.code.size(); pc++) {
+            if (code.code[pc].code == op_t::result && (code.code[pc].arg != 0 || pc + 1 < code.code.size())) {
+                throw error(code.where[pc], "unexpected input");
+            }
+        }
+        eliminated = code.optimize().eliminated();
+    }
+
+    size_t target = nodeOf(symbol_table::intern(tokens[0].s, tokens[0].len));
+    std::vector<size_t> inputs;
+    for (auto &name : code.vars) inputs.push_back(nodeOf(symbol_table::intern(name)));
+
+    for (size_t slot = 0; slot < inputs.size(); slot++) {
+        if (reaches({ inputs[slot] }, target)) throw error(use(code, slot), "circular definition of '" + tokens[0].str() + "'");
+    }
+
+    std::vector<atom> values;
+    bind(code, inputs, values);
+    evaluator<atom> ev(code);
+    auto &r = ev.run(values.data());
+
+    // accepted - replace the definition of the node and its edges
+    auto &t = nodes[target];
+    for (size_t k : t.inputs) {
+        auto &d = nodes[k].dependents;
+        d.erase(std::find(d.begin(), d.end(), target));
+    }
+    for (size_t k : inputs) nodes[k].dependents.push_back(target);
+
+    {
+        arena_scope persistent(nullptr);
+        t.code = std::move(code);
+        t.inputs = std::move(inputs);
+        t.def.text.assign(s, n);
+    }
+    t.defined = true;
+    bool changed = store(t.def, r[0].atom);
+    counters.assignments++;
+    counters.eliminated += eliminated;
+
+    updates.clear();
+    counters.last_recomputed = 0;
+    if (changed) recompute(target);
+    return updates;
+}
+
+// evaluate the dependents of 'target' (whose value has changed) in topological order
+template<typename T>
+void session<T>::recompute(size_t target)
+{
+    // reverse postorder of a depth first search along the dependents
+    traversal++;
+    std::vector<size_t> order;
+    std::vector<std::pair<size_t, size_t>> work{ { target, 0 } };   // node, next dependent
+    nodes[target].visit = traversal;
+    while (!work.empty()) {
+        auto &w = work.back();
+        auto &deps = nodes[w.first].dependents;
+        if (w.second < deps.size()) {
+            size_t k = deps[w.second++];
+            if (nodes[k].visit != traversal) {
+                nodes[k].visit = traversal;
+                work.push_back({ k, 0 });
+            }
+        }
+        else {
+            order.push_back(w.first);
+            work.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+
+    for (size_t k : order) nodes[k].changed = false;
+    nodes[target].changed = true;
+
+    std::vector<atom> values;
+    for (size_t i = 1; i < order.size(); i++) {
+        auto &nd = nodes[order[i]];
+        bool dirty = false;
+        for (size_t k : nd.inputs) dirty |= nodes[k].changed;
+        if (!dirty) continue;
+
+        counters.recomputed++;
+        counters.last_recomputed++;
+        try {
+            bind(nd.code, nd.inputs, values);
+            evaluator<atom> ev(nd.code);
+            nd.changed = store(nd.def, ev.run(values.data())[0].atom);
+        }
+        catch (error &e) {
+            nd.changed = fail(nd.def, e);
+        }
+
+        if (nd.changed) updates.push_back(&nd.def);
+        else            counters.unchanged++;
+    }
+}
+
+template<typename T>
+std::vector<typename session<T>::result> session<T>::evaluate(const std::vector<token_view> &tokens) const
+{
+    auto code = compile(tokens);
+
+    // variables without a node are not defined and stand for themselves
+    std::vector<atom> values;
+    substitute(code, values);
+
+    evaluator<atom> ev(code);
+    return ev.run(values.data());
+}
+
+template<typename T>
+const typename session<T>::definition* session<T>::find(const std::string &name) const
+{
+    auto i = index.find(symbol_table::intern(name));
+    if (i == index.end() || !nodes[i->second].defined) return nullptr;
+    return &nodes[i->second].def;
+}
+
+template<typename T>
+typename session<T>::statistics session<T>::stats() const
+{
+    auto st = counters;
+    st.definitions = 0;
+    for (auto &n : nodes) st.definitions += n.defined;
+    return st;
+}
+
+#endif
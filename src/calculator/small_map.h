@@ -0,0 +1,188 @@
+#ifndef SMALL_MAP_H
+#define SMALL_MAP_H
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+/*
+   sorted flat map with inline storage
+   elements are (key, value) pairs kept sorted by key in a contiguous array;
+   the first N elements live inside the object, so small maps never touch the heap.
+   Larger storage comes from the allocator A; allocators that don't propagate (arena_allocator)
+   are handled like the standard containers do: copies select their own allocator and moves
+   between unequal allocators move the elements one by one
+*/
+
+template<typename K, typename V, size_t N, typename A = std::allocator<std::pair<K, V>>>
+class small_map {
+public:
+    using key_type       = K;
+    using mapped_type    = V;
+    using value_type     = std::pair<K, V>;
+    using iterator       = value_type*;
+    using const_iterator = const value_type*;
+    using allocator_type = A;
+
+    small_map() : small_map(A()) {};
+    explicit small_map(const A &a) : alloc(a), p(inline_data()), n(0), cap(N) {};
+    small_map(const small_map &m) : small_map(traits::select_on_container_copy_construction(m.alloc)) { assign(m); };
+    small_map(small_map &&m) noexcept : small_map(m.alloc) { steal(m); };
+    ~small_map() { clear(); release(); };
+
+    small_map& operator = (const small_map &m) {
+        if (this != &m) {
+            clear();
+            if (traits::propagate_on_container_copy_assignment::value && alloc != m.alloc) {
+                release();
+                alloc = m.alloc;
+            }
+            assign(m);
+        }
+        return *this;
+    }
+    small_map& operator = (small_map &&m) {
+        if (this != &m) {
+            clear();
+            if (traits::propagate_on_container_move_assignment::value || alloc == m.alloc) {
+                release();
+                if (traits::propagate_on_container_move_assignment::value) alloc = std::move(m.alloc);
+                steal(m);
+            }
+            else {
+                // memory of the other allocator can't be taken over
+                reserve(m.n);
+                for (size_t i = 0; i < m.n; i++) new (p + i) value_type(std::move(m.p[i]));
+                n = m.n;
+                m.clear();
+            }
+        }
+        return *this;
+    }
+
+    allocator_type get_allocator() const { return alloc; };
+
+    iterator       begin()       { return p; };
+    iterator       end()         { return p + n; };
+    const_iterator begin() const { return p; };
+    const_iterator end()   const { return p + n; };
+
+    size_t size()     const { return n; };
+    bool   empty()    const { return n == 0; };
+    size_t capacity() const { return cap; };
+    bool   is_inline() const { return p == inline_data(); };
+
+    value_type&       back()       { return p[n - 1]; };
+    const value_type& back() const { return p[n - 1]; };
+
+    void clear() {
+        for (size_t i = 0; i < n; i++) p[i].~value_type();
+        n = 0;
+    }
+
+    void reserve(size_t c) { if (c > cap) grow(c); };
+
+    iterator lower_bound(const K &k) {
+        return std::lower_bound(begin(), end(), k, [](const value_type &e, const K &k) {return e.first < k;});
+    }
+    const_iterator lower_bound(const K &k) const {
+        return std::lower_bound(begin(), end(), k, [](const value_type &e, const K &k) {return e.first < k;});
+    }
+    iterator find(const K &k) {
+        auto i = lower_bound(k);
+        return (i != end() && i->first == k) ? i : end();
+    }
+    const_iterator find(const K &k) const {
+        auto i = lower_bound(k);
+        return (i != end() && i->first == k) ? i : end();
+    }
+
+    V& operator[] (const K &k) {
+        auto i = lower_bound(k);
+        if (i == end() || i->first != k) i = insert(i, k, V{});
+        return i->second;
+    }
+
+    // insert before 'pos'; the caller keeps the keys sorted
+    iterator insert(iterator pos, const K &k, const V &v) {
+        size_t at = pos - p;
+        if (n == cap) grow(2 * cap);
+        if (at == n) {
+            new (p + n) value_type(k, v);
+        }
+        else {
+            new (p + n) value_type(std::move(p[n - 1]));
+            std::move_backward(p + at, p + n - 1, p + n);
+            p[at] = value_type(k, v);
+        }
+        n++;
+        return p + at;
+    }
+
+    // append at the end; the caller keeps the keys sorted
+    void push_back(const K &k, const V &v) {
+        if (n == cap) grow(2 * cap);
+        new (p + n) value_type(k, v);
+        n++;
+    }
+
+    iterator erase(iterator pos) {
+        std::move(pos + 1, end(), pos);
+        p[--n].~value_type();
+        return pos;
+    }
+
+private:
+    using storage = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
+    using traits  = std::allocator_traits<A>;
+
+    A           alloc;
+    value_type* p;      // points either to 'local' or to heap storage
+    size_t      n;
+    size_t      cap;
+    storage     local[N];
+
+    value_type*       inline_data()       { return reinterpret_cast<value_type*>(local); };
+    const value_type* inline_data() const { return reinterpret_cast<const value_type*>(local); };
+
+    void grow(size_t c) {
+        value_type *q = traits::allocate(alloc, c);
+        for (size_t i = 0; i < n; i++) {
+            new (q + i) value_type(std::move(p[i]));
+            p[i].~value_type();
+        }
+        release();
+        p = q;
+        cap = c;
+    }
+
+    // free heap storage (elements must be already destroyed)
+    void release() {
+        if (!is_inline()) traits::deallocate(alloc, p, cap);
+        p = inline_data();
+        cap = N;
+    }
+
+    void assign(const small_map &m) {
+        reserve(m.n);
+        for (size_t i = 0; i < m.n; i++) new (p + i) value_type(m.p[i]);
+        n = m.n;
+    }
+
+    void steal(small_map &m) {
+        if (m.is_inline()) {
+            for (size_t i = 0; i < m.n; i++) new (p + i) value_type(std::move(m.p[i]));
+            n = m.n;
+            m.clear();
+        }
+        else {
+            p = m.p; n = m.n; cap = m.cap;
+            m.p = m.inline_data(); m.n = 0; m.cap = N;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+
+#include "stats.h"
+
+namespace {
+
+const auto epoch = std::chrono::steady_clock::now();
+
+const char *stage_names[stage_count] = { "tokenize", "parse", "solve", "format" };
+
+int bucketOf(uint64_t v)
+{
+    int b = 0;
+    for (; v; v >>= 1) b++;
+    return b;
+}
+
+// microseconds with nanosecond digits, as the trace format expects
+void printMicros(std::ostream &os, uint64_t ns)
+{
+    os << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+}
+
+void printHistogram(std::ostream &os, const char *name, const log_histogram &h)
+{
+    os << "  " << std::left << std::setw(22) << name << std::right
+       << std::fixed << std::setprecision(1) << "mean " << h.mean()
+       << "  p50 <= " << h.percentile(0.5) << "  p90 <= " << h.percentile(0.9)
+       << "  p99 <= " << h.percentile(0.99) << "  max " << h.max() << '\n';
+}
+
+}
+
+const char* stageName(stage s)
+{
+    return stage_names[size_t(s)];
+}
+
+uint64_t statsClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+
+void log_histogram::add(uint64_t v)
+{
+    buckets[bucketOf(v)]++;
+    n++;
+    sum += v;
+    largest = std::max(largest, v);
+}
+
+void log_histogram::merge(const log_histogram &h)
+{
+    for (size_t b = 0; b < 65; b++) buckets[b] += h.buckets[b];
+    n += h.n;
+    sum += h.sum;
+    largest = std::max(largest, h.largest);
+}
+
+uint64_t log_histogram::percentile(double p) const
+{
+    uint64_t seen = 0;
+    for (int b = 0; b < 65; b++) {
+        seen += buckets[b];
+        if (seen > 0 && seen >= p * n) {
+            // the largest value of the bucket, but never beyond the largest value seen
+            uint64_t upper = b == 0 ? 0 : b == 64 ? UINT64_MAX : (uint64_t(1) << b) - 1;
+            return std::min(upper, largest);
+        }
+    }
+    return 0;
+}
+
+
+void line_stats::beginLine()
+{
+    sampled = trace_every > 0 && lines % trace_every == 0 && events.size() + stage_count + 1 <= max_events;
+    line_tokens = line_vars = 0;
+}
+
+void line_stats::endLine(uint64_t start, uint64_t allocs)
+{
+    uint64_t end = statsClock();
+    lines++;
+    allocations += allocs;
+    latency.add(end - start);
+    line_variables.add(line_vars);
+    line_allocations.add(allocs);
+    if (sampled) events.push_back({ "line", start, end - start, true, line_tokens, line_vars });
+    sampled = false;
+}
+
+void line_stats::addStage(stage s, uint64_t start)
+{
+    uint64_t end = statsClock();
+    stage_ns[size_t(s)] += end - start;
+    stage_calls[size_t(s)]++;
+    if (sampled) events.push_back({ stageName(s), start, end - start, false, 0, 0 });
+}
+
+void line_stats::countTokens(size_t t, size_t v)
+{
+    tokens += t;
+    variables += v;
+    line_tokens = uint32_t(t);
+    line_vars = uint32_t(v);
+}
+
+void line_stats::merge(const line_stats &o)
+{
+    lines += o.lines;
+    tokens += o.tokens;
+    variables += o.variables;
+    allocations += o.allocations;
+    for (size_t s = 0; s < stage_count; s++) {
+        stage_ns[s] += o.stage_ns[s];
+        stage_calls[s] += o.stage_calls[s];
+    }
+    latency.merge(o.latency);
+    line_variables.merge(o.line_variables);
+    line_allocations.merge(o.line_allocations);
+}
+
+void line_stats::report(std::ostream &os) const
+{
+    auto flags = os.flags();
+    auto precision = os.precision();
+    double per_line = lines ? 1.0 / lines : 0;
+
+    uint64_t total = 0;
+    for (size_t s = 0; s < stage_count; s++) total += stage_ns[s];
+
+    os << std::fixed << std::setprecision(1)
+       << "stats: " << lines << " lines, " << tokens << " tokens (" << tokens * per_line << " per line), "
+       << variables << " variable references, " << allocations << " allocations\n"
+       << "  stage         calls     total ms    ns/line   share\n";
+    for (size_t s = 0; s < stage_count; s++) {
+        os << "  " << std::left << std::setw(10) << stage_names[s] << std::right
+           << std::setw(9) << stage_calls[s]
+           << std::setw(13) << stage_ns[s] / 1e6
+           << std::setw(11) << stage_ns[s] * per_line
+           << std::setw(7) << (total ? 100.0 * stage_ns[s] / total : 0) << "%\n";
+    }
+    os.unsetf(std::ios::floatfield);
+    printHistogram(os, "line latency ns", latency);
+    printHistogram(os, "variables per line", line_variables);
+    printHistogram(os, "allocations per line", line_allocations);
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+
+void writeTrace(std::ostream &os, const std::vector<const line_stats*> &stats)
+{
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (auto st : stats) {
+        os << (first ? "\n" : ",\n")
+           << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << st->worker
+           << ",\"args\":{\"name\":\"worker " << st->worker << "\"}}";
+        first = false;
+
+        for (auto &e : st->events) {
+            os << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"calculator\",\"ph\":\"X\",\"pid\":1,\"tid\":" << st->worker << ",\"ts\":";
+            printMicros(os, e.start);
+            os << ",\"dur\":";
+            printMicros(os, e.duration);
+            if (e.line) os << ",\"args\":{\"tokens\":" << e.tokens << ",\"variables\":" << e.variables << '}';
+            os << '}';
+        }
+    }
+    os << "\n]}\n";
+}
@@ -0,0 +1,150 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <ostream>
+
+/*
+   instrumentation of the line processing
+   Every worker has a line_stats collecting per-stage times, token and variable reference counts,
+   heap allocations (counted by the operator new of the calculator program) and histograms of
+   the line latency, the variables and the allocations per line. Every 'trace_every'-th line is
+   also recorded as trace events, written in the Chrome trace-event JSON format.
+   The hooks are the STATS_* macros below; they do nothing without a line_stats (a null pointer)
+   and compile to no code at all when CALCULATOR_NO_STATS is defined (make STATS=0).
+*/
+
+#ifdef CALCULATOR_NO_STATS
+#define CALCULATOR_STATS 0
+#else
+#define CALCULATOR_STATS 1
+#endif
+
+// stages of a line: equations are solved and printed in 'solve', expressions and errors in 'format'
+enum class stage { tokenize, parse, solve, format };
+const size_t stage_count = 4;
+
+const char* stageName(stage s);
+
+// nanoseconds since the start of the process
+uint64_t statsClock();
+
+// heap allocations of the calling thread so far
+inline uint64_t& allocationCounter()
+{
+    static thread_local uint64_t n = 0;
+    return n;
+}
+
+// histogram with power of two buckets: bucket b > 0 holds the values [2^(b-1), 2^b)
+class log_histogram {
+public:
+    void add(uint64_t v);
+    void merge(const log_histogram &h);
+
+    uint64_t count() const { return n; };
+    uint64_t max() const { return largest; };
+    double   mean() const { return n ? double(sum) / n : 0; };
+
+    // upper bound of the bucket reaching the given fraction of the values
+    uint64_t percentile(double p) const;
+
+private:
+    uint64_t buckets[65] = {};
+    uint64_t n = 0, sum = 0, largest = 0;
+};
+
+class line_stats {
+public:
+    struct event {
+        const char *name;
+        uint64_t    start, duration;    // ns
+        bool        line;               // the whole line, not a stage
+        uint32_t    tokens, variables;  // of the line
+    };
+
+    static const size_t max_events = 1 << 20;
+
+    explicit line_stats(uint32_t worker = 0, size_t trace_every = 0) : worker(worker), trace_every(trace_every) {};
+
+    void beginLine();
+    void endLine(uint64_t start, uint64_t allocs);
+    void addStage(stage s, uint64_t start);
+    void countTokens(size_t tokens, size_t variables);
+
+    void merge(const line_stats &o);
+
+    // summary of the counters
+    void report(std::ostream &os) const;
+
+    uint64_t lines = 0;
+    uint64_t tokens = 0;
+    uint64_t variables = 0;             // variable references
+    uint64_t allocations = 0;
+    uint64_t stage_ns[stage_count] = {};
+    uint64_t stage_calls[stage_count] = {};
+    log_histogram latency;              // ns per line
+    log_histogram line_variables;
+    log_histogram line_allocations;
+
+    const uint32_t worker;
+    std::vector<event> events;          // sampled lines
+
+private:
+    const size_t trace_every;
+    bool     sampled = false;           // the current line is traced
+    uint32_t line_tokens = 0, line_vars = 0;
+};
+
+// Chrome trace-event JSON of the sampled lines of all workers
+void writeTrace(std::ostream &os, const std::vector<const line_stats*> &stats);
+
+// timer of a stage; records on destruction
+class stage_timer {
+public:
+    stage_timer(line_stats *ist, stage is) : st(ist), s(is), start(ist ? statsClock() : 0) {};
+    ~stage_timer() { if (st) st->addStage(s, start); };
+
+    stage_timer(const stage_timer&) = delete;
+    stage_timer& operator = (const stage_timer&) = delete;
+
+private:
+    line_stats *st;
+    stage       s;
+    uint64_t    start;
+};
+
+// timer of a whole line
+class line_timer {
+public:
+    explicit line_timer(line_stats *ist) : st(ist) {
+        if (!st) return;
+        st->beginLine();
+        start = statsClock();
+        allocations = allocationCounter();
+    };
+    ~line_timer() { if (st) st->endLine(start, allocationCounter() - allocations); };
+
+    line_timer(const line_timer&) = delete;
+    line_timer& operator = (const line_timer&) = delete;
+
+private:
+    line_stats *st;
+    uint64_t    start = 0;
+    uint64_t    allocations = 0;
+};
+
+#define STATS_CONCAT2(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT2(a, b)
+
+#if CALCULATOR_STATS
+#define STATS_LINE(st)              line_timer STATS_CONCAT(stats_line_, __LINE__)(st)
+#define STATS_STAGE(st, s)          stage_timer STATS_CONCAT(stats_stage_, __LINE__)(st, s)
+#else
+#define STATS_LINE(st)              ((void)(st))
+#define STATS_STAGE(st, s)          ((void)(st))
+#endif
+
+#endif
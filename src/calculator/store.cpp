@@ -0,0 +1,398 @@
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "store.h"
+
+namespace {
+
+const char     magic[8] = { 'C', 'A', 'L', 'C', 'E', 'X', 'P', 'R' };
+const uint32_t byte_order = 0x01020304;
+
+enum section { index_section, ops_section, consts_section, slots_section, symbols_section, positions_section, text_section, sections };
+
+struct store_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;              // of the file
+    uint64_t checksum;          // of the file with this field 0
+    uint64_t expressions, symbols;
+    struct {
+        uint64_t offset, size;  // in bytes
+    } section[sections];
+};
+
+// fields of an index entry
+enum field { name_off, name_len, source_off, source_len, op_first, op_count, const_first, const_count,
+             slot_first, slot_count, depth_field, results_field, temps_field, reserved, fields };
+
+static_assert(sizeof(store_header) % 8 == 0 && sizeof(uint32_t) * fields % 8 == 0, "sections are 8-byte aligned");
+// the ops are read in place
+static_assert(sizeof(op) == 8 && sizeof(op_t) == 1 && offsetof(op, arg) == 4, "op layout of the store format");
+
+void append(std::string &s, const void *p, size_t n) { s.append(static_cast<const char*>(p), n); }
+void append(std::string &s, uint32_t v) { append(s, &v, sizeof(v)); }
+
+void pad(std::string &s)
+{
+    s.append((8 - s.size() % 8) % 8, '\0');
+}
+
+const char* damaged() { return "damaged store"; }
+
+}
+
+const uint32_t expression_store::version;
+
+//-------------------------------------------------------
+// builder
+
+void expression_store::builder::add(const std::string &name, const std::string &source)
+{
+    if (names.count(name)) throw error("duplicate expression " + name);
+
+    auto tokens = tokenize_view(source);
+    entry e{ name, source, program<double>::compile(tokens) };
+    if (e.p.results == 0) throw program<double>::error(&tokens.back(), "missing expression");
+    e.p.optimize();
+    entries.push_back(std::move(e));
+    names.insert(name);
+}
+
+void expression_store::builder::addLines(const char *s, size_t n)
+{
+    size_t line = 0;
+    for (size_t start = 0, end; start < n; start = end + 1) {
+        line++;
+        end = std::find(s + start, s + n, '\n') - s;
+        std::string text(s + start, end - start);
+        if (!text.empty() && text.back() == '\r') text.pop_back();
+        if (text.find_first_not_of(" \t") == std::string::npos) continue;
+
+        size_t colon = text.find(':');
+        size_t first = text.find_first_not_of(" \t");
+        size_t last = colon == std::string::npos ? 0 : text.find_last_not_of(" \t", colon - 1);
+        if (colon == std::string::npos || first == colon) throw line_error(line, text, first, "'name: expression' expected");
+
+        size_t offset = colon + 1;
+        while (offset < text.size() && (text[offset] == ' ' || text[offset] == '\t')) offset++;
+        try {
+            add(text.substr(first, last + 1 - first), text.substr(offset));
+        }
+        catch (program<double>::error &e) {
+            throw line_error(line, text, offset + e.t.pos, e.msg);
+        }
+        catch (error &e) {
+            throw line_error(line, text, first, e.msg);
+        }
+    }
+}
+
+std::string expression_store::builder::image() const
+{
+    std::vector<const entry*> sorted;
+    for (auto &e : entries) sorted.push_back(&e);
+    std::sort(sorted.begin(), sorted.end(), [](const entry *a, const entry *b) { return a->name < b->name; });
+
+    std::string index, ops, consts, slots, symbols, positions, text;
+    std::unordered_map<std::string, uint32_t> interned;
+    size_t nops = 0, nconsts = 0, nslots = 0;
+
+    auto string = [&](const std::string &v, uint32_t *f) {
+        f[0] = uint32_t(text.size());
+        f[1] = uint32_t(v.size());
+        text += v;
+    };
+    for (auto e : sorted) {
+        auto &p = e->p;
+        uint32_t f[fields] = {};
+        string(e->name, &f[name_off]);
+        string(e->source, &f[source_off]);
+        f[op_first] = uint32_t(nops);
+        f[op_count] = uint32_t(p.code.size());
+        f[const_first] = uint32_t(nconsts);
+        f[const_count] = uint32_t(p.consts.size());
+        f[slot_first] = uint32_t(nslots);
+        f[slot_count] = uint32_t(p.vars.size());
+        f[depth_field] = uint32_t(p.depth);
+        f[results_field] = uint32_t(p.results);
+        f[temps_field] = uint32_t(p.temps);
+        append(index, f, sizeof(f));
+
+        for (size_t pc = 0; pc < p.code.size(); pc++) {
+            const char code[4] = { char(p.code[pc].code), 0, 0, 0 };
+            append(ops, code, sizeof(code));
+            append(ops, uint32_t(p.code[pc].arg));
+            append(positions, uint32_t(p.where[pc].pos));
+            append(positions, uint32_t(p.where[pc].s.size()));
+        }
+        append(consts, p.consts.data(), p.consts.size() * sizeof(double));
+        for (auto &v : p.vars) {
+            auto i = interned.find(v);
+            if (i == interned.end()) {
+                i = interned.emplace(v, uint32_t(interned.size())).first;
+                uint32_t sym[2];
+                string(v, sym);
+                append(symbols, sym, sizeof(sym));
+            }
+            append(slots, i->second);
+        }
+        nops += p.code.size();
+        nconsts += p.consts.size();
+        nslots += p.vars.size();
+
+        // offsets and counts are 32-bit
+        if (text.size() > UINT32_MAX || nops > UINT32_MAX / 2 || nconsts > UINT32_MAX || nslots > UINT32_MAX) {
+            throw error("the expressions exceed the size of a store");
+        }
+    }
+
+    store_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.byte_order = byte_order;
+    h.expressions = sorted.size();
+    h.symbols = interned.size();
+
+    std::string out(sizeof(h), '\0');
+    const std::string *parts[sections] = { &index, &ops, &consts, &slots, &symbols, &positions, &text };
+    for (size_t i = 0; i < sections; i++) {
+        h.section[i].offset = out.size();
+        h.section[i].size = parts[i]->size();
+        out += *parts[i];
+        pad(out);
+    }
+    h.size = out.size();
+    memcpy(&out[0], &h, sizeof(h));
+    h.checksum = checksum(out.data(), out.size());
+    memcpy(&out[0], &h, sizeof(h));
+    return out;
+}
+
+void expression_store::builder::write(const std::string &path) const
+{
+    auto s = image();
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f.write(s.data(), s.size());
+    f.close();
+    if (!f) throw error("unable to write " + path);
+}
+
+//-------------------------------------------------------
+// store
+
+uint64_t expression_store::checksum(const char *p, size_t n, uint64_t h)
+{
+    uint64_t w;
+    for (; n >= 8; p += 8, n -= 8) {
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+    }
+    if (n > 0) {
+        w = 0;
+        memcpy(&w, p, n);
+        h = (h ^ w) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+expression_store::expression_store(const std::string &path, check c) : file(path)
+{
+    store_header h;
+    if (file.size() < sizeof(h) || memcmp(file.data(), magic, sizeof(magic)) != 0) throw error(path + " is not an expression store");
+    memcpy(&h, file.data(), sizeof(h));
+    if (h.byte_order != byte_order) throw error(path + " was written on a machine of another byte order");
+    if (h.version != version) throw error(path + ": store version " + std::to_string(h.version) + ", expected " + std::to_string(version));
+    if (h.size != file.size() || h.size % 8 != 0) throw error(path + ": " + damaged() + " (truncated)");
+    if (h.expressions > h.size || h.symbols > h.size) throw error(path + ": " + damaged());
+
+    if (c == check::full) {
+        uint64_t sum = h.checksum;
+        h.checksum = 0;
+        uint64_t hs = checksum(reinterpret_cast<const char*>(&h), sizeof(h));
+        if (checksum(file.data() + sizeof(h), file.size() - sizeof(h), hs) != sum) throw error(path + ": " + damaged() + " (checksum)");
+    }
+
+    // the sections are in the file, aligned and as large as their contents
+    base = file.data();
+    for (auto &s : h.section) {
+        if (s.offset < sizeof(h) || s.offset % 8 != 0 || s.offset > h.size || s.size > h.size - s.offset) throw error(path + ": " + damaged());
+    }
+    auto &sec = h.section;
+    count = size_t(h.expressions);
+    nsymbols = size_t(h.symbols);
+    nops = size_t(sec[ops_section].size / sizeof(op));
+    nconsts = size_t(sec[consts_section].size / sizeof(double));
+    nslots = size_t(sec[slots_section].size / sizeof(uint32_t));
+    npositions = size_t(sec[positions_section].size / sizeof(uint32_t));
+    ntext = size_t(sec[text_section].size);
+    if (sec[index_section].size != h.expressions * fields * sizeof(uint32_t) || sec[symbols_section].size != h.symbols * 2 * sizeof(uint32_t)
+        || sec[ops_section].size % sizeof(op) != 0 || sec[consts_section].size % sizeof(double) != 0
+        || npositions != 2 * nops) {
+        throw error(path + ": " + damaged());
+    }
+
+    index          = reinterpret_cast<const uint32_t*>(base + sec[index_section].offset);
+    op_table       = reinterpret_cast<const op*>(base + sec[ops_section].offset);
+    const_table    = reinterpret_cast<const double*>(base + sec[consts_section].offset);
+    slot_table     = reinterpret_cast<const uint32_t*>(base + sec[slots_section].offset);
+    symbol_table   = reinterpret_cast<const uint32_t*>(base + sec[symbols_section].offset);
+    position_table = reinterpret_cast<const uint32_t*>(base + sec[positions_section].offset);
+    text           = base + sec[text_section].offset;
+}
+
+expression_store::expression expression_store::operator[](size_t i) const
+{
+    if (i >= count) throw error("no expression " + std::to_string(i));
+
+    const uint32_t *f = index + i * fields;
+    auto within = [](uint64_t first, uint64_t n, uint64_t size) { return first <= size && n <= size - first; };
+    if (!within(f[name_off], f[name_len], ntext) || !within(f[source_off], f[source_len], ntext) || !within(f[op_first], f[op_count], nops)
+        || !within(f[const_first], f[const_count], nconsts) || !within(f[slot_first], f[slot_count], nslots)) {
+        throw error(damaged());
+    }
+
+    expression e;
+    e.store = this;
+    e.name_off = f[name_off];
+    e.name_len = f[name_len];
+    e.source_off = f[source_off];
+    e.source_len = f[source_len];
+    e.ops = op_table + f[op_first];
+    e.nops = f[op_count];
+    e.consts = const_table + f[const_first];
+    e.nconsts = f[const_count];
+    e.slots = slot_table + f[slot_first];
+    e.nvars = f[slot_count];
+    e.positions = position_table + 2 * size_t(f[op_first]);
+    e.depth = f[depth_field];
+    e.results = f[results_field];
+    e.temps = f[temps_field];
+    return e;
+}
+
+ptrdiff_t expression_store::find(const std::string &name) const
+{
+    // names compare as std::string does
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const uint32_t *f = index + mid * fields;
+        if (f[name_off] > ntext || f[name_len] > ntext - f[name_off]) throw error(damaged());
+
+        int c = memcmp(text + f[name_off], name.data(), std::min<size_t>(f[name_len], name.size()));
+        if (c == 0) c = f[name_len] < name.size() ? -1 : f[name_len] > name.size() ? 1 : 0;
+        if (c == 0) return ptrdiff_t(mid);
+        if (c < 0) lo = mid + 1;
+        else       hi = mid;
+    }
+    return -1;
+}
+
+std::string expression_store::symbol(size_t k) const
+{
+    if (k >= nsymbols) throw error("no symbol " + std::to_string(k));
+    uint32_t off = symbol_table[2 * k], len = symbol_table[2 * k + 1];
+    if (off > ntext || len > ntext - off) throw error(damaged());
+    return string(off, len);
+}
+
+//-------------------------------------------------------
+// expressions
+
+std::string expression_store::expression::name() const { return store->string(name_off, name_len); }
+std::string expression_store::expression::source() const { return store->string(source_off, source_len); }
+std::string expression_store::expression::variable(size_t slot) const { return store->symbol(slots[slot]); }
+
+token expression_store::expression::where(size_t pc) const
+{
+    return where(source(), pc);
+}
+
+token expression_store::expression::where(const std::string &s, size_t pc) const
+{
+    size_t pos = std::min<size_t>(positions[2 * pc], s.size());
+    std::string t = s.substr(pos, positions[2 * pc + 1]);
+    return { tokenize(t)[0].type, t, pos };
+}
+
+// the checks of the code the evaluator relies on
+void expression_store::expression::validate() const
+{
+    // the sizes the evaluators allocate: every value, temporary and result has its op
+    if (depth > nops || temps > nops || results > nops) throw error(damaged());
+
+    size_t sp = 0, r = 0;
+    for (size_t pc = 0; pc < nops; pc++) {
+        const op &o = ops[pc];
+        bool valid = true;
+        switch (o.code) {
+        case op_t::push_const: valid = o.arg < nconsts; sp++; break;
+        case op_t::push_var:   valid = o.arg < nvars; sp++; break;
+        case op_t::add: case op_t::sub: case op_t::mul: case op_t::div: case op_t::pow:
+            valid = sp >= 2;
+            sp--;
+            break;
+        case op_t::neg: case op_t::log: valid = sp >= 1; break;
+        case op_t::result:     valid = sp >= 1; sp--; r++; break;
+        case op_t::store:      valid = sp >= 1 && o.arg < temps; break;
+        case op_t::load:       valid = o.arg < temps; sp++; break;
+        default:               valid = false; break;
+        }
+        if (!valid || sp > depth) throw error(damaged());
+    }
+    if (r != results) throw error(damaged());
+    for (size_t i = 0; i < nvars; i++) {
+        if (slots[i] >= store->nsymbols) throw error(damaged());
+    }
+}
+
+program<double> expression_store::expression::load() const
+{
+    validate();
+
+    program<double> p;
+    p.code.assign(ops, ops + nops);
+    p.consts.assign(consts, consts + nconsts);
+    for (size_t i = 0; i < nvars; i++) p.vars.push_back(variable(i));
+    auto s = source();
+    for (size_t pc = 0; pc < nops; pc++) p.where.push_back(where(s, pc));
+    p.depth = depth;
+    p.results = results;
+    p.temps = temps;
+    return p;
+}
+
+//-------------------------------------------------------
+
+stored_evaluator::stored_evaluator(const expression_store::expression &ie)
+    : e(ie)
+{
+    // the sizes of the index are used once the ops are checked against them
+    e.validate();
+    stack.resize(e.depth);
+    temps.resize(e.temps);
+    out.resize(e.results);
+}
+
+const std::vector<stored_evaluator::result>& stored_evaluator::run(const double *bindings)
+{
+    size_t pc = 0;
+    const char *msg;
+    try {
+        msg = execute(e.ops, e.nops, e.consts, bindings, stack.data(), temps.data(), out.data(), pc);
+    }
+    catch (std::exception &x) {
+        throw error(e.where(pc), x.what());
+    }
+    if (msg) throw error(e.where(pc), msg);
+
+    return out;
+}
@@ -0,0 +1,169 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <unordered_set>
+
+#include "program.h"
+#include "mapped_file.h"
+
+/*
+   persistent store of compiled expressions
+   A library of named expressions is compiled and optimized once into a program<double> each
+   and written to a file that is memory-mapped at start and used in place: the ops and constants
+   of an expression are read from the mapping by the evaluator, nothing is parsed or copied, so
+   opening a store costs its integrity check and the page faults of what is used.
+
+   The file is relocatable - all references are offsets from its start or indices - and consists
+   of a header and 8-byte aligned sections:
+       index      one entry per expression, sorted by name (binary search)
+       ops        the op sequences (struct op: code byte, 3 zero bytes, 32-bit argument)
+       consts     the constant pools (doubles)
+       slots      the variable slots of every expression as indices into 'symbols'
+       symbols    the variable names of all expressions, each once (offset, length in 'text')
+       positions  position and length in the source of the token of every op, for the errors
+       text       names and sources of the expressions, the variable names
+   Numbers are in the byte order of the writing machine, which the header records. The header
+   has a magic, the format version, the file size and a 64-bit checksum of the whole file (the
+   checksum field counted as 0). Opening checks the header and that every section lies within
+   the file; check::full also verifies the checksum, which reads the whole file. The ops of an
+   expression are validated (arguments, stack depth, results) before its first evaluation, and
+   the sizes of its entry before anything is allocated for them, so a damaged store is an error
+   and never a wild memory access.
+*/
+
+class expression_store {
+public:
+    struct error : public std::exception {
+        const std::string msg;
+        error(const std::string & im) :msg(im) {};
+
+        virtual const char* what() const throw()
+        {
+            return msg.c_str();
+        }
+    };
+
+    enum class check { header, full };
+
+    static const uint32_t version = 1;
+
+    // compiles 'name: expression' lines into the image of a store
+    class builder {
+    public:
+        // the expression with its compile error; 'name' must be new
+        void add(const std::string &name, const std::string &source);
+        // the lines of a library; throws the error of the first invalid line, its 'line' is 1-based
+        void addLines(const char *s, size_t n);
+
+        size_t size() const { return entries.size(); };
+
+        std::string image() const;
+        void write(const std::string &path) const;
+
+        struct line_error : public error {
+            const size_t line, pos;
+            const std::string text;
+            line_error(size_t iline, const std::string &itext, size_t ipos, const std::string &imsg)
+                : error(imsg), line(iline), pos(ipos), text(itext) {};
+        };
+
+    private:
+        struct entry {
+            std::string name, source;
+            program<double> p;
+        };
+        std::vector<entry> entries;
+        std::unordered_set<std::string> names;
+    };
+
+    // view of an expression in the mapping; valid as long as the store
+    class expression {
+    public:
+        std::string name() const;
+        std::string source() const;
+
+        size_t variables() const { return nvars; };
+        std::string variable(size_t slot) const;
+
+        const op*     code() const { return ops; };
+        size_t        size() const { return nops; };
+        const double* constants() const { return consts; };
+        size_t depth, results, temps;
+
+        // the token of op 'pc' for the errors; its text as in the source, its type from its first character
+        token where(size_t pc) const;
+
+        // a program<double> with the same code, for the columnar evaluators
+        program<double> load() const;
+
+    private:
+        friend class expression_store;
+        friend class stored_evaluator;
+
+        const expression_store *store = nullptr;
+        uint32_t name_off = 0, name_len = 0, source_off = 0, source_len = 0;
+        const op       *ops = nullptr;
+        size_t          nops = 0;
+        const double   *consts = nullptr;
+        size_t          nconsts = 0;
+        const uint32_t *slots = nullptr;
+        size_t          nvars = 0;
+        const uint32_t *positions = nullptr;     // pos, len per op
+
+        token where(const std::string &source, size_t pc) const;
+        void validate() const;
+    };
+
+    explicit expression_store(const std::string &path, check c = check::full);
+
+    size_t size() const { return count; };
+
+    // the i-th expression in name order
+    expression operator[](size_t i) const;
+    // index of the expression 'name' or -1
+    ptrdiff_t find(const std::string &name) const;
+
+    // interned variable names of all expressions
+    size_t symbols() const { return nsymbols; };
+    std::string symbol(size_t k) const;
+
+    // the checksum of the format: 64-bit words, the tail padded with zeros
+    static uint64_t checksum(const char *p, size_t n, uint64_t h = 0xcbf29ce484222325ULL);
+
+private:
+    mapped_file file;
+    size_t count = 0, nsymbols = 0;
+    const char *base = nullptr;
+    // sections, see above
+    const uint32_t *index = nullptr, *slot_table = nullptr, *symbol_table = nullptr, *position_table = nullptr;
+    const op       *op_table = nullptr;
+    const double   *const_table = nullptr;
+    size_t nops = 0, nconsts = 0, nslots = 0, npositions = 0, ntext = 0;
+    const char     *text = nullptr;
+
+    std::string string(uint32_t off, uint32_t len) const { return std::string(text + off, len); };
+};
+
+// evaluator of a stored expression, read in place
+class stored_evaluator {
+public:
+    using result = parser<double>::result;
+    using error  = parser<double>::error;
+
+    explicit stored_evaluator(const expression_store::expression &e);
+
+    // bindings[i] is the value of variable slot i of the expression
+    const std::vector<result>& run(const double *bindings);
+
+private:
+    expression_store::expression e;
+    std::vector<double> stack, temps;
+    std::vector<result> out;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cassert>
+
+#include "symbols.h"
+
+/*
+   names are stored in fixed-size chunks that never move, so 'name' can read them
+   without taking the lock; only interning a new name is serialized
+*/
+
+namespace {
+
+const size_t chunk_bits = 10;
+const size_t chunk_size = size_t(1) << chunk_bits;
+const size_t max_chunks = symbol_table::max_names / chunk_size;
+
+// names in the cache of a thread before it is emptied
+const size_t max_cached = size_t(1) << 16;
+
+struct chunk {
+    std::string names[chunk_size];
+};
+
+struct table {
+    std::mutex m;
+    std::unordered_map<std::string, var_id> ids;
+    std::atomic<chunk*> chunks[max_chunks] = {};
+    std::atomic<size_t> count{ 0 };
+
+    ~table() {
+        for (auto &c : chunks) delete c.load();
+    }
+};
+
+table& instance()
+{
+    static table t;
+    return t;
+}
+
+}
+
+const size_t symbol_table::max_names;
+
+var_id symbol_table::intern(const char *s, size_t len)
+{
+    // per-thread cache of known names, so that worker threads do not contend on the lock
+    thread_local std::unordered_map<std::string, var_id> cache;
+
+    std::string name(s, len);
+    auto c = cache.find(name);
+    if (c != cache.end()) return c->second;
+
+    var_id id = internShared(std::move(name));
+    if (cache.size() >= max_cached) cache.clear();
+    cache.emplace(symbol_table::name(id), id);
+    return id;
+}
+
+var_id symbol_table::internShared(std::string &&name)
+{
+    auto &t = instance();
+
+    std::lock_guard<std::mutex> lock(t.m);
+
+    auto i = t.ids.find(name);
+    if (i != t.ids.end()) return i->second;
+
+    size_t id = t.count.load(std::memory_order_relaxed);
+    if (id == max_names) throw error("too many variable names");
+
+    chunk *c = t.chunks[id >> chunk_bits].load(std::memory_order_relaxed);
+    if (!c) {
+        c = new chunk;
+        t.chunks[id >> chunk_bits].store(c, std::memory_order_release);
+    }
+    c->names[id & (chunk_size - 1)] = name;
+    t.ids.emplace(std::move(name), var_id(id));
+    t.count.store(id + 1, std::memory_order_release);
+
+    return var_id(id);
+}
+
+const std::string& symbol_table::name(var_id id)
+{
+    auto &t = instance();
+    assert(id < t.count.load(std::memory_order_acquire));
+
+    return t.chunks[id >> chunk_bits].load(std::memory_order_acquire)->names[id & (chunk_size - 1)];
+}
+
+size_t symbol_table::size()
+{
+    return instance().count.load(std::memory_order_acquire);
+}
@@ -0,0 +1,44 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <string>
+#include <exception>
+
+// interned variable identifier
+using var_id = unsigned;
+
+/*
+   process-wide symbol table interning variable names to small integer ids
+   ids are assigned in order of first use and stay valid for the lifetime of the process;
+   safe to use from multiple threads
+   The table holds at most max_names names; interning a new name beyond that throws
+   symbol_table::error, which the parser reports as the error of the line.
+*/
+
+class symbol_table {
+public:
+    struct error : public std::exception {
+        const std::string msg;
+        error(const std::string & im) :msg(im) {};
+
+        virtual const char* what() const throw()
+        {
+            return msg.c_str();
+        }
+    };
+
+    static const size_t max_names = size_t(1) << 24;
+
+    static var_id intern(const char *s, size_t len);
+    static var_id intern(const std::string &name) { return intern(name.data(), name.size()); };
+
+    // name of an interned id; the reference stays valid forever
+    static const std::string& name(var_id id);
+
+    static size_t size();
+
+private:
+    static var_id internShared(std::string &&name);
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <cmath>
+
+#include "symbols.h"
+#include "affine.h"
+
+/*
+   sparse system of affine equations 'a = 0', solved simultaneously
+   the system is reduced by sparse Gaussian elimination; pivots are chosen by the Markowitz
+   criterion (least (row count - 1) * (column count - 1) among the sparsest rows) with threshold
+   partial pivoting, which keeps the fill-in low. Back substitution runs on affine values, so
+   variables of underdetermined systems come out expressed in terms of the free variables.
+*/
+
+template<typename T>
+class sparse_system {
+public:
+    enum class status {
+        unique,             // every variable has a single value
+        underdetermined,    // the solution depends on free variables
+        inconsistent,       // no solution
+    };
+
+    struct solution {
+        status kind;
+        std::vector<std::pair<var_id, affine<T>>> values;   // solved variables, in id order
+        std::vector<var_id> free_vars;                      // sorted
+    };
+
+    // add the equation 'a = 0'
+    void add(const affine<T> &a);
+
+    solution solve();
+
+    size_t equations() const { return rows.size(); };
+    size_t variables() const { return vars.size(); };
+    size_t fill_in()   const { return fill; };   // entries created by the elimination
+
+private:
+    using entry = std::pair<unsigned, T>;   // column, coefficient
+
+    struct row {
+        std::vector<entry> e;   // sorted by column
+        T    rhs;
+        bool active = true;
+    };
+
+    std::vector<row>                   rows;
+    std::vector<var_id>                vars;        // variable of each column
+    std::unordered_map<var_id, unsigned> columns;
+    std::vector<var_id>                cancelled;   // variables present only with zero coefficient
+    std::vector<std::vector<unsigned>> col_rows;    // rows that contain (or contained) each column
+    std::vector<size_t>                col_count;   // active rows containing each column
+    size_t                             fill = 0;
+
+    unsigned column(var_id v);
+    bool negligible(const T &v, const T &scale) const;
+    void eliminate(unsigned pivot_row, unsigned col, std::set<std::pair<size_t, unsigned>> &order);
+};
+
+template<typename T>
+unsigned sparse_system<T>::column(var_id v)
+{
+    auto i = columns.find(v);
+    if (i != columns.end()) return i->second;
+
+    unsigned c = unsigned(vars.size());
+    columns.emplace(v, c);
+    vars.push_back(v);
+    col_rows.emplace_back();
+    col_count.push_back(0);
+    return c;
+}
+
+// cancellation test; exact for exact number types, relative to the operand size otherwise
+template<typename T>
+bool sparse_system<T>::negligible(const T &v, const T &scale) const
+{
+    if (std::numeric_limits<T>::is_exact || !std::numeric_limits<T>::is_specialized) return v == 0;
+
+    using std::abs;
+    return abs(v) <= 64 * std::numeric_limits<T>::epsilon() * scale;
+}
+
+template<typename T>
+void sparse_system<T>::add(const affine<T> &a)
+{
+    row r;
+    r.rhs = T(0) - a.d;
+    r.e.reserve(a.x.size());
+    for (auto &t : a.x) r.e.push_back({ column(t.first), t.second });
+    std::sort(r.e.begin(), r.e.end(), [](const entry &e1, const entry &e2) {return e1.first < e2.first;});
+
+    unsigned ri = unsigned(rows.size());
+    for (auto &e : r.e) {
+        col_rows[e.first].push_back(ri);
+        col_count[e.first]++;
+    }
+    rows.push_back(std::move(r));
+
+    cancelled.insert(cancelled.end(), a.z.begin(), a.z.end());
+}
+
+// subtract multiples of the pivot row from all other active rows containing 'col'
+template<typename T>
+void sparse_system<T>::eliminate(unsigned pr, unsigned col, std::set<std::pair<size_t, unsigned>> &order)
+{
+    using std::abs;
+
+    const row &p = rows[pr];
+    T pivot = std::find_if(p.e.begin(), p.e.end(), [col](const entry &e) {return e.first == col;})->second;
+
+    std::vector<entry> merged;
+    for (unsigned ri : col_rows[col]) {
+        row &r = rows[ri];
+        if (ri == pr || !r.active) continue;
+
+        auto rc = std::lower_bound(r.e.begin(), r.e.end(), col, [](const entry &e, unsigned c) {return e.first < c;});
+        if (rc == r.e.end() || rc->first != col) continue;      // stale column list entry
+
+        T factor = rc->second / pivot;
+        order.erase({ r.e.size(), ri });
+
+        // r = r - factor * p, as a merge of the two sorted rows
+        merged.clear();
+        merged.reserve(r.e.size() + p.e.size());
+        auto i1 = r.e.begin(), i2 = p.e.begin();
+        while (i1 != r.e.end() || i2 != p.e.end()) {
+            if (i2 == p.e.end() || (i1 != r.e.end() && i1->first < i2->first)) {
+                merged.push_back(*i1++);
+            }
+            else if (i1 == r.e.end() || i2->first < i1->first) {
+                // fill-in
+                merged.push_back({ i2->first, T(0) - factor * i2->second });
+                col_rows[i2->first].push_back(ri);
+                col_count[i2->first]++;
+                fill++;
+                i2++;
+            }
+            else {
+                T v = i1->second - factor * i2->second;
+                if (i1->first == col || negligible(v, std::max(abs(i1->second), abs(factor * i2->second)))) {
+                    col_count[i1->first]--;
+                }
+                else merged.push_back({ i1->first, v });
+                i1++; i2++;
+            }
+        }
+        r.e.swap(merged);
+
+        T rhs = r.rhs - factor * p.rhs;
+        r.rhs = negligible(rhs, std::max(abs(r.rhs), abs(factor * p.rhs))) ? T(0) : rhs;
+
+        order.insert({ r.e.size(), ri });
+    }
+}
+
+template<typename T>
+typename sparse_system<T>::solution sparse_system<T>::solve()
+{
+    using std::abs;
+
+    const T threshold = T(1) / T(10);  // pivot must be at least this fraction of the row maximum
+    const size_t search_rows = 4;        // sparsest rows examined for the Markowitz pivot
+
+    solution s;
+    s.kind = status::unique;
+
+    // active rows ordered by their number of entries
+    std::set<std::pair<size_t, unsigned>> order;
+    for (unsigned i = 0; i < rows.size(); i++) order.insert({ rows[i].e.size(), i });
+
+    std::vector<std::pair<unsigned, unsigned>> pivots;  // (row, column) in elimination order
+    std::vector<bool> pivoted(vars.size(), false);
+
+    while (!order.empty()) {
+        if (order.begin()->first == 0) {
+            // fully reduced row: 0 = rhs
+            unsigned ri = order.begin()->second;
+            order.erase(order.begin());
+            rows[ri].active = false;
+            if (rows[ri].rhs != 0) s.kind = status::inconsistent;
+            continue;
+        }
+
+        // Markowitz pivot search over the sparsest rows
+        unsigned best_row = 0, best_col = 0;
+        size_t best_cost = std::numeric_limits<size_t>::max();
+        size_t examined = 0;
+        for (auto &o : order) {
+            if (examined++ == search_rows) break;
+
+            const row &r = rows[o.second];
+            T row_max(0);
+            for (auto &e : r.e) row_max = std::max(row_max, T(abs(e.second)));
+
+            for (auto &e : r.e) {
+                if (abs(e.second) < threshold * row_max) continue;
+                size_t cost = (r.e.size() - 1) * (col_count[e.first] - 1);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_row = o.second;
+                    best_col = e.first;
+                }
+            }
+        }
+
+        order.erase({ rows[best_row].e.size(), best_row });
+        eliminate(best_row, best_col, order);
+
+        rows[best_row].active = false;
+        for (auto &e : rows[best_row].e) col_count[e.first]--;
+        pivots.push_back({ best_row, best_col });
+        pivoted[best_col] = true;
+    }
+
+    if (s.kind == status::inconsistent) return s;
+
+    // free variables: columns without pivot, and variables that only ever cancelled out
+    for (unsigned c = 0; c < vars.size(); c++) {
+        if (!pivoted[c]) s.free_vars.push_back(vars[c]);
+    }
+    for (auto v : cancelled) {
+        if (columns.find(v) == columns.end()) s.free_vars.push_back(v);
+    }
+    std::sort(s.free_vars.begin(), s.free_vars.end());
+    s.free_vars.erase(std::unique(s.free_vars.begin(), s.free_vars.end()), s.free_vars.end());
+    if (!s.free_vars.empty()) s.kind = status::underdetermined;
+
+    // back substitution; a pivot row only contains columns pivoted after it or free columns
+    std::vector<affine<T>> value(vars.size());
+    for (unsigned c = 0; c < vars.size(); c++) {
+        if (!pivoted[c]) value[c] = affine<T>(1, vars[c]);
+    }
+    for (auto p = pivots.rbegin(); p != pivots.rend(); ++p) {
+        const row &r = rows[p->first];
+        affine<T> v(r.rhs);
+        T pivot(0);
+        for (auto &e : r.e) {
+            if (e.first == p->second) pivot = e.second;
+            else                      v -= value[e.first] * affine<T>(e.second);
+        }
+        v /= pivot;
+        value[p->second] = std::move(v);
+    }
+
+    for (auto &p : pivots) s.values.push_back({ vars[p.second], std::move(value[p.second]) });
+    std::sort(s.values.begin(), s.values.end(), [](const auto &v1, const auto &v2) {return v1.first < v2.first;});
+
+    return s;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include <thread>
+#include <mutex>
+
+#include "thread_pool.h"
+
+thread_pool::thread_pool(size_t threads)
+{
+    if (threads == 0) threads = 1;
+
+    for (size_t i = 0; i < threads; i++) queues.emplace_back(new queue);
+    for (size_t i = 0; i < threads; i++) workers.emplace_back([this, i] { run(i); });
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(idle_m);
+        stopping = true;
+    }
+    idle_cv.notify_all();
+
+    for (auto &w : workers) w.join();
+}
+
+size_t thread_pool::default_threads()
+{
+    size_t n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+void thread_pool::submit(task t)
+{
+    auto &q = *queues[next];
+    next = (next + 1) % queues.size();
+
+    // counted before it is queued, so that 'queued' never drops below zero
+    {
+        std::lock_guard<std::mutex> lock(idle_m);
+        queued++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(q.m);
+        q.tasks.push_back(std::move(t));
+    }
+    idle_cv.notify_one();
+}
+
+// take a task from the own queue (oldest first) or steal the newest task of another worker
+bool thread_pool::pop(size_t id, task &t)
+{
+    {
+        auto &q = *queues[id];
+        std::lock_guard<std::mutex> lock(q.m);
+        if (!q.tasks.empty()) {
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues.size(); i++) {
+        auto &q = *queues[(id + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(q.m);
+        if (!q.tasks.empty()) {
+            t = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void thread_pool::run(size_t id)
+{
+    for (;;) {
+        task t;
+        if (pop(id, t)) {
+            queued--;
+            t(id);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idle_m);
+        idle_cv.wait(lock, [this] { return queued > 0 || stopping; });
+        if (queued == 0 && stopping) return;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+/*
+   work-stealing thread pool
+   every worker has its own task queue; tasks are distributed round-robin and a worker
+   that runs out of tasks steals from the back of the other queues.
+   Tasks get the index of the worker running them, so they can use per-worker state.
+*/
+
+class thread_pool {
+public:
+    using task = std::function<void(size_t worker)>;
+
+    explicit thread_pool(size_t threads);
+    ~thread_pool();     // finishes all submitted tasks
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator = (const thread_pool&) = delete;
+
+    void submit(task t);
+    size_t size() const { return workers.size(); };
+
+    // number of threads to use by default
+    static size_t default_threads();
+
+private:
+    struct queue {
+        std::mutex       m;
+        std::deque<task> tasks;
+    };
+
+    std::vector<std::unique_ptr<queue>> queues;
+    std::vector<std::thread>            workers;
+
+    std::mutex              idle_m;
+    std::condition_variable idle_cv;
+    std::atomic<size_t>     queued{ 0 };
+    bool                    stopping = false;
+    size_t                  next = 0;       // round-robin submit position
+
+    void run(size_t id);
+    bool pop(size_t id, task &t);
+};
+
+#endif
@@ -1,5 +1,8 @@
 #include <iostream>
 #include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
 
 #include <gtest/gtest.h>
 
@@ -60,3 +63,129 @@ TEST(Affine, Div)
     EXPECT_EQ(r.x["y"], 2);
     EXPECT_EQ(r.d, 0);
 }
+
+TEST(Affine, InlineTerms)
+{
+    auto r = affine<double>(1, "a") + affine<double>(2, "b") - affine<double>(3, "c") + affine<double>(4, "d");
+
+    EXPECT_EQ(r.x.size(), 4);
+    EXPECT_TRUE(r.x.is_inline());
+    EXPECT_EQ(r.x["c"], -3);
+
+    r = r + affine<double>(5, "e");
+    EXPECT_EQ(r.x.size(), 5);
+    EXPECT_FALSE(r.x.is_inline());
+    EXPECT_EQ(r.x["e"], 5);
+}
+
+TEST(Affine, MergeSorted)
+{
+    auto a = affine<double>(1, "u") + affine<double>(2, "w");
+    auto b = affine<double>(3, "v") - affine<double>(4, "w") + affine<double>(5);
+    auto r = a - b;
+
+    EXPECT_EQ(r.x.size(), 3);
+    EXPECT_TRUE(std::is_sorted(r.x.begin(), r.x.end()));
+    EXPECT_EQ(r.x["u"], 1);
+    EXPECT_EQ(r.x["v"], -3);
+    EXPECT_EQ(r.x["w"], 6);
+    EXPECT_EQ(r.d, -5);
+}
+
+TEST(Affine, PrintByName)
+{
+    // interning order differs from the name order
+    auto r = affine<double>(2, "zz") - affine<double>(1, "aa") + affine<double>(3);
+    std::ostringstream ss;
+    ss << r;
+
+    EXPECT_EQ(ss.str(), "-aa + 2*zz + 3");
+}
+
+TEST(Affine, ReadVariable)
+{
+    affine<double> a;
+    std::istringstream ss("x");
+    ss >> a;
+
+    EXPECT_EQ(a, affine<double>(1, "x"));
+    EXPECT_EQ(symbol_table::name(a.x.begin()->first), "x");
+}
+
+TEST(SymbolTable, Intern)
+{
+    auto id = symbol_table::intern("alpha");
+
+    EXPECT_EQ(symbol_table::intern(std::string("alpha")), id);
+    EXPECT_NE(symbol_table::intern("beta"), id);
+    EXPECT_EQ(symbol_table::name(id), "alpha");
+}
+
+TEST(Affine, InPlace)
+{
+    affine<double> a(3, "x");
+    a += affine<double>(2, "y") + affine<double>(1);
+    a -= affine<double>(1, "x");
+    a *= 4.0;
+    a /= 2.0;
+
+    EXPECT_EQ(a, affine<double>(4, "x") + affine<double>(4, "y") + affine<double>(2));
+    EXPECT_THROW(a /= 0.0, affine<double>::error);
+    EXPECT_THROW(a *= affine<double>(1, "z"), affine<double>::error);
+}
+
+TEST(Affine, NonThrowing)
+{
+    using atom = affine<double>;
+    atom a = atom(2, "x") + atom(1);
+
+    EXPECT_EQ(a.multiply(atom(3)), nullptr);
+    EXPECT_EQ(a, atom(6, "x") + atom(3));
+    EXPECT_STREQ(a.multiply(atom(1, "y")), "polynomial of order > 1 not allowed");
+    EXPECT_STREQ(a.divide(atom(1, "y")), "polynomial fraction not allowed");
+    EXPECT_STREQ(a.divide(0.0), "division by zero");
+    EXPECT_STREQ(a.logarithm(), "log of polynomial not allowed");
+    EXPECT_STREQ(a.power(atom(2)), "power of polynomial not allowed");
+    EXPECT_STREQ(atom(2).power(a), "polynomial exponent not allowed");
+    EXPECT_EQ(a, atom(6, "x") + atom(3));      // unchanged by the failed operations
+
+    atom c(8);
+    EXPECT_EQ(c.power(atom(2)), nullptr);
+    EXPECT_EQ(c.logarithm(), nullptr);
+    EXPECT_DOUBLE_EQ(c.d, std::log(64.0));
+    EXPECT_EQ(c.divide(atom(2)), nullptr);
+    EXPECT_DOUBLE_EQ(c.d, std::log(64.0) / 2);
+}
+
+TEST(Affine, PruneCancelled)
+{
+    auto r = affine<double>(1, "x") + affine<double>(1, "y") - affine<double>(1, "x");
+
+    EXPECT_EQ(r.x.size(), 1);
+    ASSERT_EQ(r.z.size(), 1);
+    EXPECT_EQ(symbol_table::name(r.z[0]), "x");
+
+    // the variable becomes live again
+    r += affine<double>(2, "x");
+    EXPECT_EQ(r.x.size(), 2);
+    EXPECT_TRUE(r.z.empty());
+
+    r *= 0.0;
+    EXPECT_TRUE(r.isConstant());
+    EXPECT_EQ(r.z.size(), 2);
+}
+
+TEST(Affine, MoveReusesStorage)
+{
+    affine<double> a;
+    for (auto n : { "v1", "v2", "v3", "v4", "v5", "v6" }) a += affine<double>(1, n);
+    ASSERT_FALSE(a.x.is_inline());
+
+    auto p = &*a.x.begin();
+    auto r = std::move(a) + affine<double>(1, "v7");
+    EXPECT_EQ(r.x.size(), 7);
+
+    r = -std::move(r);
+    EXPECT_EQ(&*r.x.begin(), p);
+    EXPECT_EQ(r.x["v1"], -1);
+}
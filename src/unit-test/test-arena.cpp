@@ -0,0 +1,168 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "arena.h"
+#include "small_map.h"
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+
+
+using atom = affine<double>;
+
+namespace {
+
+double coef(const atom &a, const std::string &name)
+{
+    auto i = a.x.find(symbol_table::intern(name));
+    return i == a.x.end() ? 0 : i->second;
+}
+
+}
+
+TEST(Arena, Allocate)
+{
+    arena a(256);
+    EXPECT_EQ(a.stats().capacity, 0);
+
+    auto p1 = static_cast<char*>(a.allocate(10, 1));
+    auto p2 = static_cast<char*>(a.allocate(8, 8));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p2) % 8, 0);
+    EXPECT_GE(p2, p1 + 10);
+    EXPECT_EQ(a.stats().used, size_t(p2 + 8 - p1));
+
+    // larger than a block
+    auto p3 = static_cast<char*>(a.allocate(1000, 16));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p3) % 16, 0);
+    EXPECT_EQ(a.stats().blocks, 2);
+    EXPECT_GE(a.stats().used, 1018);
+}
+
+TEST(Arena, Reset)
+{
+    arena a(256);
+    for (int i = 0; i < 100; i++) a.allocate(24, 8);
+    auto st = a.stats();
+    EXPECT_GT(st.blocks, 1);
+    EXPECT_GE(st.used, 2400);
+
+    // the blocks are coalesced into one, so the same work doesn't allocate again
+    a.reset();
+    EXPECT_EQ(a.stats().used, 0);
+    EXPECT_EQ(a.stats().peak, st.used);
+    size_t blocks = a.stats().blocks;
+    for (int i = 0; i < 100; i++) a.allocate(24, 8);
+    EXPECT_EQ(a.stats().blocks, blocks);
+    a.reset();
+    EXPECT_EQ(a.stats().blocks, blocks);
+
+    // huge lines don't keep their memory
+    a.allocate(4 * arena::max_retained, 8);
+    a.reset();
+    EXPECT_LE(a.stats().capacity, arena::max_retained);
+}
+
+TEST(Arena, Scope)
+{
+    arena a1, a2;
+    EXPECT_EQ(arena::current(), nullptr);
+    {
+        arena_scope s1(&a1);
+        EXPECT_EQ(arena::current(), &a1);
+        {
+            arena_scope s2(nullptr);
+            EXPECT_EQ(arena::current(), nullptr);
+            arena_scope s3(&a2);
+            EXPECT_EQ(arena::current(), &a2);
+        }
+        EXPECT_EQ(arena::current(), &a1);
+    }
+    EXPECT_EQ(arena::current(), nullptr);
+}
+
+TEST(Arena, Allocator)
+{
+    arena a;
+    std::vector<int, arena_allocator<int>> heap;
+    heap.assign(100, 1);
+    EXPECT_EQ(heap.get_allocator().resource(), nullptr);
+
+    arena_scope scope(&a);
+    std::vector<int, arena_allocator<int>> v(100, 2);
+    EXPECT_EQ(v.get_allocator().resource(), &a);
+    EXPECT_GE(a.stats().used, 100 * sizeof(int));
+
+    // copies follow the scope, moves keep the allocator
+    {
+        arena_scope persistent(nullptr);
+        auto copy = v;
+        EXPECT_EQ(copy.get_allocator().resource(), nullptr);
+        auto moved = std::move(heap);
+        EXPECT_EQ(moved.get_allocator().resource(), nullptr);
+        EXPECT_EQ(moved.size(), 100);
+    }
+}
+
+TEST(Arena, SmallMap)
+{
+    using map = small_map<int, double, 2, arena_allocator<std::pair<int, double>>>;
+    arena a;
+    map heap;
+    for (int i = 0; i < 10; i++) heap.push_back(i, i);
+
+    arena_scope scope(&a);
+    map m;
+    for (int i = 0; i < 10; i++) m.push_back(i, 2 * i);
+    EXPECT_FALSE(m.is_inline());
+    EXPECT_GE(a.stats().used, 10 * sizeof(std::pair<int, double>));
+
+    // unequal allocators: the elements are moved, the memory stays where it was
+    heap = std::move(m);
+    EXPECT_EQ(heap.get_allocator().resource(), nullptr);
+    ASSERT_EQ(heap.size(), 10);
+    EXPECT_EQ(heap.find(7)->second, 14);
+
+    map m2(heap);
+    EXPECT_EQ(m2.get_allocator().resource(), &a);
+    EXPECT_EQ(m2.size(), 10);
+    map m3(std::move(m2));
+    EXPECT_EQ(m3.get_allocator().resource(), &a);
+    EXPECT_EQ(m3.find(9)->second, 18);
+}
+
+// results kept past the line are copied out of the arena; the arena can then be reset
+TEST(Arena, PersistedResults)
+{
+    std::string line = "a + b + c + d + e + f - 2*g = 1, x - x + y";
+    auto tokens = tokenize_view(line);
+
+    arena a;
+    std::vector<parser<atom>::result> kept;
+    {
+        arena_scope scope(&a);
+        auto results = parser<atom>::parse(tokens);
+        EXPECT_GT(a.stats().used, 0);
+
+        arena_scope persistent(nullptr);
+        kept = results;
+    }
+    a.reset();
+
+    // overwrite the arena memory
+    {
+        arena_scope scope(&a);
+        auto other = parser<atom>::parse(tokenize_view(line));
+        for (auto &r : other) r.atom *= 100.0;
+    }
+
+    ASSERT_EQ(kept.size(), 2);
+    EXPECT_EQ(kept[0].atom.x.size(), 7);
+    EXPECT_EQ(coef(kept[0].atom, "g"), -2);
+    EXPECT_EQ(kept[0].atom.d, -1);
+    ASSERT_EQ(kept[1].atom.z.size(), 1);
+    EXPECT_EQ(symbol_table::name(kept[1].atom.z[0]), "x");
+    EXPECT_EQ(coef(kept[1].atom, "y"), 1);
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <fstream>
+#include <cstdio>
+
+#include <gtest/gtest.h>
+
+#include "thread_pool.h"
+#include "batch.h"
+#include "output.h"
+#include "mapped_file.h"
+
+TEST(ThreadPool, RunsAllTasks)
+{
+    std::atomic<int> sum{ 0 };
+    {
+        thread_pool pool(4);
+        for (int i = 1; i <= 1000; i++) pool.submit([&sum, i](size_t) { sum += i; });
+    }
+    EXPECT_EQ(sum, 500500);
+}
+
+TEST(ThreadPool, WorkerIndex)
+{
+    std::atomic<int> bad{ 0 };
+    {
+        thread_pool pool(3);
+        for (int i = 0; i < 100; i++) pool.submit([&bad](size_t w) { if (w >= 3) bad++; });
+    }
+    EXPECT_EQ(bad, 0);
+}
+
+TEST(BlockOutput, Interleaving)
+{
+    block_output b;
+    b.out() << "a";
+    b.err() << "b";
+    b.err() << "c";
+    b.out() << "d";
+
+    std::ostringstream o, e, both;
+    b.flush_to(o, e);
+    EXPECT_EQ(o.str(), "ad");
+    EXPECT_EQ(e.str(), "bc");
+    EXPECT_TRUE(b.empty());
+
+    b.out() << "1";
+    b.err() << "2";
+    b.out() << "3";
+    b.flush_to(both, both);
+    EXPECT_EQ(both.str(), "123");
+}
+
+TEST(Batch, OrderedOutput)
+{
+    // enough lines for many blocks
+    std::ostringstream input, expected;
+    for (int i = 0; i < 200000; i++) {
+        input << i << "\n";
+        if (i % 7 == 0) input << "\n";      // empty lines are skipped
+        if (i % 3 == 0) expected << "E" << i << "\n";
+        else            expected << "O" << i << "\n";
+    }
+    input << "last";    // no trailing newline
+    expected << "Olast\n";
+
+    std::istringstream in(input.str());
+    std::ostringstream out;
+    processBatch(in, out, out, 4, [](const char *s, size_t n, size_t, block_output &o) {
+        std::string line(s, n);
+        if (line != "last" && std::stoi(line) % 3 == 0) o.err() << "E" << line << "\n";
+        else                                             o.out() << "O" << line << "\n";
+    });
+
+    EXPECT_EQ(out.str(), expected.str());
+}
+
+TEST(Batch, InMemoryInput)
+{
+    std::string input = "a\n\nbb\nccc";
+
+    std::ostringstream out;
+    stream_sink sink(out, out);
+    processBatch(input.data(), input.size(), sink, 2, [](const char *s, size_t n, size_t, block_output &o) {
+        o.out() << n << ":";
+        o.out().write(s, n) << "\n";
+    });
+
+    EXPECT_EQ(out.str(), "1:a\n2:bb\n3:ccc\n");
+}
+
+TEST(MappedFile, Read)
+{
+    const char *path = "test-mapped-file.tmp";
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << "1+1\n2*x\n";
+    }
+    {
+        mapped_file m(path);
+        ASSERT_EQ(m.size(), 8);
+        EXPECT_EQ(std::string(m.data(), m.size()), "1+1\n2*x\n");
+    }
+    std::remove(path);
+
+    EXPECT_THROW(mapped_file("no-such-file.tmp"), mapped_file::error);
+}
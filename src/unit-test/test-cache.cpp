@@ -0,0 +1,135 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "cache.h"
+
+
+using atom  = affine<double>;
+using cache = result_cache<atom>;
+
+namespace {
+
+std::string key_of(const std::string &line)
+{
+    std::string key;
+    cache::normalize(tokenize_view(line), key);
+    return key;
+}
+
+double coef(const atom &a, const std::string &name)
+{
+    auto i = a.x.find(symbol_table::intern(name));
+    return i == a.x.end() ? 0 : i->second;
+}
+
+std::shared_ptr<const cache::value> parsed(const std::string &line)
+{
+    auto v = std::make_shared<cache::value>();
+    v->results = parser<atom>::parse(tokenize_view(line));
+    return v;
+}
+
+}
+
+TEST(ResultCache, NormalizedKey)
+{
+    EXPECT_EQ(key_of("2*x + 1 = 0"), key_of(" 2 * x+1=0 "));
+    EXPECT_NE(key_of("1 2"), key_of("12"));
+    EXPECT_NE(key_of("x+1"), key_of("x-1"));
+}
+
+TEST(ResultCache, HitMiss)
+{
+    cache c(1 << 20);
+    EXPECT_EQ(c.find(key_of("2*x=1")), nullptr);
+
+    c.insert(key_of("2*x=1"), parsed("2*x=1"));
+    auto v = c.find(key_of("2 * x = 1"));
+    ASSERT_NE(v, nullptr);
+    ASSERT_EQ(v->results.size(), 1);
+    EXPECT_TRUE(v->results[0].equal_to_zero);
+    EXPECT_EQ(coef(v->results[0].atom, "x"), 2.0);
+
+    auto st = c.stats();
+    EXPECT_EQ(st.hits, 1);
+    EXPECT_EQ(st.misses, 1);
+    EXPECT_EQ(st.entries, 1);
+    EXPECT_GT(st.bytes, 0);
+}
+
+TEST(ResultCache, Error)
+{
+    // the error is stored by token index; the caret follows the spacing of each line
+    cache c(1 << 20);
+    std::string line = "1 + (2", other_line = "1+(2";
+    auto tokens = tokenize_view(line);
+    auto v = std::make_shared<cache::value>();
+    v->failed = true;
+    v->error_token = 4;
+    v->error_msg = "missing right parenthesis";
+    c.insert(key_of("1 + (2"), v);
+
+    auto other = tokenize_view(other_line);
+    auto hit = c.find(key_of(other_line));
+    ASSERT_NE(hit, nullptr);
+    EXPECT_TRUE(hit->failed);
+    EXPECT_EQ(tokens[hit->error_token].pos, 6);
+    EXPECT_EQ(other[hit->error_token].pos, 4);
+}
+
+TEST(ResultCache, Eviction)
+{
+    // one shard: least recently used entries go first
+    auto v = parsed("x + 1");
+    std::string k0 = key_of("0");
+    cache probe(1 << 20, 1);
+    probe.insert(k0, v);
+    size_t entry = probe.stats().bytes;
+
+    cache c(3 * entry + entry / 2, 1);
+    for (int i = 0; i < 3; i++) c.insert(key_of(std::to_string(i)), v);
+    EXPECT_NE(c.find(key_of("0")), nullptr);    // 0 becomes the most recent
+
+    c.insert(key_of("3"), v);
+    auto st = c.stats();
+    EXPECT_EQ(st.entries, 3);
+    EXPECT_EQ(st.evictions, 1);
+    EXPECT_LE(st.bytes, 3 * entry + entry / 2);
+    EXPECT_EQ(c.find(key_of("1")), nullptr);
+    EXPECT_NE(c.find(key_of("0")), nullptr);
+    EXPECT_NE(c.find(key_of("3")), nullptr);
+
+    // a value larger than the budget is not kept
+    cache tiny(16, 1);
+    tiny.insert(k0, v);
+    EXPECT_EQ(tiny.stats().entries, 0);
+}
+
+TEST(ResultCache, Threads)
+{
+    cache c(64 << 10, 4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&c, t]() {
+            for (int i = 0; i < 2000; i++) {
+                std::string line = std::to_string((i * 7 + t) % 300) + "*x = 1";
+                auto k = key_of(line);
+                auto v = c.find(k);
+                if (!v) c.insert(k, parsed(line));
+                else    EXPECT_DOUBLE_EQ(coef(v->results[0].atom, "x"), double((i * 7 + t) % 300));
+            }
+        });
+    }
+    for (auto &t : threads) t.join();
+
+    auto st = c.stats();
+    EXPECT_EQ(st.hits + st.misses, 8000);
+    EXPECT_LE(st.bytes, 64 << 10);
+}
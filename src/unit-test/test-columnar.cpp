@@ -0,0 +1,201 @@
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "program.h"
+#include "columnar.h"
+
+
+namespace {
+
+// instruction sets available on this machine
+std::vector<simd_isa> isas()
+{
+    std::vector<simd_isa> r = { simd_isa::scalar };
+    if (detectIsa() != simd_isa::scalar) r.push_back(simd_isa::sse2);
+    if (detectIsa() == simd_isa::avx2)   r.push_back(simd_isa::avx2);
+    return r;
+}
+
+// columnar results of the first expression of 'input' against evaluator<double>, row by row:
+// exact with the default kernels, within 'tolerance' with the approximate ones; the relative
+// tolerance is scaled by |log(result)|, the error of exp(b*log(a)) grows with it
+void compare(const std::string &input, const std::vector<std::vector<double>> &columns, double tolerance)
+{
+    auto p = program<double>::compile(tokenize(input));
+    size_t rows = columns[0].size();
+
+    std::vector<double> expected(rows);
+    evaluator<double> ev(p);
+    std::vector<double> b(p.vars.size());
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t v = 0; v < b.size(); v++) b[v] = columns[v][i];
+        expected[i] = ev.run(b.data())[0].atom;
+    }
+
+    std::vector<const double*> bindings;
+    for (auto &c : columns) bindings.push_back(c.data());
+
+    for (auto isa : isas()) {
+        for (bool approximate : { false, true }) {
+            column_evaluator ce(p, 0, isa, approximate);
+            ASSERT_EQ(ce.isa(), isa);
+            std::vector<double> out(rows);
+            ce.run(bindings.data(), rows, out.data());
+
+            for (size_t i = 0; i < rows; i++) {
+                SCOPED_TRACE(input + " row " + std::to_string(i) + " " + isaName(isa) + (approximate ? " approximate" : ""));
+                if (std::isnan(expected[i])) EXPECT_TRUE(std::isnan(out[i]));
+                else if (!approximate || tolerance == 0 || std::isinf(expected[i]) || expected[i] == 0) EXPECT_EQ(out[i], expected[i]);
+                else EXPECT_NEAR(out[i], expected[i], tolerance * std::abs(expected[i]) * std::max(1.0, std::abs(std::log(std::abs(expected[i])))));
+            }
+        }
+    }
+}
+
+std::vector<double> random_column(size_t n, double lo, double hi, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> d(lo, hi);
+    std::vector<double> r(n);
+    for (auto &v : r) v = d(gen);
+    return r;
+}
+
+}
+
+TEST(Columnar, Arithmetic)
+{
+    // 1037 rows: several tiles and a tail shorter than a vector
+    auto a = random_column(1037, -100, 100, 1);
+    auto b = random_column(1037, -100, 100, 2);
+
+    compare("a + b*3 - (a - b)/7", { a, b }, 0);
+    compare("-a*-b/(a+b) + -2", { a, b }, 0);
+    compare("a", { a }, 0);
+    compare("2.5", { a }, 0);
+}
+
+TEST(Columnar, LogPow)
+{
+    auto a = random_column(1001, 1e-3, 1e3, 3);
+    auto b = random_column(1001, -20, 20, 4);
+
+    compare("log(a)", { a }, 4e-16);
+    compare("a^b", { a, b }, 1e-15);
+    compare("log(a*a)^0.5 - a^-1.5", { a }, 1e-15);
+}
+
+TEST(Columnar, IntegerPowers)
+{
+    // the approximate kernels give 8.999999999999998 for 3^2 and 10.000000000000002 for 10^1
+    std::vector<double> a, b;
+    for (int i = -20; i <= 20; i++) a.push_back(i);
+    for (int i = -20; i <= 20; i++) b.push_back(i % 7);
+
+    for (auto &input : { "a^2", "a^3", "10^a", "2^a", "a^b", "log(a*a)", "(a^2)^0.5" }) {
+        auto p = program<double>::compile(tokenize(input));
+        std::vector<const double*> bindings = { a.data(), b.data() };
+        std::vector<double> out(a.size());
+        evaluator<double> ev(p);
+        for (auto isa : isas()) {
+            column_evaluator(p, 0, isa).run(bindings.data(), a.size(), out.data());
+            for (size_t i = 0; i < a.size(); i++) {
+                double row[] = { a[i], b[i] };
+                double expected = ev.run(row)[0].atom;
+                if (std::isnan(expected)) EXPECT_TRUE(std::isnan(out[i]));
+                else EXPECT_EQ(out[i], expected) << input << " a=" << a[i] << " " << isaName(isa);
+            }
+        }
+    }
+}
+
+TEST(Columnar, SpecialValues)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    std::vector<double> a = { 0, -0.0, -1, inf, nan, 1e-310, -2, -2, 0, 0,  2,     2,     -8,     1, nan, 4 };
+    std::vector<double> b = { 1, 2,    3,  2,   0,   2,      3,  0.5, 0, -1, 2000, -1074, 1.0/3, nan, 0, 0.5 };
+
+    // out of domain lanes are exact, the others within rounding
+    compare("log(a)", { a }, 1e-15);
+    compare("a^b", { a, b }, 1e-15);
+    compare("a/b", { a, b }, 0);
+}
+
+TEST(Columnar, ResultSelection)
+{
+    auto p = program<double>::compile(tokenize("x + 1, 2*x = 3, x^2"));
+    std::vector<double> x = { 1, 2, 3 };
+    const double *cols[] = { x.data() };
+    std::vector<double> out(3);
+
+    column_evaluator(p, 1).run(cols, 3, out.data());
+    EXPECT_EQ(out, std::vector<double>({ -1, 1, 3 }));
+
+    column_evaluator(p, 2).run(cols, 3, out.data());
+    EXPECT_EQ(out, std::vector<double>({ 1, 4, 9 }));
+
+    EXPECT_THROW(column_evaluator(p, 3), column_error);
+}
+
+TEST(Columnar, Optimized)
+{
+    // the second result loads log(x)*x of the first one
+    auto p = program<double>::compile(tokenize("log(x)*x + 1, log(x)*x / 2"));
+    p.optimize();
+    ASSERT_EQ(p.temps, 1u);
+    size_t first, last;
+    ASSERT_TRUE(p.range(1, first, last));
+    EXPECT_EQ(first, 0u);
+
+    auto x = random_column(1037, 1, 100, 5);
+    const double *cols[] = { x.data() };
+    std::vector<double> out(x.size());
+    evaluator<double> ev(p);
+    for (size_t r = 0; r < 2; r++) {
+        for (auto isa : isas()) {
+            column_evaluator(p, r, isa).run(cols, x.size(), out.data());
+            for (size_t i = 0; i < x.size(); i++) ASSERT_NEAR(out[i], ev.run(&x[i])[r].atom, 1e-13 * std::abs(out[i])) << isaName(isa);
+        }
+    }
+}
+
+TEST(Columnar, ReadCsv)
+{
+    std::string csv = "x, y\r\n1, 2.5\n\n-3,1e3\n";
+    auto t = column_table::readCsv(csv.data(), csv.size());
+    ASSERT_EQ(t.rows, 2);
+    EXPECT_EQ(t.names, std::vector<std::string>({ "x", "y" }));
+    EXPECT_EQ(t.column("x"), std::vector<double>({ 1, -3 }));
+    EXPECT_EQ(t.column("y"), std::vector<double>({ 2.5, 1000 }));
+    EXPECT_THROW(t.column("z"), column_error);
+
+    auto p = program<double>::compile(tokenize("y/x"));
+    column_evaluator ev(p);
+    std::vector<double> out(t.rows);
+    ev.run(ev.bind(t).data(), t.rows, out.data());
+    EXPECT_EQ(out, std::vector<double>({ 2.5, 1000 / -3.0 }));
+
+    std::string bad = "x,y\n1,2\n3\n";
+    EXPECT_THROW(column_table::readCsv(bad.data(), bad.size()), column_error);
+    bad = "x\n1a\n";
+    EXPECT_THROW(column_table::readCsv(bad.data(), bad.size()), column_error);
+}
+
+TEST(Columnar, ReadBinary)
+{
+    double data[] = { 1, 2, 3, 10, 20, 30 };
+    auto t = column_table::readBinary(reinterpret_cast<const char*>(data), sizeof(data), { "a", "b" });
+    ASSERT_EQ(t.rows, 3);
+    EXPECT_EQ(t.column("b"), std::vector<double>({ 10, 20, 30 }));
+
+    EXPECT_THROW(column_table::readBinary(reinterpret_cast<const char*>(data), sizeof(data), { "a", "b", "c", "d" }), column_error);
+}
@@ -0,0 +1,251 @@
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "system.h"
+#include "double_double.h"
+#include "float128.h"
+
+
+namespace {
+
+using dd = double_double;
+
+dd parse(const std::string &s)
+{
+    dd v;
+    EXPECT_TRUE(parseNumber(s.data(), s.data() + s.size(), v)) << s;
+    return v;
+}
+
+template<typename T>
+std::string text(const T &v, int precision = 6)
+{
+    std::ostringstream ss;
+    ss.precision(precision);
+    ss << v;
+    return ss.str();
+}
+
+// |a - b| relative to |b|
+double relative(const dd &a, const dd &b)
+{
+    return std::fabs(double((a - b) / b));
+}
+
+// the solution of the equation 'input' in one variable, or the value of the expression
+template<typename T>
+std::string solve(const std::string &input)
+{
+    auto r = parser<affine<T>>::parse(tokenize(input)).at(0);
+    std::ostringstream ss;
+    auto &x = r.atom.x;
+    if (r.equal_to_zero && x.size() == 1) ss << symbol_table::name(x.begin()->first) << " = " << -r.atom.d / x.begin()->second;
+    else ss << r.atom;
+    return ss.str();
+}
+
+// the largest error of the solution of the n x n Hilbert system whose solution is all ones
+template<typename T>
+double hilbertError(int n)
+{
+    std::string eqs;
+    for (int i = 1; i <= n; i++) {
+        std::string lhs, rhs = "0";
+        for (int j = 1; j <= n; j++) {
+            lhs += (j > 1 ? " + x" : "x") + std::to_string(j) + "/" + std::to_string(i + j - 1);
+            rhs += " + 1/" + std::to_string(i + j - 1);
+        }
+        eqs += (i > 1 ? ", " : "") + lhs + " = " + rhs;
+    }
+
+    sparse_system<T> system;
+    for (auto &r : parser<affine<T>>::parse(tokenize(eqs))) system.add(r.atom);
+    auto s = system.solve();
+    EXPECT_EQ(s.kind, sparse_system<T>::status::unique);
+
+    double error = 0;
+    for (auto &v : s.values) error = std::max(error, std::fabs(double(v.second.d - T(1))));
+    return error;
+}
+
+}
+
+TEST(DoubleDouble, Arithmetic)
+{
+    EXPECT_EQ(dd(1e17) + 1 - 1e17, dd(1));
+    EXPECT_EQ(double((dd(1) + 1e-20) - 1), 1e-20);
+    dd p = dd::product(134217729, 134217729);      // 2^54 + 2^28 + 1
+    EXPECT_EQ(p.high(), std::ldexp(1.0, 54) + std::ldexp(1.0, 28));
+    EXPECT_EQ(p.low(), 1);
+
+    dd third = dd(1) / 3;
+    EXPECT_LT(std::fabs(double(third * 3 - 1)), 1e-31);
+    EXPECT_NE(third.low(), 0);
+    EXPECT_LT(relative(dd(2) / 7 * 7, 2), 1e-31);
+
+    EXPECT_TRUE(dd(1) < dd(1) + 1e-25);
+    EXPECT_TRUE(dd(1) + 1e-25 > 1);
+    EXPECT_TRUE(dd(-0.0) == 0);
+    EXPECT_FALSE(dd(std::nan("")) == dd(std::nan("")));
+    EXPECT_EQ(abs(dd(-2) - 1e-20), dd(2) + 1e-20);
+
+    EXPECT_EQ((dd(1) / 0).high(), std::numeric_limits<double>::infinity());
+    EXPECT_EQ((dd(1e300) * 1e300).high(), std::numeric_limits<double>::infinity());
+    EXPECT_TRUE(std::isnan((dd(0) / 0).high()));
+    EXPECT_EQ((dd(1) / 0).low(), 0);
+
+    EXPECT_EQ(floor(dd(2) - 1e-20), dd(1));
+    EXPECT_EQ(floor(dd(2.5) + 1e-20), dd(2));
+    EXPECT_EQ(floor(dd(-2) + 1e-20), dd(-2));
+}
+
+TEST(DoubleDouble, Functions)
+{
+    const dd e = parse("2.718281828459045235360287471352662");
+    const dd ln10 = parse("2.302585092994045684017991454684364");
+    const dd sqrt2 = parse("1.414213562373095048801688724209698");
+
+    EXPECT_LT(relative(exp(dd(1)), e), 1e-31);
+    EXPECT_LT(relative(log(dd(10)), ln10), 1e-31);
+    EXPECT_LT(relative(pow(dd(2), dd(0.5)), sqrt2), 1e-31);
+    EXPECT_LT(relative(log(e), 1), 1e-31);
+    EXPECT_LT(relative(exp(log(dd(1e200))), 1e200), 1e-30);
+    EXPECT_LT(relative(log(dd(1e-300)), -parse("690.7755278982137051803383445701005")), 1e-31);
+    EXPECT_EQ(log(dd(1)), dd(0));
+
+    // integer powers are products
+    EXPECT_EQ(pow(dd(2), dd(100)), dd(std::ldexp(1.0, 100)));
+    EXPECT_EQ(pow(dd(3), dd(40)), parse("12157665459056928801"));
+    EXPECT_EQ(pow(dd(-2), dd(3)), dd(-8));
+    EXPECT_LT(relative(pow(dd(10), dd(-5)), parse("1e-5")), 1e-31);
+    // results below the normal range, whose positive powers overflow
+    EXPECT_EQ(pow(dd(2), dd(-1030)).high(), std::ldexp(1.0, -1030));
+    EXPECT_EQ(pow(dd(2), dd(-1074)).high(), std::ldexp(1.0, -1074));
+    EXPECT_EQ(pow(dd(10), dd(-310)).high(), 1e-310);
+    EXPECT_EQ(pow(dd(-10), dd(-309)).high(), -1e-309);
+    EXPECT_EQ(pow(dd(0.5), dd(-1030)).high(), std::numeric_limits<double>::infinity());
+
+    // special cases as std::pow
+    const double inf = std::numeric_limits<double>::infinity();
+    EXPECT_EQ(pow(dd(0), dd(-1)).high(), inf);
+    EXPECT_EQ(pow(dd(-0.0), dd(-1)).high(), -inf);
+    EXPECT_EQ(pow(dd(0), dd(0.5)).high(), 0);
+    EXPECT_EQ(pow(dd(std::nan("")), dd(0)), dd(1));
+    EXPECT_EQ(pow(dd(-1), dd(1e19)), dd(1));
+    EXPECT_TRUE(std::isnan(pow(dd(-8), dd(1) / 3).high()));
+    EXPECT_EQ(pow(dd(inf), dd(-0.5)).high(), 0);
+    EXPECT_EQ(log(dd(0)).high(), -inf);
+    EXPECT_TRUE(std::isnan(log(dd(-1)).high()));
+    EXPECT_EQ(exp(dd(1000)).high(), inf);
+    EXPECT_EQ(exp(dd(-1000)).high(), 0);
+}
+
+TEST(DoubleDouble, Parse)
+{
+    dd v = parse("0.1");
+    EXPECT_EQ(v.high(), 0.1);
+    EXPECT_EQ(v.low(), -5.551115123125783e-18);    // 0.1 - double(0.1)
+    EXPECT_EQ(parse("123456789012345678901234567890"), dd::product(123456789012345, 1e15) + 678901234567890);
+    EXPECT_EQ(parse("00.000"), dd(0));
+    EXPECT_EQ(parse(".5e+1"), dd(5));
+    EXPECT_EQ(parse("1E2"), dd(100));
+    EXPECT_EQ(parse("1.7976931348623157e308").high(), std::numeric_limits<double>::max());
+    EXPECT_LT(relative(parse("0.00000000000000000000000000000000000000001e41"), 1), 1e-31);
+    EXPECT_LT(relative(parse("1" + std::string(400, '0') + "e-400"), 1), 1e-31);
+
+    for (auto bad : { "", ".", "e5", "1e", "1e+", "1x", "-1", "1e309", "1e-400", "2e-324" }) {
+        std::string s(bad);
+        EXPECT_FALSE(parseNumber(s.data(), s.data() + s.size(), v)) << s;
+    }
+
+    std::istringstream is(" -1.5e3 2e-1+x");
+    dd a, b, c;
+    is >> a >> b;
+    EXPECT_EQ(a, dd(-1500));
+    EXPECT_EQ(b, parse("0.2"));
+    EXPECT_TRUE((is >> c).fail());
+}
+
+TEST(DoubleDouble, Format)
+{
+    // doubles print as with printf
+    std::mt19937_64 gen(7);
+    for (int i = 0; i < 20000; i++) {
+        uint64_t bits = gen();
+        double x;
+        memcpy(&x, &bits, sizeof(x));
+        if (!std::isfinite(x)) continue;
+        int precision = 1 + i % 17;
+        char expected[64];
+        snprintf(expected, sizeof(expected), "%.*g", precision, x);
+        ASSERT_EQ(text(dd(x), precision), expected) << precision;
+    }
+
+    EXPECT_EQ(text(dd(1) / 3, 32), "0.33333333333333333333333333333333");
+    EXPECT_EQ(text(pow(dd(2), dd(100)), 32), "1267650600228229401496703205376");
+    EXPECT_EQ(text(dd(1e17) + 1, 20), "100000000000000001");
+    EXPECT_EQ(text(dd(-1) / 0), "-inf");
+    EXPECT_EQ(text(dd(-0.0)), "-0");
+    EXPECT_EQ(text(dd(0.5), 40), "0.5");
+
+    // 32 digits parse back to within the precision
+    std::uniform_real_distribution<double> d(-300, 300);
+    for (int i = 0; i < 2000; i++) {
+        dd x = pow(dd(10), dd(d(gen))) * (dd(1) + dd(1) / (i + 3));
+        ASSERT_LT(relative(parse(text(x, 32)), x), 1e-30) << text(x, 32);
+    }
+
+    std::string s = "x = ";
+    appendNumber(s, dd(1) / 8);
+    EXPECT_EQ(s, "x = 0.125");
+}
+
+TEST(DoubleDouble, Backend)
+{
+    // the coefficient 1 of x is lost in double
+    EXPECT_EQ(solve<dd>("(1e17 + 1)*x - 1e17*x = 2"), "x = 2");
+    EXPECT_NE(solve<double>("(1e17 + 1)*x - 1e17*x = 2"), "x = 2");
+
+    EXPECT_EQ(solve<dd>("2*x + 1 = 0"), "x = -0.5");
+    EXPECT_EQ(solve<dd>("log(100)^2 - 2^-0.5*7"), "16.2578");
+    EXPECT_EQ(solve<dd>("3*(x + y) - 2*y"), "3*x + y");
+
+    // ill-conditioned system
+    double error = hilbertError<dd>(8);
+    EXPECT_LT(error, 1e-18);
+    EXPECT_GT(hilbertError<double>(8), 1000 * error);
+}
+
+#ifdef CALCULATOR_FLOAT128
+
+TEST(Float128, Backend)
+{
+    float128 v;
+    std::string s = "0.1";
+    ASSERT_TRUE(parseNumber(s.data(), s.data() + s.size(), v));
+    EXPECT_EQ(text(v * 3, 34), "0.3");
+    EXPECT_EQ(text(v * 3), "0.3");
+    EXPECT_EQ(text(pow(float128(2), float128(0.5)), 34), "1.414213562373095048801688724209698");
+    EXPECT_EQ(text(log(float128(10)), 30), "2.30258509299404568401799145468");
+    EXPECT_EQ(text(float128(-1) / 0), "-inf");
+
+    s = "1e4933";
+    EXPECT_FALSE(parseNumber(s.data(), s.data() + s.size(), v));
+    s = "1e309";
+    EXPECT_TRUE(parseNumber(s.data(), s.data() + s.size(), v));
+
+    EXPECT_EQ(solve<float128>("(1e17 + 1)*x - 1e17*x = 2"), "x = 2");
+    EXPECT_LT(hilbertError<float128>(8), 1e-18);
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "system.h"
+#include "format.h"
+#include "driver.h"
+
+
+namespace {
+
+using atom = affine<double>;
+
+// the records of the results of 'input', one formatter line
+std::string format(const std::string &input, output_format f)
+{
+    result_formatter<double> formatter(f);
+    std::string s;
+    for (auto &z : parser<atom>::parse(tokenize(input))) {
+        if (z.equal_to_zero) formatter.equation(s, z.atom);
+        else                 formatter.expression(s, z.atom);
+    }
+    return s;
+}
+
+std::string system(const std::string &input, output_format f)
+{
+    sparse_system<double> system;
+    for (auto &z : parser<atom>::parse(tokenize(input))) system.add(z.atom);
+    auto solution = system.solve();
+    std::string s;
+    result_formatter<double>(f).system(s, solution);
+    return s;
+}
+
+// reader of the binary records
+struct record_reader {
+    const std::string &s;
+    size_t at = 0;
+
+    uint32_t u32() {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) v |= uint32_t(uint8_t(s.at(at++))) << (8 * i);
+        return v;
+    }
+    std::string str() {
+        uint32_t n = u32();
+        at += n;
+        return s.substr(at - n, n);
+    }
+    double number() {
+        uint64_t bits = u32();
+        bits |= uint64_t(u32()) << 32;
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+};
+
+}
+
+TEST(Format, Text)
+{
+    // the output of the stream formatting
+    EXPECT_EQ(format("2*x - y + 1, -x - 2.5*z - 3", output_format::text), "Result: 2*x - y + 1\nResult: -x - 2.5*z - 3\n");
+    EXPECT_EQ(format("2*x = 1", output_format::text), "Result: x = 0.5\n");
+    EXPECT_EQ(format("x + y = x + y", output_format::text), "Result: True.    This holds for any x,y.\n");
+    EXPECT_EQ(format("1 = 2, x + 2*y - 1 = 0", output_format::text), "Result: Not true.\nResult: x + 2*y - 1 = 0\n");
+    EXPECT_EQ(system("x + y = 2, x - y = 0", output_format::text), "Result: x = 1\nResult: y = 1\n");
+    EXPECT_EQ(system("x + y = 2, 2*x + 2*y = 4", output_format::text), "Result: x = -y + 2    This holds for any y.\n");
+    EXPECT_EQ(system("x = 1, x = 2", output_format::text), "Result: Not true.\n");
+
+    auto a = parser<atom>::parse(tokenize("b - 3*a + 0.25")).at(0).atom;
+    std::ostringstream os;
+    os << a;
+    std::string s;
+    a.appendTo(s);
+    EXPECT_EQ(s, "-3*a + b + 0.25");
+    EXPECT_EQ(os.str(), s);
+
+    std::string e;
+    appendError(e, "1+*2", 4, 2, "unexpected token");
+    EXPECT_EQ(e, "\n1+*2\n  ^~~~~ unexpected token\n");
+}
+
+TEST(Format, Json)
+{
+    EXPECT_EQ(format("2*x - y + 1, 2*x = 1", output_format::json),
+              "{\"result\":0,\"kind\":\"expression\",\"terms\":{\"x\":2,\"y\":-1},\"constant\":1}\n"
+              "{\"result\":1,\"kind\":\"solution\",\"var\":\"x\",\"value\":0.5,\"free\":[]}\n");
+    EXPECT_EQ(format("x + y = x + y + 1, z - z = 0", output_format::json),
+              "{\"result\":0,\"kind\":\"false\"}\n"
+              "{\"result\":1,\"kind\":\"true\",\"free\":[\"z\"]}\n");
+    EXPECT_EQ(format("x + 2*y = 0.1", output_format::json),
+              "{\"result\":0,\"kind\":\"equation\",\"terms\":{\"x\":1,\"y\":2},\"constant\":-0.1,\"free\":[]}\n");
+    EXPECT_EQ(system("x + y = 2, 2*x + 2*y = 4", output_format::json),
+              "{\"result\":0,\"kind\":\"system\",\"values\":[{\"var\":\"x\",\"terms\":{\"y\":-1},\"constant\":2}],\"free\":[\"y\"]}\n");
+
+    // all the digits, and strings for what a JSON number can't hold
+    EXPECT_EQ(format("1/3", output_format::json), "{\"result\":0,\"kind\":\"expression\",\"terms\":{},\"constant\":0.3333333333333333}\n");
+    EXPECT_EQ(format("x - 1e300*1e300", output_format::json), "{\"result\":0,\"kind\":\"expression\",\"terms\":{\"x\":1},\"constant\":\"-inf\"}\n");
+
+    std::string s;
+    appendJsonString(s, "a\"b\\c\n\x01", 7);
+    EXPECT_EQ(s, "\"a\\\"b\\\\c\\n\\u0001\"");
+    for (auto n : { "0", "-1.5", "2e-7", "1E+10" }) {
+        s = n;
+        quoteJsonNumber(s, 0);
+        EXPECT_EQ(s, n);
+    }
+    for (auto n : { "nan", "-inf", "1/3", "01", "1.", ".5", "1e" }) {
+        s = n;
+        quoteJsonNumber(s, 0);
+        EXPECT_EQ(s, "\"" + std::string(n) + "\"");
+    }
+}
+
+TEST(Format, Binary)
+{
+    std::string s = format("2*x - y + 0.5, x = 3", output_format::binary);
+    record_reader r{ s };
+
+    uint32_t size = r.u32();
+    EXPECT_EQ(size, 1 + 4 + 4 + (4 + 1 + 8) * 2 + 8);
+    EXPECT_EQ(uint8_t(s[r.at++]), uint8_t(record_kind::expression));
+    EXPECT_EQ(r.u32(), 0u);
+    ASSERT_EQ(r.u32(), 2u);
+    EXPECT_EQ(r.str(), "x");
+    EXPECT_EQ(r.number(), 2.0);
+    EXPECT_EQ(r.str(), "y");
+    EXPECT_EQ(r.number(), -1.0);
+    EXPECT_EQ(r.number(), 0.5);
+    EXPECT_EQ(r.at, size + 4);
+
+    r.u32();
+    EXPECT_EQ(uint8_t(s[r.at++]), uint8_t(record_kind::solution));
+    EXPECT_EQ(r.u32(), 1u);
+    EXPECT_EQ(r.str(), "x");
+    EXPECT_EQ(r.number(), 3.0);
+    EXPECT_EQ(r.u32(), 0u);     // free variables
+    EXPECT_EQ(r.at, s.size());
+}
+
+TEST(Format, Driver)
+{
+    // the records of a line are numbered from 0; errors are records of the output
+    line_context ctx;
+    ctx.formatter = result_formatter<numtype>(output_format::json);
+    block_output out;
+    for (std::string line : { "1 + 2, x = 4", "2*(3" }) processLine(line.data(), line.size(), ctx, out);
+
+    std::ostringstream o, e;
+    out.flush_to(o, e);
+    EXPECT_EQ(o.str(), "{\"result\":0,\"kind\":\"expression\",\"terms\":{},\"constant\":3}\n"
+                       "{\"result\":1,\"kind\":\"solution\",\"var\":\"x\",\"value\":4,\"free\":[]}\n"
+                       "{\"result\":0,\"kind\":\"error\",\"pos\":4,\"message\":\"missing right parenthesis\",\"input\":\"2*(3\"}\n");
+    EXPECT_EQ(e.str(), "");
+
+    ctx.formatter = result_formatter<numtype>(output_format::text);
+    std::string line = "2*(3";
+    processLine(line.data(), line.size(), ctx, out);
+    out.flush_to(o, e);
+    EXPECT_EQ(e.str(), "\n2*(3\n    ^~~~~ missing right parenthesis\n");
+}
@@ -0,0 +1,213 @@
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "program.h"
+#include "jit.h"
+
+
+namespace {
+
+// random expression of the grammar over the variables a-d
+std::string randomExpr(std::mt19937 &gen, int depth)
+{
+    static const char *leaves[] = { "a", "b", "c", "d", "2", "0.5", "3", "0", "1e300", "7.25" };
+    if (depth == 0 || gen() % 4 == 0) return leaves[gen() % 10];
+
+    switch (gen() % 9) {
+    case 0:  return randomExpr(gen, depth - 1) + " + " + randomExpr(gen, depth - 1);
+    case 1:  return randomExpr(gen, depth - 1) + " - " + randomExpr(gen, depth - 1);
+    case 2:  return randomExpr(gen, depth - 1) + " * " + randomExpr(gen, depth - 1);
+    case 3:  return randomExpr(gen, depth - 1) + " / " + randomExpr(gen, depth - 1);
+    case 4:  return "(" + randomExpr(gen, depth - 1) + ")^" + leaves[gen() % 10];
+    case 5:  return "log(" + randomExpr(gen, depth - 1) + ")";
+    case 6:  return "-" + randomExpr(gen, depth - 1);
+    default: return "(" + randomExpr(gen, depth - 1) + ")";
+    }
+}
+
+bool sameBits(double x, double y)
+{
+    if (std::isnan(x) && std::isnan(y)) return true;
+    return memcmp(&x, &y, sizeof(double)) == 0;
+}
+
+// native results of every expression of 'input' against evaluator<double>, row by row
+void compare(const std::string &input, const std::vector<std::vector<double>> &columns, simd_isa isa, bool optimize = false)
+{
+    auto p = program<double>::compile(tokenize(input));
+    if (optimize) p.optimize();
+    size_t rows = columns[0].size();
+
+    std::vector<const double*> bindings;
+    for (size_t v = 0; v < p.vars.size(); v++) bindings.push_back(columns[p.vars[v][0] - 'a'].data());
+
+    evaluator<double> ev(p);
+    std::vector<double> b(p.vars.size());
+    for (size_t r = 0; r < p.results; r++) {
+        jit_function f(p, r, isa);
+        std::vector<double> out(rows);
+        f.run(bindings.data(), rows, out.data());
+
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t v = 0; v < b.size(); v++) b[v] = bindings[v][i];
+            double expected = ev.run(b.data())[r].atom;
+            ASSERT_TRUE(sameBits(out[i], expected)) << input << " result " << r << " row " << i << ": " << out[i] << " != " << expected;
+        }
+    }
+}
+
+std::vector<double> randomColumn(size_t n, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> d(-10, 10);
+    std::vector<double> r(n);
+    for (auto &v : r) v = gen() % 8 == 0 ? double(int(d(gen))) : d(gen);    // some integers, zeros
+    return r;
+}
+
+std::vector<simd_isa> isas()
+{
+    std::vector<simd_isa> r = { simd_isa::sse2 };
+    if (detectIsa() == simd_isa::avx2) r.push_back(simd_isa::avx2);
+    return r;
+}
+
+}
+
+TEST(Jit, Native)
+{
+    auto p = program<double>::compile(tokenize("a*2 + 1"));
+    jit_function f(p);
+#if defined(__x86_64__) && defined(__linux__)
+    EXPECT_TRUE(f.native());
+    EXPECT_GT(f.code_size(), 0u);
+    EXPECT_EQ(f.packed(), detectIsa() == simd_isa::avx2);
+#else
+    EXPECT_FALSE(f.native());
+#endif
+
+    double a[] = { 1, 2, 3, 4, 5, 6, 7 }, out[7];
+    const double *columns[] = { a };
+    f.run(columns, 7, out);
+    for (int i = 0; i < 7; i++) EXPECT_EQ(out[i], a[i] * 2 + 1);
+    f.run(columns, 0, out);
+
+    EXPECT_THROW(jit_function(p, 1), column_error);
+}
+
+TEST(Jit, Fixed)
+{
+    // 37 rows: packed iterations and a scalar tail
+    std::vector<std::vector<double>> columns = { randomColumn(37, 1), randomColumn(37, 2), randomColumn(37, 3), randomColumn(37, 4) };
+    for (auto isa : isas()) {
+        compare("a + b*3 - (a - b)/7", columns, isa);
+        compare("-a*-b/(a+b) + -2, a, 2.5, a = b", columns, isa);
+        compare("log(a) + log(b*b)*c, a^b, a^0.5 - b^2, (a*b)^(c/d)", columns, isa);
+        compare("log(log(a)), a^b^c, log(a)^log(b), c - log(a)/(b + log(d))", columns, isa);
+        compare("a*(b*(c*(d*(a+(b+(c+(d+(a*log(b)^(c-d))))))))), 1/0, -1/0, 0/0", columns, isa);
+    }
+}
+
+TEST(Jit, Differential)
+{
+    std::vector<std::vector<double>> columns = { randomColumn(23, 5), randomColumn(23, 6), randomColumn(23, 7), randomColumn(23, 8) };
+    std::mt19937 gen(42);
+    for (int i = 0; i < 400; i++) {
+        std::string e = randomExpr(gen, 6) + ", " + randomExpr(gen, 3) + " = " + randomExpr(gen, 3);
+        for (auto isa : isas()) compare(e, columns, isa);
+    }
+}
+
+TEST(Jit, Optimized)
+{
+    std::vector<std::vector<double>> columns = { randomColumn(23, 12), randomColumn(23, 13), randomColumn(23, 14), randomColumn(23, 15) };
+    for (auto isa : isas()) compare("log(a*b) + (a*b)^c - log(a*b)/(a*b), log(a*b)*d, 2*(a*b)", columns, isa, true);
+
+    // the optimized programs give the results of the original ones
+    std::mt19937 gen(43);
+    for (int i = 0; i < 400; i++) {
+        std::string l = randomExpr(gen, 4), e = l + " * " + l + " - " + randomExpr(gen, 5) + ", " + l + " + 1";
+        auto p = program<double>::compile(tokenize(e)), q = p;
+        q.optimize();
+        evaluator<double> ep(p), eq(q);
+        for (size_t row = 0; row < 23; row++) {
+            double b[] = { columns[0][row], columns[1][row], columns[2][row], columns[3][row] };
+            std::vector<double> v(p.vars.size());
+            for (size_t k = 0; k < v.size(); k++) v[k] = b[p.vars[k][0] - 'a'];
+            for (size_t r = 0; r < 2; r++) {
+                double x = ep.run(v.data())[r].atom, y = eq.run(v.data())[r].atom;
+                ASSERT_TRUE(sameBits(x, y) || x == y) << e << " result " << r << ": " << x << " != " << y;   // x+0 for x = -0
+            }
+        }
+        for (auto isa : isas()) compare(e, columns, isa, true);
+    }
+}
+
+TEST(Jit, Fallback)
+{
+    // 21 values on the stack do not fit the registers: the scalar kernels run instead
+    std::string deep = "b";
+    for (int i = 0; i < 20; i++) deep = "a*(c + " + deep + ")";
+
+    auto p = program<double>::compile(tokenize(deep));
+    ASSERT_GT(p.depth, 16u);
+    EXPECT_FALSE(jit_function(p).native());
+
+    std::vector<std::vector<double>> columns = { randomColumn(9, 9), randomColumn(9, 10), randomColumn(9, 11) };
+    compare(deep + ", log(" + deep + ")", columns, detectIsa());
+
+    // 16 values use all registers, with calls at the deepest level
+    std::string full = "log(b^c)";
+    for (int i = 0; i < 14; i++) full = (i % 2 ? "a - (" : "c / (") + full + ")";
+    p = program<double>::compile(tokenize(full));
+    ASSERT_EQ(p.depth, 16u);
+    EXPECT_EQ(jit_function(p).native(), jit_function(program<double>::compile(tokenize("a"))).native());
+    for (auto isa : isas()) compare(full, columns, isa);
+}
+
+TEST(Jit, Cache)
+{
+    jit_cache cache(2);
+    auto f = cache.get("a*2 + 1");
+    EXPECT_EQ(cache.get("a * 2+1"), f);     // same tokens
+    EXPECT_NE(cache.get("a*2 + 1, a", 1), f);
+    auto st = cache.stats();
+    EXPECT_EQ(st.hits, 1u);
+    EXPECT_EQ(st.misses, 2u);
+    EXPECT_EQ(st.entries, 2u);
+
+    cache.get("a*3");                       // drops the oldest
+    EXPECT_EQ(cache.stats().entries, 2u);
+    EXPECT_NE(cache.get("a*2 + 1"), f);
+
+    double a[] = { 1.5 }, out[1];
+    const double *columns[] = { a };
+    f->run(columns, 1, out);                // still valid after eviction
+    EXPECT_EQ(out[0], 4);
+
+    EXPECT_THROW(cache.get("a +"), program<double>::error);
+
+    // compiled programs: by code, result and instruction set
+    jit_cache programs;
+    auto p = program<double>::compile(tokenize("a*2 + 1, a - b"));
+    auto g = programs.get(p, 1, simd_isa::sse2);
+    EXPECT_EQ(programs.get(program<double>::compile(tokenize("a*2+1, a-b")), 1, simd_isa::sse2), g);
+    EXPECT_NE(programs.get(p, 0, simd_isa::sse2), g);
+    EXPECT_NE(programs.get(p, 1, simd_isa::scalar), g);
+    EXPECT_NE(programs.get(program<double>::compile(tokenize("a*2 + 1, a - c")), 1, simd_isa::sse2), g);
+    EXPECT_NE(programs.get(program<double>::compile(tokenize("a*2 + 1, a - 1")), 1, simd_isa::sse2), g);
+    st = programs.stats();
+    EXPECT_EQ(st.hits, 1u);
+    EXPECT_EQ(st.misses, 5u);
+
+    double b[] = { 0.5 };
+    const double *ab[] = { a, b };
+    g->run(ab, 1, out);
+    EXPECT_EQ(out[0], 1);
+}
@@ -2,10 +2,83 @@
 //
 #include <iostream>
 #include <vector>
+#include <string>
+#include <random>
+#include <cctype>
 
 #include <gtest/gtest.h>
 
 #include "lexer.h"
+#include "cpu.h"
+
+namespace {
+
+// the lexer as it was with the <cctype> functions, one character at a time
+std::vector<token_view> reference(const std::string &in)
+{
+    const char *s = in.data();
+    const size_t n = in.size();
+    std::vector<token_view> result;
+    auto digits = [&](size_t &i) { for (; i < n && isdigit(s[i]); i++) {} };
+
+    for (size_t i = 0; i < n;) {
+        char c = s[i];
+        if (isspace(c)) {
+            i++;
+            continue;
+        }
+        if (isdigit(c) || c == '.') {
+            const size_t numstart = i;
+            digits(i);
+            if (i < n && s[i] == '.') {
+                i++;
+                digits(i);
+                if (i == numstart + 1) {
+                    result.push_back({ tok_t::punct, tok_kind::none, s + numstart, 1, numstart });
+                    continue;
+                }
+            }
+            const size_t expstart = i;
+            if (i < n && tolower(s[i]) == 'e') {
+                i++;
+                if (i < n && (s[i] == '+' || s[i] == '-')) { i++; }
+                if (i == n || !isdigit(s[i])) i = expstart;
+                else                          digits(i);
+            }
+            result.push_back({ tok_t::num, tok_kind::none, s + numstart, i - numstart, numstart });
+        }
+        else if (isalpha(c)) {
+            const size_t idstart = i++;
+            for (; i < n && isalnum(s[i]); i++) {};
+            result.push_back({ tok_t::id, classify(tok_t::id, s + idstart, i - idstart), s + idstart, i - idstart, idstart });
+        }
+        else {
+            result.push_back({ tok_t::punct, classify(tok_t::punct, s + i, 1), s + i, 1, i });
+            i++;
+        }
+    }
+    result.push_back({ tok_t::end, tok_kind::none, s + n, 0, n });
+    return result;
+}
+
+// runs of random length of characters of one group, long ones among them
+std::string randomInput(std::mt19937 &gen, size_t size)
+{
+    static const std::string groups[] = {
+        "0123456789", " \t\n\v\f\r", "abcxyzEeABZlog019", ".eE+-", "*/^(),=!_~@[`{",
+        std::string("\0\x80\xe9\xff\x7f\x08\x0e/:", 9),
+    };
+    std::string s;
+    while (s.size() < size) {
+        auto &g = groups[gen() % 6];
+        size_t run = gen() % 4 == 0 ? gen() % 200 : gen() % 4;
+        for (size_t k = 0; k < run; k++) s += g[gen() % g.size()];
+    }
+    s.resize(size);
+    return s;
+}
+
+}
 
 TEST(Tokenize, Empty)
 {
@@ -88,3 +161,82 @@ TEST(Tokenize, Addition)
     };
     EXPECT_EQ(tokenize(" 1 + x   "), addition);
 }
+
+TEST(TokenizeView, Kinds)
+{
+    std::string input = "log(x)^2 - 1.5e3*y";
+    auto v = tokenize_view(input);
+
+    ASSERT_EQ(v.size(), 11);
+    EXPECT_EQ(v[0].kind, tok_kind::kw_log);
+    EXPECT_EQ(v[1].kind, tok_kind::lparen);
+    EXPECT_EQ(v[2].kind, tok_kind::none);
+    EXPECT_EQ(v[3].kind, tok_kind::rparen);
+    EXPECT_EQ(v[4].kind, tok_kind::caret);
+    EXPECT_EQ(v[6].kind, tok_kind::minus);
+    EXPECT_EQ(v[7].str(), "1.5e3");
+    EXPECT_EQ(v[8].kind, tok_kind::star);
+    EXPECT_EQ(v[10].type, tok_t::end);
+}
+
+TEST(TokenizeView, PointsIntoInput)
+{
+    std::string input = " 1 + x ";
+    auto v = tokenize_view(input);
+
+    ASSERT_EQ(v.size(), 4);
+    EXPECT_EQ(v[2].s, input.data() + 5);
+    EXPECT_EQ(v[2].len, 1);
+    EXPECT_EQ(v[3].pos, input.size());
+}
+
+TEST(TokenizeView, MatchesTokenize)
+{
+    std::string input = "  2*x + .5 = log(y1) ^ -1.e+ , ., z";
+    auto t = tokenize(input);
+    auto v = tokenize_view(input);
+
+    ASSERT_EQ(t.size(), v.size());
+    for (size_t i = 0; i < t.size(); i++) EXPECT_EQ(t[i], make_token(v[i]));
+}
+
+TEST(TokenizeView, MatchesReference)
+{
+    std::mt19937 gen(24);
+    std::vector<token_view> v;
+    for (int k = 0; k < 3000; k++) {
+        // ends at every offset within the vector width, and a few long lines
+        std::string input = randomInput(gen, k < 2900 ? gen() % 300 : 20000 + gen() % 5000);
+        auto expected = reference(input);
+        for (auto isa : { simd_isa::scalar, simd_isa::sse2, simd_isa::avx2 }) {
+            if (isa > detectIsa()) continue;
+            tokenize(input.data(), input.size(), v, isa);
+            ASSERT_EQ(v.size(), expected.size()) << isaName(isa) << " input " << k;
+            for (size_t i = 0; i < v.size(); i++) {
+                ASSERT_EQ(v[i].type, expected[i].type) << isaName(isa) << " input " << k << " token " << i;
+                ASSERT_EQ(v[i].kind, expected[i].kind);
+                ASSERT_EQ(v[i].s, expected[i].s);
+                ASSERT_EQ(v[i].len, expected[i].len);
+                ASSERT_EQ(v[i].pos, expected[i].pos);
+            }
+        }
+    }
+}
+
+TEST(TokenizeView, LongRuns)
+{
+    // a run across many vectors, ending in the middle of one
+    std::string input = "  1/0." + std::string(1000, '0') + "1e-7" + std::string(77, ' ') + "x" + std::string(500, 'y') + "9 ";
+    for (auto isa : { simd_isa::scalar, simd_isa::sse2, simd_isa::avx2 }) {
+        if (isa > detectIsa()) continue;
+        std::vector<token_view> v;
+        tokenize(input.data(), input.size(), v, isa);
+        ASSERT_EQ(v.size(), 5);
+        EXPECT_EQ(v[2].pos, 4);
+        EXPECT_EQ(v[2].len, 1006);
+        EXPECT_EQ(v[3].pos, 4 + 1006 + 77);
+        EXPECT_EQ(v[3].len, 502);
+        EXPECT_EQ(v[4].type, tok_t::end);
+        EXPECT_EQ(v[4].pos, input.size());
+    }
+}
@@ -0,0 +1,209 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "numbers.h"
+
+
+namespace {
+
+bool parse(const std::string &s, double &v)
+{
+    return parseNumber(s.data(), s.data() + s.size(), v);
+}
+
+std::string general(double v, int precision = 6)
+{
+    char buf[number_buffer];
+    return std::string(buf, formatGeneral(buf, v, precision));
+}
+
+std::string shortest(double v)
+{
+    char buf[number_buffer];
+    return std::string(buf, formatShortest(buf, v));
+}
+
+std::string printf_g(double v, int precision = 6)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*g", precision, v);
+    return buf;
+}
+
+// significant digits of a formatted number
+int significant(std::string s)
+{
+    s = s.substr(0, s.find('e'));
+    s.erase(std::remove(s.begin(), s.end(), '.'), s.end());
+    size_t first = s.find_first_not_of("-0");
+    if (first == std::string::npos) return 0;
+    return int(s.find_last_not_of('0') - first + 1);
+}
+
+// true if the decimal of 'digits' significant digits nearest to v parses back to v
+bool roundTrips(double v, int digits)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*e", digits - 1, v);
+    return strtod(buf, nullptr) == v;
+}
+
+double random_double(std::mt19937_64 &gen)
+{
+    // random bit patterns cover every exponent; non-finite values are skipped
+    for (;;) {
+        uint64_t bits = gen();
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        if (std::isfinite(v)) return v;
+    }
+}
+
+}
+
+TEST(Numbers, Parse)
+{
+    double v;
+    EXPECT_TRUE(parse("0", v));      EXPECT_EQ(v, 0);
+    EXPECT_TRUE(parse("0.5", v));    EXPECT_EQ(v, 0.5);
+    EXPECT_TRUE(parse(".5", v));     EXPECT_EQ(v, 0.5);
+    EXPECT_TRUE(parse("5.", v));     EXPECT_EQ(v, 5);
+    EXPECT_TRUE(parse("1e3", v));    EXPECT_EQ(v, 1000);
+    EXPECT_TRUE(parse("1E-3", v));   EXPECT_EQ(v, 0.001);
+    EXPECT_TRUE(parse("2.5e+2", v)); EXPECT_EQ(v, 250);
+    EXPECT_TRUE(parse("123456789.123456789", v)); EXPECT_EQ(v, 123456789.123456789);
+    EXPECT_TRUE(parse("0.000000000000000000000000000000", v)); EXPECT_EQ(v, 0);
+    EXPECT_TRUE(parse("1e-320", v)); EXPECT_EQ(v, 1e-320);   // subnormal, still representable
+    EXPECT_TRUE(parse("1.7976931348623157e308", v)); EXPECT_EQ(v, std::numeric_limits<double>::max());
+
+    EXPECT_FALSE(parse("", v));
+    EXPECT_FALSE(parse(".", v));
+    EXPECT_FALSE(parse("1e", v));
+    EXPECT_FALSE(parse("1e+", v));
+    EXPECT_FALSE(parse("1.2.3", v));
+    EXPECT_FALSE(parse("12a", v));
+    EXPECT_FALSE(parse("-1", v));
+
+    // out of range
+    EXPECT_FALSE(parse("1e+1000", v));
+    EXPECT_FALSE(parse("1e-1000", v));
+    EXPECT_FALSE(parse("2e308", v));
+    EXPECT_FALSE(parse("1e-400", v));
+}
+
+TEST(Numbers, ParseMatchesStrtod)
+{
+    std::mt19937_64 gen(5);
+    for (int i = 0; i < 100000; i++) {
+        // random literals: 1-25 digits, a decimal point somewhere, an exponent sometimes
+        std::string s;
+        int digits = 1 + int(gen() % 25);
+        int point = int(gen() % (digits + 1));
+        for (int d = 0; d < digits; d++) {
+            if (d == point) s += '.';
+            s += char('0' + gen() % 10);
+        }
+        if (gen() % 2) s += "e" + std::to_string(int(gen() % 700) - 350);
+
+        double expected = strtod(s.c_str(), nullptr), v = -1;
+        bool ok = parse(s, v);
+        if (std::isinf(expected) || (expected == 0 && s.find_first_of("123456789") < s.find('e'))) {
+            EXPECT_FALSE(ok) << s;
+        }
+        else {
+            EXPECT_TRUE(ok) << s;
+            EXPECT_EQ(v, expected) << s;
+        }
+    }
+}
+
+TEST(Numbers, General)
+{
+    const double values[] = { 0, -0.0, 1, -1, 0.1, 1.0 / 3, 100000, 1e6, 123456.5, 999999.5, 9.9999996,
+                              0.0001, 0.00001, 1e-300, 5e-324, 1.7976931348623157e308, 2.5, -2.5e-7 };
+    for (double v : values) {
+        for (int p = 1; p <= 17; p++) EXPECT_EQ(general(v, p), printf_g(v, p)) << v << " " << p;
+    }
+
+    std::mt19937_64 gen(6);
+    for (int i = 0; i < 100000; i++) {
+        double v = random_double(gen);
+        EXPECT_EQ(general(v), printf_g(v)) << v;
+    }
+
+    // default stream output
+    std::ostringstream ss;
+    ss << 1.0 / 3 << ' ' << 1e100;
+    EXPECT_EQ(general(1.0 / 3) + ' ' + general(1e100), ss.str());
+}
+
+TEST(Numbers, Shortest)
+{
+    EXPECT_EQ(shortest(0), "0");
+    EXPECT_EQ(shortest(-0.0), "-0");
+    EXPECT_EQ(shortest(0.1), "0.1");
+    EXPECT_EQ(shortest(1.0 / 3), "0.3333333333333333");
+    EXPECT_EQ(shortest(123456), "123456");
+    EXPECT_EQ(shortest(1e21), "1e+21");
+    EXPECT_EQ(shortest(1e-7), "1e-07");
+    EXPECT_EQ(shortest(0.001), "0.001");
+    // subnormals have fewer significant digits
+    EXPECT_EQ(shortest(5e-324), "5e-324");
+    EXPECT_EQ(shortest(-1e-323), "-1e-323");
+    EXPECT_EQ(shortest(1.5e-323), "1.5e-323");
+    EXPECT_EQ(shortest(2.2250738585072e-308), "2.2250738585072e-308");
+    EXPECT_EQ(shortest(std::numeric_limits<double>::denorm_min() * 12345), "6.099e-320");
+    EXPECT_EQ(shortest(std::numeric_limits<double>::infinity()), "inf");
+
+    std::mt19937_64 gen(7);
+    for (int i = 0; i < 100000; i++) {
+        double v = random_double(gen), back;
+        auto s = shortest(v);
+        std::string text = s[0] == '-' ? s.substr(1) : s;
+        ASSERT_TRUE(parse(text, back) || back == 0) << s;
+        EXPECT_EQ(s[0] == '-' ? -back : back, v) << s;
+        EXPECT_LE(s.size(), printf_g(v, 17).size()) << s;
+        EXPECT_TRUE(significant(s) == 1 || !roundTrips(v, significant(s) - 1)) << s;
+    }
+
+    // subnormals: every number of digits
+    for (int i = 0; i < 20000; i++) {
+        double v;
+        uint64_t bits = gen() & ((uint64_t(1) << 52) - 1);
+        memcpy(&v, &bits, sizeof(v));
+        if (v == 0) continue;
+        auto s = shortest(v);
+        EXPECT_EQ(strtod(s.c_str(), nullptr), v) << s;
+        EXPECT_TRUE(significant(s) == 1 || !roundTrips(v, significant(s) - 1)) << s;
+    }
+}
+
+TEST(Numbers, AtomTraits)
+{
+    std::string input = "2.5";
+    double v;
+    EXPECT_TRUE(atom_traits<double>::number(input.data(), input.data() + input.size(), v));
+    EXPECT_EQ(v, 2.5);
+    EXPECT_FALSE(atom_traits<double>::variable("x", 1, v));
+
+    // generic stream based version
+    float f;
+    EXPECT_TRUE(atom_traits<float>::number(input.data(), input.data() + input.size(), f));
+    EXPECT_EQ(f, 2.5f);
+
+    std::ostringstream ss;
+    atom_traits<double>::print(ss, 1.0 / 3);
+    ss.precision(12);
+    ss << ' ';
+    atom_traits<double>::print(ss, 1.0 / 3);
+    EXPECT_EQ(ss.str(), "0.333333 0.333333333333");
+}
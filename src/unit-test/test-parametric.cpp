@@ -0,0 +1,165 @@
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "numbers.h"
+#include "format.h"
+#include "parametric.h"
+
+
+namespace {
+
+using atom = affine<double>;
+
+// the record of row 'i' of a solved template
+std::string row(const parametric_equation &pe, const parametric_equation::rows &r, size_t i, output_format f = output_format::text)
+{
+    result_formatter<double> formatter(f);
+    std::string s;
+    if (r.coef[i] != 0) formatter.solution(s, pe.unknown(), r.x[i]);
+    else                formatter.cancelled(s, pe.unknown(), r.constant[i] == 0);
+    return s;
+}
+
+// an error of the line: its message and the number of its '/' (the positions differ)
+std::string failure(const std::string &line, size_t pos, const std::string &msg)
+{
+    return msg + " at /" + std::to_string(std::count(line.begin(), line.begin() + pos, '/'));
+}
+
+// the record of row 'i', or its error
+std::string solved(const std::string &eq, const parametric_equation &pe, const parametric_equation::rows &r, size_t i)
+{
+    if (r.zero_divisor[i] < 0) return row(pe, r, i);
+    return failure(eq, pe.divisor(size_t(r.zero_divisor[i])).pos, "division by zero");
+}
+
+// the output of the line parser for the equation with the parameters replaced by their values
+std::string parsed(const std::string &eq, const column_table &t, size_t i)
+{
+    std::string line;
+    for (size_t p = 0; p < eq.size(); p++) {
+        auto c = std::find(t.names.begin(), t.names.end(), std::string(1, eq[p]));
+        if (c == t.names.end()) {
+            line += eq[p];
+            continue;
+        }
+        char buf[number_buffer];
+        double v = t.data[c - t.names.begin()][i];
+        line += '(';
+        if (v < 0) line += '-';
+        line.append(buf, formatShortest(buf, std::abs(v)));
+        line += ')';
+    }
+
+    result_formatter<double> formatter;
+    std::string s;
+    try {
+        formatter.equation(s, parser<atom>::parse(tokenize(line)).at(0).atom);
+    }
+    catch (parser<atom>::error &e) {
+        return failure(line, e.t.pos, e.msg);
+    }
+    return s;
+}
+
+std::string error(const std::string &eq, const std::string &unknown)
+{
+    try {
+        parametric_equation pe(tokenize_view(eq), unknown);
+    }
+    catch (parametric_equation::error &e) {
+        return std::to_string(e.t.pos) + ": " + e.msg;
+    }
+    return "";
+}
+
+}
+
+TEST(Parametric, MatchesParser)
+{
+    // small integers, so that many rows have a zero coefficient
+    column_table t;
+    t.names = { "a", "b", "c", "d" };
+    t.data.resize(4);
+    std::mt19937 gen(5);
+    for (t.rows = 0; t.rows < 500; t.rows++) {
+        for (auto &col : t.data) col.push_back(double(int(gen() % 7) - 3) / (t.rows % 3 ? 1 : 4));
+    }
+
+    const char *templates[] = {
+        "a*x + b = c*x - d",
+        "(a - b)*(x + c) = d*x/4 + 2",
+        "x*a/(b + 5) - 3*x = -(c - x*d)",
+        "log(a*a + 1)*x + 2^b = (c^2)*x - d*x + b",
+        "-(-x) + 0*a = x + b",
+        // divisors that are 0 in some rows
+        "x/a = b",
+        "(x + a)/(b - c) = d",
+        "0/(a + 1) + x/4 = b/c/(d*0 + 1)",
+    };
+    for (std::string eq : templates) {
+        parametric_equation pe(tokenize_view(eq), "x");
+        for (auto jit : { false, true }) {
+            auto r = pe.solve(t, simd_isa::scalar, jit);
+            ASSERT_EQ(r.size(), t.rows);
+            for (size_t i = 0; i < t.rows; i++) ASSERT_EQ(solved(eq, pe, r, i), parsed(eq, t, i)) << eq << " row " << i;
+        }
+    }
+
+    // the rows with a = 0; constant divisors other than 0 are not results
+    std::string eq = "x/a = b/4";
+    parametric_equation pe(tokenize_view(eq), "x");
+    EXPECT_EQ(pe.reduced().results, 3u);
+    auto r = pe.solve(t);
+    EXPECT_EQ(std::count(r.zero_divisor.begin(), r.zero_divisor.end(), 0), std::count(t.data[0].begin(), t.data[0].end(), 0.0));
+    EXPECT_EQ(pe.divisor(0).pos, 1u);
+}
+
+TEST(Parametric, Reduced)
+{
+    std::string eq = "a*x + log(b) = c*x - log(b)";
+    parametric_equation pe(tokenize_view(eq), "x");
+    auto &p = pe.reduced();
+    EXPECT_EQ(p.vars, std::vector<std::string>({ "a", "b", "c" }));
+    EXPECT_EQ(p.results, 2u);
+
+    column_table t;
+    t.names = { "a", "b", "c" };
+    t.data = { { 1, 2, 2 }, { 1, 1, 3 }, { 3, 1, 2 } };
+    t.rows = 3;
+    auto r = pe.solve(t);
+    EXPECT_EQ(r.coef, std::vector<double>({ -2, 1, 0 }));
+    EXPECT_EQ(r.constant[2], 2 * std::log(3));
+    EXPECT_EQ(r.x[1], -0.0);
+    EXPECT_TRUE(std::isnan(r.x[2]));
+
+    EXPECT_EQ(row(pe, r, 0), "Result: x = 0\n");
+    EXPECT_EQ(row(pe, r, 2), "Result: Not true.    This holds for any x.\n");
+    EXPECT_EQ(row(pe, r, 2, output_format::json), "{\"result\":0,\"kind\":\"false\"}\n");
+    t.data[1][2] = 1;
+    EXPECT_EQ(row(pe, pe.solve(t), 2, output_format::json), "{\"result\":0,\"kind\":\"true\",\"free\":[\"x\"]}\n");
+}
+
+TEST(Parametric, Errors)
+{
+    EXPECT_EQ(error("a*x*x = b", "x"), "3: polynomial of order > 1 not allowed");
+    EXPECT_EQ(error("a/(x + 1) = b", "x"), "1: polynomial fraction not allowed");
+    EXPECT_EQ(error("log(x) = b", "x"), "0: log of polynomial not allowed");
+    EXPECT_EQ(error("a^x = 2", "x"), "1: polynomial exponent not allowed");
+    EXPECT_EQ(error("x^a = 2", "x"), "1: power of polynomial not allowed");
+    EXPECT_EQ(error("a*x = b, c = x", "x"), "7: a single equation expected");
+    EXPECT_EQ(error("a*x + b", "x"), "7: equation expected");
+    EXPECT_EQ(error("a*y = b", "x"), "0: the equation does not contain x");
+    EXPECT_EQ(error("a*x = (b", "x"), "8: missing right parenthesis");
+
+    // parameters are only multiplied and divided by each other
+    EXPECT_EQ(error("a*b*x/c = log(d)^2", "x"), "");
+}
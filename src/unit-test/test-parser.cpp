@@ -1,5 +1,11 @@
 #include <iostream>
 #include <vector>
+#include <string>
+#include <utility>
+#include <stdexcept>
+#include <cmath>
+#include <random>
+#include <sstream>
 
 #include <gtest/gtest.h>
 
@@ -87,3 +93,181 @@ TEST(ParserErrors, VerySmallNumber)
     ASSERT_THROW(parser<atom>::parse(tokens),parser<atom>::error);
 }
 
+
+//---------------------------------------------
+
+namespace {
+
+using atom = affine<double>;
+
+// error of the non-throwing interface as (token position, message)
+std::pair<size_t, std::string> tryError(const std::string &input)
+{
+    auto tokens = tokenize_view(input);
+    std::vector<parser<atom>::result> r;
+    auto s = parser<atom>::try_parse(tokens, r);
+    if (s.ok()) return { std::string::npos, "" };
+    return { s.where->pos, s.msg };
+}
+
+// the same through the throwing interface
+std::pair<size_t, std::string> thrownError(const std::string &input)
+{
+    try {
+        parser<atom>::parse(tokenize_view(input));
+    }
+    catch (parser<atom>::error &e) {
+        return { e.t.pos, e.msg };
+    }
+    return { std::string::npos, "" };
+}
+
+// atom whose division throws, like types with exception based error reporting
+struct checked {
+    double v;
+    checked(double iv = 0) : v(iv) {};
+
+    checked& operator += (const checked &b) { v += b.v; return *this; }
+    checked& operator -= (const checked &b) { v -= b.v; return *this; }
+    checked& operator *= (const checked &b) { v *= b.v; return *this; }
+    checked& operator /= (const checked &b) {
+        if (b.v == 0) throw std::domain_error("checked division by zero");
+        v /= b.v;
+        return *this;
+    }
+    checked operator - () const { return -v; }
+};
+
+checked log(const checked &a) { return std::log(a.v); }
+checked pow(const checked &a, const checked &b) { return std::pow(a.v, b.v); }
+std::istream& operator >> (std::istream &is, checked &a) { return is >> a.v; }
+
+}
+
+TEST(ParserErrors, TryParse)
+{
+    std::string input = "2*x + 1 = 3, y/2";
+    auto tokens = tokenize_view(input);
+    std::vector<parser<atom>::result> r;
+    auto s = parser<atom>::try_parse(tokens, r);
+    EXPECT_TRUE(s.ok());
+    ASSERT_EQ(r.size(), 2);
+    EXPECT_EQ(r[0].atom, atom(2, "x") - atom(2));
+    EXPECT_TRUE(r[0].equal_to_zero);
+    EXPECT_EQ(r[1].atom, atom(0.5, "y"));
+
+    typedef std::pair<size_t, std::string> err;
+    EXPECT_EQ(tryError("(((x*y)))"),           err(4, "polynomial of order > 1 not allowed"));
+    EXPECT_EQ(tryError("1 + (2*(3 - log(x)))"), err(12, "log of polynomial not allowed"));
+    EXPECT_EQ(tryError("2^x"),                 err(1, "polynomial exponent not allowed"));
+    EXPECT_EQ(tryError("x^2"),                 err(1, "power of polynomial not allowed"));
+    EXPECT_EQ(tryError("(x+1)/(y - 1)"),       err(5, "polynomial fraction not allowed"));
+    EXPECT_EQ(tryError("1/0"),                 err(1, "division by zero"));
+    EXPECT_EQ(tryError("a = b*c"),             err(5, "polynomial of order > 1 not allowed"));
+    EXPECT_EQ(tryError("1, 2 3"),              err(5, "unexpected input"));
+    EXPECT_EQ(tryError("((1+2)"),              err(6, "missing right parenthesis"));
+    EXPECT_EQ(tryError("log 2"),               err(4, "missing left parenthesis"));
+    EXPECT_EQ(tryError("1 + "),                err(4, "missing operand"));
+    EXPECT_EQ(tryError("1e999"),               err(0, "unable to parse the input as a floating point number"));
+
+    for (auto line : { "(((x*y)))", "x^2", "1/0", "1 + ", "((1+2)", "2*x = 1" }) {
+        EXPECT_EQ(tryError(line), thrownError(line)) << line;
+    }
+}
+
+// exceptions of the atom operators are reported at the operator being applied
+TEST(ParserErrors, ThrowingAtom)
+{
+    std::string input = "1 + 2 * (3 / (1 - 1))";
+    auto tokens = tokenize_view(input);
+    std::vector<parser<checked>::result> r;
+    auto s = parser<checked>::try_parse(tokens, r);
+    ASSERT_FALSE(s.ok());
+    EXPECT_EQ(s.where->pos, 11);
+    EXPECT_EQ(s.msg, "checked division by zero");
+
+    EXPECT_THROW(parser<checked>::parse(tokens), parser<checked>::error);
+    std::string valid = "6 / 4";
+    EXPECT_EQ(parser<checked>::parse(tokenize_view(valid))[0].atom.v, 1.5);
+
+    // division by zero is not an error for double
+    std::vector<parser<double>::result> rd;
+    EXPECT_TRUE(parser<double>::try_parse(tokens, rd).ok());
+    EXPECT_TRUE(std::isinf(rd[0].atom));
+}
+
+//---------------------------------------------
+
+namespace {
+
+// outcome of a parse as text: the printed results or the error with its position
+template<typename T>
+std::string outcome(const std::string &input, parse_method method)
+{
+    auto tokens = tokenize_view(input);
+    std::vector<typename parser<T>::result> r;
+    auto s = parser<T>::try_parse(tokens, r, method);
+
+    std::ostringstream ss;
+    if (!s.ok()) ss << "error at " << s.where->pos << ": " << s.msg;
+    else for (auto &z : r) ss << z.atom << (z.equal_to_zero ? " = 0; " : "; ");
+    return ss.str();
+}
+
+// random token soup: mostly well formed fragments, often not
+std::string randomInput(std::mt19937 &gen)
+{
+    static const char *pieces[] = { "x", "y", "2", "0", "0.5", "3", "(", ")", "+", "-", "*", "/", "^",
+                                    "log", "log(", "=", ",", "(", ")", "-", "2", "x" };
+    std::string s;
+    size_t n = 1 + gen() % 16;
+    for (size_t i = 0; i < n; i++) {
+        s += pieces[gen() % (sizeof(pieces) / sizeof(pieces[0]))];
+        s += ' ';
+    }
+    return s;
+}
+
+}
+
+TEST(ParserIterative, SameAsRecursive)
+{
+    const char *lines[] = {
+        "-2^2", "2^-3^2", "2^3^2", "-x*3 + 4", "a * -b ^ 2", "2^3*4", "(1+2)*-(3-4)/5",
+        "log(100)^2 - 2^-0.5*7", "1 - -2 - +3", "--x", "x = 2, y = 3*x", "log(log(10))",
+    };
+    for (auto line : lines) {
+        EXPECT_EQ(outcome<atom>(line, parse_method::iterative), outcome<atom>(line, parse_method::recursive)) << line;
+        EXPECT_EQ(outcome<double>(line, parse_method::iterative), outcome<double>(line, parse_method::recursive)) << line;
+    }
+    EXPECT_EQ(outcome<double>("2^3^2", parse_method::iterative), "512; ");
+    EXPECT_EQ(outcome<double>("-2^2", parse_method::iterative), "-4; ");
+    EXPECT_EQ(outcome<double>("2^-1*4", parse_method::iterative), "2; ");
+
+    std::mt19937 gen(14);
+    for (int i = 0; i < 20000; i++) {
+        auto line = randomInput(gen);
+        ASSERT_EQ(outcome<atom>(line, parse_method::iterative), outcome<atom>(line, parse_method::recursive)) << line;
+        ASSERT_EQ(outcome<double>(line, parse_method::iterative), outcome<double>(line, parse_method::recursive)) << line;
+    }
+}
+
+// far deeper than the recursive parser's stack allows
+TEST(ParserIterative, DeepNesting)
+{
+    const size_t depth = 200000;
+    std::string input = std::string(depth, '(') + "x" + std::string(depth, ')') + " + 1";
+    for (size_t i = 0; i < 1000; i++) input = "-(" + input + ")";
+
+    auto r = parser<atom>::parse(tokenize_view(input), parse_method::iterative);
+    ASSERT_EQ(r.size(), 1);
+    EXPECT_EQ(r[0].atom, atom(1, "x") + atom(1));
+
+    std::string unclosed = std::string(depth, '(') + "1";
+    auto tokens = tokenize_view(unclosed);
+    std::vector<parser<atom>::result> out;
+    auto s = parser<atom>::try_parse(tokens, out, parse_method::iterative);
+    ASSERT_FALSE(s.ok());
+    EXPECT_EQ(s.where->pos, unclosed.size());
+    EXPECT_EQ(s.msg, "missing right parenthesis");
+}
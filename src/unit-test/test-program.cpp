@@ -0,0 +1,279 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "program.h"
+#include "affine.h"
+
+
+TEST(ProgramDouble, Constant)
+{
+    auto p = program<double>::compile(tokenize("(3+(4-1))*5"));
+    evaluator<double> ev(p);
+
+    auto &r = ev.run(nullptr);
+    ASSERT_EQ(r.size(), 1);
+    EXPECT_EQ(r[0].atom, 30.0);
+    EXPECT_FALSE(r[0].equal_to_zero);
+}
+
+TEST(ProgramDouble, Bindings)
+{
+    auto p = program<double>::compile(tokenize("2*x - y^2, x = y"));
+    ASSERT_EQ(p.vars.size(), 2);
+    ASSERT_EQ(p.slot("x"), 0);
+    ASSERT_EQ(p.slot("y"), 1);
+    ASSERT_EQ(p.slot("z"), -1);
+
+    evaluator<double> ev(p);
+    for (double x = -2; x <= 2; x += 0.5) {
+        double b[] = { x, 3 };
+        auto &r = ev.run(b);
+        ASSERT_EQ(r.size(), 2);
+        EXPECT_EQ(r[0].atom, 2 * x - 9);
+        EXPECT_EQ(r[1].atom, x - 3);
+        EXPECT_TRUE(r[1].equal_to_zero);
+    }
+}
+
+TEST(ProgramDouble, ManyVariables)
+{
+    // slots in order of first use, each name once
+    const size_t n = 50000;
+    std::string input;
+    for (size_t i = 0; i < n; i++) input += "v" + std::to_string(i) + " + ";
+    for (size_t i = n; i-- > 0;) input += "v" + std::to_string(i) + (i > 0 ? " + " : "");
+
+    auto p = program<double>::compile(tokenize_view(input));
+    ASSERT_EQ(p.vars.size(), n);
+    EXPECT_EQ(p.vars[0], "v0");
+    EXPECT_EQ(p.slot("v49999"), int(n - 1));
+
+    std::vector<double> b(n);
+    for (size_t i = 0; i < n; i++) b[i] = double(i);
+    EXPECT_EQ(evaluator<double>(p).run(b.data())[0].atom, double(n) * (n - 1));
+}
+
+TEST(ProgramDouble, MatchesParser)
+{
+    std::string input = "-2^2, 2^-1, 2^3^2, log(100)/log(10), -(1-4)*-3, +1/8";
+    auto tokens = tokenize(input);
+    auto parsed = parser<double>::parse(tokens);
+    auto p = program<double>::compile(tokens);
+    evaluator<double> ev(p);
+    auto &r = ev.run(nullptr);
+
+    ASSERT_EQ(parsed.size(), r.size());
+    for (size_t i = 0; i < r.size(); i++) EXPECT_EQ(parsed[i].atom, r[i].atom);
+}
+
+TEST(ProgramAffineDouble, Symbolic)
+{
+    using atom = affine<double>;
+
+    auto p = program<atom>::compile(tokenize("2*x+0.5=1"));
+    evaluator<atom> ev(p);
+
+    atom b[] = { atom(1, "x") };
+    auto &r = ev.run(b);
+    EXPECT_EQ(r[0].atom, atom(2, "x") - atom(0.5));
+    EXPECT_TRUE(r[0].equal_to_zero);
+
+    b[0] = atom(3);
+    EXPECT_EQ(ev.run(b)[0].atom, atom(5.5));
+}
+
+TEST(ProgramErrors, Compile)
+{
+    using atom = affine<double>;
+
+    try {
+        program<atom>::compile(tokenize("(1+2"));
+        FAIL();
+    }
+    catch (program<atom>::error &e) {
+        EXPECT_EQ(e.msg, "missing right parenthesis");
+        EXPECT_EQ(e.t.pos, 4);
+    }
+}
+
+// the compiler shares the iterative loop of the parser: any depth, the same errors
+TEST(ProgramErrors, DeepNesting)
+{
+    using atom = affine<double>;
+
+    const size_t depth = 200000;
+    std::string input = std::string(depth, '(') + "x" + std::string(depth, ')') + " + 1";
+    for (size_t i = 0; i < 1000; i++) input = "-(" + input + ")";
+
+    auto p = program<atom>::compile(tokenize_view(input));
+    EXPECT_EQ(p.depth, 2);
+    evaluator<atom> ev(p);
+    atom b[] = { atom(1, "x") };
+    EXPECT_EQ(ev.run(b)[0].atom, atom(1, "x") + atom(1));
+
+    std::string unclosed = std::string(depth, '(') + "1";
+    try {
+        program<atom>::compile(tokenize_view(unclosed));
+        FAIL();
+    }
+    catch (program<atom>::error &e) {
+        EXPECT_EQ(e.msg, "missing right parenthesis");
+        EXPECT_EQ(e.t.pos, unclosed.size());
+    }
+
+    for (std::string line : { "2*(x", "x + * 3", "log x", "(1+2))", "1, 2 +", "x = ", "(x))" }) {
+        auto tokens = tokenize_view(line);
+        std::vector<parser<atom>::result> out;
+        auto parsed = parser<atom>::try_parse(tokens, out);
+        program<atom> q;
+        auto compiled = program<atom>::try_compile(tokens, q);
+        ASSERT_FALSE(compiled.ok()) << line;
+        EXPECT_EQ(compiled.msg, parsed.msg) << line;
+        EXPECT_EQ(compiled.where, parsed.where) << line;
+    }
+}
+
+TEST(ProgramErrors, Evaluate)
+{
+    using atom = affine<double>;
+
+    auto p = program<atom>::compile(tokenize("x * y"));
+    evaluator<atom> ev(p);
+
+    atom b[] = { atom(1, "x"), atom(2) };
+    EXPECT_EQ(ev.run(b)[0].atom, atom(2, "x"));
+
+    b[1] = atom(1, "y");
+    try {
+        ev.run(b);
+        FAIL();
+    }
+    catch (program<atom>::error &e) {
+        EXPECT_EQ(e.msg, "polynomial of order > 1 not allowed");
+        EXPECT_EQ(e.t.pos, 2);
+    }
+}
+
+TEST(ProgramOptimize, Shared)
+{
+    auto tokens = tokenize("log(x+1)*2 + log(x+1)/3 - (x+1), (x+1)^2");
+    auto p = program<double>::compile(tokens);
+    auto q = p;
+    auto o = q.optimize();
+
+    // x+1 and log(x+1) once each
+    EXPECT_EQ(o.shared, 2u);
+    EXPECT_EQ(q.temps, 2u);
+    EXPECT_EQ(o.before, 22u);
+    EXPECT_EQ(o.after, 17u);
+    EXPECT_EQ(o.eliminated(), 5u);
+
+    evaluator<double> ev(p), eq(q);
+    for (double x = 0; x < 5; x += 0.25) {
+        auto &r = ev.run(&x);
+        auto &s = eq.run(&x);
+        ASSERT_EQ(s.size(), 2u);
+        EXPECT_EQ(r[0].atom, s[0].atom);
+        EXPECT_EQ(r[1].atom, s[1].atom);
+    }
+}
+
+TEST(ProgramOptimize, Folding)
+{
+    auto p = program<double>::compile(tokenize("x*(2+3) + log(100)/log(10) = -(-y)/1*1"));
+    auto o = p.optimize();
+    EXPECT_EQ(o.folded, 4u);
+    EXPECT_EQ(o.simplified, 3u);
+    EXPECT_EQ(p.consts, std::vector<double>({ 5, 2 }));
+
+    // x 5 * 2 + y - result
+    ASSERT_EQ(p.code.size(), 8u);
+    EXPECT_EQ(p.code[6].code, op_t::sub);
+    EXPECT_EQ(p.code[7].code, op_t::result);
+    EXPECT_EQ(p.code[7].arg, 1u);
+    EXPECT_EQ(p.depth, 2u);
+
+    double b[] = { 1, 4 };
+    EXPECT_EQ(evaluator<double>(p).run(b)[0].atom, 3);
+
+    // only the constant parts of affine expressions
+    using atom = affine<double>;
+    auto q = program<atom>::compile(tokenize("-0 + x^1*1 - 2^3"));
+    auto oq = q.optimize();
+    EXPECT_EQ(oq.folded, 2u);
+    EXPECT_EQ(oq.simplified, 2u);
+    atom c[] = { atom(3) };
+    EXPECT_EQ(evaluator<atom>(q).run(c)[0].atom, atom(-5));
+
+    // x + 0 is kept, -0 + 0 is 0
+    auto z = program<double>::compile(tokenize("x*0 + 0, 0 + x*0, x*0 - 0, x*0 + -0"));
+    EXPECT_EQ(z.optimize().simplified, 2u);
+    double m = -1;
+    evaluator<double> ez(z);
+    auto &rz = ez.run(&m);
+    EXPECT_FALSE(std::signbit(rz[0].atom));
+    EXPECT_FALSE(std::signbit(rz[1].atom));
+    EXPECT_TRUE(std::signbit(rz[2].atom));
+    EXPECT_TRUE(std::signbit(rz[3].atom));
+}
+
+TEST(ProgramOptimize, Errors)
+{
+    using atom = affine<double>;
+
+    // at the first occurrence, as without the optimization
+    auto p = program<atom>::compile(tokenize("1 + x*y - 2*(x*y) + 1/0"));
+    EXPECT_EQ(p.optimize().shared, 1u);
+    atom b[] = { atom(1, "x"), atom(1, "y") };
+    try {
+        evaluator<atom>(p).run(b);
+        FAIL();
+    }
+    catch (program<atom>::error &e) {
+        EXPECT_EQ(e.msg, "polynomial of order > 1 not allowed");
+        EXPECT_EQ(e.t.pos, 5);
+    }
+
+    // constant operations that fail are left to the evaluation
+    b[1] = atom(2);
+    try {
+        evaluator<atom>(p).run(b);
+        FAIL();
+    }
+    catch (program<atom>::error &e) {
+        EXPECT_EQ(e.msg, "division by zero");
+        EXPECT_EQ(e.t.pos, 21);
+    }
+
+    // x^1 keeps its error
+    auto q = program<atom>::compile(tokenize("x^1"));
+    EXPECT_EQ(q.optimize().simplified, 0u);
+    EXPECT_THROW(evaluator<atom>(q).run(b), program<atom>::error);
+}
+
+TEST(ProgramOptimize, DeepChain)
+{
+    using atom = affine<double>;
+
+    // a left-deep sum is a graph as deep as the line is long
+    const size_t terms = 300000;
+    std::string input = "a";
+    for (size_t i = 1; i < terms; i++) input += "+a";
+    input += " = y";
+
+    auto p = program<atom>::compile(tokenize_view(input));
+    EXPECT_EQ(p.optimize().after, 2 * terms + 1);     // nothing to drop
+    EXPECT_EQ(p.depth, 2u);
+    atom b[] = { atom(1, "a"), atom(1, "y") };
+    EXPECT_EQ(evaluator<atom>(p).run(b)[0].atom, atom(double(terms), "a") - atom(1, "y"));
+
+    auto q = program<double>::compile(tokenize_view(input));
+    q.optimize();
+    double c[] = { 0.5, 1 };
+    EXPECT_EQ(evaluator<double>(q).run(c)[0].atom, terms * 0.5 - 1);
+}
@@ -0,0 +1,190 @@
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "system.h"
+#include "rational.h"
+
+
+namespace {
+
+rational parse(const std::string &s)
+{
+    rational v;
+    EXPECT_TRUE(parseNumber(s.data(), s.data() + s.size(), v)) << s;
+    return v;
+}
+
+std::string text(const rational &v)
+{
+    std::ostringstream ss;
+    ss << v;
+    return ss.str();
+}
+
+// the solution of the equation 'input' in one variable, or the value of the expression
+std::string solve(const std::string &input)
+{
+    auto r = parser<affine<rational>>::parse(tokenize(input)).at(0);
+    std::ostringstream ss;
+    auto &x = r.atom.x;
+    if (r.equal_to_zero && x.size() == 1) ss << symbol_table::name(x.begin()->first) << " = " << -r.atom.d / x.begin()->second;
+    else ss << r.atom;
+    return ss.str();
+}
+
+// the error message of the input
+std::string error(const std::string &input)
+{
+    std::vector<parser<affine<rational>>::result> r;
+    auto tokens = tokenize_view(input);
+    return parser<affine<rational>>::try_parse(tokens, r).msg;
+}
+
+const int64_t max64 = std::numeric_limits<int64_t>::max();
+const int64_t min64 = std::numeric_limits<int64_t>::min();
+
+}
+
+TEST(Rational, Arithmetic)
+{
+    EXPECT_EQ(text(rational(1) / 3 + rational(1) / 6), "1/2");
+    EXPECT_EQ(text(rational::fraction(6, -4)), "-3/2");
+    EXPECT_EQ(text(rational(2) / 7 * 7), "2");
+    EXPECT_EQ(text(rational(1) / 3 - rational(1) / 3), "0");
+    EXPECT_EQ(text(-(rational(5) / 8)), "-5/8");
+    EXPECT_EQ(text(abs(rational(-5) / 8)), "5/8");
+    EXPECT_EQ(text(rational(0) * (rational(1) / 3)), "0");
+
+    EXPECT_TRUE(rational(1) / 3 < rational(1) / 2);
+    EXPECT_TRUE(rational(-1) / 2 < 0);
+    EXPECT_TRUE(rational(2) / 4 == rational(1) / 2);
+    EXPECT_EQ(rational(-3) / 4 * 4, -3);
+    EXPECT_EQ((rational(1) / 3).sign(), 1);
+    EXPECT_EQ(double(rational(1) / 4), 0.25);
+
+    EXPECT_THROW(rational(1) / 0, rational::error);
+    EXPECT_THROW(rational::fraction(1, 0), rational::error);
+}
+
+TEST(Rational, Promotion)
+{
+    // overflowing results are promoted and demoted when they fit again
+    rational big = rational(max64) + 1;
+    EXPECT_FALSE(big.inlined());
+    EXPECT_EQ(text(big), "9223372036854775808");
+    EXPECT_TRUE((big - 1).inlined());
+    EXPECT_EQ(big - 1, max64);
+
+    EXPECT_FALSE(rational(min64).inlined());
+    EXPECT_EQ(text(rational(min64)), "-9223372036854775808");
+    EXPECT_EQ(text(-rational(min64)), "9223372036854775808");
+
+    rational p = rational(max64) * max64;
+    EXPECT_EQ(text(p), "85070591730234615847396907784232501249");
+    EXPECT_EQ(p / max64, max64);
+    EXPECT_TRUE((p / max64).inlined());
+    EXPECT_EQ(text(rational(1) / max64 / max64), "1/85070591730234615847396907784232501249");
+    EXPECT_TRUE(rational(1) / p < rational(1) / max64);
+    EXPECT_TRUE(-p < min64);
+    EXPECT_NEAR(double(p), 8.507059173023462e37, 1e23);
+
+    // (a * b) / b == a and (a + b) - b == a through the long division
+    std::mt19937_64 gen(11);
+    for (int i = 0; i < 2000; i++) {
+        rational a = rational::fraction(int64_t(gen() >> 1), int64_t(gen() >> 1) | 1);
+        rational b = rational::fraction(int64_t(gen() >> 2), int64_t(gen() >> 3) | 1);
+        for (int k = i % 4; k > 0; k--) a *= a;
+        if (i % 2) b = -b;
+        if (b == 0) continue;
+        ASSERT_EQ(a * b / b, a) << text(a) << " " << text(b);
+        ASSERT_EQ(a + b - b, a) << text(a) << " " << text(b);
+        ASSERT_EQ(a < a + abs(b), true);
+    }
+
+    EXPECT_THROW(pow(rational(3), rational(100000)), rational::error);
+}
+
+TEST(Rational, Parse)
+{
+    EXPECT_EQ(text(parse("0.1")), "1/10");
+    EXPECT_EQ(text(parse("2.50")), "5/2");
+    EXPECT_EQ(text(parse("00.000")), "0");
+    EXPECT_EQ(text(parse(".5e+1")), "5");
+    EXPECT_EQ(text(parse("1E2")), "100");
+    EXPECT_EQ(text(parse("1e-30")), "1/1000000000000000000000000000000");
+    EXPECT_EQ(text(parse("123456789012345678901234567890")), "123456789012345678901234567890");
+    EXPECT_EQ(text(parse("1" + std::string(400, '0') + "e-400")), "1");
+    EXPECT_EQ(text(parse("3.14159265358979323846")), "157079632679489661923/50000000000000000000");
+    EXPECT_EQ(parse("1.5e3"), 1500);
+
+    rational v;
+    for (auto bad : { "", ".", "e5", "1e", "1e+", "1x", "-1", "1/2", "1e100000" }) {
+        std::string s(bad);
+        EXPECT_FALSE(parseNumber(s.data(), s.data() + s.size(), v)) << s;
+    }
+
+    std::istringstream is(" -1.5e3 22/7 0.5/0.25 1/0");
+    rational a, b, c, d;
+    is >> a >> b >> c;
+    EXPECT_EQ(a, -1500);
+    EXPECT_EQ(text(b), "22/7");
+    EXPECT_EQ(c, 2);
+    EXPECT_TRUE((is >> d).fail());
+}
+
+TEST(Rational, Functions)
+{
+    EXPECT_EQ(text(pow(rational(2), rational(100))), "1267650600228229401496703205376");
+    EXPECT_EQ(text(pow(rational(2) / 3, rational(-3))), "27/8");
+    EXPECT_EQ(text(pow(rational(-1), parse("12345678901234567890123"))), "-1");
+    EXPECT_EQ(text(pow(rational(0), rational(0))), "1");
+    EXPECT_EQ(text(pow(rational(9) / 4, parse("0.5"))), "3/2");
+    EXPECT_EQ(text(pow(rational(-8), rational(2) / 3)), "4");
+    EXPECT_EQ(text(pow(rational(27), rational(-1) / 3)), "1/3");
+    EXPECT_EQ(log(rational(1)), 0);
+
+    EXPECT_THROW(pow(rational(0), rational(-1)), rational::error);
+    EXPECT_THROW(pow(rational(2), parse("0.5")), rational::error);
+    EXPECT_THROW(pow(rational(-4), parse("0.5")), rational::error);
+    EXPECT_THROW(log(rational(2)), rational::error);
+}
+
+TEST(Rational, Backend)
+{
+    EXPECT_EQ(solve("x/3 = 1/7"), "x = 3/7");
+    EXPECT_EQ(solve("0.1 + 0.2"), "3/10");
+    EXPECT_EQ(solve("(1e17 + 1)*x - 1e17*x = 2"), "x = 2");
+    EXPECT_EQ(solve("3*(x + y) - 2*y/5"), "3*x + 13/5*y");
+    EXPECT_EQ(solve("log(1)*x + 4^0.5"), "2");
+
+    // non-rational operations are errors at the operator
+    EXPECT_EQ(error("log(2)"), "inexact log not allowed in rational arithmetic");
+    EXPECT_EQ(error("2^0.5"), "inexact power not allowed in rational arithmetic");
+    EXPECT_EQ(error("x/0"), "division by zero");
+
+    // the Hilbert system is solved exactly
+    const int n = 10;
+    std::string eqs;
+    for (int i = 1; i <= n; i++) {
+        std::string lhs, rhs = "0";
+        for (int j = 1; j <= n; j++) {
+            lhs += (j > 1 ? " + x" : "x") + std::to_string(j) + "/" + std::to_string(i + j - 1);
+            rhs += " + 1/" + std::to_string(i + j - 1);
+        }
+        eqs += (i > 1 ? ", " : "") + lhs + " = " + rhs;
+    }
+    sparse_system<rational> system;
+    for (auto &r : parser<affine<rational>>::parse(tokenize(eqs))) system.add(r.atom);
+    auto s = system.solve();
+    ASSERT_EQ(s.kind, sparse_system<rational>::status::unique);
+    ASSERT_EQ(s.values.size(), size_t(n));
+    for (auto &v : s.values) EXPECT_EQ(v.second.d, 1);
+}
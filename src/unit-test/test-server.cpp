@@ -0,0 +1,237 @@
+#ifdef __linux__
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <algorithm>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "server.h"
+#include "driver.h"
+
+
+namespace {
+
+// calculator server on a background thread
+class test_server {
+public:
+    explicit test_server(server_options o) : ctx(o.threads), srv(o, [this](const char *s, size_t n, size_t worker, block_output &out) {
+        processLine(s, n, ctx[worker], out);
+    }), loop([this] { srv.run(); }) {};
+
+    ~test_server() {
+        srv.stop();
+        loop.join();
+    }
+
+    std::vector<line_context> ctx;
+    server srv;
+
+private:
+    std::thread loop;
+};
+
+int connectUnix(const std::string &path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connectTcp(int port)
+{
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(uint16_t(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// send the input in random pieces (while reading the answers), then read until the server closes
+std::string exchange(int fd, const std::string &input, unsigned seed)
+{
+    std::thread writer([fd, &input, seed] {
+        std::mt19937 gen(seed);
+        for (size_t i = 0; i < input.size();) {
+            size_t n = std::min<size_t>(1 + gen() % 300, input.size() - i);
+            ssize_t w = write(fd, input.data() + i, n);
+            if (w <= 0) break;
+            i += w;
+        }
+        shutdown(fd, SHUT_WR);
+    });
+
+    std::string answers;
+    char buf[4096];
+    for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0;) answers.append(buf, n);
+    writer.join();
+    close(fd);
+    return answers;
+}
+
+// the answers of the lines as the server frames them
+std::string expected(const std::string &input)
+{
+    line_context ctx;
+    std::string r;
+    for (size_t start = 0; start < input.size();) {
+        size_t end = std::min(input.find('\n', start), input.size());
+        block_output out;
+        if (end > start) processLine(input.data() + start, end - start, ctx, out);
+
+        std::ostringstream text;
+        out.flush_to(text, text);
+        r += std::to_string(text.str().size()) + '\n' + text.str();
+        start = end + 1;
+    }
+    return r;
+}
+
+std::string socketPath(const char *name)
+{
+    return "/tmp/calculator-test-" + std::to_string(getpid()) + "-" + name;
+}
+
+}
+
+TEST(Server, Answers)
+{
+    server_options o;
+    o.unix_path = socketPath("answers");
+    test_server ts(o);
+
+    std::string input = "1+2\n\n2*x = 4\n1+\nx + y = 1, 3\nlog(0)\nlast line";
+    EXPECT_EQ(exchange(connectUnix(o.unix_path), input, 1),
+              "10\nResult: 3\n"
+              "0\n"
+              "14\nResult: x = 2\n"
+              "28\n\n1+\n  ^~~~~ missing operand\n"
+              "32\nResult: x + y - 1 = 0\nResult: 3\n" +
+              expected("log(0)\nlast line"));
+    EXPECT_EQ(ts.srv.port(), -1);
+}
+
+TEST(Server, Pipelining)
+{
+    // concurrent clients, each with its own lines written in pieces that split lines
+    server_options o;
+    o.unix_path = socketPath("pipelining");
+    o.threads = 3;
+    test_server ts(o);
+
+    const int clients = 8;
+    std::vector<std::string> inputs(clients), answers(clients);
+    for (int c = 0; c < clients; c++) {
+        for (int i = 0; i < 3000; i++) {
+            inputs[c] += std::to_string(i) + "*x" + std::to_string(c) + " = " + std::to_string(c) + (i % 7 ? "\n" : " +\n");
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; c++) {
+        threads.emplace_back([&, c] { answers[c] = exchange(connectUnix(o.unix_path), inputs[c], c); });
+    }
+    for (auto &t : threads) t.join();
+
+    for (int c = 0; c < clients; c++) EXPECT_EQ(answers[c], expected(inputs[c])) << c;
+
+    auto st = ts.srv.stats();
+    EXPECT_EQ(st.connections, clients);
+    EXPECT_EQ(st.requests, clients * 3000);
+}
+
+TEST(Server, Backpressure)
+{
+    // a client that sends everything before reading: the server stops reading and catches up later
+    server_options o;
+    o.unix_path = socketPath("backpressure");
+    test_server ts(o);
+
+    std::string input;
+    for (int i = 0; i < 20000; i++) input += "a + b + c + d + e + f + g + h + " + std::to_string(i) + "\n";
+
+    int fd = connectUnix(o.unix_path);
+    std::string answers;
+    std::thread reader([fd, &answers] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        char buf[4096];
+        for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0;) answers.append(buf, n);
+    });
+    for (size_t i = 0; i < input.size();) {
+        ssize_t w = write(fd, input.data() + i, input.size() - i);
+        if (w <= 0) break;
+        i += w;
+    }
+    shutdown(fd, SHUT_WR);
+    reader.join();
+    close(fd);
+
+    EXPECT_EQ(answers, expected(input));
+}
+
+TEST(Server, Tcp)
+{
+    server_options o;
+    o.tcp_port = 0;
+    test_server ts(o);
+    ASSERT_GT(ts.srv.port(), 0);
+
+    EXPECT_EQ(exchange(connectTcp(ts.srv.port()), "2^10\n", 3), "13\nResult: 1024\n");
+    EXPECT_EQ(ts.srv.stats().bytes_in, 5);
+    EXPECT_EQ(ts.srv.stats().bytes_out, 16);
+}
+
+TEST(Server, LongLine)
+{
+    server_options o;
+    o.unix_path = socketPath("longline");
+    o.max_line = 1000;
+    test_server ts(o);
+
+    // a line within the limit split over several reads is answered
+    std::string sum = "1";
+    while (sum.size() < 900) sum += "+1";
+    EXPECT_EQ(exchange(connectUnix(o.unix_path), sum + "\n", 4), expected(sum + "\n"));
+
+    // a client that keeps sending without a newline is disconnected
+    int fd = connectUnix(o.unix_path);
+    std::string junk(4000, '1');
+    ssize_t w = send(fd, junk.data(), junk.size(), MSG_NOSIGNAL);
+    EXPECT_EQ(w, ssize_t(junk.size()));
+    char buf[64];
+    EXPECT_LE(read(fd, buf, sizeof(buf)), 0);
+    close(fd);
+
+    EXPECT_EQ(exchange(connectUnix(o.unix_path), "2*3\n", 5), "10\nResult: 6\n");
+}
+
+TEST(Server, Errors)
+{
+    server_options o;
+    o.unix_path = "/nonexistent-directory/socket";
+    EXPECT_THROW(server(o, line_handler()), server::error);
+}
+
+#endif
@@ -0,0 +1,267 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "session.h"
+#include "arena.h"
+
+
+using worksheet = session<double>;
+
+namespace {
+
+// assign one line; returns the names of the updated dependents
+std::vector<std::string> assign(worksheet &ws, const std::string &line)
+{
+    auto tokens = tokenize_view(line);
+    std::vector<std::string> names;
+    for (auto d : ws.assign(tokens, line.data(), line.size())) names.push_back(symbol_table::name(d->name));
+    return names;
+}
+
+std::string value(const worksheet &ws, const std::string &name)
+{
+    auto d = ws.find(name);
+    if (!d) return "undefined";
+    if (d->failed) return "error: " + d->error_msg;
+    std::ostringstream ss;
+    ss << d->value;
+    return ss.str();
+}
+
+bool isAssignment(const std::string &line)
+{
+    return worksheet::isAssignment(tokenize_view(line));
+}
+
+std::string evaluate(const worksheet &ws, const std::string &line)
+{
+    std::ostringstream ss;
+    for (auto &r : ws.evaluate(tokenize_view(line))) ss << r.atom << (r.equal_to_zero ? " = 0;" : ";");
+    return ss.str();
+}
+
+}
+
+TEST(Session, IsAssignment)
+{
+    EXPECT_TRUE(isAssignment("a = 1"));
+    EXPECT_TRUE(isAssignment("a ="));
+    EXPECT_FALSE(isAssignment("a"));
+    EXPECT_FALSE(isAssignment("2 = a"));
+    EXPECT_FALSE(isAssignment("a + 1 = 2"));
+    EXPECT_FALSE(isAssignment("log = 2"));
+}
+
+TEST(Session, Definitions)
+{
+    worksheet ws;
+    assign(ws, "rate = 0.05");
+    assign(ws, "fee = base*rate + 2");
+    EXPECT_EQ(value(ws, "rate"), "0.05");
+    EXPECT_EQ(value(ws, "fee"), "0.05*base + 2");
+    EXPECT_EQ(value(ws, "base"), "undefined");
+
+    EXPECT_EQ(evaluate(ws, "fee*2, fee = 3"), "0.1*base + 4;0.05*base - 1 = 0;");
+    EXPECT_EQ(evaluate(ws, "y"), "y;");
+
+    // defining the free variable updates the dependents
+    EXPECT_EQ(assign(ws, "base = 100"), std::vector<std::string>{ "fee" });
+    EXPECT_EQ(value(ws, "fee"), "7");
+    EXPECT_EQ(ws.stats().definitions, 3);
+    EXPECT_EQ(ws.stats().assignments, 3);
+}
+
+TEST(Session, OnlyDownstreamRecomputed)
+{
+    // two independent chains of 10 definitions each
+    worksheet ws;
+    assign(ws, "a0 = 1");
+    assign(ws, "b0 = 1");
+    for (int i = 1; i < 10; i++) {
+        auto s = std::to_string(i), p = std::to_string(i - 1);
+        assign(ws, "a" + s + " = a" + p + " + 1");
+        assign(ws, "b" + s + " = 2*b" + p);
+    }
+    EXPECT_EQ(value(ws, "a9"), "10");
+    EXPECT_EQ(value(ws, "b9"), "512");
+    EXPECT_EQ(ws.stats().recomputed, 0);
+
+    auto updated = assign(ws, "a0 = 5");
+    EXPECT_EQ(updated.size(), 9);
+    EXPECT_EQ(updated.front(), "a1");
+    EXPECT_EQ(updated.back(), "a9");
+    EXPECT_EQ(ws.stats().last_recomputed, 9);
+    EXPECT_EQ(value(ws, "a9"), "14");
+    EXPECT_EQ(value(ws, "b9"), "512");
+
+    // in the middle of the chain
+    assign(ws, "b5 = 1");
+    EXPECT_EQ(ws.stats().last_recomputed, 4);
+    EXPECT_EQ(value(ws, "b9"), "16");
+
+    // the same value again: nothing to do
+    EXPECT_TRUE(assign(ws, "b5 = 2 - 1").empty());
+    EXPECT_EQ(ws.stats().last_recomputed, 0);
+    EXPECT_EQ(ws.stats().recomputed, 13);
+}
+
+TEST(Session, TopologicalOrder)
+{
+    // diamond: d reads b and c, both read a; d is evaluated once, after both
+    worksheet ws;
+    assign(ws, "a = 1");
+    assign(ws, "b = a + 1");
+    assign(ws, "c = 2*a");
+    assign(ws, "d = b*c");
+    assign(ws, "e = d - b");
+    EXPECT_EQ(value(ws, "e"), "2");
+
+    auto updated = assign(ws, "a = 2");
+    EXPECT_EQ(ws.stats().last_recomputed, 4);
+    ASSERT_EQ(updated.size(), 4);
+    EXPECT_EQ(updated[3], "e");
+    EXPECT_EQ(value(ws, "d"), "12");
+    EXPECT_EQ(value(ws, "e"), "9");
+}
+
+TEST(Session, Cutoff)
+{
+    // the propagation stops at dependents that keep their value
+    worksheet ws;
+    assign(ws, "a = 1");
+    assign(ws, "b = a - a");
+    assign(ws, "c = b + 1");
+    assign(ws, "d = c + a");
+
+    auto updated = assign(ws, "a = 3");
+    EXPECT_EQ(updated, std::vector<std::string>{ "d" });
+    EXPECT_EQ(ws.stats().last_recomputed, 2);   // b and d
+    EXPECT_EQ(ws.stats().unchanged, 1);
+    EXPECT_EQ(value(ws, "d"), "4");
+}
+
+TEST(Session, Optimized)
+{
+    // a + 1 is computed once, log(100) and log(10) when the definition is made
+    worksheet ws;
+    assign(ws, "a = 1");
+    assign(ws, "b = (a + 1)*2 + (a + 1)*log(100)/log(10)");
+    EXPECT_EQ(ws.stats().eliminated, 3);
+    EXPECT_EQ(value(ws, "b"), "8");
+
+    assign(ws, "a = x");
+    EXPECT_EQ(value(ws, "b"), "4*x + 4");
+}
+
+TEST(Session, Redefinition)
+{
+    // the dependencies follow the current definition
+    worksheet ws;
+    assign(ws, "a = 1");
+    assign(ws, "b = 2");
+    assign(ws, "c = a + 10");
+    assign(ws, "c = b + 10");
+    EXPECT_TRUE(assign(ws, "a = 5").empty());
+    EXPECT_EQ(assign(ws, "b = 5"), std::vector<std::string>{ "c" });
+    EXPECT_EQ(value(ws, "c"), "15");
+}
+
+TEST(Session, Errors)
+{
+    worksheet ws;
+    auto rejected = [&ws](const std::string &line, size_t pos, const std::string &msg) {
+        try {
+            assign(ws, line);
+            ADD_FAILURE() << line;
+        }
+        catch (worksheet::error &e) {
+            EXPECT_EQ(e.t.pos, pos) << line;
+            EXPECT_EQ(e.msg, msg) << line;
+        }
+    };
+
+    rejected("x = x + 1", 4, "circular definition of 'x'");
+    assign(ws, "a = b + 1");
+    assign(ws, "c = 2*a");
+    rejected("b = 3 + c", 8, "circular definition of 'b'");
+    rejected("b = a", 4, "circular definition of 'b'");
+    rejected("d = 1, 2", 5, "unexpected input");
+    rejected("d = e = 1", 6, "unexpected input");
+    rejected("d =", 3, "missing operand");
+    rejected("d = a*a", 5, "polynomial of order > 1 not allowed");
+    rejected("d = a*a + (", 5, "polynomial of order > 1 not allowed");
+    rejected("d = a + (", 9, "missing operand");
+
+    // rejected definitions leave no trace
+    EXPECT_EQ(value(ws, "d"), "undefined");
+    EXPECT_EQ(value(ws, "b"), "undefined");
+    EXPECT_EQ(value(ws, "c"), "2*b + 2");
+    EXPECT_EQ(ws.stats().assignments, 2);
+}
+
+// the first error of a line is the parser's, also with evaluation errors before a syntax error
+TEST(Session, ErrorsAsParser)
+{
+    worksheet ws;
+    const char *lines[] = {
+        "x*x + (", "1/0 + (", "2*(x", "x + * 3", "log(x", "log x", "x*x*(y+", "(1+2))", "1, 2 +", "x, x*x = 1 +",
+    };
+    for (std::string line : lines) {
+        auto tokens = tokenize_view(line);
+        std::vector<worksheet::result> out;
+        auto st = parser<worksheet::atom>::try_parse(tokens, out);
+        ASSERT_FALSE(st.ok()) << line;
+        try {
+            ws.evaluate(tokens);
+            ADD_FAILURE() << line;
+        }
+        catch (worksheet::error &e) {
+            EXPECT_EQ(e.msg, st.msg) << line;
+            EXPECT_EQ(e.t.pos, st.where->pos) << line;
+        }
+    }
+}
+
+TEST(Session, FailedDependents)
+{
+    worksheet ws;
+    assign(ws, "a = 1");
+    assign(ws, "b = 1/(a - 2)");
+    assign(ws, "c = b + 1");
+
+    // b fails on recomputation, c fails because of b
+    auto updated = assign(ws, "a = 2");
+    EXPECT_EQ(updated, (std::vector<std::string>{ "b", "c" }));
+    EXPECT_EQ(value(ws, "b"), "error: division by zero");
+    EXPECT_EQ(ws.find("b")->error_pos, 5);
+    EXPECT_EQ(value(ws, "c"), "error: the definition of 'b' failed");
+    EXPECT_EQ(ws.find("c")->error_pos, 4);
+    std::string line = "c";
+    EXPECT_THROW(ws.evaluate(tokenize_view(line)), worksheet::error);
+
+    // and recover
+    assign(ws, "a = 3");
+    EXPECT_EQ(value(ws, "b"), "1");
+    EXPECT_EQ(value(ws, "c"), "2");
+}
+
+TEST(Session, PersistentValues)
+{
+    // values are kept on the heap while the line arena is reset
+    worksheet ws;
+    arena a;
+    for (int i = 0; i < 20; i++) {
+        {
+            arena_scope scope(&a);
+            assign(ws, "v" + std::to_string(i) + " = a + b + c + d + e + f + " + std::to_string(i));
+            assign(ws, "f = " + std::to_string(i));
+            EXPECT_EQ(evaluate(ws, "v0 - v0 + g"), "g;");
+        }
+        a.reset();
+    }
+    EXPECT_EQ(value(ws, "v0"), "a + b + c + d + e + 19");
+    EXPECT_EQ(value(ws, "v19"), "a + b + c + d + e + 38");
+}
@@ -0,0 +1,132 @@
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "stats.h"
+#include "driver.h"
+
+#if CALCULATOR_STATS
+
+namespace {
+
+std::string process(line_context &ctx, const std::vector<std::string> &lines)
+{
+    std::ostringstream text;
+    for (auto &l : lines) {
+        block_output out;
+        processLine(l.data(), l.size(), ctx, out);
+        out.flush_to(text, text);
+    }
+    return text.str();
+}
+
+const std::vector<std::string> lines = { "1+2", "2*x = 4", "1+", "x + y + log(2)" };
+
+}
+
+TEST(Stats, Histogram)
+{
+    log_histogram h;
+    EXPECT_EQ(h.percentile(0.5), 0);
+
+    for (uint64_t v = 1; v <= 100; v++) h.add(v);
+    h.add(0);
+    EXPECT_EQ(h.count(), 101);
+    EXPECT_EQ(h.max(), 100);
+    EXPECT_DOUBLE_EQ(h.mean(), 50);
+    EXPECT_EQ(h.percentile(0.5), 63);      // 51 is in [32, 64)
+    EXPECT_EQ(h.percentile(0.9), 100);     // [64, 128), limited by the largest value
+    EXPECT_EQ(h.percentile(0.0), 0);
+
+    log_histogram g;
+    g.add(1000);
+    h.merge(g);
+    EXPECT_EQ(h.count(), 102);
+    EXPECT_EQ(h.max(), 1000);
+    EXPECT_EQ(h.percentile(1.0), 1000);
+}
+
+TEST(Stats, Counters)
+{
+    line_stats st;
+    line_context ctx;
+    ctx.stats = &st;
+    process(ctx, lines);
+
+    EXPECT_EQ(st.lines, 4);
+    EXPECT_EQ(st.tokens, 3 + 5 + 2 + 8);
+    EXPECT_EQ(st.variables, 3);
+    EXPECT_EQ(st.stage_calls[size_t(stage::tokenize)], 4);
+    EXPECT_EQ(st.stage_calls[size_t(stage::parse)], 4);
+    EXPECT_EQ(st.stage_calls[size_t(stage::solve)], 1);
+    EXPECT_EQ(st.stage_calls[size_t(stage::format)], 3);   // two expressions and an error
+    EXPECT_EQ(st.latency.count(), 4);
+    EXPECT_EQ(st.line_variables.max(), 2);
+    EXPECT_TRUE(st.events.empty());
+
+    // the output does not depend on the instrumentation
+    line_context plain;
+    EXPECT_EQ(process(ctx, lines), process(plain, lines));
+
+    line_stats total;
+    total.merge(st);
+    total.merge(st);
+    EXPECT_EQ(total.lines, 16);
+    EXPECT_EQ(total.stage_calls[size_t(stage::solve)], 4);
+
+    std::ostringstream report;
+    total.report(report);
+    EXPECT_EQ(report.str().find("stats: 16 lines, 72 tokens (4.5 per line), 12 variable references"), 0u);
+    EXPECT_NE(report.str().find("solve"), std::string::npos);
+    EXPECT_NE(report.str().find("line latency ns"), std::string::npos);
+}
+
+TEST(Stats, System)
+{
+    line_stats st;
+    line_context ctx;
+    ctx.stats = &st;
+    ctx.solve_system = true;
+    process(ctx, { "x + y = 3, x - y = 1, x + 1" });
+
+    EXPECT_EQ(st.stage_calls[size_t(stage::solve)], 1);    // the equations are solved together
+    EXPECT_EQ(st.stage_calls[size_t(stage::format)], 1);
+}
+
+TEST(Stats, Trace)
+{
+    line_stats st(3, 2);
+    line_context ctx;
+    ctx.stats = &st;
+    process(ctx, lines);
+
+    // the first and the third line: their stages, then the line itself
+    std::vector<std::string> names;
+    for (auto &e : st.events) names.push_back(e.name);
+    EXPECT_EQ(names, std::vector<std::string>({ "tokenize", "parse", "format", "line", "tokenize", "parse", "format", "line" }));
+
+    auto &line = st.events[3];
+    EXPECT_TRUE(line.line);
+    EXPECT_EQ(line.tokens, 3);
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_FALSE(st.events[i].line);
+        EXPECT_GE(st.events[i].start, line.start);
+        EXPECT_LE(st.events[i].start + st.events[i].duration, line.start + line.duration);
+    }
+
+    std::ostringstream json;
+    writeTrace(json, { &st });
+    auto text = json.str();
+    EXPECT_EQ(text.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+    EXPECT_NE(text.find("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,\"args\":{\"name\":\"worker 3\"}}"), std::string::npos);
+    EXPECT_NE(text.find("\"args\":{\"tokens\":2,\"variables\":0}}"), std::string::npos);
+    EXPECT_EQ(text.substr(text.size() - 4), "\n]}\n");
+
+    size_t complete = 0;
+    for (size_t p = 0; (p = text.find("\"ph\":\"X\"", p)) != std::string::npos; p++) complete++;
+    EXPECT_EQ(complete, 8);
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "program.h"
+#include "store.h"
+
+
+namespace {
+
+const char *path = "test-store.tmp";
+
+const char *library =
+    "hyp: (a^2 + b^2)^0.5\n"
+    "\n"
+    "  area :w*h\r\n"
+    "poly: 3*x^3 - 2*x^2 + x - 7, x = log(a)\n"
+    "shared: log(x+1)*2 + log(x+1)/3 - (x+1)\n"
+    "const: 2^10 - 1e3\n";
+
+void writeFile(const std::string &s)
+{
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f.write(s.data(), s.size());
+}
+
+std::string image()
+{
+    expression_store::builder b;
+    b.addLines(library, strlen(library));
+    return b.image();
+}
+
+std::string openError(expression_store::check c = expression_store::check::full)
+{
+    try {
+        expression_store store(path, c);
+        for (size_t i = 0; i < store.size(); i++) stored_evaluator ev(store[i]);
+    }
+    catch (expression_store::error &e) {
+        return e.msg;
+    }
+    return "";
+}
+
+// 'name: source' and the message of the first invalid line
+std::string buildError(const char *lines)
+{
+    try {
+        expression_store::builder b;
+        b.addLines(lines, strlen(lines));
+    }
+    catch (expression_store::builder::line_error &e) {
+        return std::to_string(e.line) + ":" + std::to_string(e.pos) + ": " + e.msg;
+    }
+    return "";
+}
+
+}
+
+TEST(Store, MatchesProgram)
+{
+    writeFile(image());
+    {
+        expression_store store(path);
+        ASSERT_EQ(store.size(), 5);
+        EXPECT_EQ(store[0].name(), "area");
+        EXPECT_EQ(store[4].name(), "shared");
+        EXPECT_EQ(store.symbols(), 5);      // w, h, a, b, x once each
+        EXPECT_EQ(store.find("hyp"), 2);
+        EXPECT_EQ(store.find("hy"), -1);
+        EXPECT_EQ(store.find("hypo"), -1);
+        EXPECT_EQ(store.find(""), -1);
+
+        double bindings[] = { 1.5, 2, 0.25 };
+        for (size_t i = 0; i < store.size(); i++) {
+            auto e = store[i];
+            auto p = program<double>::compile(tokenize(e.source()));
+            p.optimize();
+
+            ASSERT_EQ(e.variables(), p.vars.size());
+            for (size_t v = 0; v < p.vars.size(); v++) EXPECT_EQ(e.variable(v), p.vars[v]);
+
+            // in place
+            stored_evaluator sev(e);
+            evaluator<double> ev(p);
+            auto &r = sev.run(bindings);
+            auto &expected = ev.run(bindings);
+            ASSERT_EQ(r.size(), expected.size()) << e.name();
+            for (size_t k = 0; k < r.size(); k++) {
+                EXPECT_EQ(r[k].atom, expected[k].atom) << e.name();
+                EXPECT_EQ(r[k].equal_to_zero, expected[k].equal_to_zero);
+            }
+
+            // copied
+            auto q = e.load();
+            ASSERT_EQ(q.code.size(), p.code.size());
+            for (size_t pc = 0; pc < p.code.size(); pc++) {
+                EXPECT_EQ(q.code[pc].code, p.code[pc].code);
+                EXPECT_EQ(q.code[pc].arg, p.code[pc].arg);
+                EXPECT_EQ(q.where[pc], p.where[pc]) << e.name() << " op " << pc;
+            }
+            EXPECT_EQ(q.consts, p.consts);
+            EXPECT_EQ(q.depth, p.depth);
+            EXPECT_EQ(q.temps, p.temps);
+        }
+        EXPECT_GT(store[store.find("shared")].temps, 0);
+    }
+    std::remove(path);
+}
+
+TEST(Store, Library)
+{
+    EXPECT_EQ(buildError("a: 1\nb: 2*(x\n"), "2:7: missing right parenthesis");
+    EXPECT_EQ(buildError("a: 1\n\n  x+1\n"), "3:2: 'name: expression' expected");
+    EXPECT_EQ(buildError(" : 1\n"), "1:1: 'name: expression' expected");
+    EXPECT_EQ(buildError("a: 1\na :2\n"), "2:0: duplicate expression a");
+    EXPECT_EQ(buildError("a:   \n"), "1:5: missing expression");
+    EXPECT_EQ(buildError("a b: x\n"), "");
+
+    // the same library gives the same bytes
+    EXPECT_EQ(image(), image());
+}
+
+TEST(Store, Integrity)
+{
+    const auto good = image();
+    writeFile(good);
+    EXPECT_EQ(openError(), "");
+
+    // a changed byte anywhere is found by the checksum
+    for (size_t i = 0; i < good.size(); i += 7) {
+        auto s = good;
+        s[i] ^= 0x10;
+        writeFile(s);
+        EXPECT_NE(openError(), "") << "byte " << i;
+    }
+
+    auto s = good;
+    s[0] = 'X';
+    writeFile(s);
+    EXPECT_EQ(openError(), std::string(path) + " is not an expression store");
+
+    s = good;
+    s[8] = 2;
+    writeFile(s);
+    EXPECT_EQ(openError(), std::string(path) + ": store version 2, expected 1");
+
+    writeFile(good.substr(0, good.size() - 8));
+    EXPECT_EQ(openError(), std::string(path) + ": damaged store (truncated)");
+
+    // without the checksum, an invalid op is still found before its evaluation
+    expression_store::builder b;
+    b.add("f", "x + 1");
+    s = b.image();
+    uint64_t ops;
+    memcpy(&ops, &s[64], sizeof(ops));     // offset of the op section in the header
+    ASSERT_EQ(s[ops + 8], char(op_t::push_const));
+    s[ops + 12] = 9;    // push_var x, push_const 9 of the 1 constant
+    writeFile(s);
+    EXPECT_EQ(openError(expression_store::check::full), std::string(path) + ": damaged store (checksum)");
+    EXPECT_EQ(openError(expression_store::check::header), "damaged store");
+
+    // nor are the depth, results and temps of the index entry: nothing is allocated for them
+    s = b.image();
+    uint64_t index;
+    memcpy(&index, &s[48], sizeof(index));     // offset of the index section
+    for (size_t field : { 10, 11, 12 }) {
+        auto d = s;
+        d[index + 4 * field + 3] ^= 0x40;
+        writeFile(d);
+        EXPECT_EQ(openError(expression_store::check::header), "damaged store") << "field " << field;
+    }
+
+    std::remove(path);
+}
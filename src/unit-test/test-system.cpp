@@ -0,0 +1,125 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <map>
+
+#include <gtest/gtest.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "affine.h"
+#include "system.h"
+
+using atom = affine<double>;
+using sys  = sparse_system<double>;
+
+static sys makeSystem(const std::string &input)
+{
+    sys s;
+    for (auto &r : parser<atom>::parse(tokenize(input))) s.add(r.atom);
+    return s;
+}
+
+static double valueOf(const sys::solution &s, const std::string &name)
+{
+    for (auto &v : s.values) {
+        if (symbol_table::name(v.first) == name) {
+            EXPECT_TRUE(v.second.isConstant());
+            return v.second.d;
+        }
+    }
+    ADD_FAILURE() << name << " not solved";
+    return 0;
+}
+
+TEST(SparseSystem, Unique)
+{
+    auto s = makeSystem("x+y=3, x-y=1").solve();
+
+    EXPECT_EQ(s.kind, sys::status::unique);
+    EXPECT_DOUBLE_EQ(valueOf(s, "x"), 2);
+    EXPECT_DOUBLE_EQ(valueOf(s, "y"), 1);
+}
+
+TEST(SparseSystem, Underdetermined)
+{
+    auto s = makeSystem("x+y+z=3, x-y=1, 2*x+2*y+2*z=6").solve();
+
+    EXPECT_EQ(s.kind, sys::status::underdetermined);
+    ASSERT_EQ(s.free_vars.size(), 1);
+    ASSERT_EQ(s.values.size(), 2);
+
+    // substitute a value for the free variable and check the equations
+    double f = 5;
+    auto fv = s.free_vars[0];
+    std::map<std::string, double> v;
+    v[symbol_table::name(fv)] = f;
+    for (auto &p : s.values) {
+        auto &a = p.second;
+        double val = a.d;
+        for (auto &t : a.x) {
+            EXPECT_EQ(t.first, fv);
+            val += t.second * f;
+        }
+        v[symbol_table::name(p.first)] = val;
+    }
+    EXPECT_NEAR(v["x"] + v["y"] + v["z"], 3, 1e-12);
+    EXPECT_NEAR(v["x"] - v["y"], 1, 1e-12);
+}
+
+TEST(SparseSystem, Inconsistent)
+{
+    EXPECT_EQ(makeSystem("x+y=3, x+y=4").solve().kind, sys::status::inconsistent);
+    EXPECT_EQ(makeSystem("1=2").solve().kind, sys::status::inconsistent);
+    EXPECT_EQ(makeSystem("1=1").solve().kind, sys::status::unique);
+}
+
+TEST(SparseSystem, CancelledVariablesAreFree)
+{
+    auto s = makeSystem("x=1, y-y=0").solve();
+
+    EXPECT_EQ(s.kind, sys::status::underdetermined);
+    ASSERT_EQ(s.free_vars.size(), 1);
+    EXPECT_EQ(symbol_table::name(s.free_vars[0]), "y");
+}
+
+TEST(SparseSystem, LargeSparse)
+{
+    // random sparse diagonally dominant system with a known solution
+    const int n = 500;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> col(0, n - 1);
+    std::uniform_real_distribution<double> val(-1, 1);
+
+    std::vector<var_id> ids;
+    std::vector<double> x(n);
+    for (int i = 0; i < n; i++) {
+        ids.push_back(symbol_table::intern("s" + std::to_string(i)));
+        x[i] = val(rng) * 10;
+    }
+
+    sys system;
+    for (int i = 0; i < n; i++) {
+        atom eq(8, ids[i]);
+        double rhs = 8 * x[i];
+        for (int k = 0; k < 3; k++) {
+            int j = col(rng);
+            if (j == i) continue;
+            double a = val(rng);
+            eq += atom(a, ids[j]);
+            rhs += a * x[j];
+        }
+        eq -= atom(rhs);
+        system.add(eq);
+    }
+
+    auto s = system.solve();
+    ASSERT_EQ(s.kind, sys::status::unique);
+    ASSERT_EQ(s.values.size(), n);
+    for (auto &v : s.values) {
+        int i = std::stoi(symbol_table::name(v.first).substr(1));
+        EXPECT_NEAR(v.second.d, x[i], 1e-9);
+    }
+}